@@ -0,0 +1,276 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * ConnectionManager tests: link and attempt bounds, connection parameters, timeouts and
+ * retries against a recording link, then whole fleet polls against SimulatedConnectionLink.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "embedded_BLE_connection.h"
+#include "simulated_link.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_FLEET_SIZE             (64)
+#define TEST_POLL_BYTES             (4096)
+#define TEST_FAILURE_PERCENT        (5)
+#define TEST_MAX_STEPS              (10000000)
+
+/* Records the calls of the manager */
+class RecordingLink : public ConnectionLink
+{
+public:
+    RecordingLink() : connects(0), cancels(0), disconnects(0), updates(0), interval(0) {}
+
+    virtual ble_error_t connect(uint8_t addr_type, const uint8_t* bd_addr)
+    {
+        connects++;
+        return BLE_ERROR_NONE;
+    }
+
+    virtual void cancel(uint8_t addr_type, const uint8_t* bd_addr)
+    {
+        cancels++;
+    }
+
+    virtual void disconnect(uint16_t conn_id)
+    {
+        disconnects++;
+    }
+
+    virtual ble_error_t setParameters(uint16_t conn_id, const uint8_t* bd_addr, const wiced_bt_ble_conn_params_t& params)
+    {
+        updates++;
+        interval = params.interval_min;
+        return BLE_ERROR_NONE;
+    }
+
+    int      connects;
+    int      cancels;
+    int      disconnects;
+    int      updates;
+    uint16_t interval;
+};
+
+static const wiced_bt_ble_conn_params_t bulk_parameters = { 6, 12, 0, 200 };
+static const wiced_bt_ble_conn_params_t idle_parameters = { 80, 160, 4, 600 };
+static const wiced_bt_ble_conn_params_t keep_parameters = { 40, 40, 0, 400 };
+
+static void test_scheduling(void)
+{
+    RecordingLink               link;
+    ConnectionManager           manager(link);
+    ConnectionManagerParameters params;
+    ConnectionStatistics        stats;
+    uint8_t                     peers[3][BD_ADDR_LEN] = { { 1 }, { 2 }, { 3 } };
+    int                         i = 0;
+
+    memset(&params, 0, sizeof(params));
+    params.links              = 2;
+    params.connects           = 1;
+    params.max_attempts       = 2;
+    params.backoff_ms         = 100;
+    params.backoff_max_ms     = 1000;
+    params.connect_timeout_ms = 1000;
+    params.poll_timeout_ms    = 5000;
+    params.bulk               = bulk_parameters;
+    params.idle               = idle_parameters;
+    manager.configure(params);
+
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, manager.add(0, peers[i], 0, 0));
+    }
+    TEST_ASSERT_EQUAL(BLE_ERROR_INVALID_STATE, manager.add(0, peers[0], 0, 0));
+
+    /* One connection attempt at a time, bulk parameters once connected */
+    manager.service(0);
+    TEST_ASSERT_EQUAL(1, link.connects);
+    TEST_ASSERT_TRUE(manager.connected(peers[0], 0x40, 10));
+    TEST_ASSERT_EQUAL(1, link.updates);
+    TEST_ASSERT_EQUAL(bulk_parameters.interval_min, link.interval);
+
+    /* Second link; a connection nobody asked for is dropped */
+    manager.service(10);
+    TEST_ASSERT_EQUAL(2, link.connects);
+    TEST_ASSERT_FALSE(manager.connected(peers[2], 0x41, 20));
+    TEST_ASSERT_EQUAL(1, link.disconnects);
+
+    /* Both links busy */
+    manager.service(20);
+    TEST_ASSERT_EQUAL(2, link.connects);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, manager.setWorkload(0x40, CONNECTION_WORKLOAD_IDLE));
+    TEST_ASSERT_EQUAL(idle_parameters.interval_min, link.interval);
+
+    /* The second attempt times out at 1010 and is retried later, the third peer takes the link */
+    TEST_ASSERT_EQUAL(510, manager.service(500));
+    manager.service(1010);
+    TEST_ASSERT_EQUAL(1, link.cancels);
+    TEST_ASSERT_EQUAL(3, link.connects);
+
+    TEST_ASSERT_TRUE(manager.completed(0x40, true, 1100));
+    TEST_ASSERT_EQUAL(2, link.disconnects);
+    TEST_ASSERT_TRUE(manager.disconnected(0x40, 1110));
+    manager.getStatistics(stats);
+    TEST_ASSERT_EQUAL(1, stats.polled);
+    TEST_ASSERT_EQUAL(1, stats.timeouts);
+    TEST_ASSERT_EQUAL(1, stats.retries);
+    TEST_ASSERT_EQUAL(1, stats.unexpected);
+    TEST_ASSERT_EQUAL(1, stats.links);
+
+    /* A link dropped in the middle of a poll is retried */
+    TEST_ASSERT_TRUE(manager.connected(peers[2], 0x42, 1200));
+    TEST_ASSERT_TRUE(manager.disconnected(0x42, 1300));
+    manager.getStatistics(stats);
+    TEST_ASSERT_EQUAL(2, stats.retries);
+}
+
+/* Polls the whole fleet in simulated time, returns the time it took (ms) */
+static uint32_t poll_fleet(uint8_t links, const wiced_bt_ble_conn_params_t& bulk, uint32_t poll_bytes)
+{
+    SimulatedConnectionParameters simulation;
+    ConnectionManagerParameters   params;
+    ConnectionStatistics          stats;
+    uint8_t                       peer[BD_ADDR_LEN] = { 0 };
+    uint32_t                      now_ms = 0;
+    uint32_t                      wait = 0;
+    uint32_t                      most_links = 0;
+    int                           i = 0;
+
+    memset(&simulation, 0, sizeof(simulation));
+    simulation.connect_ms              = 20;
+    simulation.jitter_ms               = 1000;
+    simulation.initial_interval        = 40;
+    simulation.update_events           = 6;
+    simulation.poll_bytes              = poll_bytes;
+    simulation.bytes_per_event         = 80;
+    simulation.connect_failure_percent = TEST_FAILURE_PERCENT;
+    simulation.seed                    = 7;
+
+    SimulatedConnectionLink link(simulation);
+    ConnectionManager       manager(link);
+
+    link.setManager(&manager);
+
+    memset(&params, 0, sizeof(params));
+    params.links              = links;
+    params.connects           = 1;
+    params.max_attempts       = 4;
+    params.backoff_ms         = 500;
+    params.backoff_max_ms     = 4000;
+    params.connect_timeout_ms = 3000;
+    params.poll_timeout_ms    = 60000;
+    params.bulk               = bulk;
+    params.idle               = idle_parameters;
+    manager.configure(params);
+
+    for (i = 0; i < TEST_FLEET_SIZE; i++)
+    {
+        peer[BD_ADDR_LEN - 1] = (uint8_t)i;
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, manager.add(0, peer, 0, 0));
+    }
+
+    for (i = 0; i < TEST_MAX_STEPS; i++)
+    {
+        uint32_t manager_wait = 0;
+        uint32_t link_wait = link.service(now_ms);
+
+        manager_wait = manager.service(now_ms);
+        wait = link.service(now_ms);
+        wait = (link_wait < wait) ? link_wait : wait;
+        wait = (manager_wait < wait) ? manager_wait : wait;
+
+        manager.getStatistics(stats);
+        most_links = (stats.links > most_links) ? stats.links : most_links;
+        if (stats.polled + stats.failed == TEST_FLEET_SIZE)
+        {
+            break;
+        }
+        TEST_ASSERT_NOT_EQUAL(osWaitForever, wait);
+        now_ms += wait ? wait : 1;
+    }
+
+    TEST_ASSERT_EQUAL(TEST_FLEET_SIZE, stats.polled + stats.failed);
+    TEST_ASSERT_TRUE(stats.polled > 0);
+    TEST_ASSERT_TRUE(most_links <= links);
+    printf("%u links, %u B per poll: %d peers in %lu ms, %lu failed, %lu timeouts, %lu retries\r\n",
+           links, (unsigned int)poll_bytes, TEST_FLEET_SIZE, (unsigned long)stats.elapsed_ms,
+           (unsigned long)stats.failed, (unsigned long)stats.timeouts, (unsigned long)stats.retries);
+
+    return stats.elapsed_ms;
+}
+
+static void test_fleet(void)
+{
+    poll_fleet(4, bulk_parameters, TEST_POLL_BYTES);
+}
+
+static void test_concurrency(void)
+{
+    uint32_t sequential = poll_fleet(1, keep_parameters, TEST_POLL_BYTES);
+    uint32_t parallel   = poll_fleet(4, keep_parameters, TEST_POLL_BYTES);
+    uint32_t bulk       = poll_fleet(8, bulk_parameters, TEST_POLL_BYTES);
+
+    /* More links overlap the connections, short intervals speed up the transfers */
+    TEST_ASSERT_TRUE(parallel < sequential);
+    TEST_ASSERT_TRUE(bulk < parallel);
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("ConnectionManager scheduling", test_scheduling),
+    Case("ConnectionManager fleet poll", test_fleet),
+    Case("ConnectionManager links and intervals", test_concurrency),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
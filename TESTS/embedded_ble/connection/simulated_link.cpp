@@ -0,0 +1,288 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Simulated connection link for the connection manager tests
+ */
+
+#include <string.h>
+#include "simulated_link.h"
+
+using namespace cypress::embedded;
+
+#define SIMULATED_LINK_FREE             (0)
+#define SIMULATED_LINK_OPENED           (1)
+#define SIMULATED_LINK_CONNECTING       (2)
+#define SIMULATED_LINK_NEVER            (3)
+#define SIMULATED_LINK_CONNECTED        (4)
+#define SIMULATED_LINK_POLLED           (5)
+#define SIMULATED_LINK_DISCONNECTING    (6)
+
+#define SIMULATED_LINK_CONN_ID_BASE     (0x0080)
+#define SIMULATED_LINK_INTERVAL_US      (1250)
+
+SimulatedConnectionLink::SimulatedConnectionLink(const SimulatedConnectionParameters& parameters) :
+    params(parameters), manager(NULL), state(parameters.seed ? parameters.seed : 1), now_ms(0), next_conn_id(0)
+{
+    memset(connections, 0, sizeof(connections));
+    if (params.initial_interval == 0)
+    {
+        params.initial_interval = 40;
+    }
+    if (params.bytes_per_event == 0)
+    {
+        params.bytes_per_event = 20;
+    }
+}
+
+/* xorshift32, called with the lock held */
+uint32_t SimulatedConnectionLink::random(uint32_t range)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return range ? (state % range) : 0;
+}
+
+ble_error_t SimulatedConnectionLink::connect(uint8_t addr_type, const uint8_t* bd_addr)
+{
+    uint8_t i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        if (connections[i].state == SIMULATED_LINK_FREE)
+        {
+            memcpy(connections[i].bd_addr, bd_addr, BD_ADDR_LEN);
+            connections[i].state = SIMULATED_LINK_OPENED;
+            lock.unlock();
+            return BLE_ERROR_NONE;
+        }
+    }
+
+    lock.unlock();
+
+    return BLE_ERROR_NO_MEM;
+}
+
+void SimulatedConnectionLink::cancel(uint8_t addr_type, const uint8_t* bd_addr)
+{
+    uint8_t i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        Connection& connection = connections[i];
+
+        if ((connection.state == SIMULATED_LINK_OPENED || connection.state == SIMULATED_LINK_CONNECTING ||
+             connection.state == SIMULATED_LINK_NEVER) && memcmp(connection.bd_addr, bd_addr, BD_ADDR_LEN) == 0)
+        {
+            connection.state = SIMULATED_LINK_FREE;
+        }
+    }
+
+    lock.unlock();
+}
+
+void SimulatedConnectionLink::disconnect(uint16_t conn_id)
+{
+    uint8_t i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        Connection& connection = connections[i];
+
+        if (connection.state >= SIMULATED_LINK_CONNECTED && connection.conn_id == conn_id)
+        {
+            /* Reported at the next connection event */
+            connection.state  = SIMULATED_LINK_DISCONNECTING;
+            connection.due_ms = now_ms + (connection.interval * SIMULATED_LINK_INTERVAL_US + 999) / 1000;
+        }
+    }
+
+    lock.unlock();
+}
+
+/* Counts the bytes transferred up to time_ms at the current interval. Called with the lock held */
+void SimulatedConnectionLink::advance(Connection& connection, uint32_t time_ms)
+{
+    uint32_t events = (time_ms - connection.mark_ms) * 1000 / (connection.interval * SIMULATED_LINK_INTERVAL_US);
+    uint32_t bytes  = events * params.bytes_per_event;
+
+    connection.remaining = (bytes < connection.remaining) ? connection.remaining - bytes : 0;
+    connection.mark_ms   = time_ms;
+}
+
+/* Sets due_ms to the end of the transfer or to the parameter update. Called with the lock held */
+void SimulatedConnectionLink::transfer(Connection& connection)
+{
+    uint32_t events = (connection.remaining + params.bytes_per_event - 1) / params.bytes_per_event;
+    uint32_t end_ms = connection.mark_ms + (events * connection.interval * SIMULATED_LINK_INTERVAL_US + 999) / 1000;
+
+    connection.due_ms = end_ms;
+    if (connection.next_interval != 0 && (int32_t)(connection.update_ms - end_ms) < 0)
+    {
+        connection.due_ms = connection.update_ms;
+    }
+}
+
+ble_error_t SimulatedConnectionLink::setParameters(uint16_t conn_id, const uint8_t* bd_addr, const wiced_bt_ble_conn_params_t& parameters)
+{
+    uint8_t i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        Connection& connection = connections[i];
+
+        if (connection.state == SIMULATED_LINK_CONNECTED && connection.conn_id == conn_id)
+        {
+            /* The central picks the shortest interval of the range, applied update_events connection
+             * events after the request */
+            advance(connection, now_ms);
+            connection.next_interval = parameters.interval_min;
+            connection.update_ms     = now_ms + (params.update_events * connection.interval * SIMULATED_LINK_INTERVAL_US) / 1000;
+            transfer(connection);
+        }
+    }
+
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+uint32_t SimulatedConnectionLink::service(uint32_t time_ms)
+{
+    struct
+    {
+        uint8_t  bd_addr[BD_ADDR_LEN];
+        uint16_t conn_id;
+        uint8_t  state;
+    } reports[EMBEDDED_BLE_CONNECTION_MAX_LINKS];
+    uint32_t wait = osWaitForever;
+    uint8_t  count = 0;
+    uint8_t  i = 0;
+
+    lock.lock();
+
+    now_ms = time_ms;
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        Connection& connection = connections[i];
+
+        if (connection.state == SIMULATED_LINK_OPENED)
+        {
+            connection.state = SIMULATED_LINK_CONNECTING;
+            if (random(100) < params.connect_failure_percent)
+            {
+                /* Out of range, left to the manager timeout */
+                connection.state = SIMULATED_LINK_NEVER;
+                continue;
+            }
+            connection.due_ms = now_ms + params.connect_ms + random(params.jitter_ms + 1);
+        }
+
+        if (connection.state != SIMULATED_LINK_CONNECTING && connection.state != SIMULATED_LINK_CONNECTED &&
+            connection.state != SIMULATED_LINK_DISCONNECTING)
+        {
+            continue;
+        }
+
+        /* A parameter update may apply before the transfer ends */
+        if (connection.state == SIMULATED_LINK_CONNECTED && connection.next_interval != 0 &&
+            (int32_t)(connection.update_ms - now_ms) <= 0)
+        {
+            advance(connection, connection.update_ms);
+            connection.interval      = connection.next_interval;
+            connection.next_interval = 0;
+            transfer(connection);
+        }
+
+        if ((int32_t)(connection.due_ms - now_ms) > 0)
+        {
+            wait = ((connection.due_ms - now_ms) < wait) ? (connection.due_ms - now_ms) : wait;
+            continue;
+        }
+
+        memcpy(reports[count].bd_addr, connection.bd_addr, BD_ADDR_LEN);
+        reports[count].state = connection.state;
+
+        if (connection.state == SIMULATED_LINK_CONNECTING)
+        {
+            connection.state         = SIMULATED_LINK_CONNECTED;
+            connection.conn_id       = SIMULATED_LINK_CONN_ID_BASE + next_conn_id++;
+            connection.interval      = params.initial_interval;
+            connection.next_interval = 0;
+            connection.remaining     = params.poll_bytes;
+            connection.mark_ms       = now_ms;
+            transfer(connection);
+            wait = ((connection.due_ms - now_ms) < wait) ? (connection.due_ms - now_ms) : wait;
+        }
+        else if (connection.state == SIMULATED_LINK_CONNECTED)
+        {
+            connection.state = SIMULATED_LINK_POLLED;
+        }
+        else
+        {
+            connection.state = SIMULATED_LINK_FREE;
+        }
+        reports[count].conn_id = connection.conn_id;
+        count++;
+    }
+
+    lock.unlock();
+
+    /* Reported without the lock, the manager calls the link with its own lock held */
+    for (i = 0; i < count && manager != NULL; i++)
+    {
+        if (reports[i].state == SIMULATED_LINK_CONNECTING)
+        {
+            manager->connected(reports[i].bd_addr, reports[i].conn_id, time_ms);
+        }
+        else if (reports[i].state == SIMULATED_LINK_CONNECTED)
+        {
+            manager->completed(reports[i].conn_id, true, time_ms);
+        }
+        else
+        {
+            manager->disconnected(reports[i].conn_id, time_ms);
+        }
+    }
+
+    return wait;
+}
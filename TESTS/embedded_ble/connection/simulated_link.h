@@ -0,0 +1,120 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Simulated connection link for the connection manager tests: models the connection and
+ * transfer latency of a fleet of peripherals and reports the connections, polls and
+ * disconnections to the manager as a controller would.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "embedded_BLE_connection.h"
+
+namespace cypress
+{
+namespace embedded
+{
+
+/** Defines the simulated fleet */
+struct SimulatedConnectionParameters
+{
+    uint32_t connect_ms;                /**< Time to connect, the peer's advertising interval on average */
+    uint32_t jitter_ms;                 /**< Random extra time added to each connection */
+    uint16_t initial_interval;          /**< Connection interval before the first parameter update, 1.25 ms units */
+    uint16_t update_events;             /**< Connection events before new parameters apply */
+    uint32_t poll_bytes;                /**< Bytes read from each peer */
+    uint16_t bytes_per_event;           /**< Bytes transferred per connection event */
+    uint8_t  connect_failure_percent;   /**< Connections that never complete (the manager times them out) */
+    uint32_t seed;                      /**< Seed of the pseudo random generator */
+};
+
+/** Defines a link simulating the connections and the polls of a fleet, which report their end themselves */
+class SimulatedConnectionLink : public ConnectionLink
+{
+public:
+    SimulatedConnectionLink(const SimulatedConnectionParameters& params);
+
+    /** Sets the manager notified of the connections and polls */
+    void setManager(ConnectionManager* manager)
+    {
+        this->manager = manager;
+    }
+
+    virtual ble_error_t connect(uint8_t addr_type, const uint8_t* bd_addr);
+
+    virtual void cancel(uint8_t addr_type, const uint8_t* bd_addr);
+
+    virtual void disconnect(uint16_t conn_id);
+
+    virtual ble_error_t setParameters(uint16_t conn_id, const uint8_t* bd_addr, const wiced_bt_ble_conn_params_t& params);
+
+    /** Reports the connections, polls and disconnections due at now_ms to the manager.
+     *
+     * @return time until the next report (ms), osWaitForever when there is none
+     */
+    uint32_t service(uint32_t now_ms);
+
+private:
+    struct Connection
+    {
+        uint8_t  bd_addr[BD_ADDR_LEN];
+        uint8_t  state;
+        uint16_t conn_id;
+        uint16_t interval;
+        uint16_t next_interval;
+        uint32_t remaining;
+        uint32_t mark_ms;
+        uint32_t update_ms;
+        uint32_t due_ms;
+    };
+
+    uint32_t random(uint32_t range);
+    void advance(Connection& connection, uint32_t time_ms);
+    void transfer(Connection& connection);
+
+    SimulatedConnectionParameters params;
+    ConnectionManager*            manager;
+    Connection                    connections[EMBEDDED_BLE_CONNECTION_MAX_LINKS];
+    uint32_t                      state;
+    uint32_t                      now_ms;
+    uint16_t                      next_conn_id;
+    rtos::Mutex                   lock;
+};
+
+}
+
+}
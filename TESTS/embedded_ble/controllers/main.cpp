@@ -0,0 +1,325 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Multiple controller tests: WICED_HCI_MAX_CONTROLLERS simulated controllers, each behind its
+ * own HCI driver, stream GATT notifications, advertisement reports and mesh proxy data tagged
+ * with their index while an application thread per controller sends tagged write commands.
+ * Checks that every event reaches the callbacks of its own controller and reports the rate.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "wiced_hci.h"
+#include "wiced_hci_bt_dm.h"
+#include "wiced_hci_bt_ble.h"
+#include "wiced_hci_bt_gatt.h"
+#include "wiced_hci_bt_mesh.h"
+#include "simulated_controller.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_EVENTS                 (3000)
+#define TEST_OUTSTANDING_EVENTS     (32)
+#define TEST_START_TIMEOUT_MS       (10000)
+#define TEST_STREAM_TIMEOUT_MS      (60000)
+#define TEST_THREAD_STACK_SIZE      (1024)
+#define TEST_WRITE_LENGTH           (20)
+
+/* What a controller delivered to its callbacks */
+struct Deliveries
+{
+    uint32_t notifications;
+    uint32_t adverts;
+    uint32_t proxy;
+    uint32_t foreign;
+    uint32_t enabled;
+};
+
+static SimulatedController controllers[WICED_HCI_MAX_CONTROLLERS];
+static Deliveries          delivered[WICED_HCI_MAX_CONTROLLERS];
+
+static uint32_t delivered_events(wiced_hci_controller_t controller)
+{
+    wiced_hci_event_stats_t stats;
+
+    wiced_hci_get_event_stats(controller, &stats);
+    return delivered[controller].notifications + delivered[controller].adverts + delivered[controller].proxy +
+           stats.events_dropped;
+}
+
+static wiced_bt_gatt_status_t gatt_callback(wiced_hci_controller_t controller, wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t* p_data)
+{
+    if (event == GATT_OPERATION_CPLT_EVT && p_data->operation_complete.op == GATTC_OPTYPE_NOTIFICATION)
+    {
+        if (p_data->operation_complete.response_data.att_value.p_data[4] != controller)
+        {
+            core_util_atomic_incr_u32(&delivered[controller].foreign, 1);
+        }
+        core_util_atomic_incr_u32(&delivered[controller].notifications, 1);
+    }
+    return WICED_BT_GATT_SUCCESS;
+}
+
+static void scan_callback(wiced_hci_controller_t controller, wiced_bt_ble_scan_results_t* p_scan_result, uint8_t* p_adv_data)
+{
+    if (p_scan_result->remote_bd_addr[BD_ADDR_LEN - 1] != controller || p_adv_data[0] != controller)
+    {
+        core_util_atomic_incr_u32(&delivered[controller].foreign, 1);
+    }
+    core_util_atomic_incr_u32(&delivered[controller].adverts, 1);
+}
+
+static void proxy_callback(wiced_hci_controller_t controller, const uint8_t* packet, uint32_t packet_len)
+{
+    if (packet_len < 2 || packet[1] != controller)
+    {
+        core_util_atomic_incr_u32(&delivered[controller].foreign, 1);
+    }
+    core_util_atomic_incr_u32(&delivered[controller].proxy, 1);
+}
+
+static cy_rslt_t management_callback(wiced_hci_controller_t controller, wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t* p_event_data)
+{
+    if (event == BTM_ENABLED_EVT)
+    {
+        core_util_atomic_incr_u32(&delivered[controller].enabled, 1);
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+/* Streams the events of a controller, and writes to it, from two threads of its own */
+class ControllerRun
+{
+public:
+    ControllerRun() :
+        controller(0),
+        feeder(osPriorityNormal, TEST_THREAD_STACK_SIZE),
+        application(osPriorityNormal, TEST_THREAD_STACK_SIZE)
+    {
+    }
+
+    void start(wiced_hci_controller_t controller)
+    {
+        this->controller = controller;
+        feeder.start(callback(this, &ControllerRun::feed));
+        application.start(callback(this, &ControllerRun::send));
+    }
+
+    void join()
+    {
+        feeder.join();
+        application.join();
+    }
+
+private:
+    /* Each event carries the index of the controller where its callback reads it back */
+    void feed()
+    {
+        uint8_t  payload[24];
+        uint16_t opcode = 0;
+        uint16_t length = 0;
+        uint32_t i = 0;
+
+        for (i = 0; i < TEST_EVENTS; i++)
+        {
+            memset(payload, 0, sizeof(payload));
+            switch (i % 3)
+            {
+                case 0:
+                    /* conn_id, handle, value */
+                    opcode = HCI_CONTROL_GATT_EVENT_NOTIFICATION;
+                    length = 24;
+                    payload[0] = 1;
+                    payload[2] = 0x2a;
+                    memcpy(&payload[4], &i, sizeof(i));
+                    payload[8] = controller;
+                    break;
+                case 1:
+                    /* event type, address type, address (reversed), rssi, data */
+                    opcode = HCI_CONTROL_LE_EVENT_ADVERTISEMENT_REPORT;
+                    length = 20;
+                    payload[2] = controller;
+                    payload[8] = 0xc0;
+                    payload[9] = controller;
+                    break;
+                default:
+                    /* a complete network PDU */
+                    opcode = HCI_CONTROL_MESH_EVENT_PROXY_DATA;
+                    length = 16;
+                    payload[1] = controller;
+                    break;
+            }
+
+            /* Pace the controller as its UART flow control would */
+            while (i - delivered_events(controller) >= TEST_OUTSTANDING_EVENTS)
+            {
+                ThisThread::sleep_for(1);
+            }
+            controllers[controller].sendEvent(opcode, payload, length);
+        }
+    }
+
+    void send()
+    {
+        uint8_t  value[TEST_WRITE_LENGTH];
+        uint32_t i = 0;
+
+        memset(value, controller, sizeof(value));
+        for (i = 0; i < TEST_EVENTS / 3; i++)
+        {
+            wiced_bt_gatt_send_write_command(controller, 1, 0x2a, value, sizeof(value));
+        }
+    }
+
+    wiced_hci_controller_t controller;
+    Thread                 feeder;
+    Thread                 application;
+};
+
+static void test_start(void)
+{
+    uint64_t start_ms = rtos::Kernel::get_ms_count();
+    wiced_hci_controller_t controller = 0;
+
+    for (controller = 0; controller < WICED_HCI_MAX_CONTROLLERS; controller++)
+    {
+        TEST_ASSERT_TRUE(ble_attach_embedded_hci_driver(controller, controllers[controller]));
+        TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_gatt_register(controller, gatt_callback));
+        TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_stack_init(controller, management_callback));
+    }
+    TEST_ASSERT_NOT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_stack_init(WICED_HCI_MAX_CONTROLLERS, management_callback));
+
+    /* Each controller downloads its firmware and reports itself started */
+    for (controller = 0; controller < WICED_HCI_MAX_CONTROLLERS; controller++)
+    {
+        while (delivered[controller].enabled == 0)
+        {
+            TEST_ASSERT_TRUE(rtos::Kernel::get_ms_count() - start_ms < TEST_START_TIMEOUT_MS);
+            ThisThread::sleep_for(1);
+        }
+        TEST_ASSERT_EQUAL(1, delivered[controller].enabled);
+        TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_mesh_init(controller, NULL, proxy_callback, NULL, NULL));
+        TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_ble_scan(controller, BTM_BLE_SCAN_TYPE_HIGH_DUTY, 0, scan_callback));
+        TEST_ASSERT_EQUAL(0, controllers[controller].getMalformedFrames());
+    }
+}
+
+static void test_stream(void)
+{
+    static ControllerRun    runs[WICED_HCI_MAX_CONTROLLERS];
+    wiced_hci_event_stats_t stats;
+    wiced_hci_controller_t  controller = 0;
+    uint32_t                total = 0;
+    uint64_t                start_ms = rtos::Kernel::get_ms_count();
+    uint64_t                elapsed_ms = 0;
+
+    for (controller = 0; controller < WICED_HCI_MAX_CONTROLLERS; controller++)
+    {
+        runs[controller].start(controller);
+    }
+    for (controller = 0; controller < WICED_HCI_MAX_CONTROLLERS; controller++)
+    {
+        runs[controller].join();
+    }
+    for (controller = 0; controller < WICED_HCI_MAX_CONTROLLERS; controller++)
+    {
+        while (delivered_events(controller) < TEST_EVENTS)
+        {
+            TEST_ASSERT_TRUE(rtos::Kernel::get_ms_count() - start_ms < TEST_STREAM_TIMEOUT_MS);
+            ThisThread::sleep_for(1);
+        }
+    }
+    elapsed_ms = rtos::Kernel::get_ms_count() - start_ms;
+
+    for (controller = 0; controller < WICED_HCI_MAX_CONTROLLERS; controller++)
+    {
+        Deliveries& counts = delivered[controller];
+
+        wiced_hci_get_event_stats(controller, &stats);
+        printf("controller %u: %lu notifications, %lu adverts, %lu proxy, %lu dropped, %lu writes\r\n",
+               (unsigned int)controller, (unsigned long)counts.notifications, (unsigned long)counts.adverts,
+               (unsigned long)counts.proxy, (unsigned long)stats.events_dropped,
+               (unsigned long)controllers[controller].getWrites());
+
+        /* Nothing crosses controllers, nothing is lost on the way */
+        TEST_ASSERT_EQUAL(0, counts.foreign);
+        TEST_ASSERT_EQUAL(0, controllers[controller].getForeignWrites());
+        TEST_ASSERT_EQUAL(0, controllers[controller].getMalformedFrames());
+        TEST_ASSERT_EQUAL(0, stats.uart_overflow_bytes);
+        TEST_ASSERT_EQUAL(0, stats.events_dropped);
+        TEST_ASSERT_EQUAL(TEST_EVENTS, counts.notifications + counts.adverts + counts.proxy);
+        TEST_ASSERT_EQUAL(TEST_EVENTS / 3, controllers[controller].getWrites());
+        total += counts.notifications + counts.adverts + counts.proxy;
+    }
+    printf("%u controllers: %lu events in %lu ms, %lu events/s\r\n", (unsigned int)WICED_HCI_MAX_CONTROLLERS,
+           (unsigned long)total, (unsigned long)elapsed_ms,
+           (unsigned long)(elapsed_ms ? (total * 1000ULL) / elapsed_ms : 0));
+}
+
+static void test_stop(void)
+{
+    wiced_hci_controller_t controller = 0;
+
+    for (controller = 0; controller < WICED_HCI_MAX_CONTROLLERS; controller++)
+    {
+        TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_stack_deinit(controller));
+    }
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("Controllers start", test_start),
+    Case("Controllers stream concurrently", test_stream),
+    Case("Controllers stop", test_stop),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
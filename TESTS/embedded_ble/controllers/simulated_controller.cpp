@@ -0,0 +1,143 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Simulated controller for the multiple controller tests
+ */
+
+#include <string.h>
+#include "simulated_controller.h"
+#include "wiced_hci.h"
+#include "wiced_mbed_uart.h"
+
+using namespace cypress::embedded;
+
+#define SIMULATED_CONTROLLER_COMMAND_PACKET     (0x01)
+#define SIMULATED_CONTROLLER_EVENT_PACKET       (0x04)
+#define SIMULATED_CONTROLLER_COMMAND_COMPLETE   (0x0E)
+#define SIMULATED_CONTROLLER_LAUNCH_RAM         (0xFC4E)
+#define SIMULATED_CONTROLLER_HEADER_LENGTH      (4)
+#define SIMULATED_CONTROLLER_TAG_OFFSET         (8)
+#define SIMULATED_CONTROLLER_CHUNK              (255)
+
+SimulatedController::SimulatedController() :
+    controller(0), writes(0), foreign_writes(0), malformed_frames(0)
+{
+}
+
+void SimulatedController::initialize(wiced_hci_controller_t controller)
+{
+    this->controller = controller;
+    writes           = 0;
+    foreign_writes   = 0;
+    malformed_frames = 0;
+}
+
+void SimulatedController::terminate()
+{
+}
+
+/* Called with the write lock of the controller held, a whole frame at a time */
+uint16_t SimulatedController::write(uint8_t type, uint16_t len, uint8_t* pData)
+{
+    uint16_t opcode = 0;
+
+    if (len < 3)
+    {
+        malformed_frames++;
+        return len;
+    }
+    opcode = pData[0] | (pData[1] << 8);
+
+    /* The firmware download waits for the completion of each command, the launch starts the device */
+    if (type == SIMULATED_CONTROLLER_COMMAND_PACKET)
+    {
+        if (len != 3 + pData[2])
+        {
+            malformed_frames++;
+        }
+        sendCommandComplete(opcode);
+        if (opcode == SIMULATED_CONTROLLER_LAUNCH_RAM)
+        {
+            uint8_t status = HCI_CONTROL_STATUS_SUCCESS;
+            sendEvent(HCI_CONTROL_EVENT_DEVICE_STARTED, &status, sizeof(status));
+        }
+        return len;
+    }
+
+    if (type != HCI_WICED_PKT || len < SIMULATED_CONTROLLER_HEADER_LENGTH ||
+        len != SIMULATED_CONTROLLER_HEADER_LENGTH + (pData[2] | (pData[3] << 8)))
+    {
+        malformed_frames++;
+        return len;
+    }
+
+    /* conn_id and handle, then the value */
+    if (opcode == HCI_CONTROL_GATT_COMMAND_WRITE_COMMAND)
+    {
+        writes++;
+        if (len <= SIMULATED_CONTROLLER_TAG_OFFSET || pData[SIMULATED_CONTROLLER_TAG_OFFSET] != controller)
+        {
+            foreign_writes++;
+        }
+    }
+    return len;
+}
+
+void SimulatedController::sendEvent(uint16_t opcode, const uint8_t* payload, uint16_t length)
+{
+    uint8_t header[] = { HCI_WICED_PKT, (uint8_t)(opcode & 0xff), (uint8_t)(opcode >> 8),
+                         (uint8_t)(length & 0xff), (uint8_t)(length >> 8) };
+
+    receive(header, sizeof(header));
+    receive(payload, length);
+}
+
+void SimulatedController::sendCommandComplete(uint16_t opcode)
+{
+    uint8_t event[] = { SIMULATED_CONTROLLER_EVENT_PACKET, SIMULATED_CONTROLLER_COMMAND_COMPLETE, 4, 1,
+                        (uint8_t)(opcode & 0xff), (uint8_t)(opcode >> 8), HCI_CONTROL_STATUS_SUCCESS };
+
+    receive(event, sizeof(event));
+}
+
+void SimulatedController::receive(const uint8_t* data, uint16_t length)
+{
+    while (length)
+    {
+        uint8_t chunk = (length > SIMULATED_CONTROLLER_CHUNK) ? SIMULATED_CONTROLLER_CHUNK : (uint8_t)length;
+
+        wiced_hci_serial_data_rcv_handler(controller, (uint8_t*)data, chunk);
+        data   += chunk;
+        length -= chunk;
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Simulated controller for the multiple controller tests: an HCI driver answering the
+ * firmware download and reporting the device started as a controller would, which streams
+ * WICED HCI events to the host and counts the GATT write commands written to it.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "embedded_BLE_hcidriver.h"
+
+namespace cypress
+{
+namespace embedded
+{
+
+/** Defines a controller simulated behind the HCI driver of its index */
+class SimulatedController : public EmbeddedHCIDriver
+{
+public:
+    SimulatedController();
+
+    virtual void initialize(wiced_hci_controller_t controller);
+
+    virtual void terminate();
+
+    virtual uint16_t write(uint8_t type, uint16_t len, uint8_t* pData);
+
+    /** Sends a WICED HCI event to the host, in UART sized chunks */
+    void sendEvent(uint16_t opcode, const uint8_t* payload, uint16_t length);
+
+    /** GATT write commands received */
+    uint32_t getWrites() const
+    {
+        return writes;
+    }
+
+    /** GATT write commands whose value does not start with the index of the controller */
+    uint32_t getForeignWrites() const
+    {
+        return foreign_writes;
+    }
+
+    /** Frames whose length does not match their header */
+    uint32_t getMalformedFrames() const
+    {
+        return malformed_frames;
+    }
+
+private:
+    void receive(const uint8_t* data, uint16_t length);
+    void sendCommandComplete(uint16_t opcode);
+
+    wiced_hci_controller_t controller;
+    volatile uint32_t      writes;
+    volatile uint32_t      foreign_writes;
+    volatile uint32_t      malformed_frames;
+};
+
+}
+
+}
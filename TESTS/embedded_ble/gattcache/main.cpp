@@ -0,0 +1,338 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * GATT client discovery cache tests: a first discovery over a simulated controller serving a
+ * synthetic database, a reconnection served from the cache, the cache surviving a remount of
+ * its store, and truncated or corrupt cache records rejected for a discovery over the air.
+ * The store is an NVStore on a LittleFileSystem mounted on a heap block device.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "HeapBlockDevice.h"
+#include "LittleFileSystem.h"
+#include "wiced_hci_bt_dm.h"
+#include "embedded_BLE_gatt.h"
+#include "embedded_BLE_nvstore.h"
+#include "embedded_BLE_nvstore_media.h"
+#include "simulated_gatt_controller.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_FS_NAME            "fs"
+#define TEST_MEDIA_PATH         "/" TEST_FS_NAME "/gattcache.bin"
+#define TEST_AREA_SIZE          (8192)
+#define TEST_CONTROLLER         (WICED_HCI_DEFAULT_CONTROLLER)
+#define TEST_START_TIMEOUT_MS   (10000)
+#define TEST_EVENT_TIMEOUT_MS   (5000)
+#define TEST_BIT_FLIPS          (2000)
+#define TEST_DISCOVERED         (1)
+
+static HeapBlockDevice         heap_bd(64 * 1024, 1, 1, 512);
+static LittleFileSystem        fs(TEST_FS_NAME);
+static SimulatedGattController controller_stub;
+static FileNVStoreMedia*       media;
+static NVStore*                store;
+static EventFlags              discovered;
+static GattClientEventData     discovery;
+static GattDatabase            first_database;
+static uint16_t                next_conn_id = 1;
+static const uint8_t           peer[BD_ADDR_LEN] = { 1, 2, 3, 4, 5, 6 };
+
+static cy_rslt_t management_callback(wiced_hci_controller_t controller, wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t* p_event_data)
+{
+    return CY_RSLT_SUCCESS;
+}
+
+static void gatt_event(GattClientEvent event, const GattClientEventData& data)
+{
+    if (event == GATT_CLIENT_DISCOVERY_COMPLETE)
+    {
+        discovery = data;
+        discovered.set(TEST_DISCOVERED);
+    }
+}
+
+static void open_store(void)
+{
+    media = new FileNVStoreMedia(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+    store = new NVStore;
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store->init(media));
+    GattClient::getInstance(TEST_CONTROLLER).setStore(store);
+}
+
+static void close_store(void)
+{
+    GattClient::getInstance(TEST_CONTROLLER).setStore(NULL);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store->deinit());
+    delete store;
+    delete media;
+}
+
+/* Connects the peer on a new connection and discovers it, returns the discovery commands it took */
+static uint32_t discover_peer(void)
+{
+    GattClient& client = GattClient::getInstance(TEST_CONTROLLER);
+    uint32_t    requests = controller_stub.getRequests();
+    uint16_t    conn_id = next_conn_id++;
+
+    client.disconnected(conn_id - 1);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, client.connected(conn_id, peer, 0));
+    discovered.clear(TEST_DISCOVERED);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, client.discover(conn_id));
+    TEST_ASSERT_FALSE(discovered.wait_any(TEST_DISCOVERED, TEST_EVENT_TIMEOUT_MS) & osFlagsError);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, discovery.status);
+    TEST_ASSERT_EQUAL(conn_id, discovery.conn_id);
+
+    return controller_stub.getRequests() - requests;
+}
+
+static void check_same_database(const GattDatabase& expected, const GattDatabase& database)
+{
+    TEST_ASSERT_EQUAL(expected.service_count, database.service_count);
+    TEST_ASSERT_EQUAL(expected.characteristic_count, database.characteristic_count);
+    TEST_ASSERT_EQUAL(expected.descriptor_count, database.descriptor_count);
+    TEST_ASSERT_EQUAL_MEMORY(expected.services, database.services, expected.service_count * sizeof(GattService));
+    TEST_ASSERT_EQUAL_MEMORY(expected.characteristics, database.characteristics, expected.characteristic_count * sizeof(GattCharacteristic));
+    TEST_ASSERT_EQUAL_MEMORY(expected.descriptors, database.descriptors, expected.descriptor_count * sizeof(GattDescriptor));
+}
+
+/* Finds the cache record of the peer */
+static int find_record(uint8_t* record, uint16_t* length)
+{
+    int i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_GATT_CACHE_PEERS; i++)
+    {
+        if (store->read(EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID + i, record, EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE, length) == BLE_ERROR_NONE &&
+            *length > 7 && memcmp(&record[1], peer, BD_ADDR_LEN) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void test_start(void)
+{
+    GattClient& client = GattClient::getInstance(TEST_CONTROLLER);
+    uint64_t    start_ms = rtos::Kernel::get_ms_count();
+
+    TEST_ASSERT_EQUAL(0, heap_bd.init());
+    TEST_ASSERT_EQUAL(0, fs.reformat(&heap_bd));
+
+    /* 16 and 128-bit UUIDs, characteristics with and without descriptors */
+    controller_stub.addService(0x1800, false, 3, 0);
+    controller_stub.addService(0x1801, false, 1, 1);
+    controller_stub.addService(0x180A, false, 5, 0);
+    controller_stub.addService(0x5000, true, 4, 2);
+    controller_stub.addService(0x6000, true, 4, 1);
+    controller_stub.addService(0x180F, false, 1, 1);
+
+    TEST_ASSERT_TRUE(ble_attach_embedded_hci_driver(TEST_CONTROLLER, controller_stub));
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, client.initialize());
+    TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_stack_init(TEST_CONTROLLER, management_callback));
+    while (!controller_stub.isStarted())
+    {
+        TEST_ASSERT_TRUE(rtos::Kernel::get_ms_count() - start_ms < TEST_START_TIMEOUT_MS);
+        ThisThread::sleep_for(1);
+    }
+    client.setEventCallback(gatt_event);
+    open_store();
+}
+
+static void test_first_discovery(void)
+{
+    GattClient&                   client = GattClient::getInstance(TEST_CONTROLLER);
+    const SimulatedGattAttribute* attributes = NULL;
+    GattClientStatistics          stats;
+    uint16_t                      count = 0;
+    uint32_t                      requests = discover_peer();
+    uint16_t                      i = 0;
+    uint8_t                       c = 0;
+
+    TEST_ASSERT_FALSE(discovery.from_cache);
+    TEST_ASSERT_TRUE(requests > 0);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, client.getDatabase(discovery.conn_id, first_database));
+
+    TEST_ASSERT_EQUAL(controller_stub.count(SIMULATED_GATT_SERVICE), first_database.service_count);
+    TEST_ASSERT_EQUAL(controller_stub.count(SIMULATED_GATT_CHARACTERISTIC), first_database.characteristic_count);
+    TEST_ASSERT_EQUAL(controller_stub.count(SIMULATED_GATT_DESCRIPTOR), first_database.descriptor_count);
+    attributes = controller_stub.getAttributes(&count);
+    for (i = 0; i < count; i++)
+    {
+        if (attributes[i].kind == SIMULATED_GATT_CHARACTERISTIC)
+        {
+            TEST_ASSERT_EQUAL(attributes[i].value_handle, first_database.characteristics[c].value_handle);
+            TEST_ASSERT_EQUAL(attributes[i].uuid128 ? 16 : 2, first_database.characteristics[c].uuid.length);
+            c++;
+        }
+    }
+    for (i = 0; i < first_database.descriptor_count; i++)
+    {
+        const GattDescriptor&     descriptor = first_database.descriptors[i];
+        const GattCharacteristic& characteristic = first_database.characteristics[descriptor.characteristic];
+
+        TEST_ASSERT_TRUE(descriptor.handle > characteristic.value_handle && descriptor.handle <= characteristic.end_handle);
+    }
+
+    client.getStatistics(stats);
+    TEST_ASSERT_EQUAL(1, stats.cache_stores);
+    printf("first discovery: %lu ms, %lu discovery commands, %u services %u characteristics %u descriptors\r\n",
+           (unsigned long)discovery.elapsed_ms, (unsigned long)requests, first_database.service_count,
+           first_database.characteristic_count, first_database.descriptor_count);
+}
+
+static void test_reconnect(void)
+{
+    GattDatabase database;
+    uint32_t     requests = discover_peer();
+
+    TEST_ASSERT_TRUE(discovery.from_cache);
+    TEST_ASSERT_EQUAL(0, requests);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, GattClient::getInstance(TEST_CONTROLLER).getDatabase(discovery.conn_id, database));
+    check_same_database(first_database, database);
+    printf("reconnect: %lu ms from the cache\r\n", (unsigned long)discovery.elapsed_ms);
+}
+
+static void test_remount(void)
+{
+    GattDatabase database;
+
+    close_store();
+    TEST_ASSERT_EQUAL(0, fs.unmount());
+    TEST_ASSERT_EQUAL(0, fs.mount(&heap_bd));
+    open_store();
+
+    TEST_ASSERT_EQUAL(0, discover_peer());
+    TEST_ASSERT_TRUE(discovery.from_cache);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, GattClient::getInstance(TEST_CONTROLLER).getDatabase(discovery.conn_id, database));
+    check_same_database(first_database, database);
+}
+
+static void test_corrupt_records(void)
+{
+    uint8_t      buffer[EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE];
+    uint8_t      record[EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE];
+    GattDatabase database;
+    uint16_t     length = GattClient::serialize(first_database, buffer, sizeof(buffer));
+    uint16_t     record_length = 0;
+    uint32_t     rejected = 0;
+    uint32_t     i = 0;
+    int          slot = -1;
+
+    /* Every truncation of a serialized database is rejected */
+    TEST_ASSERT_TRUE(length > 0);
+    TEST_ASSERT_TRUE(GattClient::deserialize(buffer, length, database));
+    check_same_database(first_database, database);
+    for (i = 0; i < length; i++)
+    {
+        TEST_ASSERT_FALSE(GattClient::deserialize(buffer, (uint16_t)i, database));
+    }
+
+    /* Flipped bits are rejected or decode within the database bounds, never read past the record */
+    srand(1);
+    for (i = 0; i < TEST_BIT_FLIPS; i++)
+    {
+        memcpy(record, buffer, length);
+        record[rand() % length] ^= (uint8_t)(1 << (rand() % 8));
+        if (!GattClient::deserialize(record, length, database))
+        {
+            rejected++;
+            continue;
+        }
+        TEST_ASSERT_TRUE(database.service_count <= EMBEDDED_BLE_GATT_MAX_SERVICES);
+        TEST_ASSERT_TRUE(database.characteristic_count <= EMBEDDED_BLE_GATT_MAX_CHARACTERISTICS);
+        TEST_ASSERT_TRUE(database.descriptor_count <= EMBEDDED_BLE_GATT_MAX_DESCRIPTORS);
+    }
+    printf("%lu of %lu records with a flipped bit rejected\r\n", (unsigned long)rejected, (unsigned long)TEST_BIT_FLIPS);
+
+    /* A truncated cache record sends the discovery over the air, which stores a good one again */
+    slot = find_record(record, &record_length);
+    TEST_ASSERT_TRUE(slot >= 0);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store->write(EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID + slot, record, record_length / 2));
+    TEST_ASSERT_TRUE(discover_peer() > 0);
+    TEST_ASSERT_FALSE(discovery.from_cache);
+    TEST_ASSERT_EQUAL(0, discover_peer());
+    TEST_ASSERT_TRUE(discovery.from_cache);
+
+    /* So does a record of another version */
+    slot = find_record(record, &record_length);
+    TEST_ASSERT_TRUE(slot >= 0);
+    record[0] ^= 0xff;
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store->write(EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID + slot, record, record_length));
+    TEST_ASSERT_TRUE(discover_peer() > 0);
+    TEST_ASSERT_FALSE(discovery.from_cache);
+    TEST_ASSERT_EQUAL(0, discover_peer());
+    TEST_ASSERT_TRUE(discovery.from_cache);
+}
+
+static void test_stop(void)
+{
+    GattClient::getInstance(TEST_CONTROLLER).disconnected(next_conn_id - 1);
+    close_store();
+    TEST_ASSERT_EQUAL(0, fs.unmount());
+    TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_stack_deinit(TEST_CONTROLLER));
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("GATT cache start", test_start),
+    Case("GATT cache first discovery", test_first_discovery),
+    Case("GATT cache reconnect", test_reconnect),
+    Case("GATT cache store remount", test_remount),
+    Case("GATT cache corrupt records", test_corrupt_records),
+    Case("GATT cache stop", test_stop),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Simulated controller for the GATT client cache tests
+ */
+
+#include <string.h>
+#include "simulated_gatt_controller.h"
+#include "wiced_hci.h"
+#include "wiced_mbed_uart.h"
+
+using namespace cypress::embedded;
+
+#define SIMULATED_GATT_COMMAND_PACKET       (0x01)
+#define SIMULATED_GATT_EVENT_PACKET         (0x04)
+#define SIMULATED_GATT_COMMAND_COMPLETE     (0x0E)
+#define SIMULATED_GATT_LAUNCH_RAM           (0xFC4E)
+#define SIMULATED_GATT_HEADER_LENGTH        (4)
+#define SIMULATED_GATT_DISCOVER_LENGTH      (6)
+#define SIMULATED_GATT_CCCD                 (0x2902)
+#define SIMULATED_GATT_PROPERTIES           (0x1A)  /* read, write, notify */
+#define SIMULATED_GATT_CHUNK                (255)
+
+static uint8_t* put16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+/* A 128-bit UUID is a fixed base ending with the 16-bit value */
+static uint8_t* putUuid(uint8_t* p, const SimulatedGattAttribute& attribute)
+{
+    uint8_t i = 0;
+
+    if (attribute.uuid128)
+    {
+        for (i = 0; i < 14; i++)
+        {
+            *p++ = 0xA0 + i;
+        }
+    }
+    return put16(p, attribute.uuid16);
+}
+
+SimulatedGattController::SimulatedGattController() :
+    controller(0), attribute_count(0), next_handle(1), requests(0), started(false)
+{
+    memset(attributes, 0, sizeof(attributes));
+}
+
+void SimulatedGattController::addService(uint16_t uuid16, bool uuid128, uint8_t characteristics, uint8_t descriptor_every)
+{
+    uint16_t service = attribute_count;
+    uint8_t  i = 0;
+
+    if (attribute_count + 1 + 2 * characteristics > SIMULATED_GATT_MAX_ATTRIBUTES)
+    {
+        return;
+    }
+
+    attributes[attribute_count].kind    = SIMULATED_GATT_SERVICE;
+    attributes[attribute_count].handle  = next_handle++;
+    attributes[attribute_count].uuid16  = uuid16;
+    attributes[attribute_count].uuid128 = uuid128;
+    attribute_count++;
+
+    for (i = 0; i < characteristics; i++)
+    {
+        SimulatedGattAttribute& characteristic = attributes[attribute_count++];
+
+        characteristic.kind         = SIMULATED_GATT_CHARACTERISTIC;
+        characteristic.handle       = next_handle;
+        characteristic.value_handle = next_handle + 1;
+        characteristic.properties   = SIMULATED_GATT_PROPERTIES;
+        characteristic.uuid16       = uuid16 + 0x100 + i;
+        characteristic.uuid128      = uuid128;
+        next_handle += 2;
+
+        if (descriptor_every && (i % descriptor_every) == 0)
+        {
+            SimulatedGattAttribute& descriptor = attributes[attribute_count++];
+
+            descriptor.kind   = SIMULATED_GATT_DESCRIPTOR;
+            descriptor.handle = next_handle++;
+            descriptor.uuid16 = SIMULATED_GATT_CCCD;
+        }
+    }
+    attributes[service].end_handle = next_handle - 1;
+}
+
+uint16_t SimulatedGattController::count(SimulatedGattKind kind) const
+{
+    uint16_t found = 0;
+    uint16_t i = 0;
+
+    for (i = 0; i < attribute_count; i++)
+    {
+        found += (attributes[i].kind == kind) ? 1 : 0;
+    }
+    return found;
+}
+
+void SimulatedGattController::initialize(wiced_hci_controller_t controller)
+{
+    this->controller = controller;
+    started = false;
+}
+
+void SimulatedGattController::terminate()
+{
+}
+
+uint16_t SimulatedGattController::write(uint8_t type, uint16_t len, uint8_t* pData)
+{
+    uint16_t opcode = 0;
+
+    if (len < 2)
+    {
+        return len;
+    }
+    opcode = pData[0] | (pData[1] << 8);
+
+    /* The firmware download waits for the completion of each command */
+    if (type == SIMULATED_GATT_COMMAND_PACKET)
+    {
+        uint8_t event[] = { SIMULATED_GATT_EVENT_PACKET, SIMULATED_GATT_COMMAND_COMPLETE, 4, 1, pData[0], pData[1], 0 };
+
+        receive(event, sizeof(event));
+        started = started || (opcode == SIMULATED_GATT_LAUNCH_RAM);
+        return len;
+    }
+
+    /* conn_id, start and end handles */
+    if (type == HCI_WICED_PKT && len == SIMULATED_GATT_HEADER_LENGTH + SIMULATED_GATT_DISCOVER_LENGTH)
+    {
+        const uint8_t* p = &pData[SIMULATED_GATT_HEADER_LENGTH];
+        uint16_t conn_id = p[0] | (p[1] << 8);
+        uint16_t start   = p[2] | (p[3] << 8);
+        uint16_t end     = p[4] | (p[5] << 8);
+
+        switch (opcode)
+        {
+            case HCI_CONTROL_GATT_COMMAND_DISCOVER_SERVICES:
+                discover(SIMULATED_GATT_SERVICE, conn_id, start, end);
+                break;
+            case HCI_CONTROL_GATT_COMMAND_DISCOVER_CHARACTERISTICS:
+                discover(SIMULATED_GATT_CHARACTERISTIC, conn_id, start, end);
+                break;
+            case HCI_CONTROL_GATT_COMMAND_DISCOVER_DESCRIPTORS:
+                discover(SIMULATED_GATT_DESCRIPTOR, conn_id, start, end);
+                break;
+            default:
+                break;
+        }
+    }
+    return len;
+}
+
+/* Reports the attributes of a kind in the range, then the end of the procedure */
+void SimulatedGattController::discover(uint8_t kind, uint16_t conn_id, uint16_t start_handle, uint16_t end_handle)
+{
+    uint8_t  event[2 + 2 + 16 + 1 + 2];
+    uint16_t i = 0;
+
+    requests++;
+    for (i = 0; i < attribute_count; i++)
+    {
+        const SimulatedGattAttribute& attribute = attributes[i];
+        uint8_t* p = put16(event, conn_id);
+
+        if (attribute.kind != kind || attribute.handle < start_handle || attribute.handle > end_handle)
+        {
+            continue;
+        }
+        if (kind == SIMULATED_GATT_SERVICE)
+        {
+            p = putUuid(p, attribute);
+            p = put16(p, attribute.handle);
+            p = put16(p, attribute.end_handle);
+            sendEvent(HCI_CONTROL_GATT_EVENT_SERVICE_DISCOVERED, event, p - event);
+        }
+        else if (kind == SIMULATED_GATT_CHARACTERISTIC)
+        {
+            p = put16(p, attribute.handle);
+            p = putUuid(p, attribute);
+            *p++ = attribute.properties;
+            p = put16(p, attribute.value_handle);
+            sendEvent(HCI_CONTROL_GATT_EVENT_CHARACTERISTIC_DISCOVERED, event, p - event);
+        }
+        else
+        {
+            p = putUuid(p, attribute);
+            p = put16(p, attribute.handle);
+            sendEvent(HCI_CONTROL_GATT_EVENT_DESCRIPTOR_DISCOVERED, event, p - event);
+        }
+    }
+    put16(event, conn_id);
+    sendEvent(HCI_CONTROL_GATT_EVENT_DISCOVERY_COMPLETE, event, 2);
+}
+
+void SimulatedGattController::sendEvent(uint16_t opcode, const uint8_t* payload, uint16_t length)
+{
+    uint8_t header[] = { HCI_WICED_PKT, (uint8_t)(opcode & 0xff), (uint8_t)(opcode >> 8),
+                         (uint8_t)(length & 0xff), (uint8_t)(length >> 8) };
+
+    receive(header, sizeof(header));
+    receive(payload, length);
+}
+
+void SimulatedGattController::receive(const uint8_t* data, uint16_t length)
+{
+    while (length)
+    {
+        uint8_t chunk = (length > SIMULATED_GATT_CHUNK) ? SIMULATED_GATT_CHUNK : (uint8_t)length;
+
+        wiced_hci_serial_data_rcv_handler(controller, (uint8_t*)data, chunk);
+        data   += chunk;
+        length -= chunk;
+    }
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Simulated controller for the GATT client cache tests: an HCI driver answering the firmware
+ * download, connected to a peer whose synthetic attribute database it serves to the discovery
+ * commands as the controller would, with the WICED HCI GATT events.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "embedded_BLE_hcidriver.h"
+
+/** Maximum number of attributes of the simulated database */
+#define SIMULATED_GATT_MAX_ATTRIBUTES   (64)
+
+namespace cypress
+{
+namespace embedded
+{
+
+/** Defines the kind of an attribute of the simulated database */
+enum SimulatedGattKind
+{
+    SIMULATED_GATT_SERVICE = 1,
+    SIMULATED_GATT_CHARACTERISTIC,
+    SIMULATED_GATT_DESCRIPTOR,
+};
+
+/** Defines an attribute of the simulated database */
+struct SimulatedGattAttribute
+{
+    uint8_t  kind;                      /**< SimulatedGattKind */
+    uint16_t handle;                    /**< Service or characteristic declaration, descriptor handle */
+    uint16_t end_handle;                /**< Service: last handle */
+    uint16_t value_handle;              /**< Characteristic: value handle */
+    uint8_t  properties;                /**< Characteristic: properties */
+    uint16_t uuid16;                    /**< 16-bit UUID, or the last two bytes of a 128-bit one */
+    bool     uuid128;                   /**< 128-bit UUID */
+};
+
+/** Defines a controller serving the database of its peer to the GATT discovery commands */
+class SimulatedGattController : public EmbeddedHCIDriver
+{
+public:
+    SimulatedGattController();
+
+    /** Adds a service of characteristics, one in descriptor_every with a CCCD (0 for none) */
+    void addService(uint16_t uuid16, bool uuid128, uint8_t characteristics, uint8_t descriptor_every);
+
+    /** Attributes of the database, in handle order */
+    const SimulatedGattAttribute* getAttributes(uint16_t* count) const
+    {
+        *count = attribute_count;
+        return attributes;
+    }
+
+    /** Attributes of a kind */
+    uint16_t count(SimulatedGattKind kind) const;
+
+    /** Discovery commands received */
+    uint32_t getRequests() const
+    {
+        return requests;
+    }
+
+    /** The firmware download is over */
+    bool isStarted() const
+    {
+        return started;
+    }
+
+    virtual void initialize(wiced_hci_controller_t controller);
+
+    virtual void terminate();
+
+    virtual uint16_t write(uint8_t type, uint16_t len, uint8_t* pData);
+
+private:
+    void discover(uint8_t kind, uint16_t conn_id, uint16_t start_handle, uint16_t end_handle);
+    void sendEvent(uint16_t opcode, const uint8_t* payload, uint16_t length);
+    void receive(const uint8_t* data, uint16_t length);
+
+    wiced_hci_controller_t controller;
+    SimulatedGattAttribute attributes[SIMULATED_GATT_MAX_ATTRIBUTES];
+    uint16_t               attribute_count;
+    uint16_t               next_handle;
+    volatile uint32_t      requests;
+    volatile bool          started;
+};
+
+}
+
+}
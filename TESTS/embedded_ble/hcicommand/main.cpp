@@ -0,0 +1,263 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * WICED HCI command encoder tests: the packets of HciSetLocalBdaddr, HciSetRawAdvertisementData
+ * and HciPushNvramData, encoded at run time and by the compiler, against golden bytes and the
+ * packets of the WICED HCI functions of the same commands, captured by a stub controller.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "wiced_hci.h"
+#include "wiced_mbed_uart.h"
+#include "wiced_hci_bt_dm.h"
+#include "wiced_hci_bt_ble.h"
+#include "wiced_hci_bt_mesh.h"
+#include "embedded_BLE_hcidriver.h"
+#include "embedded_BLE_hcicommand.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_CONTROLLER             (WICED_HCI_DEFAULT_CONTROLLER)
+#define TEST_CAPTURE_SIZE           (64)
+#define TEST_START_TIMEOUT_MS       (10000)
+#define TEST_COST_CALLS             (100000)
+
+#define HCI_COMMAND_PACKET          (0x01)
+#define HCI_EVENT_PACKET            (0x04)
+#define HCI_COMMAND_COMPLETE        (0x0E)
+#define HCI_LAUNCH_RAM              (0xFC4E)
+
+/* Answers the firmware download and keeps the last WICED HCI packet written */
+class CapturingController : public EmbeddedHCIDriver
+{
+public:
+    CapturingController() : controller(0), capturing(true), launched(false), length(0) {}
+
+    virtual void initialize(wiced_hci_controller_t controller)
+    {
+        this->controller = controller;
+    }
+
+    virtual void terminate()
+    {
+    }
+
+    virtual uint16_t write(uint8_t type, uint16_t len, uint8_t* pData)
+    {
+        if (type == HCI_COMMAND_PACKET && len >= 2)
+        {
+            uint8_t event[] = { HCI_EVENT_PACKET, HCI_COMMAND_COMPLETE, 4, 1, pData[0], pData[1], 0 };
+
+            wiced_hci_serial_data_rcv_handler(controller, event, sizeof(event));
+            launched = launched || ((pData[0] | (pData[1] << 8)) == HCI_LAUNCH_RAM);
+        }
+        else if (capturing && type == HCI_WICED_PKT && len < sizeof(packet))
+        {
+            packet[0] = type;
+            memcpy(&packet[1], pData, len);
+            length = 1 + len;
+        }
+        return len;
+    }
+
+    wiced_hci_controller_t controller;
+    volatile bool          capturing;
+    volatile bool          launched;
+    uint16_t               length;
+    uint8_t                packet[TEST_CAPTURE_SIZE];
+};
+
+static CapturingController controller_stub;
+
+static void expect_packet(const uint8_t* golden, uint16_t length)
+{
+    TEST_ASSERT_EQUAL(length, controller_stub.length);
+    TEST_ASSERT_EQUAL_MEMORY(golden, controller_stub.packet, length);
+    controller_stub.length = 0;
+}
+
+static uint8_t bd_addr[BD_ADDR_LEN] = { 0x00, 0xA0, 0x50, 0x11, 0x22, 0x33 };
+static const uint8_t bd_addr_golden[] = { 0x19, 0x03, 0x00, 0x06, 0x00, 0x33, 0x22, 0x11, 0x50, 0xA0, 0x00 };
+
+static uint8_t flags[1] = { 0x06 };
+static uint8_t name[8]  = { 'g', 'a', 't', 'e', 'w', 'a', 'y', '1' };
+static const uint8_t advert_golden[] = { 0x19, 0x0a, 0x01, 0x12, 0x00, 0x02,
+                                         0x01, 0x00, 0x01, 0x06, 0x00,
+                                         0x09, 0x00, 0x08, 'g', 'a', 't', 'e', 'w', 'a', 'y', '1', 0x00 };
+
+static uint8_t record[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+static const uint8_t record_golden[] = { 0x19, 0x05, 0x00, 0x12, 0x00, 0x34, 0x12,
+                                         1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+
+typedef HciSetRawAdvertisementData<AdField<BTM_BLE_ADVERT_TYPE_FLAG, 1>, AdField<BTM_BLE_ADVERT_TYPE_NAME_COMPLETE, 8> > RawAdvertisement;
+
+/* Encoded by the compiler */
+static constexpr uint8_t constant_bd_addr[BD_ADDR_LEN] = { 0x00, 0xA0, 0x50, 0x11, 0x22, 0x33 };
+static constexpr HciCommandFrame<HciSetLocalBdaddr> constant_bd_addr_frame{ HciSetLocalBdaddr(constant_bd_addr) };
+
+static_assert(constant_bd_addr_frame.bytes[5] == 0x33 && constant_bd_addr_frame.bytes[10] == 0x00, "constant frame differs from the golden bytes");
+static_assert(HciCommandFrame<HciSetLocalBdaddr>::size == sizeof(bd_addr_golden), "frame size");
+static_assert(HciCommandFrame<RawAdvertisement>::size == sizeof(advert_golden), "frame size");
+static_assert(HciCommandFrame<HciPushNvramData<16> >::size == sizeof(record_golden), "frame size");
+
+static cy_rslt_t management_callback(wiced_hci_controller_t controller, wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t* p_event_data)
+{
+    return CY_RSLT_SUCCESS;
+}
+
+static void test_start(void)
+{
+    uint64_t start_ms = rtos::Kernel::get_ms_count();
+
+    TEST_ASSERT_TRUE(ble_attach_embedded_hci_driver(TEST_CONTROLLER, controller_stub));
+    TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_stack_init(TEST_CONTROLLER, management_callback));
+    while (!controller_stub.launched)
+    {
+        TEST_ASSERT_TRUE(rtos::Kernel::get_ms_count() - start_ms < TEST_START_TIMEOUT_MS);
+        ThisThread::sleep_for(1);
+    }
+}
+
+static void test_local_bdaddr(void)
+{
+    wiced_bt_set_local_bdaddr(TEST_CONTROLLER, bd_addr);
+    expect_packet(bd_addr_golden, sizeof(bd_addr_golden));
+
+    sendHciCommand(TEST_CONTROLLER, HciSetLocalBdaddr(bd_addr));
+    expect_packet(bd_addr_golden, sizeof(bd_addr_golden));
+
+    sendHciFrame(TEST_CONTROLLER, constant_bd_addr_frame);
+    expect_packet(bd_addr_golden, sizeof(bd_addr_golden));
+}
+
+static void test_raw_advertisement_data(void)
+{
+    wiced_bt_ble_advert_elem_t elements[2] = { { flags, sizeof(flags), BTM_BLE_ADVERT_TYPE_FLAG },
+                                               { name, sizeof(name), BTM_BLE_ADVERT_TYPE_NAME_COMPLETE } };
+
+    wiced_bt_ble_set_raw_advertisement_data(TEST_CONTROLLER, 2, elements);
+    expect_packet(advert_golden, sizeof(advert_golden));
+
+    sendHciCommand(TEST_CONTROLLER, RawAdvertisement(flags, name));
+    expect_packet(advert_golden, sizeof(advert_golden));
+}
+
+static void test_push_nvram_data(void)
+{
+    wiced_bt_mesh_push_nvram_data(TEST_CONTROLLER, record, sizeof(record), 0x1234);
+    expect_packet(record_golden, sizeof(record_golden));
+
+    sendHciCommand(TEST_CONTROLLER, HciPushNvramData<16>(0x1234, record));
+    expect_packet(record_golden, sizeof(record_golden));
+}
+
+/* Time to encode a packet and hand it to the UART, in ns per call */
+static unsigned long cost(void (*send)(void))
+{
+    uint64_t start_ms = rtos::Kernel::get_ms_count();
+    uint32_t i = 0;
+
+    for (i = 0; i < TEST_COST_CALLS; i++)
+    {
+        record[0] = (uint8_t)i;
+        send();
+    }
+    return (unsigned long)((rtos::Kernel::get_ms_count() - start_ms) * 1000000ULL / TEST_COST_CALLS);
+}
+
+static void send_bdaddr_function(void)
+{
+    wiced_bt_set_local_bdaddr(TEST_CONTROLLER, bd_addr);
+}
+
+static void send_bdaddr_encoder(void)
+{
+    sendHciCommand(TEST_CONTROLLER, HciSetLocalBdaddr(bd_addr));
+}
+
+static void send_record_function(void)
+{
+    wiced_bt_mesh_push_nvram_data(TEST_CONTROLLER, record, sizeof(record), 0x1234);
+}
+
+static void send_record_encoder(void)
+{
+    sendHciCommand(TEST_CONTROLLER, HciPushNvramData<16>(0x1234, record));
+}
+
+static void test_cost(void)
+{
+    controller_stub.capturing = false;
+    printf("set local bdaddr: function %lu ns, encoder %lu ns\r\n",
+           cost(send_bdaddr_function), cost(send_bdaddr_encoder));
+    printf("push nvram data (16 B): function %lu ns, encoder %lu ns\r\n",
+           cost(send_record_function), cost(send_record_encoder));
+    controller_stub.capturing = true;
+}
+
+static void test_stop(void)
+{
+    TEST_ASSERT_EQUAL(CY_RSLT_SUCCESS, wiced_bt_stack_deinit(TEST_CONTROLLER));
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("HCI command encoders start", test_start),
+    Case("HciSetLocalBdaddr packet", test_local_bdaddr),
+    Case("HciSetRawAdvertisementData packet", test_raw_advertisement_data),
+    Case("HciPushNvramData packet", test_push_nvram_data),
+    Case("HCI command encoders cost", test_cost),
+    Case("HCI command encoders stop", test_stop),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
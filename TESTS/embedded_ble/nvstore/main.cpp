@@ -0,0 +1,406 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * NVStore tests on FileNVStoreMedia: record updates and deletes, compaction, recovery from
+ * a power loss at any point of a write or of a compaction, and a full store.
+ * The media file lives on a LittleFileSystem mounted on a heap block device.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "HeapBlockDevice.h"
+#include "LittleFileSystem.h"
+#include "embedded_BLE_nvstore.h"
+#include "embedded_BLE_nvstore_media.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_FS_NAME            "fs"
+#define TEST_MEDIA_PATH         "/" TEST_FS_NAME "/nvstore.bin"
+#define TEST_AREA_SIZE          (4096)
+#define TEST_SMALL_AREA_SIZE    (1024)
+#define TEST_UPDATES            (200)
+#define TEST_UPDATED_IDS        (4)
+#define TEST_KEPT_ID            (9)
+#define TEST_POWER_LOSS_STEP    (97)
+
+static HeapBlockDevice   heap_bd(64 * 1024, 1, 1, 512);
+static LittleFileSystem  fs(TEST_FS_NAME);
+
+/* Passes the calls to a media until a byte budget is spent: the program call crossing it is cut short
+ * and every later program or erase fails, as when the power goes away */
+class PowerLossMedia : public NVStoreMedia
+{
+public:
+    PowerLossMedia(NVStoreMedia& media, uint32_t budget) : media(media), budget(budget), cut(false) {}
+
+    virtual int init(void)
+    {
+        return media.init();
+    }
+
+    virtual uint32_t getAreaSize(void)
+    {
+        return media.getAreaSize();
+    }
+
+    virtual uint32_t getProgramSize(void)
+    {
+        return media.getProgramSize();
+    }
+
+    virtual int read(uint8_t area, uint32_t offset, void* buffer, uint32_t length)
+    {
+        return media.read(area, offset, buffer, length);
+    }
+
+    virtual int program(uint8_t area, uint32_t offset, const void* buffer, uint32_t length)
+    {
+        if (cut)
+        {
+            return -1;
+        }
+        if (length > budget)
+        {
+            if (budget)
+            {
+                media.program(area, offset, buffer, budget);
+            }
+            cut = true;
+            return -1;
+        }
+        budget -= length;
+
+        return media.program(area, offset, buffer, length);
+    }
+
+    virtual int erase(uint8_t area)
+    {
+        return cut ? -1 : media.erase(area);
+    }
+
+    bool isCut(void) const
+    {
+        return cut;
+    }
+
+private:
+    NVStoreMedia& media;
+    uint32_t      budget;
+    bool          cut;
+};
+
+static void write_string(NVStore& store, uint16_t id, const char* value)
+{
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.write(id, (const uint8_t*)value, (uint16_t)strlen(value)));
+}
+
+static void check_string(NVStore& store, uint16_t id, const char* expected)
+{
+    uint8_t  buffer[EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE];
+    uint16_t length = 0;
+
+    if (expected == NULL)
+    {
+        TEST_ASSERT_EQUAL(BLE_ERROR_NOT_FOUND, store.read(id, buffer, sizeof(buffer), &length));
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.read(id, buffer, sizeof(buffer), &length));
+    TEST_ASSERT_EQUAL(strlen(expected), length);
+    TEST_ASSERT_EQUAL_MEMORY(expected, buffer, length);
+}
+
+static void test_write_read_delete(void)
+{
+    uint16_t ids[8];
+
+    remove(TEST_MEDIA_PATH);
+    {
+        FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+        NVStore          store;
+
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+        write_string(store, 1, "hello");
+        write_string(store, 2, "world");
+        write_string(store, 1, "HELLO");
+        check_string(store, 1, "HELLO");
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.sync());
+        check_string(store, 1, "HELLO");
+        check_string(store, 2, "world");
+
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.write(2, NULL, 0));
+        check_string(store, 2, NULL);
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.sync());
+        check_string(store, 2, NULL);
+
+        write_string(store, 3, "x");
+        TEST_ASSERT_EQUAL(2, store.list(ids, 8));
+        TEST_ASSERT_EQUAL(1, ids[0]);
+        TEST_ASSERT_EQUAL(3, ids[1]);
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.deinit());
+    }
+    {
+        FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+        NVStore          store;
+
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+        check_string(store, 1, "HELLO");
+        check_string(store, 2, NULL);
+        check_string(store, 3, "x");
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.deinit());
+    }
+}
+
+static void test_compaction(void)
+{
+    NVStoreStatistics stats;
+    char              value[32];
+    int               i = 0;
+
+    remove(TEST_MEDIA_PATH);
+    {
+        FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+        NVStore          store;
+
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+        write_string(store, TEST_KEPT_ID, "kept");
+        for (i = 0; i < 10 * TEST_UPDATES; i++)
+        {
+            snprintf(value, sizeof(value), "value-%d-%d", i % 10, i);
+            write_string(store, (uint16_t)(10 + i % 10), value);
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.sync());
+        }
+        store.getStatistics(stats);
+        TEST_ASSERT_TRUE(stats.compactions > 0);
+        TEST_ASSERT_EQUAL(0, stats.errors);
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.deinit());
+    }
+    {
+        FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+        NVStore          store;
+
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+        check_string(store, TEST_KEPT_ID, "kept");
+        for (i = 10 * TEST_UPDATES - 10; i < 10 * TEST_UPDATES; i++)
+        {
+            snprintf(value, sizeof(value), "value-%d-%d", i % 10, i);
+            check_string(store, (uint16_t)(10 + i % 10), value);
+        }
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.deinit());
+    }
+}
+
+/* The record of an updated id holds its initial value or one of its updates */
+static void check_update(NVStore& store, uint16_t id)
+{
+    uint8_t  buffer[EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE];
+    char     value[32];
+    uint16_t length = 0;
+    int      i = 0;
+
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.read(id, buffer, sizeof(buffer), &length));
+
+    snprintf(value, sizeof(value), "initial-%d", id);
+    if (length == strlen(value) && memcmp(buffer, value, length) == 0)
+    {
+        return;
+    }
+    for (i = id - 1; i < TEST_UPDATES; i += TEST_UPDATED_IDS)
+    {
+        snprintf(value, sizeof(value), "update-%d", i);
+        if (length == strlen(value) && memcmp(buffer, value, length) == 0)
+        {
+            return;
+        }
+    }
+
+    TEST_FAIL_MESSAGE("record damaged by the power loss");
+}
+
+static void test_power_loss(void)
+{
+    char     value[32];
+    uint32_t budget = 0;
+    uint16_t id = 0;
+    int      i = 0;
+    bool     cut = true;
+
+    /* Cuts the power after every TEST_POWER_LOSS_STEP programmed bytes until a run completes */
+    for (budget = 0; cut; budget += TEST_POWER_LOSS_STEP)
+    {
+        remove(TEST_MEDIA_PATH);
+        {
+            FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+            NVStore          store;
+
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+            write_string(store, TEST_KEPT_ID, "kept");
+            for (id = 1; id <= TEST_UPDATED_IDS; id++)
+            {
+                snprintf(value, sizeof(value), "initial-%d", id);
+                write_string(store, id, value);
+            }
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.deinit());
+        }
+        {
+            FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+            PowerLossMedia   failing(media, budget);
+            NVStore          store;
+
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&failing));
+            for (i = 0; i < TEST_UPDATES && !failing.isCut(); i++)
+            {
+                snprintf(value, sizeof(value), "update-%d", i);
+                write_string(store, (uint16_t)(1 + i % TEST_UPDATED_IDS), value);
+                store.sync();
+            }
+            cut = failing.isCut();
+            store.deinit();
+        }
+        {
+            FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+            NVStore          store;
+
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+            check_string(store, TEST_KEPT_ID, "kept");
+            for (id = 1; id <= TEST_UPDATED_IDS; id++)
+            {
+                check_update(store, id);
+            }
+
+            /* The recovered log takes new records */
+            write_string(store, 5, "after");
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.sync());
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.deinit());
+        }
+        {
+            FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_AREA_SIZE);
+            NVStore          store;
+
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+            check_string(store, 5, "after");
+            check_string(store, TEST_KEPT_ID, "kept");
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.deinit());
+        }
+    }
+}
+
+static void test_full_store(void)
+{
+    uint8_t     record[64];
+    ble_error_t result = BLE_ERROR_NONE;
+    uint16_t    id = 0;
+    uint16_t    stored = 0;
+    int         i = 0;
+
+    remove(TEST_MEDIA_PATH);
+    {
+        FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_SMALL_AREA_SIZE);
+        NVStore          store;
+
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+
+        /* The record that does not fit is reported and kept pending */
+        for (id = 1; result == BLE_ERROR_NONE; id++)
+        {
+            memset(record, id, sizeof(record));
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.write(id, record, sizeof(record)));
+            result = store.sync();
+        }
+        TEST_ASSERT_EQUAL(BLE_ERROR_NO_MEM, result);
+        stored = id - 2;
+        TEST_ASSERT_TRUE(stored > 0);
+
+        /* Once every pending slot holds a record that does not fit, writes are refused */
+        result = BLE_ERROR_NONE;
+        for (i = 0; i < EMBEDDED_BLE_NVSTORE_PENDING_SLOTS && result == BLE_ERROR_NONE; i++, id++)
+        {
+            memset(record, id, sizeof(record));
+            result = store.write(id, record, sizeof(record));
+        }
+        TEST_ASSERT_EQUAL(BLE_ERROR_NO_MEM, result);
+        store.deinit();
+    }
+    {
+        FileNVStoreMedia media(TEST_MEDIA_PATH, TEST_SMALL_AREA_SIZE);
+        NVStore          store;
+        uint8_t          buffer[sizeof(record)];
+        uint16_t         length = 0;
+
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.init(&media));
+        for (id = 1; id <= stored; id++)
+        {
+            memset(record, id, sizeof(record));
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.read(id, buffer, sizeof(buffer), &length));
+            TEST_ASSERT_EQUAL(sizeof(record), length);
+            TEST_ASSERT_EQUAL_MEMORY(record, buffer, length);
+        }
+        TEST_ASSERT_EQUAL(BLE_ERROR_NOT_FOUND, store.read(stored + 1, buffer, sizeof(buffer), &length));
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, store.deinit());
+    }
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(300, "default_auto");
+
+    if (heap_bd.init() != 0 || fs.reformat(&heap_bd) != 0)
+    {
+        return STATUS_ABORT;
+    }
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("NVStore write, read and delete", test_write_read_delete),
+    Case("NVStore compaction", test_compaction),
+    Case("NVStore power loss recovery", test_power_loss),
+    Case("NVStore full", test_full_store),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * PresenceTable tests: cost of the per report update with the table holding TEST_DEVICES devices
+ * (or as many as EMBEDDED_BLE_PRESENCE_TABLE_SIZE allows), and the summaries of the devices
+ * arriving, seen again and departing.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "embedded_BLE_presence.h"
+#include "wiced_hci_bt_gatt.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_DEVICES                (10000)
+#define TEST_MAX_TRACKED            (EMBEDDED_BLE_PRESENCE_TABLE_SIZE / 4 * 3)
+#define TEST_TRACKED                ((TEST_DEVICES < TEST_MAX_TRACKED) ? TEST_DEVICES : TEST_MAX_TRACKED)
+#define TEST_UPDATES                (1000000)
+#define TEST_ROUNDS                 (TEST_UPDATES / TEST_TRACKED)
+#define TEST_SUMMARY_INTERVAL_MS    (1000)
+#define TEST_STALE_TIMEOUT_MS       (5000)
+
+static PresenceTable table;
+static uint32_t      arrived;
+static uint32_t      updated;
+static uint32_t      departed;
+static uint32_t      reports;
+
+static void summary_callback(const PresenceSummary* summaries, uint16_t count)
+{
+    uint16_t i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (summaries[i].state == PRESENCE_ARRIVED)
+        {
+            arrived++;
+        }
+        else if (summaries[i].state == PRESENCE_UPDATED)
+        {
+            updated++;
+        }
+        else
+        {
+            departed++;
+        }
+        reports += summaries[i].count;
+    }
+}
+
+static void reset_summaries(void)
+{
+    arrived = 0;
+    updated = 0;
+    departed = 0;
+    reports = 0;
+}
+
+/* Random static addresses of devices first to first + count - 1, seen at now_ms */
+static void update_devices(uint32_t first, uint32_t count, uint32_t now_ms)
+{
+    uint8_t  address[6] = { 0xC0, 0x12, 0x34, 0, 0, 0 };
+    uint32_t i = 0;
+
+    for (i = first; i < first + count; i++)
+    {
+        address[3] = (uint8_t)(i >> 16);
+        address[4] = (uint8_t)(i >> 8);
+        address[5] = (uint8_t)i;
+        table.update(address, BLE_ADDR_RANDOM, -60 - (int8_t)(i % 20), now_ms);
+    }
+}
+
+static void test_update_cost(void)
+{
+    PresenceStatistics stats;
+    uint64_t           start_ms = 0;
+    uint32_t           elapsed_ms = 0;
+    uint32_t           round = 0;
+
+    table.configure(TEST_SUMMARY_INTERVAL_MS, TEST_STALE_TIMEOUT_MS, summary_callback);
+    update_devices(0, TEST_TRACKED, 0);
+
+    start_ms = rtos::Kernel::get_ms_count();
+    for (round = 1; round <= TEST_ROUNDS; round++)
+    {
+        update_devices(0, TEST_TRACKED, round);
+    }
+    elapsed_ms = (uint32_t)(rtos::Kernel::get_ms_count() - start_ms);
+
+    table.getStatistics(stats);
+    printf("%lu devices tracked in %lu slots: %lu updates in %lu ms (%lu ns per update), "
+           "%lu.%02lu probes per update, %lu at most\r\n",
+           (unsigned long)stats.tracked, (unsigned long)EMBEDDED_BLE_PRESENCE_TABLE_SIZE,
+           (unsigned long)(TEST_ROUNDS * TEST_TRACKED), (unsigned long)elapsed_ms,
+           (unsigned long)((elapsed_ms * 1000000ULL) / (TEST_ROUNDS * TEST_TRACKED)),
+           (unsigned long)(stats.probes / stats.updates), (unsigned long)((stats.probes % stats.updates) * 100 / stats.updates),
+           (unsigned long)stats.max_probes);
+
+    TEST_ASSERT_EQUAL(TEST_TRACKED, stats.tracked);
+    TEST_ASSERT_EQUAL(TEST_TRACKED, stats.inserts);
+    TEST_ASSERT_EQUAL((TEST_ROUNDS + 1) * TEST_TRACKED, stats.updates);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+    TEST_ASSERT_EQUAL(0, stats.departed);
+}
+
+static void test_full_table(void)
+{
+    PresenceStatistics stats;
+
+    /* Reports of new devices are dropped once the table is full, the tracked ones still update */
+    update_devices(TEST_TRACKED, TEST_MAX_TRACKED - TEST_TRACKED, TEST_ROUNDS + 1);
+    update_devices(TEST_MAX_TRACKED, 10, TEST_ROUNDS + 2);
+    update_devices(0, TEST_MAX_TRACKED, TEST_ROUNDS + 3);
+    table.getStatistics(stats);
+
+    TEST_ASSERT_EQUAL(TEST_MAX_TRACKED, stats.tracked);
+    TEST_ASSERT_EQUAL(TEST_MAX_TRACKED, stats.inserts);
+    TEST_ASSERT_EQUAL(10, stats.dropped);
+}
+
+static void test_summaries(void)
+{
+    PresenceStatistics stats;
+
+    table.configure(TEST_SUMMARY_INTERVAL_MS, TEST_STALE_TIMEOUT_MS, summary_callback);
+    reset_summaries();
+
+    update_devices(0, TEST_TRACKED, 0);
+    update_devices(0, TEST_TRACKED, 100);
+    table.summarize(100);
+    TEST_ASSERT_EQUAL(TEST_TRACKED, arrived);
+    TEST_ASSERT_EQUAL(0, updated);
+    TEST_ASSERT_EQUAL(0, departed);
+    TEST_ASSERT_EQUAL(2 * TEST_TRACKED, reports);
+
+    /* No summary before the interval has elapsed */
+    reset_summaries();
+    table.poll(100 + TEST_SUMMARY_INTERVAL_MS - 1);
+    TEST_ASSERT_EQUAL(0, arrived + updated + departed);
+
+    /* Half the devices are seen again, the others depart once the stale timeout has elapsed */
+    update_devices(0, TEST_TRACKED / 2, TEST_STALE_TIMEOUT_MS);
+    table.summarize(TEST_STALE_TIMEOUT_MS + 101);
+    TEST_ASSERT_EQUAL(0, arrived);
+    TEST_ASSERT_EQUAL(TEST_TRACKED / 2, updated);
+    TEST_ASSERT_EQUAL(TEST_TRACKED - TEST_TRACKED / 2, departed);
+
+    table.getStatistics(stats);
+    TEST_ASSERT_EQUAL(TEST_TRACKED / 2, stats.tracked);
+    TEST_ASSERT_EQUAL(TEST_TRACKED - TEST_TRACKED / 2, stats.departed);
+
+    /* The slots of the departed devices are reused */
+    update_devices(TEST_TRACKED, TEST_TRACKED - TEST_TRACKED / 2, TEST_STALE_TIMEOUT_MS + 200);
+    table.getStatistics(stats);
+    TEST_ASSERT_EQUAL(TEST_TRACKED, stats.tracked);
+    TEST_ASSERT_EQUAL(0, stats.dropped);
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("PresenceTable update cost", test_update_cost),
+    Case("PresenceTable full", test_full_table),
+    Case("PresenceTable summaries", test_summaries),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
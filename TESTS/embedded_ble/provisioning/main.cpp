@@ -0,0 +1,191 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * ProvisioningManager tests: a fleet of devices provisioned through SimulatedProvisioningBearer
+ * with injected connection and provisioning failures, on a simulated clock and on the manager
+ * thread.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "embedded_BLE_provisioning.h"
+#include "simulated_bearer.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_FLEET_SIZE             (120)
+#define TEST_THREAD_FLEET_SIZE      (40)
+#define TEST_MAX_MS                 (3600000)
+
+static uint32_t done_events;
+
+static void on_progress(const ProvisioningProgress& progress, void* context)
+{
+    if (progress.state == PROVISIONING_STATE_DONE)
+    {
+        done_events++;
+    }
+}
+
+/* Provisions the fleet on a simulated clock, returns the provisioned devices per minute */
+static uint32_t provision_fleet(uint8_t sessions)
+{
+    SimulatedProvisioningParameters simulated = { 1500, 6000, 1000, 5, 5, 42 };
+    ProvisioningParameters          params = { sessions, 3, 2000, 30000, 5000, 20000 };
+    SimulatedProvisioningBearer     bearer(simulated);
+    ProvisioningManager             manager(bearer);
+    ProvisioningStatistics          stats;
+    uint8_t                         uuid[EMBEDDED_BLE_MESH_UUID_LENGTH] = { 0 };
+    uint32_t                        now = 0;
+    int                             i = 0;
+
+    bearer.setManager(&manager);
+    manager.configure(params);
+    manager.setEventCallback(on_progress);
+    done_events = 0;
+
+    for (i = 0; i < TEST_FLEET_SIZE; i++)
+    {
+        uuid[0] = i;
+        uuid[1] = i >> 8;
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, manager.add(uuid, 0));
+    }
+    TEST_ASSERT_EQUAL(BLE_ERROR_INVALID_STATE, manager.add(uuid, 0));
+
+    for (now = 0; now < TEST_MAX_MS; now++)
+    {
+        bearer.service(now);
+        manager.service(now);
+        if (now % 1000 == 0)
+        {
+            manager.getStatistics(stats);
+            if (stats.queued == 0 && stats.active == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    manager.getStatistics(stats);
+    printf("%u sessions: %lu/%d provisioned, %lu failed, %lu retries (%lu timeouts) in %lu ms, %lu nodes/min\r\n",
+           sessions, (unsigned long) stats.provisioned, TEST_FLEET_SIZE, (unsigned long) stats.failed,
+           (unsigned long) stats.retries, (unsigned long) stats.timeouts, (unsigned long) stats.elapsed_ms,
+           (unsigned long) stats.nodes_per_minute);
+
+    /* Every device ends provisioned or out of attempts, failures are retried */
+    TEST_ASSERT_EQUAL(TEST_FLEET_SIZE, stats.provisioned + stats.failed);
+    TEST_ASSERT_EQUAL(stats.provisioned, done_events);
+    TEST_ASSERT_TRUE(stats.retries > 0);
+    TEST_ASSERT_TRUE(stats.failed < TEST_FLEET_SIZE / 20);
+    TEST_ASSERT_EQUAL(stats.provisioned + stats.retries + stats.failed, stats.stages[PROVISIONING_STAGE_QUEUE].count);
+
+    return stats.nodes_per_minute;
+}
+
+static void test_fleet(void)
+{
+    provision_fleet(1);
+}
+
+static void test_sessions(void)
+{
+    uint32_t single   = provision_fleet(1);
+    uint32_t parallel = provision_fleet(EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS);
+
+    /* Concurrent sessions overlap the connections and the provisioning */
+    TEST_ASSERT_TRUE(parallel > single);
+}
+
+static void test_thread(void)
+{
+    SimulatedProvisioningParameters simulated = { 5, 20, 5, 10, 10, 7 };
+    ProvisioningParameters          params = { 2, 5, 10, 50, 50, 200 };
+    SimulatedProvisioningBearer     bearer(simulated);
+    ProvisioningManager             manager(bearer);
+    ProvisioningStatistics          stats;
+    uint8_t                         uuid[EMBEDDED_BLE_MESH_UUID_LENGTH] = { 0 };
+    int                             i = 0;
+
+    bearer.setManager(&manager);
+    manager.configure(params);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, manager.start());
+
+    for (i = 0; i < TEST_THREAD_FLEET_SIZE; i++)
+    {
+        uuid[0] = i;
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, manager.add(uuid));
+    }
+
+    /* The test drives the controller stand-in, the manager thread the sessions */
+    for (i = 0; i < 10000; i++)
+    {
+        bearer.service((uint32_t) rtos::Kernel::get_ms_count());
+        manager.getStatistics(stats);
+        if (stats.queued == 0 && stats.active == 0)
+        {
+            break;
+        }
+        ThisThread::sleep_for(1);
+    }
+
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, manager.stop());
+    TEST_ASSERT_EQUAL(TEST_THREAD_FLEET_SIZE, stats.provisioned + stats.failed);
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("ProvisioningManager fleet", test_fleet),
+    Case("ProvisioningManager sessions", test_sessions),
+    Case("ProvisioningManager thread", test_thread),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Simulated provisioning bearer for the provisioning manager tests
+ */
+
+#include <string.h>
+#include "simulated_bearer.h"
+#include "wiced_hci_bt_mesh.h"
+
+using namespace cypress::embedded;
+
+#define SIMULATED_SESSION_FREE          (0)
+#define SIMULATED_SESSION_OPENED        (1)
+#define SIMULATED_SESSION_CONNECTING    (2)
+#define SIMULATED_SESSION_PROVISIONING  (3)
+#define SIMULATED_SESSION_REPORTED      (4)
+
+SimulatedProvisioningBearer::SimulatedProvisioningBearer(const SimulatedProvisioningParameters& parameters) :
+    params(parameters), manager(NULL), state(parameters.seed ? parameters.seed : 1)
+{
+    memset(sessions, 0, sizeof(sessions));
+}
+
+/* xorshift32, called with the lock held */
+uint32_t SimulatedProvisioningBearer::random(uint32_t range)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return range ? (state % range) : 0;
+}
+
+ble_error_t SimulatedProvisioningBearer::open(uint16_t conn_id, const uint8_t* uuid)
+{
+    uint8_t i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS; i++)
+    {
+        if (sessions[i].state == SIMULATED_SESSION_FREE)
+        {
+            sessions[i].conn_id = conn_id;
+            sessions[i].state   = SIMULATED_SESSION_OPENED;
+            lock.unlock();
+            return BLE_ERROR_NONE;
+        }
+    }
+
+    lock.unlock();
+
+    return BLE_ERROR_NO_MEM;
+}
+
+void SimulatedProvisioningBearer::close(uint16_t conn_id)
+{
+    uint8_t i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS; i++)
+    {
+        if (sessions[i].state != SIMULATED_SESSION_FREE && sessions[i].conn_id == conn_id)
+        {
+            sessions[i].state = SIMULATED_SESSION_FREE;
+        }
+    }
+
+    lock.unlock();
+}
+
+uint32_t SimulatedProvisioningBearer::service(uint32_t now_ms)
+{
+    struct
+    {
+        uint16_t conn_id;
+        uint8_t  state;
+        bool     fails;
+    } reports[EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS];
+    uint32_t wait = osWaitForever;
+    uint8_t  count = 0;
+    uint8_t  i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS; i++)
+    {
+        Session& session = sessions[i];
+
+        if (session.state == SIMULATED_SESSION_OPENED)
+        {
+            session.state = SIMULATED_SESSION_CONNECTING;
+            if (random(100) < params.connect_failure_percent)
+            {
+                /* Never connects, left to the manager timeout */
+                session.state = SIMULATED_SESSION_REPORTED;
+                continue;
+            }
+            session.due_ms = now_ms + params.connect_ms + random(params.jitter_ms + 1);
+        }
+
+        if (session.state != SIMULATED_SESSION_CONNECTING && session.state != SIMULATED_SESSION_PROVISIONING)
+        {
+            continue;
+        }
+
+        if ((int32_t)(session.due_ms - now_ms) > 0)
+        {
+            wait = ((session.due_ms - now_ms) < wait) ? (session.due_ms - now_ms) : wait;
+            continue;
+        }
+
+        reports[count].conn_id = session.conn_id;
+        reports[count].state   = session.state;
+        reports[count].fails   = session.fails;
+        count++;
+
+        if (session.state == SIMULATED_SESSION_CONNECTING)
+        {
+            session.state  = SIMULATED_SESSION_PROVISIONING;
+            session.fails  = (random(100) < params.provision_failure_percent);
+            session.due_ms = now_ms + params.provision_ms + random(params.jitter_ms + 1);
+            wait = ((session.due_ms - now_ms) < wait) ? (session.due_ms - now_ms) : wait;
+        }
+        else
+        {
+            session.state = SIMULATED_SESSION_REPORTED;
+        }
+    }
+
+    lock.unlock();
+
+    /* Reported without the lock, the manager may call open and close while reporting */
+    for (i = 0; i < count && manager != NULL; i++)
+    {
+        if (reports[i].state == SIMULATED_SESSION_CONNECTING)
+        {
+            manager->connected(reports[i].conn_id, true, now_ms);
+        }
+        else
+        {
+            manager->completed(reports[i].conn_id, reports[i].fails ? WICED_BT_MESH_PROVISION_RESULT_FAILED :
+                               WICED_BT_MESH_PROVISION_RESULT_SUCCESS, now_ms);
+        }
+    }
+
+    return wait;
+}
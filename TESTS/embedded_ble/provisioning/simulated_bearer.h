@@ -0,0 +1,105 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Simulated provisioning bearer for the provisioning manager tests: connects and provisions
+ * devices after a modeled latency, with injected failures, and reports them to the manager
+ * as a Bluetooth Controller would.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "embedded_BLE_provisioning.h"
+
+namespace cypress
+{
+namespace embedded
+{
+
+/** Defines the provisioning latency model of SimulatedProvisioningBearer */
+struct SimulatedProvisioningParameters
+{
+    uint32_t connect_ms;                /**< Time to connect to a device */
+    uint32_t provision_ms;              /**< Time to provision a connected device */
+    uint32_t jitter_ms;                 /**< Random extra time added to each stage */
+    uint8_t  connect_failure_percent;   /**< Connections that never complete (the manager times them out) */
+    uint8_t  provision_failure_percent; /**< Provisioning attempts reporting WICED_BT_MESH_PROVISION_RESULT_FAILED */
+    uint32_t seed;                      /**< Seed of the pseudo random generator */
+};
+
+/** Defines a controller stand-in that connects and provisions devices after a modeled latency */
+class SimulatedProvisioningBearer : public ProvisioningBearer
+{
+public:
+    SimulatedProvisioningBearer(const SimulatedProvisioningParameters& params);
+
+    /** Sets the manager notified of the connections and results */
+    void setManager(ProvisioningManager* manager)
+    {
+        this->manager = manager;
+    }
+
+    virtual ble_error_t open(uint16_t conn_id, const uint8_t* uuid);
+
+    virtual void close(uint16_t conn_id);
+
+    /** Reports the connections and results due at now_ms to the manager.
+     *
+     * @return time until the next report (ms), osWaitForever when there is none
+     */
+    uint32_t service(uint32_t now_ms);
+
+private:
+    struct Session
+    {
+        uint16_t conn_id;
+        uint8_t  state;
+        bool     fails;
+        uint32_t due_ms;
+    };
+
+    uint32_t random(uint32_t range);
+
+    SimulatedProvisioningParameters params;
+    ProvisioningManager*            manager;
+    Session                         sessions[EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS];
+    uint32_t                        state;
+    rtos::Mutex                     lock;
+};
+
+}
+
+}
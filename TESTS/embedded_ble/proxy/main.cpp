@@ -0,0 +1,408 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * ProxyConnectionTable tests: routing and per-connection ordering of packets sent from a thread
+ * per connection, round robin between the queues, and the connection selections of connect,
+ * disconnect and the default connection, against a controller model applying proxy data to
+ * the connection selected last.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "embedded_BLE_proxy.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_CONNECTIONS            (4)
+#define TEST_PACKETS                (500)
+#define TEST_MAX_PACKET_LENGTH      (300)
+#define TEST_LARGE_PACKET_LENGTH    (EMBEDDED_BLE_MESH_PROXY_QUEUE_SIZE + 100)
+#define TEST_QUEUED_PACKETS         (12)
+#define TEST_THREAD_STACK_SIZE      (1024)
+#define TEST_EVENT_TIMEOUT_MS       (5000)
+#define TEST_MAX_RECORDS            (64)
+#define TEST_SENDING                (1)
+#define TEST_RELEASE                (2)
+#define TEST_START                  (4)
+
+/* Applies proxy data to the connection selected last, as the controller does, and checks that
+ * the table writes one packet or selection at a time */
+class ControllerModel
+{
+public:
+    ControllerModel() : hold(false)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        selected = 0;
+        writing = 0;
+        overlaps = 0;
+        misrouted = 0;
+        misordered = 0;
+        records = 0;
+        memset(open, 0, sizeof(open));
+        memset(received, 0, sizeof(received));
+        memset(record, 0, sizeof(record));
+    }
+
+    /* Packets carry the connection they are for, then a 16-bit sequence number */
+    bool transmit(uint16_t conn_id, const uint8_t* data, uint16_t length)
+    {
+        uint16_t owner = 0;
+        uint16_t sequence = 0;
+
+        enter();
+        if (hold)
+        {
+            hold = false;
+            flags.set(TEST_SENDING);
+            flags.wait_any(TEST_RELEASE);
+        }
+        if (conn_id != 0)
+        {
+            selected = conn_id;
+        }
+        owner    = data[0] | (data[1] << 8);
+        sequence = data[2] | (data[3] << 8);
+        if (selected == 0 || selected != owner || selected >= TEST_MAX_RECORDS || !open[selected])
+        {
+            misrouted++;
+        }
+        else
+        {
+            if (sequence != received[selected])
+            {
+                misordered++;
+            }
+            received[selected] = sequence + 1;
+        }
+        if (records < TEST_MAX_RECORDS)
+        {
+            record[records++] = selected;
+        }
+        leave();
+
+        // Writing to the controller takes a while, the senders queue behind it
+        ThisThread::yield();
+
+        return true;
+    }
+
+    void control(uint16_t conn_id, bool connected)
+    {
+        enter();
+        if (connected)
+        {
+            open[conn_id] = true;
+            selected = conn_id;
+        }
+        else if (conn_id == 0)
+        {
+            memset(open, 0, sizeof(open));
+            selected = 0;
+        }
+        else
+        {
+            open[conn_id] = false;
+            selected = (selected == conn_id) ? 0 : selected;
+        }
+        leave();
+    }
+
+    static bool transmitFunction(uint16_t conn_id, const uint8_t* data, uint16_t length, void* context)
+    {
+        return ((ControllerModel*)context)->transmit(conn_id, data, length);
+    }
+
+    static void controlFunction(uint16_t conn_id, bool connected, void* context)
+    {
+        ((ControllerModel*)context)->control(conn_id, connected);
+    }
+
+    volatile bool hold;
+    EventFlags    flags;
+    uint16_t      selected;
+    uint32_t      overlaps;
+    uint32_t      misrouted;
+    uint32_t      misordered;
+    bool          open[TEST_MAX_RECORDS];
+    uint16_t      received[TEST_MAX_RECORDS];
+    uint16_t      record[TEST_MAX_RECORDS];
+    uint16_t      records;
+
+private:
+    void enter()
+    {
+        if (core_util_atomic_incr_u32(&writing, 1) != 1)
+        {
+            overlaps++;
+        }
+    }
+
+    void leave()
+    {
+        core_util_atomic_decr_u32(&writing, 1);
+    }
+
+    volatile uint32_t writing;
+};
+
+static ControllerModel      model;
+static ProxyConnectionTable table(ControllerModel::transmitFunction, &model, ControllerModel::controlFunction);
+static EventFlags           start_flags;
+
+static void make_packet(uint8_t* packet, uint16_t conn_id, uint16_t sequence)
+{
+    packet[0] = (uint8_t)conn_id;
+    packet[1] = (uint8_t)(conn_id >> 8);
+    packet[2] = (uint8_t)sequence;
+    packet[3] = (uint8_t)(sequence >> 8);
+}
+
+/* Sends the packets of one connection */
+class Sender
+{
+public:
+    Sender() : conn_id(0), failures(0), thread(osPriorityNormal, TEST_THREAD_STACK_SIZE) {}
+
+    void start(uint16_t conn_id)
+    {
+        this->conn_id = conn_id;
+        thread.start(callback(this, &Sender::run));
+    }
+
+    void join()
+    {
+        thread.join();
+    }
+
+    uint16_t conn_id;
+    uint32_t failures;
+
+private:
+    void run()
+    {
+        uint8_t  packet[TEST_MAX_PACKET_LENGTH];
+        uint16_t sequence = 0;
+
+        memset(packet, 0, sizeof(packet));
+        start_flags.wait_any(TEST_START, osWaitForever, false);
+        for (sequence = 0; sequence < TEST_PACKETS; sequence++)
+        {
+            make_packet(packet, conn_id, sequence);
+            if (table.send(conn_id, packet, 4 + (sequence * 37) % (TEST_MAX_PACKET_LENGTH - 4)) != BLE_ERROR_NONE)
+            {
+                failures++;
+            }
+        }
+    }
+
+    Thread thread;
+};
+
+static void test_routing(void)
+{
+    static Sender       senders[TEST_CONNECTIONS];
+    ProxyConnectionInfo info[EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS];
+    uint32_t            switches = table.getSwitchCount();
+    uint32_t            packets = 0;
+    uint8_t             count = 0;
+    uint8_t             i = 0;
+
+    for (i = 0; i < TEST_CONNECTIONS; i++)
+    {
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.connect(3 + 4 * i));
+        TEST_ASSERT_EQUAL(3 + 4 * i, model.selected);
+    }
+    TEST_ASSERT_EQUAL(BLE_ERROR_NO_MEM, table.connect(40));
+
+    for (i = 0; i < TEST_CONNECTIONS; i++)
+    {
+        senders[i].start(3 + 4 * i);
+    }
+    start_flags.set(TEST_START);
+    for (i = 0; i < TEST_CONNECTIONS; i++)
+    {
+        senders[i].join();
+        TEST_ASSERT_EQUAL(0, senders[i].failures);
+        TEST_ASSERT_EQUAL(TEST_PACKETS, model.received[senders[i].conn_id]);
+    }
+    TEST_ASSERT_EQUAL(0, model.misrouted);
+    TEST_ASSERT_EQUAL(0, model.misordered);
+    TEST_ASSERT_EQUAL(0, model.overlaps);
+    TEST_ASSERT_EQUAL(0, table.getQueueDepth());
+
+    count = table.getConnections(info, EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS);
+    for (i = 0; i < count; i++)
+    {
+        TEST_ASSERT_EQUAL(TEST_PACKETS, info[i].tx_packets);
+        TEST_ASSERT_EQUAL(0, info[i].tx_dropped);
+        packets += info[i].tx_packets;
+    }
+    printf("%lu packets on %u connections, %lu connection selections\r\n", (unsigned long)packets,
+           (unsigned int)count, (unsigned long)(table.getSwitchCount() - switches));
+
+    /* A packet too large for the queue is sent in turn, from the caller's buffer */
+    {
+        static uint8_t large[TEST_LARGE_PACKET_LENGTH];
+
+        make_packet(large, 3, TEST_PACKETS);
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.send(3, large, sizeof(large)));
+        TEST_ASSERT_EQUAL(TEST_PACKETS + 1, model.received[3]);
+    }
+}
+
+/* Sends the first packet, which holds the table in the model while the others are queued */
+static void send_held(void)
+{
+    uint8_t packet[8];
+
+    memset(packet, 0, sizeof(packet));
+    make_packet(packet, 3, model.received[3]);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.send(3, packet, sizeof(packet)));
+}
+
+static void test_round_robin(void)
+{
+    Thread   sender(osPriorityNormal, TEST_THREAD_STACK_SIZE);
+    uint8_t  packet[8];
+    uint16_t sequence[TEST_CONNECTIONS];
+    uint16_t first = 0;
+    uint16_t i = 0;
+    uint16_t j = 0;
+
+    /* Everyone's packets are queued while the first one is in the controller */
+    memset(packet, 0, sizeof(packet));
+    for (j = 0; j < TEST_CONNECTIONS; j++)
+    {
+        sequence[j] = model.received[3 + 4 * j];
+    }
+    sequence[0]++;
+    model.records = 0;
+    model.hold = true;
+    model.flags.clear();
+    sender.start(send_held);
+    TEST_ASSERT_FALSE(model.flags.wait_any(TEST_SENDING, TEST_EVENT_TIMEOUT_MS) & osFlagsError);
+    for (i = 0; i < TEST_QUEUED_PACKETS; i++)
+    {
+        for (j = 0; j < TEST_CONNECTIONS; j++)
+        {
+            make_packet(packet, 3 + 4 * j, sequence[j]++);
+            TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.send(3 + 4 * j, packet, sizeof(packet)));
+        }
+    }
+    TEST_ASSERT_EQUAL(1 + TEST_QUEUED_PACKETS * TEST_CONNECTIONS, table.getQueueDepth());
+    model.flags.set(TEST_RELEASE);
+    sender.join();
+
+    /* No connection keeps the controller for more than a burst while others wait */
+    TEST_ASSERT_EQUAL(1 + TEST_QUEUED_PACKETS * TEST_CONNECTIONS, model.records);
+    for (i = 1, first = 0; i <= model.records; i++)
+    {
+        if (i == model.records || model.record[i] != model.record[first])
+        {
+            TEST_ASSERT_TRUE(i - first <= EMBEDDED_BLE_MESH_PROXY_BURST);
+            first = i;
+        }
+    }
+    TEST_ASSERT_EQUAL(0, model.misrouted);
+    TEST_ASSERT_EQUAL(0, model.misordered);
+    TEST_ASSERT_EQUAL(0, model.overlaps);
+}
+
+static void test_selection(void)
+{
+    uint8_t packet[8];
+
+    memset(packet, 0, sizeof(packet));
+
+    /* The default connection sends on the one the controller has selected */
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.disconnect(7));
+    TEST_ASSERT_FALSE(model.open[7]);
+    make_packet(packet, 7, model.received[7]);
+    TEST_ASSERT_EQUAL(BLE_ERROR_INVALID_STATE, table.send(7, packet, sizeof(packet)));
+    TEST_ASSERT_EQUAL(BLE_ERROR_INVALID_PARAM, table.disconnect(40));
+    TEST_ASSERT_EQUAL(3, table.getDefaultConnection());
+
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.connect(11));
+    make_packet(packet, 11, model.received[11]);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.send(0, packet, sizeof(packet)));
+
+    /* A closed entry is reused for a new connection */
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.connect(40));
+    TEST_ASSERT_TRUE(model.open[40]);
+    make_packet(packet, 40, 0);
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.send(40, packet, sizeof(packet)));
+    TEST_ASSERT_EQUAL(1, model.received[40]);
+
+    /* 0 closes them all */
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, table.disconnect(0));
+    TEST_ASSERT_EQUAL(0, model.selected);
+    TEST_ASSERT_EQUAL(0, table.getDefaultConnection());
+    TEST_ASSERT_EQUAL(BLE_ERROR_INVALID_PARAM, table.connect(0));
+
+    TEST_ASSERT_EQUAL(0, model.misrouted);
+    TEST_ASSERT_EQUAL(0, model.misordered);
+    TEST_ASSERT_EQUAL(0, model.overlaps);
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("ProxyConnectionTable routing and ordering", test_routing),
+    Case("ProxyConnectionTable round robin", test_round_robin),
+    Case("ProxyConnectionTable connection selection", test_selection),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -0,0 +1,348 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * MeshRadioGroup tests: radio selection, failover and uplink de-duplication, then the
+ * throughput of saturated groups of SimulatedMeshRadio links and a link dropping mid run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "embedded_BLE_radiogroup.h"
+#include "simulated_radio.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_PROXY_PDU_SIZE         (29)
+#define TEST_DURATION_MS            (20000)
+#define TEST_MAX_RADIOS             (4)
+
+/* Packets a saturated group got acknowledged, overall and around a link drop */
+struct RadioGroupRun
+{
+    uint32_t acked;
+    uint32_t lost;
+    uint32_t failovers;
+    uint32_t window[3];
+};
+
+static uint8_t packet[TEST_PROXY_PDU_SIZE];
+
+static SimulatedMeshRadioParameters link_parameters(uint32_t bytes_per_second, uint32_t latency_ms, uint16_t queue_packets)
+{
+    SimulatedMeshRadioParameters params = { bytes_per_second, latency_ms, queue_packets };
+
+    return params;
+}
+
+static void test_selection(void)
+{
+    SimulatedMeshRadio       a(link_parameters(2400, 30, 2));
+    SimulatedMeshRadio       b(link_parameters(2400, 30, 2));
+    MeshRadioGroup           group;
+    MeshRadioGroupStatistics stats;
+    int                      i = 0;
+
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, group.addRadio(a));
+    TEST_ASSERT_EQUAL(BLE_ERROR_NONE, group.addRadio(b));
+    a.service(0);
+    b.service(0);
+
+    /* Equal links share the traffic until both are full */
+    for (i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, group.sendData(packet, sizeof(packet)));
+    }
+    TEST_ASSERT_EQUAL(2, a.getQueueDepth());
+    TEST_ASSERT_EQUAL(2, b.getQueueDepth());
+    TEST_ASSERT_EQUAL(BLE_ERROR_NO_MEM, group.sendData(packet, sizeof(packet)));
+    group.getStatistics(stats);
+    TEST_ASSERT_EQUAL(4, stats.sent);
+    TEST_ASSERT_EQUAL(1, stats.failed);
+    TEST_ASSERT_EQUAL(0, stats.failovers);
+
+    /* A dropped link loses its packets and receives nothing more */
+    a.setConnected(false);
+    TEST_ASSERT_EQUAL(2, a.getLost());
+    b.service(100);
+    TEST_ASSERT_EQUAL(0, b.getQueueDepth());
+    TEST_ASSERT_EQUAL(2, b.getAcknowledged());
+    for (i = 0; i < 2; i++)
+    {
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, group.sendData(packet, sizeof(packet)));
+    }
+    TEST_ASSERT_EQUAL(2, b.getQueueDepth());
+    b.setConnected(false);
+    TEST_ASSERT_EQUAL(BLE_ERROR_INVALID_STATE, group.sendData(packet, sizeof(packet)));
+}
+
+static void test_failover(void)
+{
+    SimulatedMeshRadio       x(link_parameters(2400, 30, 1));
+    SimulatedMeshRadio       y(link_parameters(2400, 30, 4));
+    MeshRadioGroup           group;
+    MeshRadioGroupStatistics stats;
+    MeshRadioInfo            info[2];
+    int                      i = 0;
+
+    group.addRadio(x);
+    group.addRadio(y);
+
+    /* The third packet goes to the full radio first and fails over */
+    for (i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(BLE_ERROR_NONE, group.sendData(packet, sizeof(packet)));
+    }
+    TEST_ASSERT_EQUAL(2, group.getRadios(info, 2));
+    group.getStatistics(stats);
+    TEST_ASSERT_EQUAL(1, x.getQueueDepth());
+    TEST_ASSERT_EQUAL(2, y.getQueueDepth());
+    TEST_ASSERT_EQUAL(1, info[0].refused);
+    TEST_ASSERT_EQUAL(1, stats.failovers);
+}
+
+static void test_slow_link(void)
+{
+    SimulatedMeshRadio fast(link_parameters(4800, 20, 8));
+    SimulatedMeshRadio slow(link_parameters(4800, 200, 8));
+    MeshRadioGroup     group;
+    MeshRadioInfo      info[2];
+    uint32_t           now = 0;
+
+    group.addRadio(fast);
+    group.addRadio(slow);
+
+    for (now = 0; now < 5000; now++)
+    {
+        fast.service(now);
+        slow.service(now);
+        if (now % 20 == 0)
+        {
+            group.sendData(packet, sizeof(packet));
+        }
+    }
+
+    /* The link acknowledging ten times slower gets a fraction of the traffic */
+    TEST_ASSERT_EQUAL(2, group.getRadios(info, 2));
+    printf("slow link: %lu of %lu packets\r\n", (unsigned long) info[1].sent, (unsigned long) (info[0].sent + info[1].sent));
+    TEST_ASSERT_TRUE(info[0].sent > 3 * info[1].sent);
+}
+
+static void test_uplink(void)
+{
+    SimulatedMeshRadio   r0(link_parameters(1, 1, 1));
+    SimulatedMeshRadio   r1(link_parameters(1, 1, 1));
+    SimulatedMeshRadio   r2(link_parameters(1, 1, 1));
+    SimulatedMeshRadio*  radios[3] = { &r0, &r1, &r2 };
+    MeshRadioGroup       group;
+    MeshUplinkStatistics stats;
+    uint8_t              message[20];
+    int                  delivered = 0;
+    int                  i = 0;
+    int                  k = 0;
+
+    for (i = 0; i < 3; i++)
+    {
+        group.addRadio(*radios[i]);
+    }
+
+    /* Every radio hears every message, the application gets each one once */
+    for (k = 0; k < 100; k++)
+    {
+        memset(message, 0, sizeof(message));
+        message[5] = k;
+        message[6] = k >> 8;
+        for (i = 0; i < 3; i++)
+        {
+            radios[i]->service(k * 10);
+            delivered += radios[i]->receive(message, sizeof(message));
+        }
+    }
+
+    group.getUplinkStatistics(stats);
+    TEST_ASSERT_EQUAL(100, delivered);
+    TEST_ASSERT_EQUAL(300, stats.received);
+    TEST_ASSERT_EQUAL(200, stats.duplicates);
+}
+
+/* Keeps every radio of the group full for duration_ms, radio drop is down from drop_ms to back_ms */
+static RadioGroupRun saturate(int count, const SimulatedMeshRadioParameters* params, int drop, uint32_t drop_ms, uint32_t back_ms)
+{
+    SimulatedMeshRadio*      radios[TEST_MAX_RADIOS];
+    MeshRadioGroup           group;
+    MeshRadioGroupStatistics stats;
+    RadioGroupRun            run;
+    uint32_t                 previous = 0;
+    uint32_t                 acked = 0;
+    uint32_t                 now = 0;
+    int                      i = 0;
+
+    memset(&run, 0, sizeof(run));
+    for (i = 0; i < count; i++)
+    {
+        radios[i] = new SimulatedMeshRadio(params[i]);
+        group.addRadio(*radios[i]);
+    }
+
+    for (now = 0; now <= TEST_DURATION_MS; now++)
+    {
+        for (i = 0; i < count; i++)
+        {
+            radios[i]->service(now);
+        }
+        if (drop >= 0 && now == drop_ms)
+        {
+            radios[drop]->setConnected(false);
+        }
+        if (drop >= 0 && now == back_ms)
+        {
+            radios[drop]->setConnected(true);
+        }
+        while (group.sendData(packet, sizeof(packet)) == BLE_ERROR_NONE)
+        {
+        }
+
+        acked = 0;
+        for (i = 0; i < count; i++)
+        {
+            acked += radios[i]->getAcknowledged();
+        }
+        if (drop >= 0 && (now == drop_ms || now == back_ms || now == TEST_DURATION_MS))
+        {
+            run.window[now == drop_ms ? 0 : (now == back_ms ? 1 : 2)] = acked - previous;
+            previous = acked;
+        }
+    }
+
+    group.getStatistics(stats);
+    run.acked     = acked;
+    run.failovers = stats.failovers;
+    for (i = 0; i < count; i++)
+    {
+        run.lost += radios[i]->getLost();
+        delete radios[i];
+    }
+
+    return run;
+}
+
+static void test_throughput(void)
+{
+    SimulatedMeshRadioParameters same[TEST_MAX_RADIOS];
+    SimulatedMeshRadioParameters mixed[TEST_MAX_RADIOS] =
+    {
+        link_parameters(4800, 20, 8), link_parameters(2400, 30, 8),
+        link_parameters(2400, 30, 8), link_parameters(1200, 80, 8),
+    };
+    RadioGroupRun                run;
+    uint32_t                     single = 0;
+    uint32_t                     link_rates = (4800 + 2400 + 2400 + 1200) / TEST_PROXY_PDU_SIZE;
+    int                          count = 0;
+
+    for (count = 0; count < TEST_MAX_RADIOS; count++)
+    {
+        same[count] = link_parameters(2400, 30, 8);
+    }
+
+    /* Identical links: the group scales with the number of radios */
+    for (count = 1; count <= TEST_MAX_RADIOS; count++)
+    {
+        run = saturate(count, same, -1, 0, 0);
+        printf("%d identical radios: %lu packets/s\r\n", count, (unsigned long) (run.acked * 1000 / TEST_DURATION_MS));
+        if (count == 1)
+        {
+            single = run.acked;
+        }
+    }
+    TEST_ASSERT_TRUE(run.acked > 3 * single);
+
+    /* Mixed links: the group gets close to the sum of the link rates */
+    run = saturate(TEST_MAX_RADIOS, mixed, -1, 0, 0);
+    printf("4 mixed radios: %lu packets/s, links carry %lu\r\n", (unsigned long) (run.acked * 1000 / TEST_DURATION_MS),
+           (unsigned long) link_rates);
+    TEST_ASSERT_TRUE(run.acked * 1000 / TEST_DURATION_MS > link_rates * 8 / 10);
+}
+
+static void test_link_drop(void)
+{
+    SimulatedMeshRadioParameters same[TEST_MAX_RADIOS];
+    RadioGroupRun                run;
+    int                          i = 0;
+
+    for (i = 0; i < TEST_MAX_RADIOS; i++)
+    {
+        same[i] = link_parameters(2400, 30, 8);
+    }
+
+    /* Radio 2 is down through the middle third of the run */
+    run = saturate(TEST_MAX_RADIOS, same, 2, TEST_DURATION_MS / 3, 2 * TEST_DURATION_MS / 3);
+    printf("link drop: %lu / %lu / %lu packets before/during/after, %lu lost, %lu failovers\r\n",
+           (unsigned long) run.window[0], (unsigned long) run.window[1], (unsigned long) run.window[2],
+           (unsigned long) run.lost, (unsigned long) run.failovers);
+
+    /* The three remaining links carry the traffic, the fourth takes its share back */
+    TEST_ASSERT_TRUE(run.window[1] < run.window[0]);
+    TEST_ASSERT_TRUE(run.window[1] > run.window[0] * 2 / 3);
+    TEST_ASSERT_TRUE(run.window[2] > run.window[1]);
+    TEST_ASSERT_TRUE(run.lost <= 8);
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("MeshRadioGroup selection", test_selection),
+    Case("MeshRadioGroup failover", test_failover),
+    Case("MeshRadioGroup slow link", test_slow_link),
+    Case("MeshRadioGroup uplink", test_uplink),
+    Case("MeshRadioGroup throughput", test_throughput),
+    Case("MeshRadioGroup link drop", test_link_drop),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
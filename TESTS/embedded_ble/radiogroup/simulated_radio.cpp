@@ -0,0 +1,158 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Simulated radio for the radio group tests
+ */
+
+#include <string.h>
+#include "simulated_radio.h"
+
+using namespace cypress::embedded;
+
+SimulatedMeshRadio::SimulatedMeshRadio(const SimulatedMeshRadioParameters& params) :
+    params(params),
+    head(0),
+    count(0),
+    connected(true),
+    busy_until_us(0),
+    now_ms(0),
+    acked(0),
+    latency_total_ms(0),
+    lost(0)
+{
+    if (this->params.queue_packets == 0 || this->params.queue_packets > EMBEDDED_BLE_MESH_SIMULATED_RADIO_QUEUE)
+    {
+        this->params.queue_packets = EMBEDDED_BLE_MESH_SIMULATED_RADIO_QUEUE;
+    }
+    if (this->params.bytes_per_second == 0)
+    {
+        this->params.bytes_per_second = 1;
+    }
+}
+
+bool SimulatedMeshRadio::isConnected(void)
+{
+    return connected;
+}
+
+uint32_t SimulatedMeshRadio::getQueueDepth(void)
+{
+    return count;
+}
+
+ble_error_t SimulatedMeshRadio::send(const uint8_t* data, uint16_t length)
+{
+    ble_error_t result = BLE_ERROR_NONE;
+    uint64_t    start_us = 0;
+    Packet*     packet = NULL;
+
+    lock.lock();
+
+    if (!connected)
+    {
+        result = BLE_ERROR_INVALID_STATE;
+    }
+    else if (count >= params.queue_packets)
+    {
+        result = BLE_ERROR_NO_MEM;
+    }
+    else
+    {
+        // The link transmits one packet after the other at its rate
+        start_us = (uint64_t) now_ms * 1000;
+        if (busy_until_us > start_us)
+        {
+            start_us = busy_until_us;
+        }
+        busy_until_us = start_us + (uint64_t) length * 1000000 / params.bytes_per_second;
+
+        packet = &packets[(head + count) % EMBEDDED_BLE_MESH_SIMULATED_RADIO_QUEUE];
+        packet->sent_ms = now_ms;
+        packet->ack_ms  = (uint32_t) ((busy_until_us + 999) / 1000) + params.latency_ms;
+        count++;
+    }
+
+    lock.unlock();
+
+    return result;
+}
+
+void SimulatedMeshRadio::setConnected(bool connected)
+{
+    lock.lock();
+
+    if (!connected)
+    {
+        lost += count;
+        count = 0;
+        busy_until_us = 0;
+    }
+    this->connected = connected;
+
+    lock.unlock();
+}
+
+bool SimulatedMeshRadio::receive(const uint8_t* packet, uint32_t length)
+{
+    if (uplink == NULL)
+    {
+        return true;
+    }
+
+    return uplink->accept(packet, length, now_ms);
+}
+
+uint32_t SimulatedMeshRadio::service(uint32_t now_ms)
+{
+    uint32_t wait_ms = osWaitForever;
+
+    lock.lock();
+
+    this->now_ms = now_ms;
+    while (count && (int32_t) (packets[head].ack_ms - now_ms) <= 0)
+    {
+        acknowledged(packets[head].ack_ms - packets[head].sent_ms);
+        latency_total_ms += packets[head].ack_ms - packets[head].sent_ms;
+        head = (head + 1) % EMBEDDED_BLE_MESH_SIMULATED_RADIO_QUEUE;
+        count--;
+        acked++;
+    }
+    if (count)
+    {
+        wait_ms = packets[head].ack_ms - now_ms;
+    }
+
+    lock.unlock();
+
+    return wait_ms;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Simulated radio for the radio group tests: models the rate, acknowledgement latency and
+ * queue of a proxy link, and passes the packets it hears through the uplink filter.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "embedded_BLE_radiogroup.h"
+
+/** Packets a simulated radio can hold until they are acknowledged */
+#ifndef EMBEDDED_BLE_MESH_SIMULATED_RADIO_QUEUE
+#define EMBEDDED_BLE_MESH_SIMULATED_RADIO_QUEUE (32)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/** Defines the simulated link of a radio */
+struct SimulatedMeshRadioParameters
+{
+    uint32_t bytes_per_second;      /**< Throughput of the link */
+    uint32_t latency_ms;            /**< Time from the end of a transmission to its acknowledgement */
+    uint16_t queue_packets;         /**< Outstanding packets accepted, at most EMBEDDED_BLE_MESH_SIMULATED_RADIO_QUEUE */
+};
+
+/** Defines a radio simulating the transmission and acknowledgement of packets */
+class SimulatedMeshRadio : public MeshRadio
+{
+public:
+    SimulatedMeshRadio(const SimulatedMeshRadioParameters& params);
+
+    virtual bool isConnected(void);
+
+    virtual uint32_t getQueueDepth(void);
+
+    virtual ble_error_t send(const uint8_t* data, uint16_t length);
+
+    /** Opens or drops the link, the outstanding packets of a dropped link are lost */
+    void setConnected(bool connected);
+
+    /** Passes a packet heard by the radio through the uplink filter.
+     *
+     * @return true when the packet is delivered to the application
+     */
+    bool receive(const uint8_t* packet, uint32_t length);
+
+    /** Acknowledges the packets due at now_ms.
+     *
+     * @return time until the next acknowledgement (ms), osWaitForever when there is none
+     */
+    uint32_t service(uint32_t now_ms);
+
+    /** Gets the packets acknowledged */
+    inline uint32_t getAcknowledged(void)
+    {
+        return acked;
+    }
+
+    /** Gets the sum of the acknowledgement latencies (ms) */
+    inline uint64_t getLatencyTotal(void)
+    {
+        return latency_total_ms;
+    }
+
+    /** Gets the packets lost when the link dropped */
+    inline uint32_t getLost(void)
+    {
+        return lost;
+    }
+
+private:
+    struct Packet
+    {
+        uint32_t sent_ms;
+        uint32_t ack_ms;
+    };
+
+    SimulatedMeshRadioParameters params;
+    Packet                       packets[EMBEDDED_BLE_MESH_SIMULATED_RADIO_QUEUE];
+    uint16_t                     head;
+    uint16_t                     count;
+    bool                         connected;
+    uint64_t                     busy_until_us;
+    uint32_t                     now_ms;
+    uint32_t                     acked;
+    uint64_t                     latency_total_ms;
+    uint32_t                     lost;
+    rtos::Mutex                  lock;
+};
+
+}
+
+}
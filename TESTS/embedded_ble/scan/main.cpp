@@ -0,0 +1,243 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * ScanPipeline tests: a simulated controller floods the pipeline with the advertisement reports
+ * of a population of advertisers in duplicate filtering mode, the delivered reports are checked
+ * against the de-duplication window and the rate the pipeline sustains is reported.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "mbed.h"
+#include "greentea-client/test_env.h"
+#include "unity.h"
+#include "utest.h"
+#include "embedded_BLE_scanner.h"
+
+using namespace utest::v1;
+using namespace cypress::embedded;
+
+#define TEST_REPORTS                (200000)
+#define TEST_DEVICES                (100)
+#define TEST_CROWD_DEVICES          (2 * EMBEDDED_BLE_SCAN_DEDUP_CACHE_SIZE)
+#define TEST_DEDUP_WINDOW_MS        (1000)
+#define TEST_BATCH_SIZE             (EMBEDDED_BLE_SCAN_MAX_BATCH_SIZE)
+#define TEST_ADV_DATA_LENGTH        (31)
+
+/* Generates the reports of devices advertising in turn, one report per millisecond */
+class SimulatedScanner
+{
+public:
+    SimulatedScanner(uint32_t devices) : devices(devices)
+    {
+        memset(&result, 0, sizeof(result));
+        memset(adv_data, 0, sizeof(adv_data));
+        result.ble_addr_type   = BLE_ADDR_RANDOM;
+        result.ble_evt_type    = BTM_BLE_EVT_NON_CONNECTABLE_ADVERTISEMENT;
+        result.adv_data_length = TEST_ADV_DATA_LENGTH;
+        adv_data[0] = 2;
+        adv_data[1] = BTM_BLE_ADVERT_TYPE_FLAG;
+        adv_data[2] = 0x06;
+        adv_data[3] = TEST_ADV_DATA_LENGTH - 4;
+        adv_data[4] = BTM_BLE_ADVERT_TYPE_MANUFACTURER;
+    }
+
+    /* Floods the pipeline, returns the time taken (ms) */
+    uint32_t flood(ScanPipeline& pipeline, uint32_t reports)
+    {
+        uint64_t start_ms = rtos::Kernel::get_ms_count();
+        uint32_t i = 0;
+
+        for (i = 0; i < reports; i++)
+        {
+            uint32_t device = i % devices;
+
+            result.remote_bd_addr[0] = (uint8_t)device;
+            result.remote_bd_addr[1] = (uint8_t)(device >> 8);
+            result.remote_bd_addr[5] = 0xC0;
+            result.rssi = -40 - (int8_t)(i % 50);
+            adv_data[5] = (uint8_t)device;
+            adv_data[6] = (uint8_t)(device >> 8);
+            pipeline.process(&result, adv_data, i);
+        }
+        pipeline.flush();
+
+        return (uint32_t)(rtos::Kernel::get_ms_count() - start_ms);
+    }
+
+    /* Reports let through when no device is evicted from the cache: a device advertising every
+     * interval is let through again by its first report after the window has elapsed. An eviction
+     * lets at most one more report through */
+    uint32_t expected(uint32_t reports)
+    {
+        uint32_t period = (TEST_DEDUP_WINDOW_MS / devices + 1) * devices;
+        uint32_t count = 0;
+        uint32_t device = 0;
+
+        for (device = 0; device < devices && device < reports; device++)
+        {
+            uint32_t last = device + ((reports - 1 - device) / devices) * devices;
+
+            count += (last - device) / period + 1;
+        }
+
+        return count;
+    }
+
+private:
+    uint32_t                    devices;
+    wiced_bt_ble_scan_results_t result;
+    uint8_t                     adv_data[TEST_ADV_DATA_LENGTH];
+};
+
+static ScanPipeline pipeline;
+static uint32_t     delivered;
+static uint32_t     batches;
+static uint32_t     oversized;
+
+static void report_callback(const AdvertisementReport* reports, uint16_t count)
+{
+    delivered += count;
+    batches++;
+    if (count > TEST_BATCH_SIZE || reports[0].data_length != TEST_ADV_DATA_LENGTH)
+    {
+        oversized++;
+    }
+}
+
+/* Partial batches are only delivered by flush(), the flood runs on its own clock */
+static void configure(void)
+{
+    ScanParameters params = { true, TEST_DEDUP_WINDOW_MS, TEST_BATCH_SIZE, osWaitForever };
+
+    delivered = 0;
+    batches = 0;
+    oversized = 0;
+    pipeline.configure(params, report_callback);
+}
+
+static void print_rate(const char* name, const ScanStatistics& stats, uint32_t elapsed_ms)
+{
+    printf("%s: %lu reports in %lu ms (%lu reports/s), %lu duplicates, %lu delivered in %lu batches, "
+           "%lu evictions\r\n", name, (unsigned long)stats.received, (unsigned long)elapsed_ms,
+           (unsigned long)(elapsed_ms ? (stats.received * 1000ULL) / elapsed_ms : 0),
+           (unsigned long)stats.duplicates, (unsigned long)stats.delivered, (unsigned long)stats.batches,
+           (unsigned long)stats.evictions);
+}
+
+static void test_flood(void)
+{
+    SimulatedScanner scanner(TEST_DEVICES);
+    ScanStatistics   stats;
+    uint32_t         elapsed_ms = 0;
+
+    configure();
+    elapsed_ms = scanner.flood(pipeline, TEST_REPORTS);
+    pipeline.getStatistics(stats);
+    print_rate("Dedup flood", stats, elapsed_ms);
+
+    TEST_ASSERT_EQUAL(TEST_REPORTS, stats.received);
+    TEST_ASSERT_EQUAL(0, stats.filtered);
+    TEST_ASSERT_EQUAL(0, stats.malformed);
+    TEST_ASSERT_TRUE(stats.delivered >= scanner.expected(TEST_REPORTS));
+    TEST_ASSERT_TRUE(stats.delivered <= scanner.expected(TEST_REPORTS) + stats.evictions);
+    TEST_ASSERT_EQUAL(TEST_REPORTS, stats.delivered + stats.duplicates);
+    TEST_ASSERT_EQUAL(stats.delivered, delivered);
+    TEST_ASSERT_EQUAL(stats.batches, batches);
+    TEST_ASSERT_EQUAL(0, oversized);
+}
+
+static void test_crowd(void)
+{
+    SimulatedScanner scanner(TEST_CROWD_DEVICES);
+    ScanStatistics   stats;
+    uint32_t         elapsed_ms = 0;
+
+    /* More advertisers than cache slots: evicted devices are let through early, never dropped */
+    configure();
+    elapsed_ms = scanner.flood(pipeline, TEST_REPORTS);
+    pipeline.getStatistics(stats);
+    print_rate("Crowd flood", stats, elapsed_ms);
+
+    TEST_ASSERT_EQUAL(TEST_REPORTS, stats.received);
+    TEST_ASSERT_TRUE(stats.evictions > 0);
+    TEST_ASSERT_TRUE(stats.delivered >= scanner.expected(TEST_REPORTS));
+    TEST_ASSERT_TRUE(stats.delivered <= scanner.expected(TEST_REPORTS) + stats.evictions);
+    TEST_ASSERT_EQUAL(TEST_REPORTS, stats.delivered + stats.duplicates);
+    TEST_ASSERT_EQUAL(stats.delivered, delivered);
+    TEST_ASSERT_EQUAL(0, oversized);
+}
+
+static void test_no_dedup(void)
+{
+    SimulatedScanner scanner(TEST_DEVICES);
+    ScanParameters   params = { false, 0, TEST_BATCH_SIZE, osWaitForever };
+    ScanStatistics   stats;
+    uint32_t         elapsed_ms = 0;
+
+    /* The cost of delivering every report, for comparison */
+    delivered = 0;
+    batches = 0;
+    pipeline.configure(params, report_callback);
+    elapsed_ms = scanner.flood(pipeline, TEST_REPORTS);
+    pipeline.getStatistics(stats);
+    print_rate("No dedup flood", stats, elapsed_ms);
+
+    TEST_ASSERT_EQUAL(TEST_REPORTS, stats.delivered);
+    TEST_ASSERT_EQUAL(0, stats.duplicates);
+    TEST_ASSERT_EQUAL(TEST_REPORTS, delivered);
+    TEST_ASSERT_EQUAL((TEST_REPORTS + TEST_BATCH_SIZE - 1) / TEST_BATCH_SIZE, batches);
+}
+
+static utest::v1::status_t test_setup(const size_t number_of_cases)
+{
+    GREENTEA_SETUP(120, "default_auto");
+
+    return greentea_test_setup_handler(number_of_cases);
+}
+
+static Case cases[] =
+{
+    Case("ScanPipeline dedup flood", test_flood),
+    Case("ScanPipeline crowd flood", test_crowd),
+    Case("ScanPipeline flood without dedup", test_no_dedup),
+};
+
+static Specification specification(test_setup, cases);
+
+int main()
+{
+    return !Harness::run(specification);
+}
@@ -35,83 +35,117 @@
 #include "embedded_BLE_mesh.h"
 #include "embedded_BLE.h"
 #include "embedded_GAP.h"
+#include "embedded_BLE_gatt.h"
+#include "embedded_BLE_gatt_server.h"
 
 #include "wiced_hci_bt_dm.h"
 #include "cy_result.h"
 
 using namespace cypress::embedded;
 
-BLE* BLE::Eble = NULL;
+BLE* BLE::Eble[BLE::NUM_INSTANCES];
 
-cy_rslt_t embedded_bluetooth_event_callback(wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data)
-{
-    cy_rslt_t result = CY_RSLT_SUCCESS;
-
-    printf("%s (event: %x)\n",__func__, event );
-
-    BLE& ble = BLE::Instance();
+typedef void (*ManagementEventHandler)(BLE& ble, wiced_bt_management_evt_data_t* p_event_data);
 
+static void onStackEnabled(BLE& ble, wiced_bt_management_evt_data_t* p_event_data)
+{
     ble_init_callback_t callback = ble.get_initCallback();
 
-    switch( event )
-    {
-    /* Bluetooth stack enabled */
-    case BTM_ENABLED_EVT:
-        ble.setInitialized();
-        if (callback)
-            callback();
-        break;
-
-    case BTM_DISABLED_EVT:
-        break;
-
-    case BTM_PAIRING_IO_CAPABILITIES_BLE_REQUEST_EVT:
-        break;
+    ble.setInitialized();
+    Mesh::getMeshInstance(ble).getStateMachine().event(MESH_STATE_EVENT_STACK_ENABLED);
+    if (callback)
+        callback();
+}
 
-    case BTM_PAIRING_COMPLETE_EVT:
-        break;
+static void onStackDisabled(BLE& ble, wiced_bt_management_evt_data_t* p_event_data)
+{
+    Mesh::getMeshInstance(ble).getStateMachine().event(MESH_STATE_EVENT_STACK_DISABLED);
+}
 
-    case BTM_SECURITY_REQUEST_EVT:
-        break;
+/* Events the stack may report that need nothing from the host */
+static void ignoreEvent(BLE& ble, wiced_bt_management_evt_data_t* p_event_data)
+{
+}
 
-    case BTM_PAIRED_DEVICE_LINK_KEYS_UPDATE_EVT:
-        break;
+/* Management events and their handlers, the others are reported as unhandled */
+#define EMBEDDED_BLE_MANAGEMENT_EVENTS(EVENT) \
+    EVENT(BTM_ENABLED_EVT,                              onStackEnabled) \
+    EVENT(BTM_DISABLED_EVT,                             onStackDisabled) \
+    EVENT(BTM_PAIRING_IO_CAPABILITIES_BLE_REQUEST_EVT,  ignoreEvent) \
+    EVENT(BTM_PAIRING_COMPLETE_EVT,                     ignoreEvent) \
+    EVENT(BTM_SECURITY_REQUEST_EVT,                     ignoreEvent) \
+    EVENT(BTM_PAIRED_DEVICE_LINK_KEYS_UPDATE_EVT,       ignoreEvent) \
+    EVENT(BTM_PAIRED_DEVICE_LINK_KEYS_REQUEST_EVT,      ignoreEvent) \
+    EVENT(BTM_BLE_ADVERT_STATE_CHANGED_EVT,             ignoreEvent) \
+    EVENT(BTM_BLE_SCAN_STATE_CHANGED_EVT,               ignoreEvent) \
+    EVENT(BTM_PASSKEY_REQUEST_EVT,                      ignoreEvent) \
+    EVENT(BTM_SMP_REMOTE_OOB_DATA_REQUEST_EVT,          ignoreEvent) \
+    EVENT(BTM_USER_CONFIRMATION_REQUEST_EVT,            ignoreEvent) \
+    EVENT(BTM_SMP_SC_LOCAL_OOB_DATA_NOTIFICATION_EVT,   ignoreEvent) \
+    EVENT(BTM_SMP_SC_REMOTE_OOB_DATA_REQUEST_EVT,       ignoreEvent)
+
+#define MANAGEMENT_EVENT_COUNT (BTM_LPM_STATE_LOW_POWER + 1)
+
+/* Handler of each management event, built by the compiler from the list above */
+struct ManagementEventTable
+{
+    ManagementEventHandler handlers[MANAGEMENT_EVENT_COUNT];
 
-    case BTM_PAIRED_DEVICE_LINK_KEYS_REQUEST_EVT:
-        break;
+    constexpr ManagementEventTable() : handlers()
+    {
+#define MANAGEMENT_EVENT_ENTRY(event, handler) handlers[event] = handler;
+        EMBEDDED_BLE_MANAGEMENT_EVENTS(MANAGEMENT_EVENT_ENTRY)
+#undef MANAGEMENT_EVENT_ENTRY
+    }
+};
 
-    case BTM_BLE_ADVERT_STATE_CHANGED_EVT:
-        break;
+static constexpr ManagementEventTable management_events;
 
-    case BTM_PASSKEY_REQUEST_EVT:
-    case BTM_SMP_REMOTE_OOB_DATA_REQUEST_EVT:
-    case BTM_USER_CONFIRMATION_REQUEST_EVT:
-    case BTM_SMP_SC_LOCAL_OOB_DATA_NOTIFICATION_EVT:
-    case BTM_SMP_SC_REMOTE_OOB_DATA_REQUEST_EVT:
-        break;
+cy_rslt_t embedded_bluetooth_event_callback(wiced_hci_controller_t controller, wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data)
+{
+    printf("%s (controller: %d, event: %x)\n",__func__, controller, event );
 
-    default:
+    if (event >= MANAGEMENT_EVENT_COUNT || management_events.handlers[event] == NULL)
+    {
         printf("Unhandled Bluetooth Stack Callback event :%d\n", event);
-        break;
+        return CY_RSLT_SUCCESS;
     }
 
-    return result;
+    management_events.handlers[event](BLE::Instance(controller), p_event_data);
+
+    return CY_RSLT_SUCCESS;
 }
 
 ble_error_t BLE::init(void (*callback)(void))
 {
-    printf("Initializing Embedded BLE\n");
+    printf("Initializing Embedded BLE on controller %d\n", getController());
     init_callback = callback;
 
-    wiced_bt_stack_init(embedded_bluetooth_event_callback);
+    if (wiced_bt_stack_init(getController(), embedded_bluetooth_event_callback) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INITIALIZATION_INCOMPLETE;
+    }
     return BLE_ERROR_NONE;
 }
 
+ble_error_t BLE::init(void (*callback)(void), uint32_t timeout_ms)
+{
+    ble_error_t result = init(callback);
+
+    if (result != BLE_ERROR_NONE)
+    {
+        return result;
+    }
+
+    return Mesh::getMeshInstance(*this).waitForState(MESH_STATE_STACK_UP, timeout_ms);
+}
+
 ble_error_t BLE::shutdown(void)
 {
     printf("Shutting down Embedded BLE\n");
     initialized = 0;
     init_callback = 0;
+    Mesh::getMeshInstance(*this).getStateMachine().event(MESH_STATE_EVENT_STACK_DISABLED);
     return BLE_ERROR_NONE;
 }
 
@@ -128,7 +162,7 @@ Mesh& BLE::mesh(void)
         printf("[Warning] BLE Instance has not been initialized\n");
     }
 
-    return Mesh::getMeshInstance((BLE &)*Eble);
+    return Mesh::getMeshInstance(*this);
 }
 
 Gap& BLE::gap(void)
@@ -138,5 +172,44 @@ Gap& BLE::gap(void)
         printf("[Warning] BLE Instance has not been initialized\n");
     }
 
-    return Gap::getGapInstance();
+    return Gap::getGapInstance(getController());
+}
+
+GattClient& BLE::gattClient(void)
+{
+    if (!this->initialized)
+    {
+        printf("[Warning] BLE Instance has not been initialized\n");
+    }
+
+    return GattClient::getInstance(getController());
+}
+
+GattServer& BLE::gattServer(void)
+{
+    if (!this->initialized)
+    {
+        printf("[Warning] BLE Instance has not been initialized\n");
+    }
+
+    return GattServer::getInstance(getController());
+}
+
+ConnectionManager& BLE::connectionManager(void)
+{
+    static ConnectionManager* managers[NUM_INSTANCES];
+
+    if (!this->initialized)
+    {
+        printf("[Warning] BLE Instance has not been initialized\n");
+    }
+
+    if (managers[instance_id] == NULL)
+    {
+        managers[instance_id] = new ConnectionManager(*new WicedConnectionLink(getController()));
+    }
+
+    GattClient::getInstance(getController()).setConnectionManager(managers[instance_id]);
+
+    return *managers[instance_id];
 }
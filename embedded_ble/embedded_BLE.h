@@ -54,6 +54,7 @@
 
 #include <stdint.h>
 #include "ble/blecommon.h"
+#include "wiced_bt_hci.h"
 
 /**
  * \defgroup embedded_ble Embedded BLE Library
@@ -66,6 +67,9 @@ namespace embedded
 
 class Mesh;
 class Gap;
+class GattClient;
+class GattServer;
+class ConnectionManager;
 
 /**
  * @addtogroup embedded_ble
@@ -90,24 +94,37 @@ public:
     /**
      * The value of the BLE::InstanceID_t for the default BLE instance.
      */
-    static const InstanceID_t DEFAULT_INSTANCE = 0;
+    static const InstanceID_t DEFAULT_INSTANCE = WICED_HCI_DEFAULT_CONTROLLER;
+
+    /**
+     * The number of BLE instances, one per Bluetooth Controller attached to the host.
+     */
+    static const InstanceID_t NUM_INSTANCES = WICED_HCI_MAX_CONTROLLERS;
 
     /**
      * Get a reference to the Embedded BLE singleton corresponding to a given interface.
+     * The instance id is the Bluetooth Controller the instance drives, each has its own
+     * Gap, GattClient, GattServer and Mesh.
      *
      * @note Calling Instance() is preferred over constructing a BLE object
      * directly because it returns references to singleton.
      *
+     * @param[in] id: instance, below NUM_INSTANCES. Other values get the default instance.
+     *
      * @return A reference to a single object.
      *
      */
-    static BLE &Instance(void)
+    static BLE &Instance(InstanceID_t id = DEFAULT_INSTANCE)
     {
-        if (Eble == NULL)
+        if (id >= NUM_INSTANCES)
+        {
+            id = DEFAULT_INSTANCE;
+        }
+        if (Eble[id] == NULL)
         {
-            Eble = new BLE;
+            Eble[id] = new BLE(id);
         }
-        return (BLE &)*Eble;
+        return (BLE &)*Eble[id];
     }
 
     /**
@@ -116,7 +133,14 @@ public:
      * @return Instance id of this BLE instance.
      */
     InstanceID_t getInstanceID(void) const {
-        return (InstanceID_t)DEFAULT_INSTANCE;
+        return instance_id;
+    }
+
+    /**
+     * Fetch the Bluetooth Controller driven by a BLE instance.
+     */
+    wiced_hci_controller_t getController(void) const {
+        return (wiced_hci_controller_t)instance_id;
     }
 
     /**
@@ -124,6 +148,13 @@ public:
      */
     ble_error_t init(void (*callback)(void));
 
+    /**
+     * Initialize the Embedded BLE stack/controller and wait until the Bluetooth Controller reports the stack enabled.
+     *
+     * @return BLE_ERROR_INITIALIZATION_INCOMPLETE when the stack cannot be started or is not enabled within timeout_ms
+     */
+    ble_error_t init(void (*callback)(void), uint32_t timeout_ms);
+
     /**
      * Shutdown the Embedded BLE stack/controller
      */
@@ -166,6 +197,19 @@ public:
      * Returns GAP instance associated with BLE
      */
     Gap& gap();
+    /**
+     * Returns GATT client instance associated with BLE
+     */
+    GattClient& gattClient();
+    /**
+     * Returns GATT server instance associated with BLE
+     */
+    GattServer& gattServer();
+    /**
+     * Returns the central connection manager associated with BLE, driving the controller.
+     * The connections are reported through the GATT client, initialized with GattClient::initialize.
+     */
+    ConnectionManager& connectionManager();
 
     /**
      * Translate error code into a printable string.
@@ -177,17 +221,18 @@ public:
     static const char* errorToString(ble_error_t error);
 
 private:
-    int initialized;
+    volatile int initialized;
     void (*init_callback)(void);
+    InstanceID_t instance_id;
 
     // Private so that it can not be called outside from class
-    BLE(): initialized(0), init_callback(NULL)
+    BLE(InstanceID_t id): initialized(0), init_callback(NULL), instance_id(id)
     {
     };
 
-    BLE(BLE const&): initialized(0), init_callback(NULL){};             // copy constructor is private
+    BLE(BLE const&): initialized(0), init_callback(NULL), instance_id(DEFAULT_INSTANCE){};             // copy constructor is private
     BLE& operator=(BLE const&);    // assignment operator is private
-    static BLE* Eble;
+    static BLE* Eble[NUM_INSTANCES];
 };
 
 /** @} */
@@ -0,0 +1,295 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth advertising engine
+ */
+
+#include <string.h>
+#include "embedded_BLE_advertiser.h"
+
+#include "wiced_hci_bt_ble.h"
+
+using namespace cypress::embedded;
+
+#define ADVERTISER_STOP_FLAG    (0x1)
+
+ble_error_t RawAdvertisingData::set(const uint8_t* data, uint8_t data_length)
+{
+    uint8_t offset = 0;
+
+    if (data_length > EMBEDDED_BLE_ADV_DATA_MAX_LENGTH || (data_length && data == NULL))
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    /* Every AD structure has to fit, the payload is split into elements without further checks */
+    while (offset < data_length)
+    {
+        if (data[offset] == 0 || offset + 1 + data[offset] > data_length)
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
+        offset += data[offset] + 1;
+    }
+
+    if (data_length != length || memcmp(storage, data, data_length) != 0)
+    {
+        memcpy(storage, data, data_length);
+        length  = data_length;
+        changed = 0xFFFFFFFF;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+Advertiser::Advertiser(wiced_hci_controller_t controller) :
+    payload_count(0), current(0), rotation_interval(0), advertising(false),
+    pushed_length(0), pushed_valid(false), controller(controller), rotation_thread(NULL)
+{
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+/* Called with the lock held */
+ble_error_t Advertiser::push(AdvertisingData* payload)
+{
+    wiced_bt_ble_advert_elem_t elements[EMBEDDED_BLE_ADV_DATA_MAX_LENGTH / 2];
+    const uint8_t*             data   = payload->getData();
+    uint8_t                    length = payload->getLength();
+    uint8_t                    offset = 0;
+    uint8_t                    count  = 0;
+
+    payload->clearChangedFields();
+
+    if (pushed_valid && pushed_length == length && memcmp(pushed, data, length) == 0)
+    {
+        statistics.unchanged++;
+        return BLE_ERROR_NONE;
+    }
+
+    /* The elements point into the payload, it is copied once into the WICED HCI frame */
+    while (offset < length && data[offset] != 0)
+    {
+        elements[count].advert_type = data[offset + 1];
+        elements[count].len         = data[offset] - 1;
+        elements[count].p_data      = (uint8_t*)&data[offset + 2];
+        count++;
+        offset += data[offset] + 1;
+    }
+
+    if (wiced_bt_ble_set_raw_advertisement_data(controller, count, elements) != CY_RSLT_SUCCESS)
+    {
+        pushed_valid = false;
+        return BLE_ERROR_UNSPECIFIED;
+    }
+
+    memcpy(pushed, data, length);
+    pushed_length = length;
+    pushed_valid  = true;
+    statistics.pushes++;
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Advertiser::setPayloads(AdvertisingData* const* new_payloads, uint8_t count, uint32_t rotation_interval_ms)
+{
+    ble_error_t result = BLE_ERROR_NONE;
+    uint8_t     i      = 0;
+
+    if (count == 0 || count > EMBEDDED_BLE_ADV_MAX_PAYLOADS || new_payloads == NULL)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (new_payloads[i] == NULL)
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
+    }
+
+    stopRotation();
+
+    lock.lock();
+    for (i = 0; i < count; i++)
+    {
+        payloads[i] = new_payloads[i];
+    }
+    payload_count     = count;
+    rotation_interval = rotation_interval_ms;
+    current           = 0;
+    if (advertising)
+    {
+        result = push(payloads[current]);
+    }
+    lock.unlock();
+
+    if (advertising)
+    {
+        startRotation();
+    }
+
+    return result;
+}
+
+ble_error_t Advertiser::setRawData(const uint8_t* data, uint8_t length)
+{
+    AdvertisingData* payload = &raw;
+    ble_error_t      result  = BLE_ERROR_NONE;
+
+    lock.lock();
+    result = raw.set(data, length);
+    lock.unlock();
+
+    if (result != BLE_ERROR_NONE)
+    {
+        return result;
+    }
+
+    return setPayloads(&payload, 1, 0);
+}
+
+void Advertiser::beginUpdate(void)
+{
+    lock.lock();
+}
+
+ble_error_t Advertiser::commitUpdate(void)
+{
+    ble_error_t result = BLE_ERROR_NONE;
+
+    /* Payloads not on air are pushed when the rotation reaches them */
+    if (advertising && payload_count && payloads[current]->getChangedFields())
+    {
+        result = push(payloads[current]);
+    }
+    lock.unlock();
+
+    return result;
+}
+
+ble_error_t Advertiser::start(void)
+{
+    ble_error_t result = BLE_ERROR_NONE;
+
+    lock.lock();
+    if (payload_count == 0)
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    result = push(payloads[current]);
+    if (result == BLE_ERROR_NONE &&
+        wiced_bt_start_advertisements(controller, BTM_BLE_ADVERT_UNDIRECTED_HIGH, BLE_ADDR_PUBLIC, NULL) != CY_RSLT_SUCCESS)
+    {
+        result = BLE_ERROR_UNSPECIFIED;
+    }
+    advertising = (result == BLE_ERROR_NONE);
+    lock.unlock();
+
+    if (advertising)
+    {
+        startRotation();
+    }
+
+    return result;
+}
+
+ble_error_t Advertiser::stop(void)
+{
+    ble_error_t result = BLE_ERROR_NONE;
+
+    stopRotation();
+
+    lock.lock();
+    if (wiced_bt_start_advertisements(controller, BTM_BLE_ADVERT_OFF, BLE_ADDR_PUBLIC, NULL) != CY_RSLT_SUCCESS)
+    {
+        result = BLE_ERROR_UNSPECIFIED;
+    }
+    advertising = false;
+    lock.unlock();
+
+    return result;
+}
+
+void Advertiser::getStatistics(AdvertisingStatistics& stats)
+{
+    lock.lock();
+    stats = statistics;
+    lock.unlock();
+}
+
+void Advertiser::startRotation(void)
+{
+    if (payload_count < 2 || rotation_interval == 0 || rotation_thread != NULL)
+    {
+        return;
+    }
+
+    flags.clear(ADVERTISER_STOP_FLAG);
+    rotation_thread = new rtos::Thread(osPriorityNormal, EMBEDDED_BLE_ADV_ROTATION_STACK_SIZE, NULL, "adv_rotation");
+    rotation_thread->start(callback(this, &Advertiser::rotate));
+}
+
+/* Must not be called with the lock held, the rotation thread takes it */
+void Advertiser::stopRotation(void)
+{
+    if (rotation_thread == NULL)
+    {
+        return;
+    }
+
+    flags.set(ADVERTISER_STOP_FLAG);
+    rotation_thread->join();
+    delete rotation_thread;
+    rotation_thread = NULL;
+}
+
+void Advertiser::rotate(void)
+{
+    for (;;)
+    {
+        uint32_t result = flags.wait_any(ADVERTISER_STOP_FLAG, rotation_interval);
+
+        if (!(result & osFlagsError) && (result & ADVERTISER_STOP_FLAG))
+        {
+            break;
+        }
+
+        lock.lock();
+        current = (current + 1) % payload_count;
+        statistics.rotations++;
+        push(payloads[current]);
+        lock.unlock();
+    }
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth advertising engine
+ *
+ * Advertising payloads are laid out at compile time (AdvertisingPayload<AdField<...>...>),
+ * fields are written in place in the buffer sent to the controller and the whole layout is
+ * checked against the 31 byte limit by the compiler. The Advertiser pushes a payload over
+ * WICED HCI only when its content differs from what the controller already has, and rotates
+ * between several payloads on a schedule.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+#include "wiced_bt_hci.h"
+
+/** Maximum length of a legacy advertising payload */
+#define EMBEDDED_BLE_ADV_DATA_MAX_LENGTH        (31)
+
+/** Maximum number of payloads the advertiser rotates between */
+#ifndef EMBEDDED_BLE_ADV_MAX_PAYLOADS
+#define EMBEDDED_BLE_ADV_MAX_PAYLOADS           (4)
+#endif
+
+/** Stack size of the payload rotation thread */
+#ifndef EMBEDDED_BLE_ADV_ROTATION_STACK_SIZE
+#define EMBEDDED_BLE_ADV_ROTATION_STACK_SIZE    (1536)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_gap
+ *
+ * @{
+ */
+
+/** Defines one AD structure of a payload layout: AD type and data length */
+template <uint8_t Type, uint8_t Length>
+struct AdField
+{
+    static const uint8_t type   = Type;     /**< AD type (see #wiced_bt_ble_advert_type_e) */
+    static const uint8_t length = Length;   /**< AD data length */
+};
+
+/** Compile time layout of a list of AdField */
+template <typename... Fields>
+struct AdLayout
+{
+    static const uint16_t size  = 0;
+    static const uint8_t  count = 0;
+
+    static void write(uint8_t* buffer)
+    {
+        (void)buffer;
+    }
+};
+
+template <typename First, typename... Rest>
+struct AdLayout<First, Rest...>
+{
+    static const uint16_t size  = First::length + 2 + AdLayout<Rest...>::size;
+    static const uint8_t  count = 1 + AdLayout<Rest...>::count;
+
+    /* Writes the length and type headers of every field */
+    static void write(uint8_t* buffer)
+    {
+        buffer[0] = First::length + 1;
+        buffer[1] = First::type;
+        AdLayout<Rest...>::write(buffer + First::length + 2);
+    }
+};
+
+/** Offset and type of the field at Index of a layout */
+template <uint8_t Index, typename... Fields>
+struct AdFieldAt;
+
+template <typename First, typename... Rest>
+struct AdFieldAt<0, First, Rest...>
+{
+    typedef First field;
+    static const uint16_t offset = 0;
+};
+
+template <uint8_t Index, typename First, typename... Rest>
+struct AdFieldAt<Index, First, Rest...>
+{
+    typedef typename AdFieldAt<Index - 1, Rest...>::field field;
+    static const uint16_t offset = First::length + 2 + AdFieldAt<Index - 1, Rest...>::offset;
+};
+
+/** Defines an advertising payload, the LTV encoded bytes sent to the controller */
+class AdvertisingData
+{
+public:
+    /** Gets the encoded payload */
+    const uint8_t* getData(void) const
+    {
+        return buffer;
+    }
+
+    /** Gets the encoded payload length */
+    uint8_t getLength(void) const
+    {
+        return length;
+    }
+
+    /** Gets the mask of the fields changed since the mask was last cleared */
+    uint32_t getChangedFields(void) const
+    {
+        return changed;
+    }
+
+    /** Clears the mask of changed fields */
+    void clearChangedFields(void)
+    {
+        changed = 0;
+    }
+
+protected:
+    AdvertisingData(uint8_t* data, uint8_t data_length) :
+        buffer(data), length(data_length), changed(0)
+    {
+    }
+
+    /* buffer points into the storage of the derived payload, a copy would share it */
+    AdvertisingData(const AdvertisingData&) = delete;
+    AdvertisingData& operator=(const AdvertisingData&) = delete;
+
+    /* Rewrites a field only when its content changes */
+    bool write(uint8_t field, uint16_t offset, const uint8_t* data, uint8_t data_length)
+    {
+        if (memcmp(&buffer[offset], data, data_length) == 0)
+        {
+            return false;
+        }
+        memcpy(&buffer[offset], data, data_length);
+        changed |= (1UL << field);
+        return true;
+    }
+
+    uint8_t* buffer;
+    uint8_t  length;
+    uint32_t changed;
+};
+
+/** Defines an advertising payload with a layout checked at compile time.
+ *
+ * Example:
+ * @code
+ * AdvertisingPayload< AdField<BTM_BLE_ADVERT_TYPE_FLAG, 1>,
+ *                     AdField<BTM_BLE_ADVERT_TYPE_MANUFACTURER, 6> > payload;
+ * const uint8_t flags[1] = { 0x06 };
+ * payload.set<0>(flags);
+ * @endcode
+ */
+template <typename... Fields>
+class AdvertisingPayload : public AdvertisingData
+{
+public:
+    typedef AdLayout<Fields...> Layout;
+
+    static_assert(Layout::count > 0, "advertising payload without AD structure");
+    static_assert(Layout::size <= EMBEDDED_BLE_ADV_DATA_MAX_LENGTH, "advertising payload exceeds 31 bytes");
+
+    AdvertisingPayload() : AdvertisingData(storage, Layout::size)
+    {
+        memset(storage, 0, sizeof(storage));
+        Layout::write(storage);
+    }
+
+    /** Sets the data of field Index, the array size has to match the field length.
+     *
+     * @return true when the field content changed
+     */
+    template <uint8_t Index>
+    bool set(const uint8_t (&data)[AdFieldAt<Index, Fields...>::field::length])
+    {
+        return write(Index, AdFieldAt<Index, Fields...>::offset + 2, data, AdFieldAt<Index, Fields...>::field::length);
+    }
+
+    /** Gets the data of field Index for in place updates, call markChanged afterwards */
+    template <uint8_t Index>
+    uint8_t* field(void)
+    {
+        return &storage[AdFieldAt<Index, Fields...>::offset + 2];
+    }
+
+    /** Marks field Index as changed after an in place update */
+    template <uint8_t Index>
+    void markChanged(void)
+    {
+        changed |= (1UL << Index);
+    }
+
+private:
+    uint8_t storage[Layout::size];
+};
+
+/** Defines a payload holding already encoded advertising data */
+class RawAdvertisingData : public AdvertisingData
+{
+public:
+    RawAdvertisingData() : AdvertisingData(storage, 0)
+    {
+    }
+
+    /** Replaces the payload, the AD structures are validated.
+     *
+     * @return ble_error_t
+     */
+    ble_error_t set(const uint8_t* data, uint8_t data_length);
+
+private:
+    uint8_t storage[EMBEDDED_BLE_ADV_DATA_MAX_LENGTH];
+};
+
+/** Defines the advertising counters */
+struct AdvertisingStatistics
+{
+    uint32_t pushes;                /**< Payloads sent to the controller */
+    uint32_t unchanged;             /**< Updates not sent because the controller already had the content */
+    uint32_t rotations;             /**< Payload rotations */
+};
+
+/** Defines the advertising engine */
+class Advertiser
+{
+public:
+    /** Creates an advertiser of a Bluetooth Controller */
+    Advertiser(wiced_hci_controller_t controller = WICED_HCI_DEFAULT_CONTROLLER);
+
+    /** Sets the payloads to advertise.
+     *
+     * @param[in] payloads:             payloads, owned by the caller
+     * @param[in] count:                number of payloads (up to EMBEDDED_BLE_ADV_MAX_PAYLOADS)
+     * @param[in] rotation_interval_ms: time each payload is advertised, 0 disables the rotation
+     *
+     * @return ble_error_t
+     */
+    ble_error_t setPayloads(AdvertisingData* const* payloads, uint8_t count, uint32_t rotation_interval_ms);
+
+    /** Advertises an encoded payload, replaces the payload list */
+    ble_error_t setRawData(const uint8_t* data, uint8_t length);
+
+    /** Starts a payload update, the rotation does not touch the payloads until commitUpdate */
+    void beginUpdate(void);
+
+    /** Ends a payload update and pushes the current payload if its content changed */
+    ble_error_t commitUpdate(void);
+
+    /** Starts advertising */
+    ble_error_t start(void);
+
+    /** Stops advertising */
+    ble_error_t stop(void);
+
+    /** Copies the counters */
+    void getStatistics(AdvertisingStatistics& stats);
+
+private:
+    ble_error_t push(AdvertisingData* payload);
+    void        startRotation(void);
+    void        stopRotation(void);
+    void        rotate(void);
+
+    AdvertisingData*      payloads[EMBEDDED_BLE_ADV_MAX_PAYLOADS];
+    uint8_t               payload_count;
+    uint8_t               current;
+    uint32_t              rotation_interval;
+    bool                  advertising;
+
+    /* content last sent to the controller */
+    uint8_t               pushed[EMBEDDED_BLE_ADV_DATA_MAX_LENGTH];
+    uint8_t               pushed_length;
+    bool                  pushed_valid;
+
+    RawAdvertisingData    raw;
+    AdvertisingStatistics statistics;
+    wiced_hci_controller_t controller;
+    rtos::Mutex           lock;
+    rtos::EventFlags      flags;
+    rtos::Thread*         rotation_thread;
+};
+
+/** @} */
+}
+
+}
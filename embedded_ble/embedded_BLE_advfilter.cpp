@@ -0,0 +1,267 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth advertisement filter
+ */
+
+#include <string.h>
+#include "embedded_BLE_advfilter.h"
+
+#include "wiced_hci_bt_gatt.h"
+
+using namespace cypress::embedded;
+
+AdvertisementFilter::AdvertisementFilter()
+{
+    compile(NULL, 0);
+}
+
+bool AdvertisementFilter::addInstruction(uint8_t ad_type, uint8_t opcode, uint8_t rule, uint16_t id)
+{
+    uint8_t index = instruction_count;
+
+    if (instruction_count >= MAX_INSTRUCTIONS)
+    {
+        return false;
+    }
+
+    /* Keep the instructions sorted by AD type, rule order is preserved within a type */
+    while (index > 0 && instructions[index - 1].ad_type > ad_type)
+    {
+        instructions[index] = instructions[index - 1];
+        index--;
+    }
+
+    instructions[index].ad_type = ad_type;
+    instructions[index].opcode  = opcode;
+    instructions[index].rule    = rule;
+    instructions[index].id      = id;
+    instruction_count++;
+
+    return true;
+}
+
+ble_error_t AdvertisementFilter::compile(const AdvertisementFilterRule* rules, uint8_t count)
+{
+    uint8_t i = 0;
+
+    if (count > EMBEDDED_BLE_ADV_FILTER_MAX_RULES || (count && rules == NULL))
+    {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (rules[i].length > EMBEDDED_BLE_ADV_FILTER_MAX_PATTERN_LENGTH ||
+            (rules[i].type == AdvertisementFilterRule::ADDRESS_PREFIX && (rules[i].length == 0 || rules[i].length > 6)) ||
+            rules[i].type > AdvertisementFilterRule::RSSI_THRESHOLD)
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
+    }
+
+    memset(first_instruction, 0, sizeof(first_instruction));
+    memset(address_first_byte, 0, sizeof(address_first_byte));
+    memset(&statistics, 0, sizeof(statistics));
+    instruction_count  = 0;
+    address_rule_count = 0;
+    match_rule_count   = 0;
+    match_rejected     = 0;
+    min_rssi           = -128;
+    rssi_rule          = -1;
+
+    for (i = 0; i < count; i++)
+    {
+        const AdvertisementFilterRule& rule = rules[i];
+
+        memcpy(patterns[i], rule.value, rule.length);
+        pattern_lengths[i] = rule.length;
+
+        switch (rule.type)
+        {
+        case AdvertisementFilterRule::ADDRESS_PREFIX:
+            address_first_byte[rule.value[0] >> 5] |= (1UL << (rule.value[0] & 31));
+            address_rules[address_rule_count++] = i;
+            match_rules[match_rule_count++] = i;
+            break;
+
+        case AdvertisementFilterRule::COMPANY_ID:
+            addInstruction(BTM_BLE_ADVERT_TYPE_MANUFACTURER, MATCH_COMPANY_ID, i, rule.id);
+            match_rules[match_rule_count++] = i;
+            break;
+
+        case AdvertisementFilterRule::SERVICE_UUID16:
+            addInstruction(BTM_BLE_ADVERT_TYPE_16SRV_PARTIAL, MATCH_UUID16_LIST, i, rule.id);
+            addInstruction(BTM_BLE_ADVERT_TYPE_16SRV_COMPLETE, MATCH_UUID16_LIST, i, rule.id);
+            addInstruction(BTM_BLE_ADVERT_TYPE_SERVICE_DATA, MATCH_UUID16_DATA, i, rule.id);
+            match_rules[match_rule_count++] = i;
+            break;
+
+        case AdvertisementFilterRule::AD_PATTERN:
+            addInstruction(rule.ad_type, MATCH_PATTERN, i, 0);
+            match_rules[match_rule_count++] = i;
+            break;
+
+        case AdvertisementFilterRule::RSSI_THRESHOLD:
+            /* Every threshold has to pass, only the highest one matters */
+            if (rssi_rule < 0 || rule.rssi > min_rssi)
+            {
+                min_rssi  = rule.rssi;
+                rssi_rule = i;
+            }
+            break;
+        }
+    }
+
+    for (i = instruction_count; i > 0; i--)
+    {
+        first_instruction[instructions[i - 1].ad_type] = i;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+bool AdvertisementFilter::execute(const Instruction& instruction, const uint8_t* data, uint8_t length)
+{
+    uint8_t offset = 0;
+
+    switch (instruction.opcode)
+    {
+    case MATCH_COMPANY_ID:
+    case MATCH_UUID16_DATA:
+        return (length >= 2) && ((data[0] | (data[1] << 8)) == instruction.id);
+
+    case MATCH_UUID16_LIST:
+        for (offset = 0; offset + 1 < length; offset += 2)
+        {
+            if ((data[offset] | (data[offset + 1] << 8)) == instruction.id)
+            {
+                return true;
+            }
+        }
+        return false;
+
+    case MATCH_PATTERN:
+        return (length >= pattern_lengths[instruction.rule]) &&
+               (memcmp(data, patterns[instruction.rule], pattern_lengths[instruction.rule]) == 0);
+    }
+
+    return false;
+}
+
+bool AdvertisementFilter::accept(uint8_t rule)
+{
+    statistics.accepted++;
+    statistics.rule_accepted[rule]++;
+    return true;
+}
+
+bool AdvertisementFilter::reject(int rule)
+{
+    statistics.rejected++;
+    if (rule >= 0)
+    {
+        statistics.rule_rejected[rule]++;
+    }
+    else
+    {
+        match_rejected++;
+    }
+    return false;
+}
+
+void AdvertisementFilter::getStatistics(AdvertisementFilterStatistics& stats) const
+{
+    uint8_t i = 0;
+
+    stats = statistics;
+    for (i = 0; i < match_rule_count; i++)
+    {
+        stats.rule_rejected[match_rules[i]] += match_rejected;
+    }
+}
+
+bool AdvertisementFilter::evaluate(const uint8_t* address, int8_t rssi, const uint8_t* adv_data, uint8_t length)
+{
+    uint16_t offset = 0;
+    uint8_t  i      = 0;
+
+    if (rssi_rule >= 0 && rssi < min_rssi)
+    {
+        return reject(rssi_rule);
+    }
+
+    if (match_rule_count == 0)
+    {
+        statistics.accepted++;
+        return true;
+    }
+
+    if (address_first_byte[address[0] >> 5] & (1UL << (address[0] & 31)))
+    {
+        for (i = 0; i < address_rule_count; i++)
+        {
+            uint8_t rule = address_rules[i];
+
+            if (memcmp(address, patterns[rule], pattern_lengths[rule]) == 0)
+            {
+                return accept(rule);
+            }
+        }
+    }
+
+    /* Single pass over the AD structures, only the types referenced by a rule are inspected */
+    while (offset + 1 < length)
+    {
+        uint8_t ad_length = adv_data[offset];
+        uint8_t ad_type   = 0;
+
+        if (ad_length == 0 || offset + 1 + ad_length > length)
+        {
+            break;
+        }
+
+        ad_type = adv_data[offset + 1];
+        for (i = first_instruction[ad_type]; i > 0 && i <= instruction_count && instructions[i - 1].ad_type == ad_type; i++)
+        {
+            if (execute(instructions[i - 1], &adv_data[offset + 2], ad_length - 1))
+            {
+                return accept(instructions[i - 1].rule);
+            }
+        }
+
+        offset += ad_length + 1;
+    }
+
+    return reject(-1);
+}
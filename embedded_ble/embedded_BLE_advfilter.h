@@ -0,0 +1,187 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth advertisement filter
+ *
+ * Filter rules are compiled into a table indexed by AD type, so a report is accepted or
+ * rejected in a single pass over its AD structures. Reports are accepted when they pass the
+ * RSSI thresholds and match at least one of the address, company, service or pattern rules
+ * (or when no such rule is installed).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "ble/blecommon.h"
+
+/** Maximum number of filter rules */
+#ifndef EMBEDDED_BLE_ADV_FILTER_MAX_RULES
+#define EMBEDDED_BLE_ADV_FILTER_MAX_RULES           (32)
+#endif
+
+#if EMBEDDED_BLE_ADV_FILTER_MAX_RULES > 80
+#error "EMBEDDED_BLE_ADV_FILTER_MAX_RULES is limited to 80"
+#endif
+
+/** Maximum length of an address prefix or AD data pattern */
+#ifndef EMBEDDED_BLE_ADV_FILTER_MAX_PATTERN_LENGTH
+#define EMBEDDED_BLE_ADV_FILTER_MAX_PATTERN_LENGTH  (16)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_gap
+ *
+ * @{
+ */
+
+/** Defines an advertisement filter rule */
+struct AdvertisementFilterRule
+{
+    /** Defines the rule types */
+    enum Type
+    {
+        ADDRESS_PREFIX,     /**< Advertiser address starts with value[0..length-1] (most significant byte first) */
+        COMPANY_ID,         /**< Manufacturer specific data of company id */
+        SERVICE_UUID16,     /**< 16-bit service UUID in the service lists or service data */
+        AD_PATTERN,         /**< Data of AD structure ad_type starts with value[0..length-1] */
+        RSSI_THRESHOLD,     /**< RSSI is at least rssi, applies to every report */
+    };
+
+    Type     type;          /**< Rule type */
+    uint8_t  ad_type;       /**< AD_PATTERN: AD type the pattern applies to */
+    uint16_t id;            /**< COMPANY_ID: company identifier, SERVICE_UUID16: UUID */
+    int8_t   rssi;          /**< RSSI_THRESHOLD: minimum RSSI */
+    uint8_t  length;        /**< ADDRESS_PREFIX, AD_PATTERN: number of bytes of value */
+    uint8_t  value[EMBEDDED_BLE_ADV_FILTER_MAX_PATTERN_LENGTH]; /**< ADDRESS_PREFIX, AD_PATTERN: bytes to match */
+};
+
+/** Defines the advertisement filter counters */
+struct AdvertisementFilterStatistics
+{
+    uint32_t accepted;                                      /**< Reports accepted */
+    uint32_t rejected;                                      /**< Reports rejected */
+    uint32_t rule_accepted[EMBEDDED_BLE_ADV_FILTER_MAX_RULES]; /**< Reports accepted by each rule */
+    uint32_t rule_rejected[EMBEDDED_BLE_ADV_FILTER_MAX_RULES]; /**< Reports rejected by each rule: below an RSSI threshold, or matching none of the address, company, service or pattern rules */
+};
+
+/** Defines the compiled advertisement filter */
+class AdvertisementFilter
+{
+public:
+    AdvertisementFilter();
+
+    /** Compiles a rule set, replaces the current one and clears the counters.
+     *  An empty rule set accepts every report.
+     *
+     * @param[in] rules: rules, indexes are kept in the statistics
+     * @param[in] count: number of rules
+     *
+     * @return ble_error_t
+     */
+    ble_error_t compile(const AdvertisementFilterRule* rules, uint8_t count);
+
+    /** Evaluates a report.
+     *
+     * @param[in] address:  advertiser address (most significant byte first)
+     * @param[in] rssi:     received signal strength
+     * @param[in] adv_data: advertisement data
+     * @param[in] length:   advertisement data length
+     *
+     * @return true when the report is accepted
+     */
+    bool evaluate(const uint8_t* address, int8_t rssi, const uint8_t* adv_data, uint8_t length);
+
+    /** Copies the counters */
+    void getStatistics(AdvertisementFilterStatistics& stats) const;
+
+private:
+    enum Opcode
+    {
+        MATCH_COMPANY_ID,
+        MATCH_UUID16_LIST,
+        MATCH_UUID16_DATA,
+        MATCH_PATTERN,
+    };
+
+    /* Checks of one AD type, sorted by AD type */
+    struct Instruction
+    {
+        uint8_t  ad_type;
+        uint8_t  opcode;
+        uint8_t  rule;
+        uint16_t id;
+    };
+
+    static const uint8_t MAX_INSTRUCTIONS = EMBEDDED_BLE_ADV_FILTER_MAX_RULES * 3;
+
+    bool addInstruction(uint8_t ad_type, uint8_t opcode, uint8_t rule, uint16_t id);
+    bool execute(const Instruction& instruction, const uint8_t* data, uint8_t length);
+    bool accept(uint8_t rule);
+    bool reject(int rule);
+
+    /* index + 1 of the first instruction of each AD type, 0 when no rule looks at the type */
+    uint8_t        first_instruction[256];
+    Instruction    instructions[MAX_INSTRUCTIONS];
+    uint8_t        instruction_count;
+
+    /* address prefix rules, with a bitset of the first address bytes they accept */
+    uint32_t       address_first_byte[256 / 32];
+    uint8_t        address_rules[EMBEDDED_BLE_ADV_FILTER_MAX_RULES];
+    uint8_t        address_rule_count;
+
+    uint8_t        patterns[EMBEDDED_BLE_ADV_FILTER_MAX_RULES][EMBEDDED_BLE_ADV_FILTER_MAX_PATTERN_LENGTH];
+    uint8_t        pattern_lengths[EMBEDDED_BLE_ADV_FILTER_MAX_RULES];
+
+    /* address, company, service and pattern rules: a report matching none of them is rejected
+     * by all of them, counted once in match_rejected and spread by getStatistics */
+    uint8_t        match_rules[EMBEDDED_BLE_ADV_FILTER_MAX_RULES];
+    uint8_t        match_rule_count;
+    uint32_t       match_rejected;
+
+    int8_t         min_rssi;
+    int            rssi_rule;
+
+    AdvertisementFilterStatistics statistics;
+};
+
+/** @} */
+}
+
+}
@@ -0,0 +1,751 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth central connection manager
+ */
+
+#include <string.h>
+#include "embedded_BLE_connection.h"
+
+using namespace cypress::embedded;
+
+#define CONNECTION_WAKE_FLAG        (0x1)
+#define CONNECTION_STOP_FLAG        (0x2)
+
+ble_error_t WicedConnectionLink::connect(uint8_t addr_type, const uint8_t* bd_addr)
+{
+    if (wiced_bt_ble_connect(controller, addr_type, bd_addr) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INTERNAL_STACK_FAILURE;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+void WicedConnectionLink::cancel(uint8_t addr_type, const uint8_t* bd_addr)
+{
+    wiced_bt_ble_cancel_connect(controller, addr_type, bd_addr);
+}
+
+void WicedConnectionLink::disconnect(uint16_t conn_id)
+{
+    wiced_bt_ble_disconnect(controller, conn_id);
+}
+
+ble_error_t WicedConnectionLink::setParameters(uint16_t conn_id, const uint8_t* bd_addr, const wiced_bt_ble_conn_params_t& params)
+{
+    if (wiced_bt_ble_set_conn_params(controller, bd_addr, &params) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+ConnectionManager::ConnectionManager(ConnectionLink& link) :
+    link(link), event_callback(NULL), started(false), first_start_ms(0), thread(NULL)
+{
+    memset(peers, 0, sizeof(peers));
+    memset(links, 0, sizeof(links));
+    memset(&statistics, 0, sizeof(statistics));
+
+    params.links              = 4;
+    params.connects           = 1;
+    params.max_attempts       = 3;
+    params.backoff_ms         = 1000;
+    params.backoff_max_ms     = 30000;
+    params.connect_timeout_ms = 5000;
+    params.poll_timeout_ms    = 30000;
+
+    /* 7.5 - 15 ms while transferring */
+    params.bulk.interval_min        = 6;
+    params.bulk.interval_max        = 12;
+    params.bulk.latency             = 0;
+    params.bulk.supervision_timeout = 200;
+
+    /* 100 - 200 ms and 4 skipped events when idle */
+    params.idle.interval_min        = 80;
+    params.idle.interval_max        = 160;
+    params.idle.latency             = 4;
+    params.idle.supervision_timeout = 600;
+}
+
+ConnectionManager::~ConnectionManager()
+{
+    stop();
+}
+
+void ConnectionManager::configure(const ConnectionManagerParameters& parameters)
+{
+    lock.lock();
+
+    params = parameters;
+    if (params.links == 0 || params.links > EMBEDDED_BLE_CONNECTION_MAX_LINKS)
+    {
+        params.links = EMBEDDED_BLE_CONNECTION_MAX_LINKS;
+    }
+    if (params.connects == 0 || params.connects > params.links)
+    {
+        params.connects = params.links;
+    }
+    if (params.max_attempts == 0)
+    {
+        params.max_attempts = 1;
+    }
+
+    lock.unlock();
+
+    flags.set(CONNECTION_WAKE_FLAG);
+}
+
+void ConnectionManager::setEventCallback(ConnectionEventCallback_t callback_function)
+{
+    lock.lock();
+    event_callback = callback_function;
+    lock.unlock();
+}
+
+ble_error_t ConnectionManager::start(void)
+{
+    if (thread != NULL)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    flags.clear(CONNECTION_WAKE_FLAG | CONNECTION_STOP_FLAG);
+    thread = new rtos::Thread(osPriorityNormal, EMBEDDED_BLE_CONNECTION_THREAD_STACK_SIZE, NULL, "connection");
+    thread->start(callback(this, &ConnectionManager::worker));
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t ConnectionManager::stop(void)
+{
+    if (thread == NULL)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    flags.set(CONNECTION_STOP_FLAG);
+    thread->join();
+    delete thread;
+    thread = NULL;
+
+    return BLE_ERROR_NONE;
+}
+
+void ConnectionManager::worker(void)
+{
+    for (;;)
+    {
+        uint32_t wait   = service((uint32_t)rtos::Kernel::get_ms_count());
+        uint32_t result = flags.wait_any(CONNECTION_WAKE_FLAG | CONNECTION_STOP_FLAG, wait);
+
+        if (!(result & osFlagsError) && (result & CONNECTION_STOP_FLAG))
+        {
+            break;
+        }
+    }
+}
+
+/* Called with the lock held */
+ConnectionManager::Peer* ConnectionManager::findPeer(const uint8_t* bd_addr)
+{
+    int i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_PEERS; i++)
+    {
+        if (peers[i].used && memcmp(peers[i].bd_addr, bd_addr, BD_ADDR_LEN) == 0)
+        {
+            return &peers[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Called with the lock held */
+ConnectionManager::Peer* ConnectionManager::findLink(uint16_t conn_id)
+{
+    uint8_t i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        if (links[i] != NULL && links[i]->conn_id == conn_id)
+        {
+            return links[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Counts the links in a state, or all of them for CONNECTION_STATE_QUEUED. Called with the lock held */
+uint8_t ConnectionManager::countLinks(uint8_t state)
+{
+    uint8_t count = 0;
+    uint8_t i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        if (links[i] != NULL && (state == CONNECTION_STATE_QUEUED || links[i]->state == state))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+ble_error_t ConnectionManager::add(uint8_t addr_type, const uint8_t* bd_addr, uint32_t period_ms)
+{
+    return add(addr_type, bd_addr, period_ms, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+ble_error_t ConnectionManager::add(uint8_t addr_type, const uint8_t* bd_addr, uint32_t period_ms, uint32_t now_ms)
+{
+    Peer* peer = NULL;
+    int   i = 0;
+
+    if (bd_addr == NULL)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    lock.lock();
+
+    if (findPeer(bd_addr) != NULL)
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_STATE;
+    }
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_PEERS && peer == NULL; i++)
+    {
+        if (!peers[i].used)
+        {
+            peer = &peers[i];
+        }
+    }
+    if (peer == NULL)
+    {
+        lock.unlock();
+        return BLE_ERROR_NO_MEM;
+    }
+
+    memset(peer, 0, sizeof(*peer));
+    memcpy(peer->bd_addr, bd_addr, BD_ADDR_LEN);
+    peer->addr_type = addr_type;
+    peer->used      = true;
+    peer->state     = CONNECTION_STATE_QUEUED;
+    peer->period_ms = period_ms;
+    peer->round_ms  = now_ms;
+    peer->stage_ms  = now_ms;
+    peer->due_ms    = now_ms;
+
+    statistics.added++;
+    notify(*peer, now_ms);
+
+    lock.unlock();
+
+    flags.set(CONNECTION_WAKE_FLAG);
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t ConnectionManager::remove(const uint8_t* bd_addr)
+{
+    Peer*   peer = NULL;
+    uint8_t i = 0;
+
+    lock.lock();
+
+    peer = (bd_addr != NULL) ? findPeer(bd_addr) : NULL;
+    if (peer == NULL)
+    {
+        lock.unlock();
+        return BLE_ERROR_NOT_FOUND;
+    }
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        if (links[i] == peer)
+        {
+            links[i] = NULL;
+        }
+    }
+    if (peer->state == CONNECTION_STATE_CONNECTING)
+    {
+        link.cancel(peer->addr_type, peer->bd_addr);
+    }
+    else if (peer->state == CONNECTION_STATE_CONNECTED || peer->state == CONNECTION_STATE_DISCONNECTING)
+    {
+        link.disconnect(peer->conn_id);
+    }
+    peer->used = false;
+
+    lock.unlock();
+
+    flags.set(CONNECTION_WAKE_FLAG);
+
+    return BLE_ERROR_NONE;
+}
+
+/* Called with the lock held */
+void ConnectionManager::leaveStage(Peer& peer, ConnectionStage stage, uint32_t now_ms)
+{
+    ConnectionStageStatistics& stats = statistics.stages[stage];
+    uint32_t elapsed = now_ms - peer.stage_ms;
+
+    stats.count++;
+    stats.total_ms += elapsed;
+    if (elapsed > stats.max_ms)
+    {
+        stats.max_ms = elapsed;
+    }
+    peer.stage_ms = now_ms;
+}
+
+/* Called with the lock held */
+void ConnectionManager::notify(Peer& peer, uint32_t now_ms)
+{
+    ConnectionProgress progress;
+    int                i = 0;
+
+    if (event_callback == NULL)
+    {
+        return;
+    }
+
+    memcpy(progress.bd_addr, peer.bd_addr, BD_ADDR_LEN);
+    progress.addr_type  = peer.addr_type;
+    progress.state      = (ConnectionState)peer.state;
+    progress.conn_id    = peer.conn_id;
+    progress.attempt    = peer.attempt;
+    progress.elapsed_ms = now_ms - peer.round_ms;
+    progress.remaining  = 0;
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_PEERS; i++)
+    {
+        Peer& other = peers[i];
+
+        if (other.used && (other.state == CONNECTION_STATE_CONNECTING || other.state == CONNECTION_STATE_CONNECTED ||
+                           other.state == CONNECTION_STATE_DISCONNECTING ||
+                           ((other.state == CONNECTION_STATE_QUEUED || other.state == CONNECTION_STATE_RETRY_WAIT ||
+                             other.state == CONNECTION_STATE_PERIOD_WAIT) && (int32_t)(other.due_ms - now_ms) <= 0)))
+        {
+            progress.remaining++;
+        }
+    }
+
+    event_callback(progress);
+}
+
+/* Ends the attempt of a peer on a link, disconnecting it first when connected. Called with the lock held */
+void ConnectionManager::end(Peer& peer, bool success, uint32_t now_ms)
+{
+    uint16_t conn_id = peer.conn_id;
+
+    peer.success = success;
+    if (conn_id == 0)
+    {
+        release(peer, now_ms);
+        return;
+    }
+
+    /* The link may report the disconnection before returning */
+    peer.state    = CONNECTION_STATE_DISCONNECTING;
+    peer.stage_ms = now_ms;
+    notify(peer, now_ms);
+    link.disconnect(conn_id);
+}
+
+/* Frees the link of a peer and schedules its next attempt. Called with the lock held */
+void ConnectionManager::release(Peer& peer, uint32_t now_ms)
+{
+    uint32_t backoff = 0;
+    uint8_t  i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_LINKS; i++)
+    {
+        if (links[i] == &peer)
+        {
+            links[i] = NULL;
+        }
+    }
+    peer.conn_id = 0;
+
+    if (!peer.success && peer.attempt < params.max_attempts)
+    {
+        /* Doubled on each retry, bounded by backoff_max_ms */
+        backoff = params.backoff_ms;
+        for (i = 1; i < peer.attempt && backoff < params.backoff_max_ms; i++)
+        {
+            backoff <<= 1;
+        }
+        if (backoff > params.backoff_max_ms)
+        {
+            backoff = params.backoff_max_ms;
+        }
+
+        peer.state  = CONNECTION_STATE_RETRY_WAIT;
+        peer.due_ms = now_ms + backoff;
+        statistics.retries++;
+        notify(peer, now_ms);
+        return;
+    }
+
+    if (peer.success)
+    {
+        peer.state = CONNECTION_STATE_DONE;
+        statistics.polled++;
+        statistics.elapsed_ms = now_ms - first_start_ms;
+    }
+    else
+    {
+        peer.state = CONNECTION_STATE_FAILED;
+        statistics.failed++;
+    }
+    notify(peer, now_ms);
+
+    if (peer.period_ms == 0)
+    {
+        peer.used = false;
+        return;
+    }
+
+    /* Periodic peers are polled again one period after the previous poll was due, or one period
+     * from now when the poll overran the period */
+    peer.state    = CONNECTION_STATE_PERIOD_WAIT;
+    peer.attempt  = 0;
+    peer.round_ms = peer.round_ms + peer.period_ms;
+    if ((int32_t)(peer.round_ms - now_ms) <= 0)
+    {
+        peer.round_ms = now_ms + peer.period_ms;
+    }
+    peer.due_ms = peer.round_ms;
+}
+
+bool ConnectionManager::connected(const uint8_t* bd_addr, uint16_t conn_id)
+{
+    return connected(bd_addr, conn_id, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+bool ConnectionManager::connected(const uint8_t* bd_addr, uint16_t conn_id, uint32_t now_ms)
+{
+    Peer* peer = NULL;
+
+    lock.lock();
+
+    peer = (bd_addr != NULL) ? findPeer(bd_addr) : NULL;
+    if (peer == NULL || peer->state != CONNECTION_STATE_CONNECTING)
+    {
+        /* Late connection of a cancelled attempt */
+        statistics.unexpected++;
+        link.disconnect(conn_id);
+        lock.unlock();
+        return false;
+    }
+
+    leaveStage(*peer, CONNECTION_STAGE_CONNECT, now_ms);
+    peer->state    = CONNECTION_STATE_CONNECTED;
+    peer->conn_id  = conn_id;
+    peer->workload = CONNECTION_WORKLOAD_BULK;
+    statistics.parameter_updates++;
+    link.setParameters(conn_id, peer->bd_addr, params.bulk);
+    notify(*peer, now_ms);
+
+    lock.unlock();
+
+    flags.set(CONNECTION_WAKE_FLAG);
+
+    return true;
+}
+
+bool ConnectionManager::disconnected(uint16_t conn_id)
+{
+    return disconnected(conn_id, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+bool ConnectionManager::disconnected(uint16_t conn_id, uint32_t now_ms)
+{
+    Peer* peer = NULL;
+
+    lock.lock();
+
+    peer = (conn_id != 0) ? findLink(conn_id) : NULL;
+    if (peer == NULL)
+    {
+        lock.unlock();
+        return false;
+    }
+
+    if (peer->state == CONNECTION_STATE_CONNECTED)
+    {
+        /* Lost before the poll ended */
+        leaveStage(*peer, CONNECTION_STAGE_POLL, now_ms);
+        peer->success = false;
+    }
+    release(*peer, now_ms);
+
+    lock.unlock();
+
+    flags.set(CONNECTION_WAKE_FLAG);
+
+    return true;
+}
+
+void ConnectionManager::connectionStatus(const wiced_bt_gatt_connection_status_t& status)
+{
+    if (status.connected)
+    {
+        connected(status.bd_addr, status.conn_id);
+    }
+    else
+    {
+        disconnected(status.conn_id);
+    }
+}
+
+bool ConnectionManager::completed(uint16_t conn_id, bool success)
+{
+    return completed(conn_id, success, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+bool ConnectionManager::completed(uint16_t conn_id, bool success, uint32_t now_ms)
+{
+    Peer* peer = NULL;
+
+    lock.lock();
+
+    peer = (conn_id != 0) ? findLink(conn_id) : NULL;
+    if (peer == NULL || peer->state != CONNECTION_STATE_CONNECTED)
+    {
+        lock.unlock();
+        return false;
+    }
+
+    leaveStage(*peer, CONNECTION_STAGE_POLL, now_ms);
+    end(*peer, success, now_ms);
+
+    lock.unlock();
+
+    flags.set(CONNECTION_WAKE_FLAG);
+
+    return true;
+}
+
+ble_error_t ConnectionManager::setWorkload(uint16_t conn_id, ConnectionWorkload workload)
+{
+    ble_error_t status = BLE_ERROR_NONE;
+    Peer*       peer = NULL;
+
+    lock.lock();
+
+    peer = (conn_id != 0) ? findLink(conn_id) : NULL;
+    if (peer == NULL || peer->state != CONNECTION_STATE_CONNECTED)
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    if (peer->workload != workload)
+    {
+        peer->workload = workload;
+        statistics.parameter_updates++;
+        status = link.setParameters(conn_id, peer->bd_addr,
+                                    (workload == CONNECTION_WORKLOAD_BULK) ? params.bulk : params.idle);
+    }
+
+    lock.unlock();
+
+    return status;
+}
+
+uint32_t ConnectionManager::service(uint32_t now_ms)
+{
+    uint32_t wait = osWaitForever;
+    uint32_t limit = 0;
+    int32_t  remaining = 0;
+    Peer*    peer = NULL;
+    uint8_t  s = 0;
+    int      i = 0;
+
+    lock.lock();
+
+    /* Time out the late attempts */
+    for (s = 0; s < EMBEDDED_BLE_CONNECTION_MAX_LINKS; s++)
+    {
+        peer = links[s];
+        if (peer == NULL)
+        {
+            continue;
+        }
+
+        limit = (peer->state == CONNECTION_STATE_CONNECTED) ? params.poll_timeout_ms : params.connect_timeout_ms;
+        if (limit == 0)
+        {
+            continue;
+        }
+
+        remaining = (int32_t)(peer->stage_ms + limit - now_ms);
+        if (remaining > 0)
+        {
+            wait = ((uint32_t)remaining < wait) ? (uint32_t)remaining : wait;
+            continue;
+        }
+
+        if (peer->state == CONNECTION_STATE_CONNECTING)
+        {
+            statistics.timeouts++;
+            link.cancel(peer->addr_type, peer->bd_addr);
+            leaveStage(*peer, CONNECTION_STAGE_CONNECT, now_ms);
+            end(*peer, false, now_ms);
+        }
+        else if (peer->state == CONNECTION_STATE_CONNECTED)
+        {
+            statistics.timeouts++;
+            leaveStage(*peer, CONNECTION_STAGE_POLL, now_ms);
+            end(*peer, false, now_ms);
+        }
+        else
+        {
+            /* The disconnection was not reported, the link is taken as closed */
+            peer->conn_id = 0;
+            release(*peer, now_ms);
+        }
+    }
+
+    /* Start the peers due the longest on the free links, one connection attempt per allowed connect */
+    while (countLinks(CONNECTION_STATE_QUEUED) < params.links &&
+           countLinks(CONNECTION_STATE_CONNECTING) < params.connects)
+    {
+        peer = NULL;
+        for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_PEERS; i++)
+        {
+            Peer& candidate = peers[i];
+
+            if (!candidate.used || (candidate.state != CONNECTION_STATE_QUEUED &&
+                                    candidate.state != CONNECTION_STATE_RETRY_WAIT &&
+                                    candidate.state != CONNECTION_STATE_PERIOD_WAIT) ||
+                (int32_t)(candidate.due_ms - now_ms) > 0)
+            {
+                continue;
+            }
+            if (peer == NULL || (int32_t)(candidate.due_ms - peer->due_ms) < 0)
+            {
+                peer = &candidate;
+            }
+        }
+        if (peer == NULL)
+        {
+            break;
+        }
+
+        for (s = 0; links[s] != NULL; s++)
+        {
+        }
+
+        if (!started)
+        {
+            started = true;
+            first_start_ms = now_ms;
+        }
+
+        /* The queue stage starts when the peer is due */
+        if ((int32_t)(peer->due_ms - peer->stage_ms) > 0)
+        {
+            peer->stage_ms = peer->due_ms;
+        }
+        leaveStage(*peer, CONNECTION_STAGE_QUEUE, now_ms);
+        peer->attempt++;
+        peer->state   = CONNECTION_STATE_CONNECTING;
+        peer->success = false;
+        peer->conn_id = 0;
+        links[s] = peer;
+        notify(*peer, now_ms);
+
+        /* The link may report the connection before returning */
+        if (link.connect(peer->addr_type, peer->bd_addr) != BLE_ERROR_NONE && peer->state == CONNECTION_STATE_CONNECTING)
+        {
+            leaveStage(*peer, CONNECTION_STAGE_CONNECT, now_ms);
+            end(*peer, false, now_ms);
+        }
+        else if (peer->state == CONNECTION_STATE_CONNECTING && params.connect_timeout_ms != 0 &&
+                 params.connect_timeout_ms < wait)
+        {
+            wait = params.connect_timeout_ms;
+        }
+    }
+
+    /* Wake up for the next retry or periodic poll */
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_PEERS; i++)
+    {
+        if (peers[i].used && (peers[i].state == CONNECTION_STATE_RETRY_WAIT || peers[i].state == CONNECTION_STATE_PERIOD_WAIT))
+        {
+            remaining = (int32_t)(peers[i].due_ms - now_ms);
+            if (remaining > 0 && (uint32_t)remaining < wait)
+            {
+                wait = (uint32_t)remaining;
+            }
+        }
+    }
+
+    lock.unlock();
+
+    return wait;
+}
+
+void ConnectionManager::getStatistics(ConnectionStatistics& stats)
+{
+    int i = 0;
+
+    lock.lock();
+
+    stats = statistics;
+    stats.queued = 0;
+    for (i = 0; i < EMBEDDED_BLE_CONNECTION_MAX_PEERS; i++)
+    {
+        if (peers[i].used && (peers[i].state == CONNECTION_STATE_QUEUED || peers[i].state == CONNECTION_STATE_RETRY_WAIT ||
+                              peers[i].state == CONNECTION_STATE_PERIOD_WAIT))
+        {
+            stats.queued++;
+        }
+    }
+    stats.links = countLinks(CONNECTION_STATE_QUEUED);
+    stats.polls_per_minute = 0;
+    if (stats.elapsed_ms != 0)
+    {
+        stats.polls_per_minute = (uint32_t)((uint64_t)stats.polled * 60000 / stats.elapsed_ms);
+    }
+
+    lock.unlock();
+}
@@ -0,0 +1,334 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth central connection manager
+ *
+ * Polls a fleet of peripherals (sensors) as central: peers wait in a queue and a bounded number
+ * of links are open at once. A poll goes through
+ * - connect: the link creates the connection, the controller creates one connection at a time
+ *            so connection attempts are bounded separately from the links,
+ * - poll:    the owner reads the peer (GATT client) and reports the end with
+ *            ConnectionManager::completed, the manager then disconnects.
+ * Connection parameters follow the workload of the link: the bulk parameters (short interval)
+ * are requested once connected, ConnectionManager::setWorkload switches a link between them and
+ * the idle parameters (long interval, peripheral latency). Stuck connection attempts and polls
+ * are timed out and retried with an exponential backoff, and peers can be polled periodically.
+ *
+ * The manager does not talk to the controller itself, a ConnectionLink connects and disconnects
+ * and the owner reports the connection status with ConnectionManager::connected and
+ * ConnectionManager::disconnected. WicedConnectionLink drives the controller over WICED HCI.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+
+#include "wiced_hci_bt_ble.h"
+
+/** Number of peers that can be polled */
+#ifndef EMBEDDED_BLE_CONNECTION_MAX_PEERS
+#define EMBEDDED_BLE_CONNECTION_MAX_PEERS           (64)
+#endif
+
+/** Maximum number of concurrent links, connecting or connected */
+#ifndef EMBEDDED_BLE_CONNECTION_MAX_LINKS
+#define EMBEDDED_BLE_CONNECTION_MAX_LINKS           (8)
+#endif
+
+/** Stack size of the connection manager thread */
+#ifndef EMBEDDED_BLE_CONNECTION_THREAD_STACK_SIZE
+#define EMBEDDED_BLE_CONNECTION_THREAD_STACK_SIZE   (2048)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble
+ *
+ * @{
+ */
+
+/** Defines the state of a peer */
+enum ConnectionState
+{
+    CONNECTION_STATE_QUEUED,            /**< Waiting for a link */
+    CONNECTION_STATE_CONNECTING,        /**< Connection requested */
+    CONNECTION_STATE_CONNECTED,         /**< Connected, the owner polls the peer */
+    CONNECTION_STATE_DISCONNECTING,     /**< Poll ended, waiting for the disconnection */
+    CONNECTION_STATE_RETRY_WAIT,        /**< Attempt failed, waiting for the backoff to elapse */
+    CONNECTION_STATE_PERIOD_WAIT,       /**< Periodic peer waiting for its next poll */
+    CONNECTION_STATE_DONE,              /**< Polled, the peer leaves the queue */
+    CONNECTION_STATE_FAILED,            /**< Out of attempts, the peer leaves the queue */
+};
+
+/** Defines the timed stages of a poll */
+enum ConnectionStage
+{
+    CONNECTION_STAGE_QUEUE,             /**< Due until a link is free */
+    CONNECTION_STAGE_CONNECT,           /**< Connection requested until connected */
+    CONNECTION_STAGE_POLL,              /**< Connected until the poll ended */
+    CONNECTION_STAGES,                  /**< Number of stages */
+};
+
+/** Defines the workload of a link, selecting its connection parameters */
+enum ConnectionWorkload
+{
+    CONNECTION_WORKLOAD_BULK,           /**< Transferring: short connection interval */
+    CONNECTION_WORKLOAD_IDLE,           /**< Waiting: long connection interval and peripheral latency */
+};
+
+/** Defines a progress event */
+struct ConnectionProgress
+{
+    uint8_t         bd_addr[BD_ADDR_LEN]; /**< Peer address */
+    uint8_t         addr_type;          /**< BLE_ADDR_PUBLIC or BLE_ADDR_RANDOM */
+    ConnectionState state;              /**< New state of the peer */
+    uint16_t        conn_id;            /**< Connection, 0 when not connected */
+    uint8_t         attempt;            /**< Attempt number of the poll, 1 for the first one */
+    uint32_t        elapsed_ms;         /**< Time since the poll was due */
+    uint16_t        remaining;          /**< Peers due or on a link */
+};
+
+/** Defines the connection manager configuration */
+struct ConnectionManagerParameters
+{
+    uint8_t  links;                     /**< Concurrent links, at most EMBEDDED_BLE_CONNECTION_MAX_LINKS */
+    uint8_t  connects;                  /**< Concurrent connection attempts, 1 for the WICED controllers */
+    uint8_t  max_attempts;              /**< Attempts per poll */
+    uint32_t backoff_ms;                /**< Delay before the first retry, doubled for each further retry */
+    uint32_t backoff_max_ms;            /**< Longest delay between retries */
+    uint32_t connect_timeout_ms;        /**< Time allowed to connect and to disconnect, 0 waits forever */
+    uint32_t poll_timeout_ms;           /**< Time allowed to poll once connected, 0 waits forever */
+    wiced_bt_ble_conn_params_t bulk;    /**< Parameters of CONNECTION_WORKLOAD_BULK, requested once connected */
+    wiced_bt_ble_conn_params_t idle;    /**< Parameters of CONNECTION_WORKLOAD_IDLE */
+};
+
+/** Defines the time spent in a stage */
+struct ConnectionStageStatistics
+{
+    uint32_t count;                     /**< Times the stage was left */
+    uint32_t total_ms;                  /**< Time spent in the stage */
+    uint32_t max_ms;                    /**< Longest time in the stage */
+};
+
+/** Defines the connection manager counters */
+struct ConnectionStatistics
+{
+    uint32_t added;                     /**< Peers added */
+    uint32_t polled;                    /**< Polls completed */
+    uint32_t failed;                    /**< Polls out of attempts */
+    uint32_t retries;                   /**< Attempts retried */
+    uint32_t timeouts;                  /**< Attempts timed out */
+    uint32_t unexpected;                /**< Connections of no attempt, disconnected */
+    uint32_t parameter_updates;         /**< Connection parameter requests */
+    uint16_t queued;                    /**< Peers waiting for a poll or a retry */
+    uint16_t links;                     /**< Links in use */
+    uint32_t elapsed_ms;                /**< Time from the first connection to the last completed poll */
+    uint32_t polls_per_minute;          /**< Completed polls per minute over elapsed_ms */
+    ConnectionStageStatistics stages[CONNECTION_STAGES]; /**< Time per stage */
+};
+
+/** Defines the link creating the connections */
+class ConnectionLink
+{
+public:
+    virtual ~ConnectionLink() {}
+
+    /** Requests a connection, reported with ConnectionManager::connected, possibly before returning */
+    virtual ble_error_t connect(uint8_t addr_type, const uint8_t* bd_addr) = 0;
+
+    /** Cancels a connection attempt */
+    virtual void cancel(uint8_t addr_type, const uint8_t* bd_addr) = 0;
+
+    /** Disconnects, reported with ConnectionManager::disconnected */
+    virtual void disconnect(uint16_t conn_id) = 0;
+
+    /** Requests new connection parameters */
+    virtual ble_error_t setParameters(uint16_t conn_id, const uint8_t* bd_addr, const wiced_bt_ble_conn_params_t& params) = 0;
+};
+
+/** Defines the link of the controller, over WICED HCI */
+class WicedConnectionLink : public ConnectionLink
+{
+public:
+    WicedConnectionLink(wiced_hci_controller_t controller = WICED_HCI_DEFAULT_CONTROLLER) : controller(controller) {}
+
+    virtual ble_error_t connect(uint8_t addr_type, const uint8_t* bd_addr);
+
+    virtual void cancel(uint8_t addr_type, const uint8_t* bd_addr);
+
+    virtual void disconnect(uint16_t conn_id);
+
+    virtual ble_error_t setParameters(uint16_t conn_id, const uint8_t* bd_addr, const wiced_bt_ble_conn_params_t& params);
+
+private:
+    wiced_hci_controller_t controller;
+};
+
+/** Defines the progress callback, called with the manager locked */
+typedef void (*ConnectionEventCallback_t)(const ConnectionProgress& progress);
+
+/** Defines the central connection manager */
+class ConnectionManager
+{
+public:
+    ConnectionManager(ConnectionLink& link);
+
+    ~ConnectionManager();
+
+    /** Sets the configuration, applied to the attempts started from now */
+    void configure(const ConnectionManagerParameters& params);
+
+    /** Sets the progress callback */
+    void setEventCallback(ConnectionEventCallback_t callback);
+
+    /** Queues a peer.
+     *
+     * @param[in] period_ms: time between the polls of a periodic peer, 0 polls once
+     *
+     * @return BLE_ERROR_INVALID_STATE when the peer is already queued, BLE_ERROR_NO_MEM when the queue is full
+     */
+    ble_error_t add(uint8_t addr_type, const uint8_t* bd_addr, uint32_t period_ms = 0);
+
+    /** Queues a peer at now_ms, for callers driving ConnectionManager::service with their own clock */
+    ble_error_t add(uint8_t addr_type, const uint8_t* bd_addr, uint32_t period_ms, uint32_t now_ms);
+
+    /** Removes a peer, disconnecting it when connected.
+     *
+     * @return BLE_ERROR_NOT_FOUND when the peer is not queued
+     */
+    ble_error_t remove(const uint8_t* bd_addr);
+
+    /** Reports a connection.
+     *
+     * @return false when no attempt connects bd_addr, the connection is then disconnected
+     */
+    bool connected(const uint8_t* bd_addr, uint16_t conn_id);
+
+    /** Reports a connection at now_ms */
+    bool connected(const uint8_t* bd_addr, uint16_t conn_id, uint32_t now_ms);
+
+    /** Reports a disconnection.
+     *
+     * @return false when conn_id is not a link of the manager
+     */
+    bool disconnected(uint16_t conn_id);
+
+    /** Reports a disconnection at now_ms */
+    bool disconnected(uint16_t conn_id, uint32_t now_ms);
+
+    /** Reports a GATT_CONNECTION_STATUS_EVT */
+    void connectionStatus(const wiced_bt_gatt_connection_status_t& status);
+
+    /** Ends the poll of a connected peer, which is then disconnected.
+     *
+     * @param[in] success: false retries the poll
+     *
+     * @return false when conn_id is not a connected link of the manager
+     */
+    bool completed(uint16_t conn_id, bool success);
+
+    /** Ends the poll of a connected peer at now_ms */
+    bool completed(uint16_t conn_id, bool success, uint32_t now_ms);
+
+    /** Requests the connection parameters of a workload on a connected link.
+     *
+     * @return BLE_ERROR_INVALID_PARAM when conn_id is not a connected link of the manager
+     */
+    ble_error_t setWorkload(uint16_t conn_id, ConnectionWorkload workload);
+
+    /** Starts the connections, retries and periodic polls due and times out the late ones.
+     *
+     * @return time until the next timeout, retry or poll (ms), osWaitForever when there is none
+     */
+    uint32_t service(uint32_t now_ms);
+
+    /** Starts the manager thread */
+    ble_error_t start(void);
+
+    /** Stops the manager thread, links are left open */
+    ble_error_t stop(void);
+
+    /** Copies the counters */
+    void getStatistics(ConnectionStatistics& stats);
+
+private:
+    struct Peer
+    {
+        uint8_t  bd_addr[BD_ADDR_LEN];
+        uint8_t  addr_type;
+        bool     used;
+        bool     success;
+        uint8_t  state;
+        uint8_t  attempt;
+        uint8_t  workload;
+        uint16_t conn_id;
+        uint32_t period_ms;
+        uint32_t round_ms;
+        uint32_t stage_ms;
+        uint32_t due_ms;
+    };
+
+    Peer* findPeer(const uint8_t* bd_addr);
+    Peer* findLink(uint16_t conn_id);
+    uint8_t countLinks(uint8_t state);
+    void leaveStage(Peer& peer, ConnectionStage stage, uint32_t now_ms);
+    void end(Peer& peer, bool success, uint32_t now_ms);
+    void release(Peer& peer, uint32_t now_ms);
+    void notify(Peer& peer, uint32_t now_ms);
+    void worker(void);
+
+    ConnectionLink&             link;
+    Peer                        peers[EMBEDDED_BLE_CONNECTION_MAX_PEERS];
+    Peer*                       links[EMBEDDED_BLE_CONNECTION_MAX_LINKS];
+    ConnectionManagerParameters params;
+    ConnectionEventCallback_t   event_callback;
+    ConnectionStatistics        statistics;
+    bool                        started;
+    uint32_t                    first_start_ms;
+    rtos::Mutex                 lock;
+    rtos::EventFlags            flags;
+    rtos::Thread*               thread;
+};
+
+/** @} */
+}
+
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth de-duplication cache
+ */
+
+#include <string.h>
+#include "embedded_BLE_dedup.h"
+
+using namespace cypress::embedded;
+
+DedupCache::DedupCache(Entry* entries, uint32_t capacity, uint32_t window_ms) :
+    entries(entries), mask(0), window(window_ms), duplicates(0), evictions(0)
+{
+    uint32_t size = 1;
+
+    while ((size << 1) <= capacity)
+    {
+        size <<= 1;
+    }
+    mask = size - 1;
+
+    clear();
+}
+
+void DedupCache::clear(void)
+{
+    memset(entries, 0, (mask + 1) * sizeof(Entry));
+    duplicates = 0;
+    evictions  = 0;
+}
+
+bool DedupCache::isDuplicate(uint32_t key, uint32_t now_ms)
+{
+    uint32_t index  = 0;
+    uint32_t victim = 0;
+    uint32_t oldest = 0;
+    uint32_t probe  = 0;
+    bool     found_free = false;
+
+    /* 0 marks a free slot */
+    if (key == 0)
+    {
+        key = 1;
+    }
+
+    for (probe = 0; probe < MAX_PROBE && probe <= mask; probe++)
+    {
+        index = (key + probe) & mask;
+
+        Entry&   entry = entries[index];
+        uint32_t age   = now_ms - entry.timestamp;
+
+        /* Duplicates leave the timestamp alone so that a repeated key is let through once per window */
+        if (entry.key == key)
+        {
+            if (age <= window)
+            {
+                duplicates++;
+                return true;
+            }
+            entry.timestamp = now_ms;
+            return false;
+        }
+
+        /* Remember the first free or expired slot, otherwise the oldest one */
+        if (found_free)
+        {
+            continue;
+        }
+        if (entry.key == 0 || age > window)
+        {
+            victim = index;
+            found_free = true;
+        }
+        else if (age >= oldest)
+        {
+            victim = index;
+            oldest = age;
+        }
+    }
+
+    if (!found_free)
+    {
+        evictions++;
+    }
+    entries[victim].key       = key;
+    entries[victim].timestamp = now_ms;
+
+    return false;
+}
+
+uint32_t DedupCache::hash(const uint8_t* data, uint32_t length, uint32_t seed)
+{
+    uint32_t h = seed;
+
+    while (length--)
+    {
+        h ^= *data++;
+        h *= 16777619UL;
+    }
+
+    return h;
+}
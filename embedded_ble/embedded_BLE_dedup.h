@@ -0,0 +1,124 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Time windowed de-duplication cache
+ *
+ * Remembers 32-bit keys (typically a hash of the identifying bytes of a packet) for a
+ * configurable time window. Storage is provided by the owner so no memory is allocated
+ * at run time, lookups use open addressing with a bounded probe length.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble
+ *
+ * @{
+ */
+
+/** Defines the de-duplication cache used by the scan and mesh pipelines */
+class DedupCache
+{
+public:
+    /** Cache slot, key 0 marks a free slot */
+    struct Entry
+    {
+        uint32_t key;               /**< Hashed key */
+        uint32_t timestamp;         /**< Time the key was last let through (ms) */
+    };
+
+    /** Maximum number of slots inspected per lookup */
+    static const uint32_t MAX_PROBE = 8;
+
+    /** Creates a cache on top of caller provided storage.
+     *
+     * @param[in] entries:   slot storage, cleared by the constructor
+     * @param[in] capacity:  number of slots, rounded down to a power of two
+     * @param[in] window_ms: time a key is remembered
+     */
+    DedupCache(Entry* entries, uint32_t capacity, uint32_t window_ms);
+
+    /** Looks up a key and records it.
+     *
+     * @param[in] key:    hashed key, see DedupCache::hash
+     * @param[in] now_ms: current time (ms)
+     *
+     * @return true when the key was let through within the window, a duplicate does not extend the window
+     */
+    bool isDuplicate(uint32_t key, uint32_t now_ms);
+
+    /** Changes the time a key is remembered */
+    void setWindow(uint32_t window_ms)
+    {
+        window = window_ms;
+    }
+
+    /** Forgets all keys and resets the counters */
+    void clear(void);
+
+    /** Number of lookups that found a duplicate */
+    uint32_t getDuplicateCount(void) const
+    {
+        return duplicates;
+    }
+
+    /** Number of live keys dropped early because their probe sequence was full */
+    uint32_t getEvictionCount(void) const
+    {
+        return evictions;
+    }
+
+    /** 32-bit FNV-1a hash, chain calls through seed to hash several fields */
+    static uint32_t hash(const uint8_t* data, uint32_t length, uint32_t seed = 2166136261UL);
+
+private:
+    Entry*   entries;
+    uint32_t mask;
+    uint32_t window;
+    uint32_t duplicates;
+    uint32_t evictions;
+};
+
+/** @} */
+}
+
+}
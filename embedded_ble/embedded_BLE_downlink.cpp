@@ -0,0 +1,608 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth Mesh downlink scheduler
+ */
+
+#include <string.h>
+#include "embedded_BLE_downlink.h"
+
+using namespace cypress::embedded;
+
+#define DOWNLINK_WAKE_FLAG          (0x1)
+#define DOWNLINK_STOP_FLAG          (0x2)
+
+/* Token buckets count thousandths, a rate per second refills rate tokens per ms */
+#define DOWNLINK_TOKEN              (1000)
+
+/* Opcodes never coalesced: the effect of the message depends on the state it finds, or it configures the node */
+static const struct
+{
+    uint32_t first;
+    uint32_t last;
+} non_idempotent_opcodes[] =
+{
+    { 0x00,   0x7E   },     /* one octet opcodes: configuration and health messages */
+    { 0x8000, 0x807F },     /* configuration and health messages */
+    { 0x8209, 0x820A },     /* Generic Level Delta Set, Generic Level Delta Set Unacknowledged */
+};
+
+const DownlinkCoalesceRule DownlinkScheduler::STATE_SET_RULES[] =
+{
+    { 0x8202, 0x8203, EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS },    /* Generic OnOff Set */
+    { 0x8206, 0x8207, EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS },    /* Generic Level Set */
+    { 0x8216, 0x8217, EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS },    /* Generic Power Level Set */
+    { 0x824C, 0x824D, EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS },    /* Light Lightness Set */
+    { 0x8250, 0x8251, EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS },    /* Light Lightness Linear Set */
+    { 0x825E, 0x825F, EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS },    /* Light CTL Set */
+    { 0x8276, 0x8277, EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS },    /* Light HSL Set */
+};
+
+const uint8_t DownlinkScheduler::STATE_SET_RULE_COUNT = sizeof(STATE_SET_RULES) / sizeof(STATE_SET_RULES[0]);
+
+DownlinkScheduler::DownlinkScheduler(ProxyTransmit_t transmit, void* context) :
+    destination_count(0), rule_count(0), airtime_tokens(0), airtime_updated_ms(0),
+    transmit_function(transmit), transmit_context(context), thread(NULL)
+{
+    memset(&params, 0, sizeof(params));
+    memset(statistics, 0, sizeof(statistics));
+    clear();
+}
+
+DownlinkScheduler::~DownlinkScheduler()
+{
+    stop();
+}
+
+void DownlinkScheduler::configure(const DownlinkParameters& parameters)
+{
+    lock.lock();
+
+    params = parameters;
+    if (params.node_burst == 0)
+    {
+        params.node_burst = 1;
+    }
+    if (params.airtime_burst < EMBEDDED_BLE_MESH_DOWNLINK_MAX_LENGTH)
+    {
+        params.airtime_burst = EMBEDDED_BLE_MESH_DOWNLINK_MAX_LENGTH;
+    }
+
+    /* Buckets refill to full on their next use */
+    destination_count  = 0;
+    airtime_tokens     = (uint64_t)params.airtime_burst * DOWNLINK_TOKEN;
+    airtime_updated_ms = (uint32_t)rtos::Kernel::get_ms_count();
+
+    lock.unlock();
+
+    flags.set(DOWNLINK_WAKE_FLAG);
+}
+
+ble_error_t DownlinkScheduler::setCoalescing(const DownlinkCoalesceRule* coalesce_rules, uint8_t count)
+{
+    uint8_t  i = 0;
+    uint32_t j = 0;
+
+    if (count > EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_RULES || (count != 0 && coalesce_rules == NULL))
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (coalesce_rules[i].opcode_first > coalesce_rules[i].opcode_last)
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
+
+        for (j = 0; j < sizeof(non_idempotent_opcodes) / sizeof(non_idempotent_opcodes[0]); j++)
+        {
+            if (coalesce_rules[i].opcode_first <= non_idempotent_opcodes[j].last &&
+                coalesce_rules[i].opcode_last >= non_idempotent_opcodes[j].first)
+            {
+                return BLE_ERROR_INVALID_PARAM;
+            }
+        }
+    }
+
+    lock.lock();
+
+    if (count != 0)
+    {
+        memcpy(rules, coalesce_rules, count * sizeof(DownlinkCoalesceRule));
+    }
+    rule_count = count;
+
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+const DownlinkCoalesceRule* DownlinkScheduler::findRule(uint32_t opcode) const
+{
+    uint8_t i = 0;
+
+    for (i = 0; i < rule_count; i++)
+    {
+        if (opcode >= rules[i].opcode_first && opcode <= rules[i].opcode_last)
+        {
+            return &rules[i];
+        }
+    }
+
+    return NULL;
+}
+
+ble_error_t DownlinkScheduler::start(void)
+{
+    if (thread != NULL)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    flags.clear(DOWNLINK_WAKE_FLAG | DOWNLINK_STOP_FLAG);
+    thread = new rtos::Thread(osPriorityNormal, EMBEDDED_BLE_MESH_DOWNLINK_THREAD_STACK_SIZE, NULL, "downlink");
+    thread->start(callback(this, &DownlinkScheduler::worker));
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t DownlinkScheduler::stop(void)
+{
+    if (thread == NULL)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    flags.set(DOWNLINK_STOP_FLAG);
+    thread->join();
+    delete thread;
+    thread = NULL;
+
+    return BLE_ERROR_NONE;
+}
+
+void DownlinkScheduler::worker(void)
+{
+    for (;;)
+    {
+        uint32_t wait   = service((uint32_t)rtos::Kernel::get_ms_count());
+        uint32_t result = flags.wait_any(DOWNLINK_WAKE_FLAG | DOWNLINK_STOP_FLAG, wait);
+
+        if (!(result & osFlagsError) && (result & DOWNLINK_STOP_FLAG))
+        {
+            break;
+        }
+    }
+}
+
+void DownlinkScheduler::clear(void)
+{
+    int i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < DOWNLINK_PRIORITY_CLASSES; i++)
+    {
+        statistics[i].dropped += statistics[i].queued;
+        statistics[i].queued = 0;
+        queues[i].head = -1;
+        queues[i].tail = -1;
+    }
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_DOWNLINK_SLOTS; i++)
+    {
+        slots[i].next = (i + 1 < EMBEDDED_BLE_MESH_DOWNLINK_SLOTS) ? (int16_t)(i + 1) : -1;
+    }
+    free_slots = 0;
+    free_count = EMBEDDED_BLE_MESH_DOWNLINK_SLOTS;
+
+    lock.unlock();
+}
+
+DownlinkScheduler::Destination* DownlinkScheduler::findDestination(uint16_t dst, uint32_t now_ms)
+{
+    Destination* destination = NULL;
+    uint8_t      i = 0;
+
+    for (i = 0; i < destination_count; i++)
+    {
+        if (destinations[i].dst == dst)
+        {
+            return &destinations[i];
+        }
+    }
+
+    /* A recycled node starts over with a full bucket */
+    if (destination_count < EMBEDDED_BLE_MESH_DOWNLINK_DESTINATIONS)
+    {
+        destination = &destinations[destination_count++];
+    }
+    else
+    {
+        destination = &destinations[0];
+        for (i = 1; i < destination_count; i++)
+        {
+            if ((int32_t)(destinations[i].updated_ms - destination->updated_ms) < 0)
+            {
+                destination = &destinations[i];
+            }
+        }
+    }
+
+    destination->dst        = dst;
+    destination->tokens     = (uint32_t)params.node_burst * DOWNLINK_TOKEN;
+    destination->updated_ms = now_ms;
+
+    return destination;
+}
+
+uint32_t DownlinkScheduler::nodeWait(Destination* destination, uint32_t now_ms)
+{
+    uint32_t capacity = (uint32_t)params.node_burst * DOWNLINK_TOKEN;
+    int32_t  elapsed  = (int32_t)(now_ms - destination->updated_ms);
+
+    if (elapsed > 0)
+    {
+        uint64_t tokens = destination->tokens + (uint64_t)elapsed * params.node_rate;
+
+        destination->tokens     = (tokens > capacity) ? capacity : (uint32_t)tokens;
+        destination->updated_ms = now_ms;
+    }
+    else if (elapsed < 0)
+    {
+        /* Clock of the caller of service differs from the previous one, start over from now */
+        destination->updated_ms = now_ms;
+    }
+
+    if (destination->tokens >= DOWNLINK_TOKEN)
+    {
+        return 0;
+    }
+
+    return (DOWNLINK_TOKEN - destination->tokens + params.node_rate - 1) / params.node_rate;
+}
+
+uint32_t DownlinkScheduler::airtimeWait(uint16_t length, uint32_t now_ms)
+{
+    uint64_t capacity = (uint64_t)params.airtime_burst * DOWNLINK_TOKEN;
+    uint64_t cost     = (uint64_t)length * DOWNLINK_TOKEN;
+    int32_t  elapsed  = (int32_t)(now_ms - airtime_updated_ms);
+
+    if (params.airtime_rate == 0)
+    {
+        return 0;
+    }
+
+    if (elapsed > 0)
+    {
+        airtime_tokens += (uint64_t)elapsed * params.airtime_rate;
+        if (airtime_tokens > capacity)
+        {
+            airtime_tokens = capacity;
+        }
+        airtime_updated_ms = now_ms;
+    }
+    else if (elapsed < 0)
+    {
+        airtime_updated_ms = now_ms;
+    }
+
+    if (airtime_tokens >= cost)
+    {
+        return 0;
+    }
+
+    return (uint32_t)((cost - airtime_tokens + params.airtime_rate - 1) / params.airtime_rate);
+}
+
+void DownlinkScheduler::unlink(uint8_t priority, int16_t slot, int16_t previous)
+{
+    Queue& queue = queues[priority];
+
+    if (previous < 0)
+    {
+        queue.head = slots[slot].next;
+    }
+    else
+    {
+        slots[previous].next = slots[slot].next;
+    }
+    if (queue.tail == slot)
+    {
+        queue.tail = previous;
+    }
+
+    slots[slot].next = free_slots;
+    free_slots = slot;
+    free_count++;
+    statistics[priority].queued--;
+}
+
+void DownlinkScheduler::append(uint8_t priority, int16_t slot)
+{
+    Queue& queue = queues[priority];
+
+    slots[slot].next = -1;
+    if (queue.tail < 0)
+    {
+        queue.head = slot;
+    }
+    else
+    {
+        slots[queue.tail].next = slot;
+    }
+    queue.tail = slot;
+    statistics[priority].queued++;
+}
+
+ble_error_t DownlinkScheduler::submit(const DownlinkMessage& message)
+{
+    return submit(message, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+ble_error_t DownlinkScheduler::submit(const DownlinkMessage& message, uint32_t now_ms)
+{
+    const DownlinkCoalesceRule* rule = NULL;
+    uint8_t priority            = (uint8_t)message.priority;
+    int16_t slot                = -1;
+    int16_t previous            = -1;
+    int16_t superseded          = -1;
+    int16_t superseded_previous = -1;
+    int     superseded_class    = 0;
+    int     c                   = 0;
+
+    if (message.data == NULL || message.length == 0 || message.length > EMBEDDED_BLE_MESH_DOWNLINK_MAX_LENGTH ||
+        priority >= DOWNLINK_PRIORITY_CLASSES)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    lock.lock();
+
+    statistics[priority].submitted++;
+
+    /* A held message takes the state of a newer one with the same opcode, any other message to the node releases it */
+    rule = findRule(message.opcode);
+    for (c = 0; c < DOWNLINK_PRIORITY_CLASSES; c++)
+    {
+        for (slot = queues[c].head; slot >= 0; slot = slots[slot].next)
+        {
+            if (slots[slot].dst != message.dst || slots[slot].conn_id != message.conn_id ||
+                (int32_t)(slots[slot].release_ms - now_ms) <= 0)
+            {
+                continue;
+            }
+
+            if (rule != NULL && c == priority && slots[slot].opcode == message.opcode)
+            {
+                memcpy(slots[slot].data, message.data, message.length);
+                slots[slot].length = message.length;
+                statistics[c].coalesced++;
+                lock.unlock();
+                return BLE_ERROR_NONE;
+            }
+
+            slots[slot].release_ms = now_ms;
+        }
+    }
+
+    /* A newer command for the same node and state replaces the queued one, in place when the class is the same */
+    for (c = 0; message.supersede_key != 0 && c < DOWNLINK_PRIORITY_CLASSES; c++)
+    {
+        previous = -1;
+        for (slot = queues[c].head; slot >= 0; previous = slot, slot = slots[slot].next)
+        {
+            if (slots[slot].supersede_key == message.supersede_key && slots[slot].dst == message.dst &&
+                slots[slot].conn_id == message.conn_id)
+            {
+                break;
+            }
+        }
+
+        if (slot < 0)
+        {
+            continue;
+        }
+
+        if (c == priority)
+        {
+            statistics[c].superseded++;
+            memcpy(slots[slot].data, message.data, message.length);
+            slots[slot].length = message.length;
+            lock.unlock();
+            return BLE_ERROR_NONE;
+        }
+
+        superseded          = slot;
+        superseded_previous = previous;
+        superseded_class    = c;
+        break;
+    }
+
+    /* The slot of the superseded message counts as free, it is only released once the new message is admitted */
+    if (free_count + ((superseded >= 0) ? 1 : 0) <= priority * EMBEDDED_BLE_MESH_DOWNLINK_RESERVED_SLOTS)
+    {
+        statistics[priority].dropped++;
+        lock.unlock();
+        return BLE_ERROR_NO_MEM;
+    }
+
+    if (superseded >= 0)
+    {
+        statistics[superseded_class].superseded++;
+        unlink((uint8_t)superseded_class, superseded, superseded_previous);
+    }
+
+    slot = free_slots;
+    free_slots = slots[slot].next;
+    free_count--;
+
+    slots[slot].conn_id       = message.conn_id;
+    slots[slot].dst           = message.dst;
+    slots[slot].supersede_key = message.supersede_key;
+    slots[slot].length        = message.length;
+    slots[slot].opcode        = message.opcode;
+    slots[slot].enqueued_ms   = now_ms;
+    slots[slot].release_ms    = now_ms + ((rule != NULL) ? rule->hold_ms : 0);
+    memcpy(slots[slot].data, message.data, message.length);
+    append(priority, slot);
+
+    lock.unlock();
+
+    flags.set(DOWNLINK_WAKE_FLAG);
+
+    return BLE_ERROR_NONE;
+}
+
+uint32_t DownlinkScheduler::service(uint32_t now_ms)
+{
+    uint32_t wait = osWaitForever;
+
+    /* One caller sends at a time, tx_buffer is only used under service_lock */
+    service_lock.lock();
+
+    for (;;)
+    {
+        Destination* destination = NULL;
+        int16_t      slot        = -1;
+        int16_t      previous    = -1;
+        uint32_t     slot_wait   = 0;
+        uint32_t     delay       = 0;
+        uint16_t     conn_id     = 0;
+        uint16_t     length      = 0;
+        bool         held        = false;
+        int          c           = 0;
+
+        wait = osWaitForever;
+
+        lock.lock();
+
+        for (c = 0; c < DOWNLINK_PRIORITY_CLASSES; c++)
+        {
+            previous = -1;
+            for (slot = queues[c].head; slot >= 0; previous = slot, slot = slots[slot].next)
+            {
+                /* Held for coalescing, the messages behind it to other nodes go ahead */
+                slot_wait = slots[slot].release_ms - now_ms;
+                if ((int32_t)slot_wait > 0)
+                {
+                    wait = (slot_wait < wait) ? slot_wait : wait;
+                    continue;
+                }
+
+                destination = NULL;
+                if (params.node_rate != 0 && slots[slot].dst != 0)
+                {
+                    destination = findDestination(slots[slot].dst, now_ms);
+                    slot_wait   = nodeWait(destination, now_ms);
+                    if (slot_wait != 0)
+                    {
+                        /* Messages to other nodes may go ahead of this one */
+                        wait = (slot_wait < wait) ? slot_wait : wait;
+                        continue;
+                    }
+                }
+
+                /* The airtime is kept for the first eligible message, lower classes do not take it */
+                slot_wait = airtimeWait(slots[slot].length, now_ms);
+                if (slot_wait != 0)
+                {
+                    wait = (slot_wait < wait) ? slot_wait : wait;
+                    held = true;
+                }
+                break;
+            }
+
+            if (slot >= 0)
+            {
+                break;
+            }
+        }
+
+        if (slot < 0 || held)
+        {
+            lock.unlock();
+            break;
+        }
+
+        if (destination != NULL)
+        {
+            destination->tokens -= DOWNLINK_TOKEN;
+        }
+        if (params.airtime_rate != 0)
+        {
+            airtime_tokens -= (uint64_t)slots[slot].length * DOWNLINK_TOKEN;
+        }
+
+        delay = now_ms - slots[slot].enqueued_ms;
+        statistics[c].sent++;
+        statistics[c].delay_total_ms += delay;
+        if (delay > statistics[c].delay_max_ms)
+        {
+            statistics[c].delay_max_ms = delay;
+        }
+
+        conn_id = slots[slot].conn_id;
+        length  = slots[slot].length;
+        memcpy(tx_buffer, slots[slot].data, length);
+        unlink((uint8_t)c, slot, previous);
+
+        lock.unlock();
+
+        if (!transmit_function(conn_id, tx_buffer, length, transmit_context))
+        {
+            lock.lock();
+            statistics[c].sent--;
+            statistics[c].dropped++;
+            lock.unlock();
+        }
+    }
+
+    service_lock.unlock();
+
+    return wait;
+}
+
+void DownlinkScheduler::getStatistics(DownlinkPriority priority, DownlinkClassStatistics& stats)
+{
+    if ((uint8_t)priority >= DOWNLINK_PRIORITY_CLASSES)
+    {
+        memset(&stats, 0, sizeof(stats));
+        return;
+    }
+
+    lock.lock();
+    stats = statistics[priority];
+    lock.unlock();
+}
@@ -0,0 +1,273 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth Mesh downlink scheduler
+ *
+ * Paces the proxy packets sent from the cloud to the mesh network. Messages wait in one FIFO
+ * per priority class and are released, highest class first, when
+ * - the token bucket of their destination node has a token (per node rate limit),
+ * - the global airtime bucket holds their length (proxy link budget, in bytes per second).
+ * A message waiting for its node does not hold back the messages to other nodes behind it.
+ * Submitting a message with the same destination, connection and supersede key (typically
+ * the model and state it sets) as a queued one replaces the queued one.
+ *
+ * Optionally, messages whose model opcode falls in a coalescing rule (state set messages:
+ * Generic Level Set...) are held for the window of the rule, and a newer message with the same
+ * destination and opcode replaces the held one: only the latest state is sent. Opcodes without
+ * a rule are never held, rules covering non-idempotent opcodes (delta sets, configuration
+ * messages) are refused. Any other message to the same destination releases the held one first
+ * so that the messages to a node keep their order.
+ *
+ * Release times are computed by DownlinkScheduler::service, called by the scheduler thread or
+ * directly by the application (for example from a simulation with its own clock).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+#include "embedded_BLE_proxy.h"
+
+/** Number of messages the scheduler can hold */
+#ifndef EMBEDDED_BLE_MESH_DOWNLINK_SLOTS
+#define EMBEDDED_BLE_MESH_DOWNLINK_SLOTS            (64)
+#endif
+
+/** Maximum length of a scheduled proxy packet */
+#ifndef EMBEDDED_BLE_MESH_DOWNLINK_MAX_LENGTH
+#define EMBEDDED_BLE_MESH_DOWNLINK_MAX_LENGTH       (64)
+#endif
+
+/** Slots a priority class leaves free for each class above it, so that bulk traffic cannot lock out urgent commands */
+#ifndef EMBEDDED_BLE_MESH_DOWNLINK_RESERVED_SLOTS
+#define EMBEDDED_BLE_MESH_DOWNLINK_RESERVED_SLOTS   (8)
+#endif
+
+/** Maximum number of coalescing rules */
+#ifndef EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_RULES
+#define EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_RULES   (8)
+#endif
+
+/** Hold window of the state set rules of DownlinkScheduler::STATE_SET_RULES */
+#ifndef EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS
+#define EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_MS      (100)
+#endif
+
+/** Number of destination nodes with a token bucket, the least recently used one is recycled */
+#ifndef EMBEDDED_BLE_MESH_DOWNLINK_DESTINATIONS
+#define EMBEDDED_BLE_MESH_DOWNLINK_DESTINATIONS     (32)
+#endif
+
+/** Stack size of the scheduler thread */
+#ifndef EMBEDDED_BLE_MESH_DOWNLINK_THREAD_STACK_SIZE
+#define EMBEDDED_BLE_MESH_DOWNLINK_THREAD_STACK_SIZE (2048)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines the downlink priority classes, served in strict priority order */
+enum DownlinkPriority
+{
+    DOWNLINK_PRIORITY_URGENT,       /**< Actuator commands (lights off...) */
+    DOWNLINK_PRIORITY_NORMAL,       /**< Interactive commands */
+    DOWNLINK_PRIORITY_BULK,         /**< Configuration pushes, firmware distribution */
+    DOWNLINK_PRIORITY_CLASSES,      /**< Number of classes */
+};
+
+/** Defines a message submitted to the scheduler */
+struct DownlinkMessage
+{
+    uint16_t         conn_id;       /**< Proxy connection, 0 for the default one */
+    uint16_t         dst;           /**< Destination address, 0 is not rate limited */
+    uint32_t         supersede_key; /**< Replaces a queued message with the same conn_id, dst and key, 0 never replaces */
+    DownlinkPriority priority;      /**< Priority class */
+    const uint8_t*   data;          /**< Proxy packet, copied by DownlinkScheduler::submit */
+    uint16_t         length;        /**< Proxy packet length */
+    uint32_t         opcode;        /**< Access message opcode, held and coalesced when a coalescing rule covers it */
+};
+
+/** Defines a coalescing rule: messages with an opcode in [opcode_first, opcode_last] are held for hold_ms */
+struct DownlinkCoalesceRule
+{
+    uint32_t opcode_first;          /**< First opcode of the class */
+    uint32_t opcode_last;           /**< Last opcode of the class */
+    uint16_t hold_ms;               /**< Time a message is held waiting for a newer one */
+};
+
+/** Defines the scheduler rates, a rate of 0 is unlimited */
+struct DownlinkParameters
+{
+    uint16_t node_rate;             /**< Messages per second to one destination */
+    uint16_t node_burst;            /**< Messages a destination can receive back to back */
+    uint32_t airtime_rate;          /**< Bytes per second on the proxy link */
+    uint32_t airtime_burst;         /**< Bytes that can be sent back to back */
+};
+
+/** Defines the counters of a priority class */
+struct DownlinkClassStatistics
+{
+    uint32_t submitted;             /**< Messages submitted */
+    uint32_t sent;                  /**< Messages handed to the proxy connection */
+    uint32_t superseded;            /**< Queued messages replaced by a newer one */
+    uint32_t coalesced;             /**< Held messages replaced by a newer one with the same opcode */
+    uint32_t dropped;               /**< Messages refused with BLE_ERROR_NO_MEM, cleared or failed to send */
+    uint32_t queued;                /**< Messages waiting */
+    uint32_t delay_total_ms;        /**< Sum of the queueing delays of the sent messages */
+    uint32_t delay_max_ms;          /**< Longest queueing delay */
+};
+
+/** Defines the downlink scheduler */
+class DownlinkScheduler
+{
+public:
+    /** Creates a scheduler sending the released messages with transmit, without limits */
+    DownlinkScheduler(ProxyTransmit_t transmit, void* context = NULL);
+
+    ~DownlinkScheduler();
+
+    /** Sets the rates, the buckets start full */
+    void configure(const DownlinkParameters& params);
+
+    /** Sets the coalescing rules, NULL or 0 rules disables coalescing (default).
+     *
+     * @return BLE_ERROR_INVALID_PARAM when a rule covers a non-idempotent opcode or there are
+     *         more than EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_RULES rules
+     */
+    ble_error_t setCoalescing(const DownlinkCoalesceRule* rules, uint8_t count);
+
+    /** Coalescing rules of the idempotent state set messages of the generic and lighting models */
+    static const DownlinkCoalesceRule STATE_SET_RULES[];
+
+    /** Number of rules in STATE_SET_RULES */
+    static const uint8_t STATE_SET_RULE_COUNT;
+
+    /** Starts the scheduler thread */
+    ble_error_t start(void);
+
+    /** Stops the scheduler thread, queued messages stay queued */
+    ble_error_t stop(void);
+
+    /** Queues a message.
+     *
+     * @return BLE_ERROR_INVALID_PARAM when the packet is empty or longer than EMBEDDED_BLE_MESH_DOWNLINK_MAX_LENGTH,
+     *         BLE_ERROR_NO_MEM when the slots available to its class are taken, submit again later
+     */
+    ble_error_t submit(const DownlinkMessage& message);
+
+    /** Queues a message received at now_ms, for callers driving DownlinkScheduler::service with their own clock */
+    ble_error_t submit(const DownlinkMessage& message, uint32_t now_ms);
+
+    /** Sends the messages released at now_ms.
+     *
+     * @return time until the next message is released (ms), osWaitForever when nothing is queued
+     */
+    uint32_t service(uint32_t now_ms);
+
+    /** Drops the queued messages */
+    void clear(void);
+
+    /** Copies the counters of a priority class */
+    void getStatistics(DownlinkPriority priority, DownlinkClassStatistics& stats);
+
+private:
+    struct Slot
+    {
+        int16_t         next;
+        uint16_t        conn_id;
+        uint16_t        dst;
+        uint16_t        length;
+        uint32_t        supersede_key;
+        uint32_t        opcode;
+        uint32_t        enqueued_ms;
+        uint32_t        release_ms;
+        uint8_t         data[EMBEDDED_BLE_MESH_DOWNLINK_MAX_LENGTH];
+    };
+
+    struct Destination
+    {
+        uint16_t        dst;
+        uint32_t        tokens;     /* thousandths of a message */
+        uint32_t        updated_ms;
+    };
+
+    struct Queue
+    {
+        int16_t         head;
+        int16_t         tail;
+    };
+
+    const DownlinkCoalesceRule* findRule(uint32_t opcode) const;
+    Destination* findDestination(uint16_t dst, uint32_t now_ms);
+    uint32_t nodeWait(Destination* destination, uint32_t now_ms);
+    uint32_t airtimeWait(uint16_t length, uint32_t now_ms);
+    void unlink(uint8_t priority, int16_t slot, int16_t previous);
+    void append(uint8_t priority, int16_t slot);
+    void worker(void);
+
+    Slot                    slots[EMBEDDED_BLE_MESH_DOWNLINK_SLOTS];
+    Queue                   queues[DOWNLINK_PRIORITY_CLASSES];
+    int16_t                 free_slots;
+    uint16_t                free_count;
+    Destination             destinations[EMBEDDED_BLE_MESH_DOWNLINK_DESTINATIONS];
+    uint8_t                 destination_count;
+    DownlinkParameters      params;
+    DownlinkCoalesceRule    rules[EMBEDDED_BLE_MESH_DOWNLINK_COALESCE_RULES];
+    uint8_t                 rule_count;
+    uint64_t                airtime_tokens; /* thousandths of a byte */
+    uint32_t                airtime_updated_ms;
+    DownlinkClassStatistics statistics[DOWNLINK_PRIORITY_CLASSES];
+    uint8_t                 tx_buffer[EMBEDDED_BLE_MESH_DOWNLINK_MAX_LENGTH];
+    ProxyTransmit_t         transmit_function;
+    void*                   transmit_context;
+    rtos::Mutex             lock;
+    rtos::Mutex             service_lock;
+    rtos::EventFlags        flags;
+    rtos::Thread*           thread;
+};
+
+/** @} */
+}
+
+}
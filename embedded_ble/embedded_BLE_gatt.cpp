@@ -0,0 +1,1195 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth GATT client
+ */
+
+#include <string.h>
+#include "embedded_BLE_gatt.h"
+#include "embedded_BLE_gatt_server.h"
+
+using namespace cypress::embedded;
+
+/* Cache record: version, address, address type, sequence, then the serialized database */
+#define GATT_CACHE_VERSION              (1)
+#define GATT_CACHE_HEADER_LENGTH        (1 + 6 + 1 + 4)
+
+/* Serialized database: service, characteristic and descriptor counts, then the entries */
+#define GATT_DB_HEADER_LENGTH           (3)
+
+/* Entry flags */
+#define GATT_ENTRY_UUID128              (0x01)
+#define GATT_ENTRY_DECLARATION_BEFORE   (0x02)  /* characteristic declaration right before the value */
+
+/* A write without response in a controller buffer: ACL and L2CAP headers, ATT opcode and handle */
+#define GATT_STREAM_PACKET_OVERHEAD     (4 + 4 + 3)
+
+#define GATT_ATT_HEADER_LENGTH          (3)
+#define GATT_HANDLE_MAX                 (0xFFFF)
+#define GATT_UUID_SERVICE_CHANGED       (0x2A05)
+
+GattClient* GattClient::client[WICED_HCI_MAX_CONTROLLERS];
+
+static void write16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t read16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void toUuid(GattUuid& uuid, const wiced_bt_uuid_t& wuuid)
+{
+    memset(&uuid, 0, sizeof(uuid));
+    if (wuuid.len == LEN_UUID_16)
+    {
+        uuid.length = LEN_UUID_16;
+        write16(uuid.value, wuuid.uu.uuid16);
+    }
+    else
+    {
+        uuid.length = LEN_UUID_128;
+        memcpy(uuid.value, wuuid.uu.uuid128, LEN_UUID_128);
+    }
+}
+
+static bool sameUuid(const GattUuid& a, const GattUuid& b)
+{
+    return a.length == b.length && memcmp(a.value, b.value, a.length) == 0;
+}
+
+/* Sets the links between services, characteristics and descriptors from their handles */
+static void linkDatabase(GattDatabase& database)
+{
+    uint8_t s = 0;
+    uint8_t c = 0;
+    uint8_t d = 0;
+
+    for (c = 0; c < database.characteristic_count; c++)
+    {
+        GattCharacteristic& characteristic = database.characteristics[c];
+
+        while (s + 1 < database.service_count && characteristic.declaration_handle > database.services[s].end_handle)
+        {
+            s++;
+        }
+        characteristic.service    = s;
+        characteristic.end_handle = database.services[s].end_handle;
+        if (c + 1 < database.characteristic_count &&
+            database.characteristics[c + 1].declaration_handle <= characteristic.end_handle)
+        {
+            characteristic.end_handle = database.characteristics[c + 1].declaration_handle - 1;
+        }
+    }
+
+    c = 0;
+    for (d = 0; d < database.descriptor_count; d++)
+    {
+        while (c + 1 < database.characteristic_count && database.descriptors[d].handle > database.characteristics[c].end_handle)
+        {
+            c++;
+        }
+        database.descriptors[d].characteristic = c;
+    }
+}
+
+GattClient::GattClient(wiced_hci_controller_t controller) :
+    controller(controller), store(NULL), event_callback(NULL), connection_manager(NULL), cache_sequence(0), credits_changed(lock), streaming(false),
+    credits_pending(false), credits(0), stream_buffer_size(0), stream_sent(0), stream_sent_at_request(0)
+{
+    memset(connections, 0, sizeof(connections));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+ble_error_t GattClient::initialize(void)
+{
+    if (wiced_bt_gatt_register(controller, gattCallback) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INTERNAL_STACK_FAILURE;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+void GattClient::setStore(NVStore* store)
+{
+    lock.lock();
+    this->store = store;
+    lock.unlock();
+}
+
+void GattClient::setEventCallback(GattClientEventCallback_t callback)
+{
+    lock.lock();
+    event_callback = callback;
+    lock.unlock();
+}
+
+void GattClient::setConnectionManager(ConnectionManager* manager)
+{
+    lock.lock();
+    connection_manager = manager;
+    lock.unlock();
+}
+
+/* Called with lock held */
+GattClient::Connection* GattClient::find(uint16_t conn_id)
+{
+    int i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_GATT_MAX_CONNECTIONS; i++)
+    {
+        if (connections[i].used && connections[i].conn_id == conn_id)
+        {
+            return &connections[i];
+        }
+    }
+
+    return NULL;
+}
+
+ble_error_t GattClient::connected(uint16_t conn_id, const uint8_t* address, uint8_t addr_type)
+{
+    Connection* connection = NULL;
+    int i = 0;
+
+    lock.lock();
+    connection = find(conn_id);
+    for (i = 0; connection == NULL && i < EMBEDDED_BLE_GATT_MAX_CONNECTIONS; i++)
+    {
+        if (!connections[i].used)
+        {
+            connection = &connections[i];
+        }
+    }
+    if (connection == NULL)
+    {
+        lock.unlock();
+        return BLE_ERROR_NO_MEM;
+    }
+
+    memset(connection, 0, sizeof(*connection));
+    connection->used      = true;
+    connection->conn_id   = conn_id;
+    connection->addr_type = addr_type;
+    connection->mtu       = EMBEDDED_BLE_GATT_DEFAULT_MTU;
+    memcpy(connection->address, address, sizeof(connection->address));
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+void GattClient::disconnected(uint16_t conn_id)
+{
+    Connection* connection = NULL;
+
+    lock.lock();
+    connection = find(conn_id);
+    if (connection)
+    {
+        connection->used = false;
+    }
+    // A stream to the connection stops waiting for credits
+    credits_changed.notify_all();
+    lock.unlock();
+
+    notifications.removeConnection(conn_id);
+}
+
+uint16_t GattClient::getMtu(uint16_t conn_id)
+{
+    Connection* connection = NULL;
+    uint16_t    mtu = 0;
+
+    lock.lock();
+    connection = find(conn_id);
+    if (connection)
+    {
+        mtu = connection->mtu;
+    }
+    lock.unlock();
+
+    return mtu;
+}
+
+/* Called with lock held: finds the next discovery request from the connection's phase and index */
+bool GattClient::next(Connection& connection, wiced_bt_gatt_discovery_type_t& type, wiced_bt_gatt_discovery_param_t& param)
+{
+    GattDatabase& database = connection.database;
+
+    memset(&param, 0, sizeof(param));
+
+    if (connection.phase == PHASE_CHARACTERISTICS)
+    {
+        if (connection.index < database.service_count)
+        {
+            type           = GATT_DISCOVER_CHARACTERISTICS;
+            param.s_handle = database.services[connection.index].start_handle;
+            param.e_handle = database.services[connection.index].end_handle;
+            return true;
+        }
+        linkDatabase(database);
+        connection.phase = PHASE_DESCRIPTORS;
+        connection.index = 0;
+    }
+
+    if (connection.phase == PHASE_DESCRIPTORS)
+    {
+        // Only characteristics with handles after their value can have descriptors
+        while (connection.index < database.characteristic_count &&
+               database.characteristics[connection.index].end_handle <= database.characteristics[connection.index].value_handle)
+        {
+            connection.index++;
+        }
+        if (connection.index < database.characteristic_count)
+        {
+            type           = GATT_DISCOVER_CHARACTERISTIC_DESCRIPTORS;
+            param.s_handle = database.characteristics[connection.index].value_handle + 1;
+            param.e_handle = database.characteristics[connection.index].end_handle;
+            return true;
+        }
+        linkDatabase(database);
+        connection.phase = PHASE_DONE;
+    }
+
+    return false;
+}
+
+/* Called with lock held */
+void GattClient::discovered(Connection& connection, const wiced_bt_gatt_discovery_result_t& result)
+{
+    GattDatabase& database = connection.database;
+    const wiced_bt_gatt_discovery_data_t& data = result.discovery_data;
+
+    if (connection.phase == PHASE_SERVICES && result.discovery_type == GATT_DISCOVER_SERVICES_ALL)
+    {
+        if (database.service_count == EMBEDDED_BLE_GATT_MAX_SERVICES)
+        {
+            connection.overflow = true;
+            return;
+        }
+        GattService& service = database.services[database.service_count++];
+        toUuid(service.uuid, data.group_value.service_type);
+        service.start_handle = data.group_value.s_handle;
+        service.end_handle   = data.group_value.e_handle;
+    }
+    else if (connection.phase == PHASE_CHARACTERISTICS && result.discovery_type == GATT_DISCOVER_CHARACTERISTICS)
+    {
+        if (database.characteristic_count == EMBEDDED_BLE_GATT_MAX_CHARACTERISTICS)
+        {
+            connection.overflow = true;
+            return;
+        }
+        GattCharacteristic& characteristic = database.characteristics[database.characteristic_count++];
+        toUuid(characteristic.uuid, data.characteristic_declaration.char_uuid);
+        characteristic.declaration_handle = data.characteristic_declaration.handle;
+        characteristic.value_handle       = data.characteristic_declaration.val_handle;
+        characteristic.properties         = data.characteristic_declaration.characteristic_properties;
+        characteristic.service            = connection.index;
+    }
+    else if (connection.phase == PHASE_DESCRIPTORS && result.discovery_type == GATT_DISCOVER_CHARACTERISTIC_DESCRIPTORS)
+    {
+        if (database.descriptor_count == EMBEDDED_BLE_GATT_MAX_DESCRIPTORS)
+        {
+            connection.overflow = true;
+            return;
+        }
+        GattDescriptor& descriptor = database.descriptors[database.descriptor_count++];
+        toUuid(descriptor.uuid, data.char_descr_info.type);
+        descriptor.handle         = data.char_descr_info.handle;
+        descriptor.characteristic = connection.index;
+    }
+}
+
+uint16_t GattClient::serialize(const GattDatabase& database, uint8_t* buffer, uint16_t size)
+{
+    uint8_t* p = buffer;
+    uint8_t* end = buffer + size;
+    uint8_t  i = 0;
+
+    if (size < GATT_DB_HEADER_LENGTH)
+    {
+        return 0;
+    }
+    *p++ = database.service_count;
+    *p++ = database.characteristic_count;
+    *p++ = database.descriptor_count;
+
+    for (i = 0; i < database.service_count; i++)
+    {
+        const GattService& service = database.services[i];
+
+        if (end - p < 5 + service.uuid.length)
+        {
+            return 0;
+        }
+        *p++ = (service.uuid.length == LEN_UUID_128) ? GATT_ENTRY_UUID128 : 0;
+        write16(p, service.start_handle);
+        write16(p + 2, service.end_handle);
+        memcpy(p + 4, service.uuid.value, service.uuid.length);
+        p += 4 + service.uuid.length;
+    }
+
+    for (i = 0; i < database.characteristic_count; i++)
+    {
+        const GattCharacteristic& characteristic = database.characteristics[i];
+        uint8_t flags = (characteristic.uuid.length == LEN_UUID_128) ? GATT_ENTRY_UUID128 : 0;
+
+        // The declaration is almost always the handle before the value, it is then not stored
+        if (characteristic.declaration_handle + 1 == characteristic.value_handle)
+        {
+            flags |= GATT_ENTRY_DECLARATION_BEFORE;
+        }
+        if (end - p < 6 + characteristic.uuid.length)
+        {
+            return 0;
+        }
+        *p++ = flags;
+        *p++ = characteristic.properties;
+        if (!(flags & GATT_ENTRY_DECLARATION_BEFORE))
+        {
+            write16(p, characteristic.declaration_handle);
+            p += 2;
+        }
+        write16(p, characteristic.value_handle);
+        memcpy(p + 2, characteristic.uuid.value, characteristic.uuid.length);
+        p += 2 + characteristic.uuid.length;
+    }
+
+    for (i = 0; i < database.descriptor_count; i++)
+    {
+        const GattDescriptor& descriptor = database.descriptors[i];
+
+        if (end - p < 3 + descriptor.uuid.length)
+        {
+            return 0;
+        }
+        *p++ = (descriptor.uuid.length == LEN_UUID_128) ? GATT_ENTRY_UUID128 : 0;
+        write16(p, descriptor.handle);
+        memcpy(p + 2, descriptor.uuid.value, descriptor.uuid.length);
+        p += 2 + descriptor.uuid.length;
+    }
+
+    return (uint16_t)(p - buffer);
+}
+
+bool GattClient::deserialize(const uint8_t* buffer, uint16_t length, GattDatabase& database)
+{
+    const uint8_t* p = buffer;
+    const uint8_t* end = buffer + length;
+    uint8_t  i = 0;
+    uint8_t  flags = 0;
+    uint8_t  uuid_length = 0;
+    uint16_t previous = 0;
+
+    memset(&database, 0, sizeof(database));
+    if (length < GATT_DB_HEADER_LENGTH || p[0] > EMBEDDED_BLE_GATT_MAX_SERVICES ||
+        p[1] > EMBEDDED_BLE_GATT_MAX_CHARACTERISTICS || p[2] > EMBEDDED_BLE_GATT_MAX_DESCRIPTORS)
+    {
+        return false;
+    }
+    database.service_count        = *p++;
+    database.characteristic_count = *p++;
+    database.descriptor_count     = *p++;
+
+    // Every entry is checked to fit and to follow the previous one in handle order
+    for (i = 0; i < database.service_count; i++)
+    {
+        GattService& service = database.services[i];
+
+        if (end - p < 5)
+        {
+            return false;
+        }
+        flags = *p++;
+        uuid_length = (flags & GATT_ENTRY_UUID128) ? LEN_UUID_128 : LEN_UUID_16;
+        if (end - p < 4 + uuid_length)
+        {
+            return false;
+        }
+        service.start_handle = read16(p);
+        service.end_handle   = read16(p + 2);
+        service.uuid.length  = uuid_length;
+        memcpy(service.uuid.value, p + 4, uuid_length);
+        p += 4 + uuid_length;
+        if (service.start_handle <= previous || service.end_handle < service.start_handle)
+        {
+            return false;
+        }
+        previous = service.end_handle;
+    }
+
+    previous = 0;
+    for (i = 0; i < database.characteristic_count; i++)
+    {
+        GattCharacteristic& characteristic = database.characteristics[i];
+
+        if (end - p < 2)
+        {
+            return false;
+        }
+        flags = *p++;
+        characteristic.properties = *p++;
+        uuid_length = (flags & GATT_ENTRY_UUID128) ? LEN_UUID_128 : LEN_UUID_16;
+        if (end - p < ((flags & GATT_ENTRY_DECLARATION_BEFORE) ? 2 : 4) + uuid_length)
+        {
+            return false;
+        }
+        if (!(flags & GATT_ENTRY_DECLARATION_BEFORE))
+        {
+            characteristic.declaration_handle = read16(p);
+            p += 2;
+        }
+        characteristic.value_handle = read16(p);
+        if (flags & GATT_ENTRY_DECLARATION_BEFORE)
+        {
+            characteristic.declaration_handle = characteristic.value_handle - 1;
+        }
+        characteristic.uuid.length = uuid_length;
+        memcpy(characteristic.uuid.value, p + 2, uuid_length);
+        p += 2 + uuid_length;
+        if (characteristic.declaration_handle <= previous || characteristic.value_handle <= characteristic.declaration_handle)
+        {
+            return false;
+        }
+        previous = characteristic.value_handle;
+    }
+
+    previous = 0;
+    for (i = 0; i < database.descriptor_count; i++)
+    {
+        GattDescriptor& descriptor = database.descriptors[i];
+
+        if (end - p < 3)
+        {
+            return false;
+        }
+        flags = *p++;
+        uuid_length = (flags & GATT_ENTRY_UUID128) ? LEN_UUID_128 : LEN_UUID_16;
+        if (end - p < 2 + uuid_length)
+        {
+            return false;
+        }
+        descriptor.handle      = read16(p);
+        descriptor.uuid.length = uuid_length;
+        memcpy(descriptor.uuid.value, p + 2, uuid_length);
+        p += 2 + uuid_length;
+        if (descriptor.handle <= previous)
+        {
+            return false;
+        }
+        previous = descriptor.handle;
+    }
+
+    if (p != end || (database.characteristic_count && database.service_count == 0))
+    {
+        return false;
+    }
+    linkDatabase(database);
+
+    return true;
+}
+
+/* Called with lock held: finds the cache record of a peer, read into record. Returns its slot, -1 when missing */
+int GattClient::findCache(const uint8_t* address, uint8_t addr_type, uint16_t* length)
+{
+    int i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_GATT_CACHE_PEERS; i++)
+    {
+        if (store->read(EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID + i, record, sizeof(record), length) == BLE_ERROR_NONE &&
+            *length > GATT_CACHE_HEADER_LENGTH && record[0] == GATT_CACHE_VERSION &&
+            memcmp(&record[1], address, 6) == 0 && record[7] == addr_type)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Called with lock held */
+bool GattClient::loadCache(Connection& connection)
+{
+    uint16_t length = 0;
+
+    if (store == NULL || findCache(connection.address, connection.addr_type, &length) < 0)
+    {
+        return false;
+    }
+
+    return deserialize(&record[GATT_CACHE_HEADER_LENGTH], length - GATT_CACHE_HEADER_LENGTH, connection.database);
+}
+
+/* Called with lock held */
+void GattClient::storeCache(Connection& connection)
+{
+    uint16_t length = 0;
+    uint32_t sequence = 0;
+    uint32_t oldest = 0;
+    int      own = -1;
+    int      free = -1;
+    int      replace = -1;
+    int      i = 0;
+
+    if (store == NULL)
+    {
+        return;
+    }
+
+    // The peer's own slot, else a free one, else the least recently discovered one.
+    // The sequence restarts after the newest stored one, so the order survives a reset
+    for (i = 0; i < EMBEDDED_BLE_GATT_CACHE_PEERS; i++)
+    {
+        if (store->read(EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID + i, record, sizeof(record), &length) != BLE_ERROR_NONE ||
+            length <= GATT_CACHE_HEADER_LENGTH || record[0] != GATT_CACHE_VERSION)
+        {
+            if (free < 0)
+            {
+                free = i;
+            }
+            continue;
+        }
+        if (memcmp(&record[1], connection.address, 6) == 0 && record[7] == connection.addr_type)
+        {
+            own = i;
+        }
+        sequence = record[8] | (record[9] << 8) | (record[10] << 16) | ((uint32_t)record[11] << 24);
+        if (replace < 0 || (int32_t)(sequence - oldest) < 0)
+        {
+            oldest  = sequence;
+            replace = i;
+        }
+        if ((int32_t)(sequence - cache_sequence) > 0)
+        {
+            cache_sequence = sequence;
+        }
+    }
+    if (own >= 0)
+    {
+        replace = own;
+    }
+    else if (free >= 0)
+    {
+        replace = free;
+    }
+
+    length = serialize(connection.database, &record[GATT_CACHE_HEADER_LENGTH], sizeof(record) - GATT_CACHE_HEADER_LENGTH);
+    if (length == 0)
+    {
+        statistics.too_large++;
+        return;
+    }
+    sequence = ++cache_sequence;
+    record[0] = GATT_CACHE_VERSION;
+    memcpy(&record[1], connection.address, 6);
+    record[7]  = connection.addr_type;
+    record[8]  = (uint8_t)sequence;
+    record[9]  = (uint8_t)(sequence >> 8);
+    record[10] = (uint8_t)(sequence >> 16);
+    record[11] = (uint8_t)(sequence >> 24);
+
+    if (store->write(EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID + replace, record, GATT_CACHE_HEADER_LENGTH + length) == BLE_ERROR_NONE)
+    {
+        statistics.cache_stores++;
+    }
+}
+
+ble_error_t GattClient::invalidate(const uint8_t* address, uint8_t addr_type)
+{
+    uint16_t length = 0;
+    int      slot = -1;
+
+    lock.lock();
+    if (store)
+    {
+        slot = findCache(address, addr_type, &length);
+    }
+    if (slot >= 0)
+    {
+        store->write(EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID + slot, NULL, 0);
+        statistics.cache_invalidations++;
+    }
+    lock.unlock();
+
+    return slot >= 0 ? BLE_ERROR_NONE : BLE_ERROR_NOT_FOUND;
+}
+
+ble_error_t GattClient::discover(uint16_t conn_id, bool refresh)
+{
+    wiced_bt_gatt_discovery_param_t param;
+    Connection* connection = NULL;
+    uint32_t    now = (uint32_t)rtos::Kernel::get_ms_count();
+
+    lock.lock();
+    connection = find(conn_id);
+    if (connection == NULL || (connection->phase != PHASE_IDLE && connection->phase != PHASE_DONE))
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    connection->started_ms = now;
+    connection->overflow   = false;
+    if (!refresh && loadCache(*connection))
+    {
+        connection->phase = PHASE_DONE;
+        statistics.cache_hits++;
+        lock.unlock();
+        complete(conn_id, BLE_ERROR_NONE, true, (uint32_t)rtos::Kernel::get_ms_count() - now);
+        return BLE_ERROR_NONE;
+    }
+
+    memset(&connection->database, 0, sizeof(connection->database));
+    connection->phase = PHASE_SERVICES;
+    connection->index = 0;
+    statistics.procedures++;
+    lock.unlock();
+
+    memset(&param, 0, sizeof(param));
+    param.s_handle = 0x0001;
+    param.e_handle = GATT_HANDLE_MAX;
+    if (wiced_bt_gatt_send_discover(controller, conn_id, GATT_DISCOVER_SERVICES_ALL, &param) != CY_RSLT_SUCCESS)
+    {
+        lock.lock();
+        connection->phase = PHASE_IDLE;
+        lock.unlock();
+        return BLE_ERROR_INTERNAL_STACK_FAILURE;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattClient::getDatabase(uint16_t conn_id, GattDatabase& database)
+{
+    Connection* connection = NULL;
+
+    lock.lock();
+    connection = find(conn_id);
+    if (connection == NULL || connection->phase != PHASE_DONE)
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_STATE;
+    }
+    database = connection->database;
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattClient::findCharacteristic(uint16_t conn_id, const GattUuid& uuid, GattCharacteristic& characteristic)
+{
+    ble_error_t result = BLE_ERROR_NOT_FOUND;
+    Connection* connection = NULL;
+    uint8_t     i = 0;
+
+    lock.lock();
+    connection = find(conn_id);
+    if (connection == NULL || connection->phase != PHASE_DONE)
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_STATE;
+    }
+    for (i = 0; i < connection->database.characteristic_count; i++)
+    {
+        if (sameUuid(connection->database.characteristics[i].uuid, uuid))
+        {
+            characteristic = connection->database.characteristics[i];
+            result = BLE_ERROR_NONE;
+            break;
+        }
+    }
+    lock.unlock();
+
+    return result;
+}
+
+ble_error_t GattClient::read(uint16_t conn_id, uint16_t handle)
+{
+    wiced_bt_gatt_read_param_t param;
+
+    memset(&param, 0, sizeof(param));
+    param.by_handle.handle = handle;
+    if (wiced_bt_gatt_send_read(controller, conn_id, GATT_READ_BY_HANDLE, &param) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattClient::write(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint16_t length, bool with_response)
+{
+    uint8_t buffer[sizeof(wiced_bt_gatt_value_t) + EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE];
+    wiced_bt_gatt_value_t* value = (wiced_bt_gatt_value_t*)buffer;
+
+    if (GATT_RESPONSE_SIZE(length) > sizeof(buffer))
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    if (!with_response)
+    {
+        if (wiced_bt_gatt_send_write_command(controller, conn_id, handle, data, length) != CY_RSLT_SUCCESS)
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
+        return BLE_ERROR_NONE;
+    }
+
+    memset(value, 0, sizeof(*value));
+    value->handle = handle;
+    value->len    = length;
+    memcpy(value->value, data, length);
+    if (wiced_bt_gatt_send_write(controller, conn_id, GATT_WRITE, value) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+void GattClient::notify(GattClientEvent event, GattClientEventData& data)
+{
+    GattClientEventCallback_t callback = NULL;
+
+    lock.lock();
+    callback = event_callback;
+    lock.unlock();
+
+    if (callback)
+    {
+        callback(event, data);
+    }
+}
+
+void GattClient::complete(uint16_t conn_id, ble_error_t status, bool from_cache, uint32_t elapsed_ms)
+{
+    GattClientEventData data;
+
+    memset(&data, 0, sizeof(data));
+    data.conn_id    = conn_id;
+    data.status     = status;
+    data.from_cache = from_cache;
+    data.elapsed_ms = elapsed_ms;
+    notify(GATT_CLIENT_DISCOVERY_COMPLETE, data);
+}
+
+void GattClient::handleEvent(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t* p_event_data)
+{
+    wiced_bt_gatt_discovery_type_t  type = 0;
+    wiced_bt_gatt_discovery_param_t param;
+    GattClientEventData data;
+    Connection* connection = NULL;
+    bool        more = false;
+    bool        done = false;
+    ble_error_t status = BLE_ERROR_NONE;
+    uint32_t    elapsed = 0;
+    uint16_t    conn_id = 0;
+    uint8_t     i = 0;
+
+    memset(&data, 0, sizeof(data));
+
+    switch (event)
+    {
+    case GATT_CONNECTION_STATUS_EVT:
+        conn_id = p_event_data->connection_status.conn_id;
+        data.conn_id = conn_id;
+        if (p_event_data->connection_status.connected)
+        {
+            data.status = connected(conn_id, p_event_data->connection_status.bd_addr, p_event_data->connection_status.addr_type);
+            notify(GATT_CLIENT_CONNECTED, data);
+        }
+        else
+        {
+            disconnected(conn_id);
+            notify(GATT_CLIENT_DISCONNECTED, data);
+        }
+        break;
+
+    case GATT_DISCOVERY_RESULT_EVT:
+        lock.lock();
+        connection = find(p_event_data->discovery_result.conn_id);
+        if (connection)
+        {
+            discovered(*connection, p_event_data->discovery_result);
+        }
+        lock.unlock();
+        break;
+
+    case GATT_DISCOVERY_CPLT_EVT:
+        conn_id = p_event_data->discovery_complete.conn_id;
+        lock.lock();
+        connection = find(conn_id);
+        if (connection == NULL || connection->phase == PHASE_IDLE || connection->phase == PHASE_DONE)
+        {
+            lock.unlock();
+            break;
+        }
+        if (connection->phase == PHASE_SERVICES)
+        {
+            connection->phase = PHASE_CHARACTERISTICS;
+            connection->index = 0;
+        }
+        else
+        {
+            connection->index++;
+        }
+        more = next(*connection, type, param);
+        if (more)
+        {
+            statistics.procedures++;
+        }
+        else
+        {
+            done    = true;
+            elapsed = (uint32_t)rtos::Kernel::get_ms_count() - connection->started_ms;
+            statistics.discoveries++;
+            statistics.discovery_total_ms += elapsed;
+            if (elapsed > statistics.discovery_max_ms)
+            {
+                statistics.discovery_max_ms = elapsed;
+            }
+            if (connection->overflow)
+            {
+                statistics.too_large++;
+                status = BLE_ERROR_NO_MEM;
+            }
+            else
+            {
+                storeCache(*connection);
+            }
+        }
+        lock.unlock();
+
+        if (more && wiced_bt_gatt_send_discover(controller, conn_id, type, &param) != CY_RSLT_SUCCESS)
+        {
+            lock.lock();
+            connection->phase = PHASE_IDLE;
+            lock.unlock();
+            done   = true;
+            status = BLE_ERROR_INTERNAL_STACK_FAILURE;
+        }
+        if (done)
+        {
+            complete(conn_id, status, false, elapsed);
+        }
+        break;
+
+    case GATT_OPERATION_CPLT_EVT:
+    {
+        const wiced_bt_gatt_operation_complete_t& operation = p_event_data->operation_complete;
+
+        data.conn_id = operation.conn_id;
+        data.status  = operation.status == WICED_BT_GATT_SUCCESS ? BLE_ERROR_NONE : BLE_ERROR_UNSPECIFIED;
+        if (operation.op == GATTC_OPTYPE_WRITE)
+        {
+            data.handle = operation.response_data.handle;
+            notify(GATT_CLIENT_WRITE_COMPLETE, data);
+            break;
+        }
+        data.handle = operation.response_data.att_value.handle;
+        data.data   = operation.response_data.att_value.p_data;
+        data.length = operation.response_data.att_value.len;
+        if (operation.op == GATTC_OPTYPE_READ)
+        {
+            notify(GATT_CLIENT_READ_COMPLETE, data);
+            break;
+        }
+        if (operation.op != GATTC_OPTYPE_NOTIFICATION && operation.op != GATTC_OPTYPE_INDICATION)
+        {
+            break;
+        }
+
+        notifications.received(operation.conn_id, data.handle, data.data, data.length, operation.op == GATTC_OPTYPE_INDICATION);
+
+        // Service Changed, always indicated: the cached database of the peer is no longer valid
+        lock.lock();
+        connection = (operation.op == GATTC_OPTYPE_INDICATION) ? find(operation.conn_id) : NULL;
+        for (i = 0; connection && connection->phase == PHASE_DONE && i < connection->database.characteristic_count; i++)
+        {
+            const GattCharacteristic& characteristic = connection->database.characteristics[i];
+
+            if (characteristic.value_handle == data.handle && characteristic.uuid.length == LEN_UUID_16 &&
+                read16(characteristic.uuid.value) == GATT_UUID_SERVICE_CHANGED)
+            {
+                invalidate(connection->address, connection->addr_type);
+                break;
+            }
+        }
+        lock.unlock();
+        notify(GATT_CLIENT_NOTIFICATION, data);
+        break;
+    }
+
+    case GATT_PEER_MTU_EVT:
+        lock.lock();
+        connection = find(p_event_data->peer_mtu.conn_id);
+        if (connection && p_event_data->peer_mtu.mtu >= EMBEDDED_BLE_GATT_DEFAULT_MTU)
+        {
+            connection->mtu = p_event_data->peer_mtu.mtu;
+        }
+        lock.unlock();
+        break;
+
+    default:
+        break;
+    }
+}
+
+/* Called with lock held and streaming set: asks the controller for its free buffers, releases the lock while it is sent.
+ * queued: writes already counted in stream_sent that are sent after the request */
+bool GattClient::requestCredits(uint32_t queued)
+{
+    bool sent = false;
+
+    credits_pending        = true;
+    stream_sent_at_request = stream_sent - queued;
+    lock.unlock();
+    sent = wiced_bt_dev_read_buffer_stats(controller, bufferStatsCallback) == CY_RSLT_SUCCESS;
+    lock.lock();
+    if (!sent)
+    {
+        credits_pending = false;
+    }
+
+    return sent;
+}
+
+void GattClient::creditsReceived(const wiced_bt_buffer_statistics_t* p_stats, uint8_t count)
+{
+    int32_t free_buffers = -1;
+    uint8_t i = 0;
+
+    lock.lock();
+    if (!streaming)
+    {
+        lock.unlock();
+        return;
+    }
+
+    // The smallest pool holding a write of the stream
+    for (i = 0; i < count; i++)
+    {
+        if (p_stats[i].pool_size >= stream_buffer_size)
+        {
+            free_buffers = (int32_t)p_stats[i].total_count - p_stats[i].current_allocated_count;
+            break;
+        }
+    }
+
+    // No pool holds the writes: the stream times out
+    if (free_buffers < 0)
+    {
+        lock.unlock();
+        return;
+    }
+
+    // The controller answered after the writes sent before the request, the ones sent since are not counted yet
+    credits = free_buffers - EMBEDDED_BLE_GATT_STREAM_RESERVE - (int32_t)(stream_sent - stream_sent_at_request);
+    credits_pending = false;
+    credits_changed.notify_all();
+    lock.unlock();
+}
+
+void GattClient::bufferStatsCallback(wiced_hci_controller_t controller, const wiced_bt_buffer_statistics_t* p_stats, uint8_t count)
+{
+    GattClient::getInstance(controller).creditsReceived(p_stats, count);
+}
+
+ble_error_t GattClient::stream(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint32_t length, GattStreamStatistics* result)
+{
+    GattStreamStatistics stats;
+    ble_error_t status = BLE_ERROR_NONE;
+    uint64_t    start = 0;
+    uint64_t    now = 0;
+    uint64_t    starved_since = 0;
+    uint32_t    offset = 0;
+    uint32_t    batch = 0;
+    uint32_t    sent = 0;
+    uint16_t    chunk = 0;
+    bool        starved = false;
+
+    memset(&stats, 0, sizeof(stats));
+    chunk = getMtu(conn_id);
+    if (chunk == 0)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+    chunk -= GATT_ATT_HEADER_LENGTH;
+    if (data == NULL && length)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    // Credits are buffers of the controller, shared by the connections: one stream at a time
+    stream_lock.lock();
+    lock.lock();
+    streaming          = true;
+    credits            = 0;
+    credits_pending    = false;
+    stream_buffer_size = chunk + GATT_STREAM_PACKET_OVERHEAD;
+    stream_sent        = 0;
+    start = rtos::Kernel::get_ms_count();
+
+    while (offset < length && status == BLE_ERROR_NONE)
+    {
+        if (find(conn_id) == NULL)
+        {
+            status = BLE_ERROR_INVALID_STATE;
+            break;
+        }
+
+        if (credits <= 0)
+        {
+            // The timeout runs from the moment the credits ran out, answers reporting no free buffer do not restart it
+            now = rtos::Kernel::get_ms_count();
+            if (!starved)
+            {
+                starved       = true;
+                starved_since = now;
+            }
+            else if (now - starved_since >= EMBEDDED_BLE_GATT_STREAM_TIMEOUT_MS)
+            {
+                status = BLE_ERROR_INITIALIZATION_INCOMPLETE;
+                break;
+            }
+
+            if (!credits_pending)
+            {
+                // The last read found no free buffer: they are freed as the packets go over the air
+                if (stats.credit_reads)
+                {
+                    credits_changed.wait_for(EMBEDDED_BLE_GATT_STREAM_POLL_MS);
+                    if (find(conn_id) == NULL)
+                    {
+                        continue;
+                    }
+                }
+                if (!requestCredits(0))
+                {
+                    status = BLE_ERROR_INTERNAL_STACK_FAILURE;
+                    break;
+                }
+                stats.credit_reads++;
+                continue;
+            }
+            stats.credit_waits++;
+            credits_changed.wait_for((uint32_t)(starved_since + EMBEDDED_BLE_GATT_STREAM_TIMEOUT_MS - now));
+            continue;
+        }
+        starved = false;
+
+        // Take every credit, and read the next ones while this batch is sent
+        batch = (length - offset + chunk - 1) / chunk;
+        if (batch > (uint32_t)credits)
+        {
+            batch = credits;
+        }
+        credits     -= batch;
+        stream_sent += batch;
+        if (!credits_pending && requestCredits(batch))
+        {
+            stats.credit_reads++;
+        }
+        lock.unlock();
+
+        for (sent = 0; sent < batch; sent++)
+        {
+            uint16_t slice = (length - offset < chunk) ? (uint16_t)(length - offset) : chunk;
+
+            if (wiced_bt_gatt_send_write_command(controller, conn_id, handle, data + offset, slice) != CY_RSLT_SUCCESS)
+            {
+                status = BLE_ERROR_INTERNAL_STACK_FAILURE;
+                break;
+            }
+            offset += slice;
+            stats.packets++;
+        }
+
+        lock.lock();
+        stream_sent -= batch - sent;
+    }
+
+    streaming = false;
+    lock.unlock();
+    stream_lock.unlock();
+
+    stats.bytes         = offset;
+    stats.packet_length = chunk;
+    stats.elapsed_ms    = (uint32_t)(rtos::Kernel::get_ms_count() - start);
+    stats.bytes_per_second = stats.elapsed_ms ? (uint32_t)((uint64_t)offset * 1000 / stats.elapsed_ms) : offset;
+    if (result)
+    {
+        *result = stats;
+    }
+
+    return status;
+}
+
+wiced_bt_gatt_status_t GattClient::gattCallback(wiced_hci_controller_t controller, wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t* p_event_data)
+{
+    GattClient&        gatt_client = GattClient::getInstance(controller);
+    ConnectionManager* manager     = NULL;
+
+    if (event == GATT_ATTRIBUTE_REQUEST_EVT)
+    {
+        return GattServer::getInstance(controller).handleRequest(p_event_data->attribute_request);
+    }
+
+    gatt_client.handleEvent(event, p_event_data);
+
+    /* Told after the client, a poll started from the manager's event finds the connection open */
+    if (event == GATT_CONNECTION_STATUS_EVT)
+    {
+        gatt_client.lock.lock();
+        manager = gatt_client.connection_manager;
+        gatt_client.lock.unlock();
+        if (manager)
+        {
+            manager->connectionStatus(p_event_data->connection_status);
+        }
+    }
+
+    return WICED_BT_GATT_SUCCESS;
+}
+
+void GattClient::getStatistics(GattClientStatistics& stats)
+{
+    lock.lock();
+    stats = statistics;
+    lock.unlock();
+}
@@ -0,0 +1,406 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth GATT client
+ *
+ * Discovers the attribute database of a peer (services, characteristics and their descriptors)
+ * through the GATT commands of the Bluetooth Controller, and reads and writes its attributes.
+ *
+ * A discovery takes one request per service and per characteristic with descriptors, seconds
+ * on a slow connection. The discovered database is cached per peer identity address in a
+ * compact serialized form in an NVStore, and a discovery of a peer found in the cache loads it
+ * instead of asking the peer. The cache of a peer is dropped when it indicates Service Changed.
+ *
+ * Bulk data (firmware images, configuration) is streamed with writes without response sized to
+ * the ATT MTU of the connection. As many writes are kept in the controller as it has free
+ * buffers, read with HCI_CONTROL_COMMAND_READ_BUFF_STATS, and the writes are sent from the
+ * caller's buffer.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+#include "embedded_BLE_nvstore.h"
+#include "embedded_BLE_notification.h"
+#include "embedded_BLE_connection.h"
+
+#include "wiced_hci_bt_gatt.h"
+#include "wiced_hci_bt_dm.h"
+
+/** Maximum number of connections with a GATT client database */
+#ifndef EMBEDDED_BLE_GATT_MAX_CONNECTIONS
+#define EMBEDDED_BLE_GATT_MAX_CONNECTIONS       (4)
+#endif
+
+/** Maximum number of services of a database */
+#ifndef EMBEDDED_BLE_GATT_MAX_SERVICES
+#define EMBEDDED_BLE_GATT_MAX_SERVICES          (8)
+#endif
+
+/** Maximum number of characteristics of a database */
+#ifndef EMBEDDED_BLE_GATT_MAX_CHARACTERISTICS
+#define EMBEDDED_BLE_GATT_MAX_CHARACTERISTICS   (32)
+#endif
+
+/** Maximum number of characteristic descriptors of a database */
+#ifndef EMBEDDED_BLE_GATT_MAX_DESCRIPTORS
+#define EMBEDDED_BLE_GATT_MAX_DESCRIPTORS       (32)
+#endif
+
+/** Number of peers kept in the discovery cache, the one discovered first is replaced */
+#ifndef EMBEDDED_BLE_GATT_CACHE_PEERS
+#define EMBEDDED_BLE_GATT_CACHE_PEERS           (8)
+#endif
+
+/** First NVStore id of the discovery cache, which takes EMBEDDED_BLE_GATT_CACHE_PEERS ids from there */
+#ifndef EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID
+#define EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID      (0xFF00)
+#endif
+
+/** ATT MTU of a connection until the peer negotiates another one */
+#ifndef EMBEDDED_BLE_GATT_DEFAULT_MTU
+#define EMBEDDED_BLE_GATT_DEFAULT_MTU           (23)
+#endif
+
+/** Controller buffers a stream leaves free for the other traffic */
+#ifndef EMBEDDED_BLE_GATT_STREAM_RESERVE
+#define EMBEDDED_BLE_GATT_STREAM_RESERVE        (2)
+#endif
+
+/** Interval of the buffer statistics reads while the controller has no free buffer */
+#ifndef EMBEDDED_BLE_GATT_STREAM_POLL_MS
+#define EMBEDDED_BLE_GATT_STREAM_POLL_MS        (2)
+#endif
+
+/** Time a stream waits for a free controller buffer before giving up */
+#ifndef EMBEDDED_BLE_GATT_STREAM_TIMEOUT_MS
+#define EMBEDDED_BLE_GATT_STREAM_TIMEOUT_MS     (2000)
+#endif
+
+/** Length of a 128-bit UUID */
+#define EMBEDDED_BLE_GATT_UUID_MAX_LENGTH       (16)
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble
+ *
+ * @{
+ */
+
+/** Defines a 16 or 128-bit UUID, little endian */
+struct GattUuid
+{
+    uint8_t length;                         /**< 2 or 16 */
+    uint8_t value[EMBEDDED_BLE_GATT_UUID_MAX_LENGTH]; /**< UUID */
+};
+
+/** Defines a discovered service */
+struct GattService
+{
+    GattUuid uuid;                          /**< Service UUID */
+    uint16_t start_handle;                  /**< First handle */
+    uint16_t end_handle;                    /**< Last handle */
+};
+
+/** Defines a discovered characteristic */
+struct GattCharacteristic
+{
+    GattUuid uuid;                          /**< Characteristic UUID */
+    uint16_t declaration_handle;            /**< Declaration handle */
+    uint16_t value_handle;                  /**< Value handle */
+    uint16_t end_handle;                    /**< Last handle of the characteristic (its descriptors) */
+    uint8_t  properties;                    /**< GATT_CHAR_PROPERTIES_BIT_... */
+    uint8_t  service;                       /**< Index of the service */
+};
+
+/** Defines a discovered characteristic descriptor */
+struct GattDescriptor
+{
+    GattUuid uuid;                          /**< Descriptor UUID */
+    uint16_t handle;                        /**< Descriptor handle */
+    uint8_t  characteristic;                /**< Index of the characteristic */
+};
+
+/** Defines the attribute database of a peer, in handle order */
+struct GattDatabase
+{
+    uint8_t            service_count;       /**< Services */
+    uint8_t            characteristic_count;/**< Characteristics */
+    uint8_t            descriptor_count;    /**< Descriptors */
+    GattService        services[EMBEDDED_BLE_GATT_MAX_SERVICES];               /**< Services */
+    GattCharacteristic characteristics[EMBEDDED_BLE_GATT_MAX_CHARACTERISTICS]; /**< Characteristics */
+    GattDescriptor     descriptors[EMBEDDED_BLE_GATT_MAX_DESCRIPTORS];         /**< Descriptors */
+};
+
+/** Defines the GATT client events */
+enum GattClientEvent
+{
+    GATT_CLIENT_CONNECTED,                  /**< Connection opened */
+    GATT_CLIENT_DISCONNECTED,               /**< Connection closed */
+    GATT_CLIENT_DISCOVERY_COMPLETE,         /**< Database discovered or loaded from the cache */
+    GATT_CLIENT_READ_COMPLETE,              /**< Read response */
+    GATT_CLIENT_WRITE_COMPLETE,             /**< Write response */
+    GATT_CLIENT_NOTIFICATION,               /**< Notification or indication received, after its subscription in the notification table */
+};
+
+/** Defines the GATT client event payload, data is only valid during the callback */
+struct GattClientEventData
+{
+    uint16_t       conn_id;                 /**< Connection id */
+    ble_error_t    status;                  /**< BLE_ERROR_NONE on success */
+    uint16_t       handle;                  /**< Attribute handle */
+    const uint8_t* data;                    /**< Value */
+    uint16_t       length;                  /**< Value length */
+    bool           from_cache;              /**< Discovery: database loaded from the cache */
+    uint32_t       elapsed_ms;              /**< Discovery: time to discover or load the database */
+};
+
+/** Defines the GATT client event callback, called from the WICED HCI event worker (the read thread
+ *  when the controller runs no worker) or the discovering thread */
+typedef void (*GattClientEventCallback_t)(GattClientEvent event, const GattClientEventData& data);
+
+/** Defines the GATT client counters */
+struct GattClientStatistics
+{
+    uint32_t discoveries;                   /**< Discoveries over the air */
+    uint32_t cache_hits;                    /**< Discoveries answered from the cache */
+    uint32_t cache_stores;                  /**< Databases written to the cache */
+    uint32_t cache_invalidations;           /**< Databases dropped from the cache (Service Changed, invalidate) */
+    uint32_t too_large;                     /**< Databases over the EMBEDDED_BLE_GATT_MAX_... limits, not cached */
+    uint32_t procedures;                    /**< Discovery requests sent to the controller */
+    uint32_t discovery_total_ms;            /**< Time spent in discoveries over the air */
+    uint32_t discovery_max_ms;              /**< Longest discovery over the air */
+};
+
+/** Defines the result of a stream */
+struct GattStreamStatistics
+{
+    uint32_t bytes;                         /**< Bytes written */
+    uint32_t packets;                       /**< Writes without response sent */
+    uint16_t packet_length;                 /**< Value length of a write, ATT MTU - 3 */
+    uint32_t elapsed_ms;                    /**< Time to hand the data to the controller */
+    uint32_t bytes_per_second;              /**< Achieved throughput */
+    uint32_t credit_reads;                  /**< Buffer statistics read from the controller */
+    uint32_t credit_waits;                  /**< Times the stream waited for a free controller buffer */
+};
+
+/** Defines the GATT client */
+class GattClient
+{
+public:
+    /**
+     * Gets static singleton instance of the GATT client of a Bluetooth Controller
+     */
+    static GattClient& getInstance(wiced_hci_controller_t controller = WICED_HCI_DEFAULT_CONTROLLER)
+    {
+        if (controller >= WICED_HCI_MAX_CONTROLLERS)
+        {
+            controller = WICED_HCI_DEFAULT_CONTROLLER;
+        }
+        if (client[controller] == NULL)
+        {
+            client[controller] = new GattClient(controller);
+        }
+        return (GattClient&)(*client[controller]);
+    }
+
+    /** Registers the GATT client with the WICED HCI GATT events */
+    ble_error_t initialize(void);
+
+    /** Sets the discovery cache store, NULL discovers every time.
+     *  The cache takes the ids from EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID, Mesh::restoreNVData skips them.
+     */
+    void setStore(NVStore* store);
+
+    /** Sets the event callback */
+    void setEventCallback(GattClientEventCallback_t callback);
+
+    /** Sets the connection manager told of the connections and disconnections, NULL for none */
+    void setConnectionManager(ConnectionManager* manager);
+
+    /** Reports a connection opened, done by the GATT_CONNECTION_STATUS_EVT handler.
+     *
+     * @param[in] conn_id:   connection id
+     * @param[in] address:   peer identity address
+     * @param[in] addr_type: BLE_ADDR_...
+     */
+    ble_error_t connected(uint16_t conn_id, const uint8_t* address, uint8_t addr_type);
+
+    /** Reports a connection closed */
+    void disconnected(uint16_t conn_id);
+
+    /** Discovers the database of a connected peer, GATT_CLIENT_DISCOVERY_COMPLETE reports the end.
+     *
+     * @param[in] conn_id: connection id
+     * @param[in] refresh: ignore the cache and discover again
+     *
+     * @return BLE_ERROR_INVALID_STATE when not connected or already discovering
+     */
+    ble_error_t discover(uint16_t conn_id, bool refresh = false);
+
+    /** Drops a peer from the discovery cache */
+    ble_error_t invalidate(const uint8_t* address, uint8_t addr_type);
+
+    /** Copies the database of a connection.
+     *
+     * @return BLE_ERROR_INVALID_STATE when it is not discovered
+     */
+    ble_error_t getDatabase(uint16_t conn_id, GattDatabase& database);
+
+    /** Finds the first characteristic with a UUID.
+     *
+     * @return BLE_ERROR_NOT_FOUND when the database has none
+     */
+    ble_error_t findCharacteristic(uint16_t conn_id, const GattUuid& uuid, GattCharacteristic& characteristic);
+
+    /** Reads an attribute, GATT_CLIENT_READ_COMPLETE carries the value */
+    ble_error_t read(uint16_t conn_id, uint16_t handle);
+
+    /** Writes an attribute, GATT_CLIENT_WRITE_COMPLETE follows a write with response */
+    ble_error_t write(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint16_t length, bool with_response = true);
+
+    /** Returns the notification table, the subscriptions of a connection are dropped when it closes */
+    GattNotificationTable& getNotificationTable(void)
+    {
+        return notifications;
+    }
+
+    /** Returns the ATT MTU of a connection, 0 when not connected */
+    uint16_t getMtu(uint16_t conn_id);
+
+    /** Streams data to an attribute with writes without response of ATT MTU - 3 bytes, one
+     *  stream at a time. Blocks until the last write is handed to the controller.
+     *
+     * @param[in]  conn_id: connection id
+     * @param[in]  handle:  attribute handle
+     * @param[in]  data:    data, sent from this buffer
+     * @param[in]  length:  data length
+     * @param[out] result:  throughput and credit counters, may be NULL
+     *
+     * @return BLE_ERROR_INVALID_STATE when the connection closes,
+     *         BLE_ERROR_INITIALIZATION_INCOMPLETE when the controller frees no buffer in EMBEDDED_BLE_GATT_STREAM_TIMEOUT_MS
+     */
+    ble_error_t stream(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint32_t length, GattStreamStatistics* result = NULL);
+
+    /** Serializes a database: returns the length, 0 when size is too small */
+    static uint16_t serialize(const GattDatabase& database, uint8_t* buffer, uint16_t size);
+
+    /** Deserializes a database.
+     *
+     * @return false when the data is not a valid database
+     */
+    static bool deserialize(const uint8_t* buffer, uint16_t length, GattDatabase& database);
+
+    /** Handles a WICED GATT event, registered by GattClient::initialize */
+    static wiced_bt_gatt_status_t gattCallback(wiced_hci_controller_t controller, wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t* p_event_data);
+
+    /** Handles the buffer statistics of the controller, registered by GattClient::stream */
+    static void bufferStatsCallback(wiced_hci_controller_t controller, const wiced_bt_buffer_statistics_t* p_stats, uint8_t count);
+
+    /** Copies the counters */
+    void getStatistics(GattClientStatistics& stats);
+
+private:
+    enum DiscoveryPhase
+    {
+        PHASE_IDLE,
+        PHASE_SERVICES,
+        PHASE_CHARACTERISTICS,
+        PHASE_DESCRIPTORS,
+        PHASE_DONE,
+    };
+
+    struct Connection
+    {
+        bool         used;
+        uint16_t     conn_id;
+        uint8_t      address[6];
+        uint8_t      addr_type;
+        uint16_t     mtu;
+        uint8_t      phase;
+        uint8_t      index;
+        bool         overflow;
+        uint32_t     started_ms;
+        GattDatabase database;
+    };
+
+    Connection* find(uint16_t conn_id);
+    bool next(Connection& connection, wiced_bt_gatt_discovery_type_t& type, wiced_bt_gatt_discovery_param_t& param);
+    void discovered(Connection& connection, const wiced_bt_gatt_discovery_result_t& result);
+    int  findCache(const uint8_t* address, uint8_t addr_type, uint16_t* length);
+    bool loadCache(Connection& connection);
+    void storeCache(Connection& connection);
+    void complete(uint16_t conn_id, ble_error_t status, bool from_cache, uint32_t elapsed_ms);
+    void notify(GattClientEvent event, GattClientEventData& data);
+    void handleEvent(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t* p_event_data);
+    bool requestCredits(uint32_t queued);
+    void creditsReceived(const wiced_bt_buffer_statistics_t* p_stats, uint8_t count);
+
+    static GattClient* client[WICED_HCI_MAX_CONTROLLERS];
+
+    wiced_hci_controller_t    controller;
+    Connection                connections[EMBEDDED_BLE_GATT_MAX_CONNECTIONS];
+    NVStore*                  store;
+    GattClientEventCallback_t event_callback;
+    ConnectionManager*        connection_manager;
+    GattClientStatistics      statistics;
+    uint32_t                  cache_sequence;
+    uint8_t                   record[EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE];
+    GattNotificationTable     notifications;
+    rtos::Mutex               lock;
+    rtos::Mutex               stream_lock;
+    rtos::ConditionVariable   credits_changed;
+    bool                      streaming;
+    bool                      credits_pending;
+    int32_t                   credits;
+    uint16_t                  stream_buffer_size;
+    uint32_t                  stream_sent;
+    uint32_t                  stream_sent_at_request;
+
+    GattClient(wiced_hci_controller_t controller);
+    GattClient(GattClient const&);              // copy constructor is private
+    GattClient& operator=(GattClient const&);   // assignment operator is private
+};
+
+/** @} */
+}
+
+}
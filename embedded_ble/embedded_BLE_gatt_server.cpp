@@ -0,0 +1,352 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth GATT server
+ */
+
+#include <string.h>
+#include "embedded_BLE_gatt_server.h"
+
+using namespace cypress::embedded;
+
+#define GATT_SERVER_UUID_PRIMARY_SERVICE    (0x2800)
+#define GATT_SERVER_UUID_CHARACTERISTIC     (0x2803)
+#define GATT_SERVER_PERM_UUID_128           (0x80)
+#define GATT_SERVER_UUID16_SIZE             (2)
+#define GATT_SERVER_UUID128_SIZE            (16)
+
+GattServer* GattServer::server[WICED_HCI_MAX_CONTROLLERS];
+
+GattServer::GattServer(wiced_hci_controller_t controller) :
+    controller(controller), attributes(NULL), attribute_count(0), write_callback(NULL)
+{
+    memset(offsets, 0, sizeof(offsets));
+    memset(lengths, 0, sizeof(lengths));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+static uint8_t* serializeUuid(const GattServerAttribute& attribute, uint8_t* p)
+{
+    if (attribute.uuid128)
+    {
+        memcpy(p, attribute.uuid128, GATT_SERVER_UUID128_SIZE);
+        return p + GATT_SERVER_UUID128_SIZE;
+    }
+    *p++ = (uint8_t)attribute.uuid16;
+    *p++ = (uint8_t)(attribute.uuid16 >> 8);
+
+    return p;
+}
+
+uint16_t GattServer::serialize(const GattServerAttribute* attributes, uint16_t count, uint8_t* buffer, uint16_t size)
+{
+    uint8_t* p = buffer;
+    uint16_t i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        const GattServerAttribute& attribute = attributes[i];
+        uint16_t                   handle    = i + 1;
+        uint8_t                    uuid_size = attribute.uuid128 ? GATT_SERVER_UUID128_SIZE : GATT_SERVER_UUID16_SIZE;
+
+        // Largest record: characteristic declaration with a 128-bit UUID
+        if (p + 5 + 3 + GATT_SERVER_UUID128_SIZE > buffer + size)
+        {
+            return 0;
+        }
+
+        *p++ = (uint8_t)handle;
+        *p++ = (uint8_t)(handle >> 8);
+
+        switch (attribute.kind)
+        {
+        case GATT_SERVER_ATTRIBUTE_SERVICE:
+            *p++ = GATT_SERVER_PERM_READABLE;
+            *p++ = GATT_SERVER_UUID16_SIZE + uuid_size;
+            *p++ = (uint8_t)GATT_SERVER_UUID_PRIMARY_SERVICE;
+            *p++ = (uint8_t)(GATT_SERVER_UUID_PRIMARY_SERVICE >> 8);
+            p = serializeUuid(attribute, p);
+            break;
+
+        case GATT_SERVER_ATTRIBUTE_CHARACTERISTIC:
+            *p++ = GATT_SERVER_PERM_READABLE;
+            *p++ = GATT_SERVER_UUID16_SIZE + 3 + uuid_size;
+            *p++ = (uint8_t)GATT_SERVER_UUID_CHARACTERISTIC;
+            *p++ = (uint8_t)(GATT_SERVER_UUID_CHARACTERISTIC >> 8);
+            *p++ = attribute.properties;
+            *p++ = (uint8_t)(handle + 1);
+            *p++ = (uint8_t)((handle + 1) >> 8);
+            p = serializeUuid(attribute, p);
+            break;
+
+        default:
+            // The writable values and descriptors have a reserved byte in front of their UUID
+            *p++ = attribute.permissions | (attribute.uuid128 ? GATT_SERVER_PERM_UUID_128 : 0);
+            *p++ = uuid_size;
+            if (attribute.permissions & GATT_SERVER_PERM_WRITABLE)
+            {
+                *p++ = 0;
+            }
+            p = serializeUuid(attribute, p);
+            break;
+        }
+    }
+
+    return (uint16_t)(p - buffer);
+}
+
+ble_error_t GattServer::setDatabase(const GattServerAttribute* attributes, uint16_t count)
+{
+    uint32_t offset = 0;
+    uint16_t length = 0;
+    uint16_t i      = 0;
+
+    if (attributes == NULL || count > EMBEDDED_BLE_GATT_SERVER_MAX_ATTRIBUTES)
+    {
+        return BLE_ERROR_NO_MEM;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        uint8_t kind = attributes[i].kind;
+        uint8_t prev = i ? attributes[i - 1].kind : GATT_SERVER_ATTRIBUTE_SERVICE;
+
+        if ((kind == GATT_SERVER_ATTRIBUTE_VALUE && prev != GATT_SERVER_ATTRIBUTE_CHARACTERISTIC) ||
+            (kind == GATT_SERVER_ATTRIBUTE_DESCRIPTOR && prev != GATT_SERVER_ATTRIBUTE_VALUE && prev != GATT_SERVER_ATTRIBUTE_DESCRIPTOR) ||
+            (kind == GATT_SERVER_ATTRIBUTE_CHARACTERISTIC && (i + 1 == count || attributes[i + 1].kind != GATT_SERVER_ATTRIBUTE_VALUE)) ||
+            kind > GATT_SERVER_ATTRIBUTE_DESCRIPTOR)
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
+        offset += attributes[i].max_length;
+    }
+    if (offset > EMBEDDED_BLE_GATT_SERVER_VALUE_SIZE)
+    {
+        return BLE_ERROR_NO_MEM;
+    }
+
+    lock.lock();
+    length = serialize(attributes, count, database, sizeof(database));
+    if (length == 0 && count)
+    {
+        lock.unlock();
+        return BLE_ERROR_NO_MEM;
+    }
+
+    this->attributes = attributes;
+    attribute_count  = count;
+    offset           = 0;
+    for (i = 0; i < count; i++)
+    {
+        offsets[i] = (uint16_t)offset;
+        lengths[i] = 0;
+        offset    += attributes[i].max_length;
+    }
+    memset(values, 0, sizeof(values));
+    lock.unlock();
+
+    // Requests only arrive once the controller has the database, the buffer is not changed again
+    if (wiced_bt_gatt_db_init(controller, database, length) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INTERNAL_STACK_FAILURE;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattServer::setValue(uint16_t handle, const uint8_t* data, uint16_t length)
+{
+    uint16_t index = handle - 1;
+
+    lock.lock();
+    if (handle == 0 || index >= attribute_count || length > attributes[index].max_length || (length && data == NULL))
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_PARAM;
+    }
+    memcpy(&values[offsets[index]], data, length);
+    lengths[index] = length;
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattServer::getValue(uint16_t handle, uint8_t* data, uint16_t size, uint16_t* length)
+{
+    uint16_t index = handle - 1;
+
+    lock.lock();
+    if (handle == 0 || index >= attribute_count || attributes[index].max_length == 0 || size < lengths[index])
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_PARAM;
+    }
+    memcpy(data, &values[offsets[index]], lengths[index]);
+    *length = lengths[index];
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+void GattServer::setWriteCallback(GattServerWriteCallback_t callback)
+{
+    lock.lock();
+    write_callback = callback;
+    lock.unlock();
+}
+
+/* Called with lock held, returns the length of the attribute value */
+uint16_t GattServer::readAttribute(uint16_t index, uint16_t offset, uint8_t* data, uint16_t size)
+{
+    const GattServerAttribute& attribute = attributes[index];
+    uint8_t                    declaration[3 + GATT_SERVER_UUID128_SIZE];
+    const uint8_t*             value  = &values[offsets[index]];
+    uint16_t                   length = lengths[index];
+
+    // The declarations are served by the controller, they are built here for completeness
+    if (attribute.kind == GATT_SERVER_ATTRIBUTE_CHARACTERISTIC)
+    {
+        declaration[0] = attribute.properties;
+        declaration[1] = (uint8_t)(index + 2);
+        declaration[2] = (uint8_t)((index + 2) >> 8);
+        length = (uint16_t)(serializeUuid(attribute, &declaration[3]) - declaration);
+        value  = declaration;
+    }
+    else if (attribute.kind == GATT_SERVER_ATTRIBUTE_SERVICE)
+    {
+        length = (uint16_t)(serializeUuid(attribute, declaration) - declaration);
+        value  = declaration;
+    }
+
+    if (offset < length)
+    {
+        memcpy(data, value + offset, (length - offset < size) ? length - offset : size);
+    }
+
+    return length;
+}
+
+wiced_bt_gatt_status_t GattServer::handleRequest(const wiced_bt_gatt_attribute_request_t& request)
+{
+    wiced_bt_gatt_status_t    status   = WICED_BT_GATT_SUCCESS;
+    GattServerWriteCallback_t callback = NULL;
+    uint16_t                  handle   = 0;
+    uint16_t                  index    = 0;
+    uint16_t                  length   = 0;
+
+    lock.lock();
+    if (request.request_type == GATTS_REQ_TYPE_READ)
+    {
+        const wiced_bt_gatt_read_t& read = request.data.read_req;
+
+        handle = read.handle;
+        index  = handle - 1;
+        if (handle == 0 || index >= attribute_count)
+        {
+            status = WICED_BT_GATT_INVALID_HANDLE;
+        }
+        else if (!(attributes[index].permissions & (GATT_SERVER_PERM_READABLE | GATT_SERVER_PERM_AUTH_READABLE)))
+        {
+            status = WICED_BT_GATT_READ_NOT_PERMIT;
+        }
+        else
+        {
+            length = readAttribute(index, read.offset, read.p_val, *read.p_val_len);
+            if (read.offset > length)
+            {
+                status = WICED_BT_GATT_INVALID_OFFSET;
+            }
+            else
+            {
+                length -= read.offset;
+                *read.p_val_len = (length < *read.p_val_len) ? length : *read.p_val_len;
+                statistics.reads++;
+            }
+        }
+    }
+    else if (request.request_type == GATTS_REQ_TYPE_WRITE)
+    {
+        const wiced_bt_gatt_write_t& write = request.data.write_req;
+
+        handle = write.handle;
+        index  = handle - 1;
+        if (handle == 0 || index >= attribute_count)
+        {
+            status = WICED_BT_GATT_INVALID_HANDLE;
+        }
+        else if (!(attributes[index].permissions & GATT_SERVER_PERM_WRITABLE))
+        {
+            status = WICED_BT_GATT_WRITE_NOT_PERMIT;
+        }
+        else if (write.offset > lengths[index])
+        {
+            status = WICED_BT_GATT_INVALID_OFFSET;
+        }
+        else if (write.offset + write.val_len > attributes[index].max_length)
+        {
+            status = WICED_BT_GATT_INVALID_ATTR_LEN;
+        }
+        else
+        {
+            memcpy(&values[offsets[index] + write.offset], write.p_val, write.val_len);
+            lengths[index] = write.offset + write.val_len;
+            callback = write_callback;
+            statistics.writes++;
+        }
+    }
+    else
+    {
+        status = WICED_BT_GATT_REQ_NOT_SUPPORTED;
+    }
+
+    if (status != WICED_BT_GATT_SUCCESS)
+    {
+        statistics.errors++;
+    }
+    lock.unlock();
+
+    // Called without the lock, the callback may set values
+    if (callback)
+    {
+        status = callback(request.conn_id, handle, request.data.write_req.p_val, request.data.write_req.val_len);
+    }
+
+    return status;
+}
+
+void GattServer::getStatistics(GattServerStatistics& stats)
+{
+    lock.lock();
+    stats = statistics;
+    lock.unlock();
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth GATT server
+ *
+ * Serves a GATT database held by the host. The database is a constant table of attributes
+ * built at compile time with the GATT_SERVER_... macros, in handle order from handle 1: the
+ * handle of an attribute is its index in the table plus one, so that a request finds its
+ * attribute and its value with an index and no search.
+ *
+ *     static constexpr GattServerAttribute battery[] =
+ *     {
+ *         GATT_SERVER_PRIMARY_SERVICE(0x180F),                                         // handle 1
+ *         GATT_SERVER_CHARACTERISTIC(0x2A19, GATT_CHAR_PROPERTIES_BIT_READ |
+ *                                    GATT_CHAR_PROPERTIES_BIT_NOTIFY,
+ *                                    GATT_SERVER_PERM_READABLE, 1),                    // handles 2, 3
+ *         GATT_SERVER_DESCRIPTOR(0x2902, GATT_SERVER_PERM_READABLE |
+ *                                GATT_SERVER_PERM_WRITE_REQ, 2),                       // handle 4
+ *     };
+ *     static_assert(gattServerValueSize(battery) <= EMBEDDED_BLE_GATT_SERVER_VALUE_SIZE, "values too large");
+ *
+ * GattServer::setDatabase gives the table to the controller, which serves the declarations and
+ * forwards the reads and writes of the values and descriptors. They are answered, one at a time,
+ * by the WICED HCI event worker of the GATT group out of a value store sized at compile time,
+ * without allocation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+
+#include "wiced_hci_bt_gatt.h"
+
+/** Maximum number of attributes of the database */
+#ifndef EMBEDDED_BLE_GATT_SERVER_MAX_ATTRIBUTES
+#define EMBEDDED_BLE_GATT_SERVER_MAX_ATTRIBUTES     (64)
+#endif
+
+/** Size of the value store: sum of the maximum lengths of the values and descriptors */
+#ifndef EMBEDDED_BLE_GATT_SERVER_VALUE_SIZE
+#define EMBEDDED_BLE_GATT_SERVER_VALUE_SIZE         (1024)
+#endif
+
+/** Largest database in the controller's format */
+#ifndef EMBEDDED_BLE_GATT_SERVER_DB_SIZE
+#define EMBEDDED_BLE_GATT_SERVER_DB_SIZE            (1024)
+#endif
+
+/** Attribute permissions, the controller's GATT database permission bits */
+#define GATT_SERVER_PERM_VARIABLE_LENGTH            (0x01)
+#define GATT_SERVER_PERM_READABLE                   (0x02)
+#define GATT_SERVER_PERM_WRITE_CMD                  (0x04)
+#define GATT_SERVER_PERM_WRITE_REQ                  (0x08)
+#define GATT_SERVER_PERM_AUTH_READABLE              (0x10)
+#define GATT_SERVER_PERM_RELIABLE_WRITE             (0x20)
+#define GATT_SERVER_PERM_AUTH_WRITABLE              (0x40)
+#define GATT_SERVER_PERM_WRITABLE                   (GATT_SERVER_PERM_WRITE_CMD | GATT_SERVER_PERM_WRITE_REQ | GATT_SERVER_PERM_AUTH_WRITABLE)
+
+/** Attribute kinds */
+#define GATT_SERVER_ATTRIBUTE_SERVICE               (0)
+#define GATT_SERVER_ATTRIBUTE_CHARACTERISTIC        (1)
+#define GATT_SERVER_ATTRIBUTE_VALUE                 (2)
+#define GATT_SERVER_ATTRIBUTE_DESCRIPTOR            (3)
+
+/** Primary service with a 16-bit UUID */
+#define GATT_SERVER_PRIMARY_SERVICE(uuid16) \
+    { GATT_SERVER_ATTRIBUTE_SERVICE, 0, GATT_SERVER_PERM_READABLE, (uuid16), NULL, 0 }
+
+/** Primary service with a 128-bit UUID, uuid128 a constant array of 16 bytes, little endian */
+#define GATT_SERVER_PRIMARY_SERVICE_128(uuid128) \
+    { GATT_SERVER_ATTRIBUTE_SERVICE, 0, GATT_SERVER_PERM_READABLE, 0, (uuid128), 0 }
+
+/** Characteristic with a 16-bit UUID: its declaration and its value, max_length bytes */
+#define GATT_SERVER_CHARACTERISTIC(uuid16, properties, permissions, max_length) \
+    { GATT_SERVER_ATTRIBUTE_CHARACTERISTIC, (properties), GATT_SERVER_PERM_READABLE, (uuid16), NULL, 0 }, \
+    { GATT_SERVER_ATTRIBUTE_VALUE, (properties), (permissions), (uuid16), NULL, (max_length) }
+
+/** Characteristic with a 128-bit UUID */
+#define GATT_SERVER_CHARACTERISTIC_128(uuid128, properties, permissions, max_length) \
+    { GATT_SERVER_ATTRIBUTE_CHARACTERISTIC, (properties), GATT_SERVER_PERM_READABLE, 0, (uuid128), 0 }, \
+    { GATT_SERVER_ATTRIBUTE_VALUE, (properties), (permissions), 0, (uuid128), (max_length) }
+
+/** Characteristic descriptor with a 16-bit UUID, after its characteristic */
+#define GATT_SERVER_DESCRIPTOR(uuid16, permissions, max_length) \
+    { GATT_SERVER_ATTRIBUTE_DESCRIPTOR, 0, (permissions), (uuid16), NULL, (max_length) }
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble
+ *
+ * @{
+ */
+
+/** Defines an attribute of the GATT server database, built with the GATT_SERVER_... macros */
+struct GattServerAttribute
+{
+    uint8_t        kind;                    /**< GATT_SERVER_ATTRIBUTE_... */
+    uint8_t        properties;              /**< Characteristic: GATT_CHAR_PROPERTIES_BIT_... */
+    uint8_t        permissions;             /**< GATT_SERVER_PERM_... */
+    uint16_t       uuid16;                  /**< 16-bit UUID, when uuid128 is NULL */
+    const uint8_t* uuid128;                 /**< 128-bit UUID, little endian */
+    uint16_t       max_length;              /**< Value and descriptor: size of the value */
+};
+
+/** Returns the value store taken by a database, to check it at compile time */
+template <uint16_t N>
+constexpr uint32_t gattServerValueSize(const GattServerAttribute (&attributes)[N])
+{
+    uint32_t size = 0;
+
+    for (uint16_t i = 0; i < N; i++)
+    {
+        size += attributes[i].max_length;
+    }
+
+    return size;
+}
+
+/** Defines the write callback, called from the WICED HCI event worker of the GATT group once the value is stored.
+ *
+ * @return WICED_BT_GATT_SUCCESS, or the error answered to the peer (the value is still stored)
+ */
+typedef wiced_bt_gatt_status_t (*GattServerWriteCallback_t)(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint16_t length);
+
+/** Defines the GATT server counters */
+struct GattServerStatistics
+{
+    uint32_t reads;                         /**< Read requests answered */
+    uint32_t writes;                        /**< Write requests stored */
+    uint32_t errors;                        /**< Requests answered with an error */
+};
+
+/** Defines the GATT server */
+class GattServer
+{
+public:
+    /**
+     * Gets static singleton instance of the GATT server of a Bluetooth Controller
+     */
+    static GattServer& getInstance(wiced_hci_controller_t controller = WICED_HCI_DEFAULT_CONTROLLER)
+    {
+        if (controller >= WICED_HCI_MAX_CONTROLLERS)
+        {
+            controller = WICED_HCI_DEFAULT_CONTROLLER;
+        }
+        if (server[controller] == NULL)
+        {
+            server[controller] = new GattServer(controller);
+        }
+        return (GattServer&)(*server[controller]);
+    }
+
+    /** Sets the database, clears the values and gives the database to the controller.
+     *
+     * @param[in] attributes: table, kept by the server
+     * @param[in] count:      attributes of the table
+     *
+     * @return BLE_ERROR_NO_MEM when the table is over EMBEDDED_BLE_GATT_SERVER_... limits,
+     *         BLE_ERROR_INVALID_PARAM when a characteristic value or descriptor is misplaced
+     */
+    ble_error_t setDatabase(const GattServerAttribute* attributes, uint16_t count);
+
+    /** Sets the database from a table */
+    template <uint16_t N>
+    ble_error_t setDatabase(const GattServerAttribute (&attributes)[N])
+    {
+        static_assert(N <= EMBEDDED_BLE_GATT_SERVER_MAX_ATTRIBUTES, "too many attributes");
+        return setDatabase(attributes, N);
+    }
+
+    /** Sets the value of a characteristic or descriptor, for example a sensor reading.
+     *
+     * @return BLE_ERROR_INVALID_PARAM when the handle has no value or length is over its maximum
+     */
+    ble_error_t setValue(uint16_t handle, const uint8_t* data, uint16_t length);
+
+    /** Copies the value of a characteristic or descriptor */
+    ble_error_t getValue(uint16_t handle, uint8_t* data, uint16_t size, uint16_t* length);
+
+    /** Sets the write callback */
+    void setWriteCallback(GattServerWriteCallback_t callback);
+
+    /** Answers a read or write request, called for GATT_ATTRIBUTE_REQUEST_EVT */
+    wiced_bt_gatt_status_t handleRequest(const wiced_bt_gatt_attribute_request_t& request);
+
+    /** Writes a database in the controller's format: returns the length, 0 when size is too small */
+    static uint16_t serialize(const GattServerAttribute* attributes, uint16_t count, uint8_t* buffer, uint16_t size);
+
+    /** Copies the counters */
+    void getStatistics(GattServerStatistics& stats);
+
+private:
+    uint16_t readAttribute(uint16_t index, uint16_t offset, uint8_t* data, uint16_t size);
+
+    static GattServer* server[WICED_HCI_MAX_CONTROLLERS];
+
+    wiced_hci_controller_t     controller;
+    const GattServerAttribute* attributes;
+    uint16_t                   attribute_count;
+    uint16_t                   offsets[EMBEDDED_BLE_GATT_SERVER_MAX_ATTRIBUTES];
+    uint16_t                   lengths[EMBEDDED_BLE_GATT_SERVER_MAX_ATTRIBUTES];
+    uint8_t                    values[EMBEDDED_BLE_GATT_SERVER_VALUE_SIZE];
+    uint8_t                    database[EMBEDDED_BLE_GATT_SERVER_DB_SIZE];
+    GattServerWriteCallback_t  write_callback;
+    GattServerStatistics       statistics;
+    rtos::Mutex                lock;
+
+    GattServer(wiced_hci_controller_t controller);
+    GattServer(GattServer const&);              // copy constructor is private
+    GattServer& operator=(GattServer const&);   // assignment operator is private
+};
+
+/** @} */
+}
+
+}
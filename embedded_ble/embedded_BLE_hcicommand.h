@@ -0,0 +1,215 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth WICED HCI command encoders
+ *
+ * One struct per command with a fixed wire layout: its opcode and payload length are compile
+ * time constants and encode() writes the payload in place. HciCommandFrame<Command> is the
+ * complete packet (header and payload) sized for the command, so a command is serialized once,
+ * directly into the bytes handed to the UART, without heap or a maximum size frame buffer:
+ *
+ *     sendHciCommand(controller, HciSetLocalBdaddr(bd_addr));
+ *
+ * Encoders are constexpr, a command whose fields are constants can be encoded by the compiler
+ * into a constant frame sent with sendHciFrame. The packets are byte for byte those of the
+ * WICED HCI functions of the same commands.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "wiced_bt_hci.h"
+#include "wiced_hci.h"
+#include "embedded_BLE_advertiser.h"
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble
+ *
+ * @{
+ */
+
+/** WICED HCI packet of a command: header then the payload written by the command */
+template <typename Command>
+struct HciCommandFrame
+{
+    static_assert(Command::length <= WICED_HCI_MAX_PAYLOAD_LENGTH, "command exceeds the WICED HCI transport MTU");
+
+    static const uint16_t size = WICED_HCI_HEADER_LENGTH + Command::length;   /**< Packet length */
+
+    uint8_t bytes[size];                                                        /**< Packet */
+
+    constexpr explicit HciCommandFrame(const Command& command) : bytes()
+    {
+        bytes[0] = HCI_WICED_PKT;
+        bytes[1] = Command::opcode & 0xff;
+        bytes[2] = (Command::opcode >> 8) & 0xff;
+        bytes[3] = Command::length & 0xff;
+        bytes[4] = (Command::length >> 8) & 0xff;
+        command.encode(&bytes[WICED_HCI_HEADER_LENGTH]);
+    }
+};
+
+/** Sends a frame encoded beforehand, by the compiler for a constant command */
+template <typename Command>
+inline void sendHciFrame(wiced_hci_controller_t controller, const HciCommandFrame<Command>& frame)
+{
+    wiced_hci_send_frame(controller, frame.bytes, frame.size);
+}
+
+/** Encodes a command into its frame and sends it */
+template <typename Command>
+inline void sendHciCommand(wiced_hci_controller_t controller, const Command& command)
+{
+    HciCommandFrame<Command> frame(command);
+
+    wiced_hci_send_frame(controller, frame.bytes, frame.size);
+}
+
+/** HCI_CONTROL_COMMAND_SET_LOCAL_BDA: address sent most significant byte first, see wiced_bt_set_local_bdaddr */
+struct HciSetLocalBdaddr
+{
+    static const uint16_t opcode = HCI_CONTROL_COMMAND_SET_LOCAL_BDA;
+    static const uint16_t length = BD_ADDR_LEN;
+
+    const uint8_t* bd_addr;
+
+    constexpr explicit HciSetLocalBdaddr(const uint8_t (&bd_addr)[BD_ADDR_LEN]) : bd_addr(bd_addr)
+    {
+    }
+
+    constexpr void encode(uint8_t* p) const
+    {
+        for (uint8_t i = 0; i < BD_ADDR_LEN; i++)
+        {
+            p[i] = bd_addr[BD_ADDR_LEN - 1 - i];
+        }
+    }
+};
+
+/** HCI_CONTROL_COMMAND_PUSH_NVRAM_DATA: id then Length bytes of a saved NVRAM record, see wiced_bt_mesh_push_nvram_data.
+ *  The frame does not take a restore credit, records of wiced_bt_mesh_restore_nvram_begin go through the function. */
+template <uint16_t Length>
+struct HciPushNvramData
+{
+    static const uint16_t opcode = HCI_CONTROL_COMMAND_PUSH_NVRAM_DATA;
+    static const uint16_t length = 2 + Length;
+
+    uint16_t       idx;
+    const uint8_t* data;
+
+    constexpr HciPushNvramData(uint16_t idx, const uint8_t (&data)[Length]) : idx(idx), data(data)
+    {
+    }
+
+    constexpr void encode(uint8_t* p) const
+    {
+        p[0] = idx & 0xff;
+        p[1] = (idx >> 8) & 0xff;
+        for (uint16_t i = 0; i < Length; i++)
+        {
+            p[2 + i] = data[i];
+        }
+    }
+};
+
+/** Compile time layout of the elements of HciSetRawAdvertisementData: type, 16-bit length most
+ *  significant byte first, data and a null byte */
+template <typename... Fields>
+struct HciAdElements
+{
+    static const uint16_t size  = 0;
+    static const uint8_t  count = 0;
+
+    static constexpr void write(uint8_t* p, const uint8_t* const* data)
+    {
+        (void)p;
+        (void)data;
+    }
+};
+
+template <typename First, typename... Rest>
+struct HciAdElements<First, Rest...>
+{
+    static const uint8_t  count = 1 + HciAdElements<Rest...>::count;
+    static const uint16_t size  = 4 + First::length + HciAdElements<Rest...>::size;
+
+    static constexpr void write(uint8_t* p, const uint8_t* const* data)
+    {
+        p[0] = First::type;
+        p[1] = 0;
+        p[2] = First::length;
+        for (uint8_t i = 0; i < First::length; i++)
+        {
+            p[3 + i] = data[0][i];
+        }
+        p[3 + First::length] = 0;
+        HciAdElements<Rest...>::write(p + 4 + First::length, data + 1);
+    }
+};
+
+/** HCI_CONTROL_LE_COMMAND_SET_RAW_ADVERTISE_DATA: element count then the AdField elements, see
+ *  wiced_bt_ble_set_raw_advertisement_data */
+template <typename... Fields>
+struct HciSetRawAdvertisementData
+{
+    typedef HciAdElements<Fields...> Layout;
+
+    static_assert(Layout::count > 0, "raw advertisement data without element");
+
+    static const uint16_t opcode = HCI_CONTROL_LE_COMMAND_SET_RAW_ADVERTISE_DATA;
+    static const uint16_t length = 1 + Layout::size;
+
+    const uint8_t* data[Layout::count];
+
+    constexpr explicit HciSetRawAdvertisementData(const uint8_t (&... data)[Fields::length]) : data{ data... }
+    {
+    }
+
+    constexpr void encode(uint8_t* p) const
+    {
+        p[0] = Layout::count;
+        Layout::write(p + 1, data);
+    }
+};
+
+/** @} */
+}
+
+}
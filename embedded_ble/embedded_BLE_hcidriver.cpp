@@ -36,24 +36,26 @@
 
 using namespace cypress::embedded;
 
-void EmbeddedHCIDriver::initialize()
+static EmbeddedHCIDriver* attached_drivers[WICED_HCI_MAX_CONTROLLERS];
+
+void EmbeddedHCIDriver::initialize(wiced_hci_controller_t controller)
 {
-    _transport_driver.initialize();
+    _transport_driver->initialize(controller);
     do_initialize();
 }
 
 void EmbeddedHCIDriver::terminate()
 {
     do_terminate();
-    _transport_driver.terminate();
+    _transport_driver->terminate();
 }
 
 uint16_t EmbeddedHCIDriver::write(uint8_t type, uint16_t len, uint8_t *pData)
 {
-    return _transport_driver.write(type, len, pData);
+    return _transport_driver->write(type, len, pData);
 }
 
-EmbeddedHCIDriver& ble_get_embedded_hci_driver() {
+static EmbeddedHCIDriver& ble_get_onboard_hci_driver() {
     static EmbeddedHCITransportDriver transport_driver(
         /* TX */ CYBSP_BT_UART_TX, /* RX */ CYBSP_BT_UART_RX,
         /* cts */ CYBSP_BT_UART_CTS, /* rts */ CYBSP_BT_UART_RTS, 115200,
@@ -65,3 +67,21 @@ EmbeddedHCIDriver& ble_get_embedded_hci_driver() {
     );
     return hci_driver;
 }
+
+EmbeddedHCIDriver* ble_get_embedded_hci_driver(wiced_hci_controller_t controller) {
+    if (controller >= WICED_HCI_MAX_CONTROLLERS) {
+        return NULL;
+    }
+    if (attached_drivers[controller] == NULL && controller == WICED_HCI_DEFAULT_CONTROLLER) {
+        return &ble_get_onboard_hci_driver();
+    }
+    return attached_drivers[controller];
+}
+
+bool ble_attach_embedded_hci_driver(wiced_hci_controller_t controller, EmbeddedHCIDriver& driver) {
+    if (controller >= WICED_HCI_MAX_CONTROLLERS) {
+        return false;
+    }
+    attached_drivers[controller] = &driver;
+    return true;
+}
@@ -63,7 +63,7 @@ public:
      * @param bt_power_name : BT Power-on Pin
      */
     EmbeddedHCIDriver(EmbeddedHCITransportDriver& transport_driver, PinName bt_power_name):
-        _transport_driver(transport_driver),
+        _transport_driver(&transport_driver),
         bt_power_name(bt_power_name),
         bt_power(bt_power_name, PIN_OUTPUT, PullUp, 0)
         { }
@@ -77,8 +77,10 @@ public:
      * Initialize the Embedded HCI driver.
      * This function start by initializing the transport driver then it delegates
      * what's remain of the initialization to the function do_initialize.
+     *
+     * @param controller The controller driven, see ble_attach_embedded_hci_driver.
      */
-    void initialize();
+    virtual void initialize(wiced_hci_controller_t controller);
 
     /**
      * Termination of the driver.
@@ -86,7 +88,7 @@ public:
      *   - do_terminate
      *   - terminate the transport driver.
      */
-    void terminate();
+    virtual void terminate();
 
     /**
      * Signal to the stack that the reset sequence has been done.
@@ -104,7 +106,18 @@ public:
      *
      * @return The number of bytes which have been transmited.
      */
-    uint16_t write(uint8_t type, uint16_t len, uint8_t *pData);
+    virtual uint16_t write(uint8_t type, uint16_t len, uint8_t *pData);
+
+protected:
+    /**
+     * Construct a driver reaching its controller without a UART transport, such as a
+     * simulated controller. It overrides initialize, terminate and write.
+     */
+    EmbeddedHCIDriver():
+        _transport_driver(NULL),
+        bt_power_name(NC),
+        bt_power(NC, PIN_OUTPUT, PullUp, 0)
+        { }
 
 private:
     /**
@@ -123,7 +136,7 @@ private:
     void do_terminate() { }
 
 private:
-    EmbeddedHCITransportDriver& _transport_driver;
+    EmbeddedHCITransportDriver* _transport_driver;
     PinName bt_power_name;
     DigitalInOut bt_power;
 };
@@ -131,3 +144,19 @@ private:
 } // end of namespace 'embedded'
 
 } // end of namespace 'cypress'
+
+/**
+ * HCI driver of a controller: the on-board Bluetooth device for WICED_HCI_DEFAULT_CONTROLLER,
+ * the driver attached with ble_attach_embedded_hci_driver for the others.
+ *
+ * @return The driver, NULL when none is attached to the controller.
+ */
+cypress::embedded::EmbeddedHCIDriver* ble_get_embedded_hci_driver(wiced_hci_controller_t controller);
+
+/**
+ * Attach the driver of a controller on another UART, before wiced_bt_stack_init is called for it.
+ * The driver must outlive the controller's use.
+ *
+ * @return false when the controller is out of WICED_HCI_MAX_CONTROLLERS.
+ */
+bool ble_attach_embedded_hci_driver(wiced_hci_controller_t controller, cypress::embedded::EmbeddedHCIDriver& driver);
@@ -35,11 +35,10 @@
 
 #include "embedded_BLE_hcitransportdriver.h"
 #include "cycfg_pins.h"
+#include "wiced_mbed_uart.h"
 
 using namespace cypress::embedded;
 
-extern void wiced_hci_serial_data_rcv_handler(uint8_t* data, uint8_t len);
-
 EmbeddedHCITransportDriver::data_received_handler_t
     EmbeddedHCITransportDriver::data_received_handler = wiced_hci_serial_data_rcv_handler;
 
@@ -50,8 +49,10 @@ void EmbeddedHCITransportDriver::bt_host_wake_irq_handler(void)
     sleep_manager_unlock_deep_sleep();
 }
 
-void EmbeddedHCITransportDriver::initialize()
+void EmbeddedHCITransportDriver::initialize(wiced_hci_controller_t controller)
 {
+    this->controller = controller;
+
     uart.format(
         /* bits */ 8,
         /* parity */ SerialBase::None,
@@ -130,7 +131,7 @@ void EmbeddedHCITransportDriver::on_data_received(uint8_t* data, uint16_t len)
 {
     while (len) {
         uint8_t chunk_length = std::min(len, (uint16_t) std::numeric_limits<uint8_t>::max());
-        data_received_handler(data, chunk_length);
+        data_received_handler(controller, data, chunk_length);
         len = len - chunk_length;
         data = data + chunk_length;
     }
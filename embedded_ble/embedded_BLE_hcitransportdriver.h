@@ -35,6 +35,7 @@
 
 #include "mbed.h"
 #include "drivers/DigitalInOut.h"
+#include "wiced_bt_hci.h"
 
 /**
  * \defgroup embedded_ble_hci_transport Embedded BLE HCI Transport Driver Interface
@@ -65,7 +66,8 @@ public:
     bt_host_wake_name(bt_host_wake_name),
     bt_device_wake_name(bt_device_wake_name),
     bt_host_wake(bt_host_wake_name, PIN_INPUT, PullNone, 0),
-    bt_device_wake(bt_device_wake_name, PIN_OUTPUT, PullDefault, 1)
+    bt_device_wake(bt_device_wake_name, PIN_OUTPUT, PullDefault, 1),
+    controller(WICED_HCI_DEFAULT_CONTROLLER)
     { }
 
     /**
@@ -75,8 +77,10 @@ public:
 
     /**
      * Inialization of the transport
+     *
+     * @param controller The controller on the UART, which the received bytes are handed to.
      */
-    void initialize();
+    void initialize(wiced_hci_controller_t controller);
 
     /**
      * termination of the transport.
@@ -102,7 +106,7 @@ public:
      * @param data Pointer to the data received.
      * @param len Number of bytes received.
      */
-    static void on_data_received(uint8_t* data, uint16_t len);
+    void on_data_received(uint8_t* data, uint16_t len);
 
     /**
      *  Bluetooth Transport driver IRQ handler
@@ -113,7 +117,7 @@ private:
     void on_controller_irq();
     void assert_bt_dev_wake();
     void deassert_bt_dev_wake();
-    typedef void (*data_received_handler_t)(uint8_t* data, uint8_t len);
+    typedef void (*data_received_handler_t)(wiced_hci_controller_t controller, uint8_t* data, uint8_t len);
 
     static data_received_handler_t data_received_handler;
 
@@ -130,6 +134,7 @@ private:
     PinName bt_device_wake_name;
     DigitalInOut bt_host_wake;
     DigitalInOut bt_device_wake;
+    wiced_hci_controller_t controller;
 };
 /** @} */
 } // end of namespace 'embedded'
@@ -32,7 +32,9 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "embedded_BLE_mesh.h"
+#include "embedded_BLE_gatt.h"
 
 #include "wiced_hci_bt_mesh.h"
 
@@ -40,15 +42,17 @@ using namespace cypress::embedded;
 
 #define MESH_GATEWAY_INFO( X )         printf X
 
-Mesh* Mesh::gmesh = NULL;
+Mesh* Mesh::gmesh[BLE::NUM_INSTANCES];
 
 
-void mesh_status_cb(uint8_t status)
+void mesh_status_cb(wiced_hci_controller_t controller, uint8_t status)
 {
 
-    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance());
+    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance(controller));
     Mesh::MeshEventCallback_t callback = mesh.getmeshCallback();
 
+    mesh.getStateMachine().event(MESH_STATE_EVENT_MESH_STATUS);
+
     Mesh::MeshEventCallbackData cb_data;
     cb_data.mesh.status = status;
 
@@ -61,11 +65,31 @@ void mesh_status_cb(uint8_t status)
 
 
 // Callback function which notifies provisioning status.
-void mesh_provisioning_status_cb(uint32_t conn_id, uint8_t result)
+void mesh_provisioning_status_cb(wiced_hci_controller_t controller, uint32_t conn_id, uint8_t result)
 {
-    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance());
+    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance(controller));
     Mesh::MeshEventCallback_t callback = mesh.getmeshCallback();
 
+    // Without a connection the result is the gateway's own provisioning. Otherwise the controller
+    // names its selected proxy connection and not the device, the result goes to the only session
+    // the provisioning bearer runs, and a result no session claims is dropped.
+    if (conn_id == 0)
+    {
+        if (result == WICED_BT_MESH_PROVISION_RESULT_SUCCESS)
+        {
+            mesh.getStateMachine().event(MESH_STATE_EVENT_PROVISIONED);
+        }
+    }
+    else
+    {
+        uint16_t session = mesh.getProvisioningManager().getSession();
+
+        if (session == 0 || !mesh.getProvisioningManager().completed(session, result))
+        {
+            MESH_GATEWAY_INFO(("%s Provisioning result %02x of no session\n", __func__, result));
+        }
+    }
+
     Mesh::MeshEventCallbackData cb_data;
     cb_data.provisioning.conn_id = conn_id;
     cb_data.provisioning.status = result;
@@ -79,14 +103,26 @@ void mesh_provisioning_status_cb(uint32_t conn_id, uint8_t result)
 }
 
 // Callback function which recieves proxy packet from the mesh core , this data should be published to cloud
-void mesh_cloud_data_cb(const uint8_t *packet, uint32_t packet_len)
+void mesh_cloud_data_cb(wiced_hci_controller_t controller, const uint8_t *packet, uint32_t packet_len)
 {
-    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance());
+    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance(controller));
     Mesh::MeshEventCallback_t callback = mesh.getmeshCallback();
 
     Mesh::MeshEventCallbackData cb_data;
     cb_data.network.packet = (uint8_t *)packet;
     cb_data.network.length = packet_len;
+    cb_data.network.conn_id = wiced_bt_mesh_proxy_selected_connection(controller);
+
+    mesh.getProxyConnectionTable().received(cb_data.network.conn_id, packet_len);
+
+    uint32_t now = (uint32_t)rtos::Kernel::get_ms_count();
+
+    // Copies of a message received on another path or relayed again are not published twice
+    if (!mesh.getUplinkFilter().accept(packet, packet_len, now))
+    {
+        return;
+    }
+    mesh.getNodeRegistry().received(packet, packet_len, now);
 
     if (callback)
     {
@@ -96,10 +132,17 @@ void mesh_cloud_data_cb(const uint8_t *packet, uint32_t packet_len)
     MESH_GATEWAY_INFO(("%s Proxy Data from Mesh for Cloud. Received length = %lu \n", __func__, packet_len));
 }
 
-void mesh_nvram_data_cb(int id, uint8_t *packet, uint32_t packet_len )
+void mesh_nvram_data_cb(wiced_hci_controller_t controller, int id, uint8_t *packet, uint32_t packet_len )
 {
-    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance());
+    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance(controller));
     Mesh::MeshEventCallback_t callback = mesh.getmeshCallback();
+    NVStore* store = mesh.getNVStore();
+
+    // The store copies the record, flash is programmed from its own thread
+    if (store && store->write((uint16_t)id, packet, (uint16_t)packet_len) != BLE_ERROR_NONE)
+    {
+        MESH_GATEWAY_INFO(("%s NVRAM data %d not stored\n", __func__, id));
+    }
 
     Mesh::MeshEventCallbackData cb_data;
     cb_data.nvram.id = id;
@@ -114,13 +157,176 @@ void mesh_nvram_data_cb(int id, uint8_t *packet, uint32_t packet_len )
     MESH_GATEWAY_INFO(("%s NVRAM data received length = %lu \n", __func__, packet_len));
 }
 
+// Callback function which notifies proxy connections opened or closed by the controller
+void mesh_proxy_connection_cb(wiced_hci_controller_t controller, uint16_t conn_id, uint8_t connected)
+{
+    Mesh& mesh = Mesh::getMeshInstance(BLE::Instance(controller));
+    Mesh::MeshEventCallback_t callback = mesh.getmeshCallback();
+
+    if (connected)
+    {
+        mesh.getProxyConnectionTable().open(conn_id);
+    }
+    else
+    {
+        mesh.getProxyConnectionTable().close(conn_id);
+    }
+
+    // A connection of a provisioning session goes to an unprovisioned device, not to the network
+    if (!mesh.getProvisioningManager().connected(conn_id, connected ? true : false))
+    {
+        if (connected)
+        {
+            mesh.getStateMachine().event(MESH_STATE_EVENT_PROXY_CONNECTED);
+        }
+        else if (mesh.getProxyConnectionTable().getDefaultConnection() == 0)
+        {
+            mesh.getStateMachine().event(MESH_STATE_EVENT_PROXY_DISCONNECTED);
+        }
+    }
+
+    Mesh::MeshEventCallbackData cb_data;
+    cb_data.connection.conn_id = conn_id;
+    cb_data.connection.connected = connected ? true : false;
+
+    if (callback)
+    {
+        callback(Mesh::BLUETOOTH_MESH_PROXY_CONNECTION_STATUS, &cb_data);
+    }
+}
+
+// Callback function which notifies the progress of the devices queued with provisionDevice
+void mesh_provisioning_progress_cb(const ProvisioningProgress& progress, void* context)
+{
+    Mesh& mesh = *(Mesh*)context;
+    Mesh::MeshEventCallback_t callback = mesh.getmeshCallback();
+
+    Mesh::MeshEventCallbackData cb_data;
+    cb_data.session.progress = &progress;
+
+    if (callback)
+    {
+        callback(Mesh::BLUETOOTH_MESH_PROVISIONING_PROGRESS, &cb_data);
+    }
+}
+
+void Mesh::stateChanged(const MeshStateTransition& transition, void* context)
+{
+    Mesh& mesh = *(Mesh*)context;
+    Mesh::MeshEventCallback_t callback = mesh.getmeshCallback();
+
+    MESH_GATEWAY_INFO(("%s %s -> %s\n", __func__, MeshStateMachine::stateToString(transition.from),
+                       MeshStateMachine::stateToString(transition.to)));
+
+    Mesh::MeshEventCallbackData cb_data;
+    cb_data.state.from = transition.from;
+    cb_data.state.to = transition.to;
+
+    if (callback)
+    {
+        callback(Mesh::BLUETOOTH_MESH_STATE_CHANGED, &cb_data);
+    }
+}
+
+// Provisioning sessions run on proxy connections opened on the Bluetooth Controller
+class MeshProvisioningBearer : public ProvisioningBearer
+{
+public:
+    MeshProvisioningBearer(wiced_hci_controller_t controller) : controller(controller) {}
+
+    // The controller reports a provisioning result without the device it belongs to
+    virtual uint8_t getMaxSessions(void) const
+    {
+        return 1;
+    }
+
+    virtual ble_error_t open(uint16_t conn_id, const uint8_t* uuid)
+    {
+        return Mesh::getMeshInstance(BLE::Instance(controller)).connectMesh(conn_id);
+    }
+
+    virtual void close(uint16_t conn_id)
+    {
+        Mesh::getMeshInstance(BLE::Instance(controller)).disconnectMesh(conn_id);
+    }
+
+private:
+    wiced_hci_controller_t controller;
+};
+
+ProvisioningBearer& Mesh::provisioningBearer(wiced_hci_controller_t controller)
+{
+    static MeshProvisioningBearer* bearers[WICED_HCI_MAX_CONTROLLERS];
+
+    if (bearers[controller] == NULL)
+    {
+        bearers[controller] = new MeshProvisioningBearer(controller);
+    }
+
+    return *bearers[controller];
+}
+
+bool Mesh::proxyTransmit(uint16_t conn_id, const uint8_t* data, uint16_t length, void* context)
+{
+    Mesh* mesh = (Mesh*)context;
+
+    // No connection opened through connectMesh: the controller uses its current one
+    if (conn_id == 0)
+    {
+        return wiced_bt_mesh_send_proxy_packet(mesh->controller, data, length) == CY_RSLT_SUCCESS;
+    }
+
+    return wiced_bt_mesh_send_proxy_packet_to(mesh->controller, conn_id, data, length) == CY_RSLT_SUCCESS;
+}
+
+void Mesh::proxyControl(uint16_t conn_id, bool connected, void* context)
+{
+    Mesh* mesh = (Mesh*)context;
+
+    if (conn_id == 0)
+    {
+        wiced_bt_mesh_proxy_connect(mesh->controller, 0);
+        return;
+    }
+
+    wiced_bt_mesh_proxy_connection(mesh->controller, conn_id, connected ? 1 : 0);
+}
+
+bool Mesh::downlinkTransmit(uint16_t conn_id, const uint8_t* data, uint16_t length, void* context)
+{
+    Mesh& mesh = *(Mesh*)context;
+
+    if (conn_id == 0)
+    {
+        return mesh.sendData((uint8_t*)data, length) == BLE_ERROR_NONE;
+    }
+
+    return mesh.sendData(conn_id, data, length) == BLE_ERROR_NONE;
+}
+
 ble_error_t Mesh::initialize(void)
 {
     MESH_GATEWAY_INFO(("Initializing Embedded BLE Mesh Service\n"));
-    wiced_bt_mesh_init( mesh_provisioning_status_cb,
+    wiced_bt_mesh_init( controller,
+                        mesh_provisioning_status_cb,
                         mesh_cloud_data_cb,
                         mesh_nvram_data_cb,
                         mesh_status_cb);
+    wiced_bt_mesh_register_proxy_connection_cb(controller, mesh_proxy_connection_cb);
+    provisioning.setEventCallback(mesh_provisioning_progress_cb, this);
+
+    // The scheduler and provisioning threads only run for gateways using them, see scheduleData and provisionDevice
+    service_lock.lock();
+    services_enabled = true;
+    if (downlink_used)
+    {
+        downlink.start();
+    }
+    if (provisioning_used)
+    {
+        provisioning.start();
+    }
+    service_lock.unlock();
 
     return BLE_ERROR_NONE;
 }
@@ -128,41 +334,172 @@ ble_error_t Mesh::initialize(void)
 ble_error_t Mesh::shutdown(void)
 {
     MESH_GATEWAY_INFO(("Shutting down Embedded BLE Mesh Service\n"));
+    service_lock.lock();
+    services_enabled = false;
+    downlink.stop();
+    provisioning.stop();
+    service_lock.unlock();
     return BLE_ERROR_NONE;
 }
 
-ble_error_t Mesh::connectMesh(void)
+ble_error_t Mesh::scheduleData(const DownlinkMessage& message)
 {
-    MESH_GATEWAY_INFO(("Connecting to Mesh network...\n"));
-    uint8_t mesh_connect_cmd = 0x1;
+    ble_error_t result = downlink.submit(message);
 
-    wiced_bt_mesh_proxy_connect(mesh_connect_cmd);
+    if (result == BLE_ERROR_NONE && !downlink_used)
+    {
+        service_lock.lock();
+        downlink_used = true;
+        if (services_enabled)
+        {
+            downlink.start();
+        }
+        service_lock.unlock();
+    }
 
-    return BLE_ERROR_NONE;
+    return result;
 }
 
-ble_error_t Mesh::disconnectMesh(void)
+ble_error_t Mesh::provisionDevice(const uint8_t* uuid)
 {
-    MESH_GATEWAY_INFO(("Disconnecting from Mesh Network...\n"));
-    uint8_t mesh_disconnect_cmd = 0x0;
+    ble_error_t result = provisioning.add(uuid);
 
-    wiced_bt_mesh_proxy_connect(mesh_disconnect_cmd);
+    if (result == BLE_ERROR_NONE && !provisioning_used)
+    {
+        service_lock.lock();
+        provisioning_used = true;
+        if (services_enabled)
+        {
+            provisioning.start();
+        }
+        service_lock.unlock();
+    }
 
-    return BLE_ERROR_NONE;
+    return result;
 }
 
-ble_error_t Mesh::pushNVData(uint8_t *data_in , uint8_t data_len , uint16_t idx)
+ble_error_t Mesh::connectMesh(uint16_t conn_id)
 {
-    wiced_bt_mesh_push_nvram_data(data_in, data_len, idx);
+    if (restoring)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    MESH_GATEWAY_INFO(("Connecting to Mesh network on proxy connection %d...\n", conn_id));
+
+    // The connection is selected on the controller in turn with the packets of the other connections
+    return proxy_connections.connect(conn_id);
+}
+
+ble_error_t Mesh::disconnectMesh(uint16_t conn_id)
+{
+    if (conn_id != 0)
+    {
+        MESH_GATEWAY_INFO(("Closing proxy connection %d...\n", conn_id));
+    }
+    else
+    {
+        MESH_GATEWAY_INFO(("Disconnecting from Mesh Network...\n"));
+    }
+
+    return proxy_connections.disconnect(conn_id);
+}
+
+ble_error_t Mesh::pushNVData(uint8_t *data_in , uint16_t data_len , uint16_t idx)
+{
+    if (wiced_bt_mesh_push_nvram_data(controller, data_in, data_len, idx) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
     return BLE_ERROR_NONE;
 }
 
-int Mesh::sendData(uint8_t* p_data, uint8_t data_len)
+ble_error_t Mesh::restoreNVData(uint8_t window)
 {
+    uint16_t ids[EMBEDDED_BLE_NVSTORE_MAX_RECORDS];
+    uint8_t  record[EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE];
+    uint16_t count = 0;
+    uint16_t length = 0;
+    uint16_t i = 0;
+    uint64_t start = 0;
+    MeshEventCallbackData cb_data;
+
+    if (nvstore == NULL)
+    {
+        return BLE_ERROR_INITIALIZATION_INCOMPLETE;
+    }
+    if (restoring || wiced_bt_mesh_restore_nvram_begin(controller, window) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+    restoring = true;
+
+    start = rtos::Kernel::get_ms_count();
+    memset(&cb_data, 0, sizeof(cb_data));
+    cb_data.restore.status = BLE_ERROR_NONE;
+
+    // Each record goes from the store to the UART through one buffer, the push only waits for a window credit
+    count = nvstore->list(ids, EMBEDDED_BLE_NVSTORE_MAX_RECORDS);
+    for (i = 0; i < count; i++)
+    {
+        // The GATT discovery cache shares the store but is not Mesh data
+        if (ids[i] >= EMBEDDED_BLE_GATT_CACHE_NVSTORE_ID)
+        {
+            break;
+        }
+        if (nvstore->read(ids[i], record, sizeof(record), &length) != BLE_ERROR_NONE)
+        {
+            continue;
+        }
+        if (wiced_bt_mesh_push_nvram_data(controller, record, length, ids[i]) != CY_RSLT_SUCCESS)
+        {
+            cb_data.restore.status = BLE_ERROR_INTERNAL_STACK_FAILURE;
+            break;
+        }
+        cb_data.restore.records++;
+        cb_data.restore.bytes += length;
+    }
+
+    if (wiced_bt_mesh_restore_nvram_end(controller) != CY_RSLT_SUCCESS)
+    {
+        cb_data.restore.status = BLE_ERROR_INTERNAL_STACK_FAILURE;
+    }
+    cb_data.restore.elapsed_ms = (uint32_t)(rtos::Kernel::get_ms_count() - start);
+    restoring = false;
+
+    MESH_GATEWAY_INFO(("%s %d records, %lu bytes restored in %lu ms, status %d\n", __func__, cb_data.restore.records,
+                       (unsigned long)cb_data.restore.bytes, (unsigned long)cb_data.restore.elapsed_ms, cb_data.restore.status));
+
+    if (mesh_callback)
+    {
+        mesh_callback(BLUETOOTH_MESH_NVRAM_RESTORE_COMPLETE, &cb_data);
+    }
+
+    return cb_data.restore.status;
+}
+
+int Mesh::sendData(uint8_t* p_data, uint16_t data_len)
+{
+    uint16_t conn_id = proxy_connections.getDefaultConnection();
+
     MESH_GATEWAY_INFO(("Sending Data to Mesh Network\n"));
 
-    wiced_bt_mesh_send_proxy_packet(p_data, data_len);
+    if (p_data == NULL || data_len == 0)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
 
-    return BLE_ERROR_NONE;
+    // 0, no connection opened through connectMesh: the controller uses its current one
+    return proxy_connections.send(conn_id, p_data, data_len);
+}
+
+ble_error_t Mesh::sendData(uint16_t conn_id, const uint8_t* p_data, uint16_t data_len)
+{
+    if (p_data == NULL || data_len == 0)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    return proxy_connections.send(conn_id, p_data, data_len);
 }
 
@@ -44,6 +44,13 @@
 
 #include <stdint.h>
 #include "embedded_BLE.h"
+#include "embedded_BLE_nvstore.h"
+#include "embedded_BLE_proxy.h"
+#include "embedded_BLE_uplink.h"
+#include "embedded_BLE_downlink.h"
+#include "embedded_BLE_provisioning.h"
+#include "embedded_BLE_state.h"
+#include "embedded_BLE_registry.h"
 
 #include "wiced_hci_bt_mesh.h"
 /**
@@ -95,6 +102,10 @@ public:
         BLUETOOTH_MESH_NETWORK_RECEIVED_DATA,       /**< Data received from Mesh network to be sent to cloud */
         BLUETOOTH_MESH_NETWORK_STATUS,              /**< Mesh Network status change */
         BLUETOOTH_MESH_NVRAM_DATA,                  /**< Update NVRAM data */
+        BLUETOOTH_MESH_NVRAM_RESTORE_COMPLETE,      /**< NVRAM data restored to the Bluetooth Controller */
+        BLUETOOTH_MESH_PROXY_CONNECTION_STATUS,     /**< Proxy connection opened or closed by the Bluetooth Controller */
+        BLUETOOTH_MESH_PROVISIONING_PROGRESS,       /**< Device of the provisioning manager changed state */
+        BLUETOOTH_MESH_STATE_CHANGED,               /**< Gateway state changed */
     };
     /** @} */
 
@@ -114,14 +125,22 @@ public:
             uint8_t device;         /**< Mesh status of Bluetooth device */
         } device;
 
-        /** Data received from Mesh network to be sent to cloud */
+        /** Data received from Mesh network to be sent to cloud: a complete proxy PDU, only valid during the callback */
         struct
         {
             uint32_t length;        /**< Length of payload received from Mesh network */
             uint8_t* packet;        /**< Mesh payload */
+            uint16_t conn_id;       /**< Proxy connection the payload was received on */
         } network;
 
-        /** NVRAM payload */
+        /** Proxy connection status */
+        struct
+        {
+            uint16_t conn_id;       /**< Proxy connection id */
+            bool     connected;     /**< Connection open */
+        } connection;
+
+        /** NVRAM payload, the data is only valid during the callback */
         struct
         {
             uint16_t id;            /**< NVRAM Payload index */
@@ -129,6 +148,28 @@ public:
             uint8_t* data;          /**< NVRAM Payload */
         } nvram;
 
+        /** Provisioning manager progress, only valid during the callback */
+        struct
+        {
+            const ProvisioningProgress* progress; /**< Device, state and session connection */
+        } session;
+
+        /** NVRAM restore result */
+        struct
+        {
+            ble_error_t status;     /**< BLE_ERROR_NONE when the Bluetooth Controller accepted every record */
+            uint16_t records;       /**< Records pushed */
+            uint32_t bytes;         /**< NVRAM bytes pushed */
+            uint32_t elapsed_ms;    /**< Restore time */
+        } restore;
+
+        /** Gateway state transition */
+        struct
+        {
+            MeshState from;         /**< Previous state */
+            MeshState to;           /**< New state */
+        } state;
+
         /** Mesh network status callback data */
         struct
         {
@@ -142,16 +183,26 @@ public:
 
 public:
     /**
-     * Get Mesh Instance
+     * Get Mesh Instance of the Bluetooth Controller driven by ble
      */
     static Mesh& getMeshInstance(BLE& ble)
     {
-        if (gmesh == NULL)
+        BLE::InstanceID_t id = ble.getInstanceID();
+
+        if (gmesh[id] == NULL)
         {
-            gmesh = new Mesh;
+            gmesh[id] = new Mesh(ble.getController());
         }
 
-        return (Mesh&)*gmesh;
+        return (Mesh&)*gmesh[id];
+    }
+
+    /**
+     * Returns the Bluetooth Controller of the Mesh
+     */
+    inline wiced_hci_controller_t getController(void)
+    {
+        return controller;
     }
 
     /**
@@ -166,31 +217,210 @@ public:
 
     /**
      * Connect to nearby Mesh Network(connects to the mesh network depending on Network-key the device was Provisioned with)
+     * Several proxy connections can be open at once, each with its own id.
+     * Returns BLE_ERROR_INVALID_STATE while restoreNVData is running.
      */
-    ble_error_t connectMesh();
+    ble_error_t connectMesh(uint16_t conn_id = WICED_BT_MESH_DEFAULT_CONNECTION_ID);
 
     /**
-     * Disconnect from Mesh Network
+     * Disconnect from Mesh Network: closes one proxy connection, or all of them when conn_id is 0
      */
-    ble_error_t disconnectMesh();
+    ble_error_t disconnectMesh(uint16_t conn_id = 0);
 
     /**
      * Push saved NVRAM data to Bluetooth Controller.
      * For example - saved pairing keys, mesh-provisioning data, saved name, address etc.
      */
-    ble_error_t pushNVData(uint8_t *data_in , uint8_t data_len , uint16_t idx);
+    ble_error_t pushNVData(uint8_t *data_in , uint16_t data_len , uint16_t idx);
 
     /**
-     * Downstream the packet received from Cloud to Mesh Network.
+     * Push every record of the NVRAM store set with setNVStore to the Bluetooth Controller,
+     * pipelining up to window records ahead of their command status (0 for the default window).
+     * BLUETOOTH_MESH_NVRAM_RESTORE_COMPLETE is delivered once before returning.
+     * Call before connectMesh.
      */
-    int sendData(uint8_t* p_data, uint8_t data_len);
+    ble_error_t restoreNVData(uint8_t window = 0);
+
+    /**
+     * Persist the NVRAM data reported by the Bluetooth Controller in a store.
+     * BLUETOOTH_MESH_NVRAM_DATA is still delivered to the Mesh Event callback.
+     *
+     * @param[in] store: initialized NVRAM store, NULL to stop persisting
+     */
+    ble_error_t setNVStore(NVStore* store)
+    {
+        nvstore = store;
+
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Returns the NVRAM store set with setNVStore.
+     */
+    inline NVStore* getNVStore(void)
+    {
+        return nvstore;
+    }
+
+    /**
+     * Downstream the packet received from Cloud to Mesh Network, on the first open proxy connection.
+     * Proxy PDUs longer than the WICED HCI transport MTU are segmented.
+     */
+    int sendData(uint8_t* p_data, uint16_t data_len);
+
+    /**
+     * Downstream a packet on a proxy connection opened with connectMesh. Packets are queued per
+     * connection and the connections are served round robin.
+     */
+    ble_error_t sendData(uint16_t conn_id, const uint8_t* p_data, uint16_t data_len);
+
+    /**
+     * Downstream a packet through the downlink scheduler: released by priority class within the per node
+     * and airtime rates set with configureDownlink, replacing a queued packet with the same supersede key.
+     * The first packet scheduled starts the scheduler thread.
+     */
+    ble_error_t scheduleData(const DownlinkMessage& message);
+
+    /**
+     * Sets the downlink scheduler rates (unlimited by default).
+     */
+    ble_error_t configureDownlink(const DownlinkParameters& params)
+    {
+        downlink.configure(params);
+
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Hold the scheduled state set messages covered by rules for their window, sending only the latest
+     * one per destination and opcode (for example DownlinkScheduler::STATE_SET_RULES). NULL disables it.
+     */
+    ble_error_t setDownlinkCoalescing(const DownlinkCoalesceRule* rules, uint8_t count)
+    {
+        return downlink.setCoalescing(rules, count);
+    }
+
+    /**
+     * Copies the downlink counters (queueing delay...) of a priority class.
+     */
+    void getDownlinkStatistics(DownlinkPriority priority, DownlinkClassStatistics& stats)
+    {
+        downlink.getStatistics(priority, stats);
+    }
+
+    /**
+     * Queue a device for the provisioning manager. When its session starts, BLUETOOTH_MESH_PROVISIONING_PROGRESS
+     * reports the proxy connection opened for it, the provisioner then provisions the device over that connection.
+     * The first device queued starts the provisioning manager thread.
+     */
+    ble_error_t provisionDevice(const uint8_t* uuid);
+
+    /**
+     * Returns the provisioning manager (configuration, statistics).
+     */
+    inline ProvisioningManager& getProvisioningManager(void)
+    {
+        return provisioning;
+    }
+
+    /**
+     * Copies the state and counters of the proxy connections.
+     *
+     * @return number of connections copied
+     */
+    uint8_t getProxyConnections(ProxyConnectionInfo* info, uint8_t max)
+    {
+        return proxy_connections.getConnections(info, max);
+    }
+
+    /**
+     * Returns the proxy connection table.
+     */
+    inline ProxyConnectionTable& getProxyConnectionTable(void)
+    {
+        return proxy_connections;
+    }
+
+    /**
+     * Drop copies of a mesh message received within window_ms before BLUETOOTH_MESH_NETWORK_RECEIVED_DATA,
+     * EMBEDDED_BLE_MESH_DEDUP_WINDOW_MS by default.
+     *
+     * @param[in] window_ms: time a message is remembered, 0 delivers every packet
+     * @param[in] key:       identifies a message, NULL for a digest of the network PDU (which only
+     *                       matches copies relayed over the same number of hops, see MeshUplinkFilter)
+     */
+    ble_error_t setUplinkDedup(uint32_t window_ms, MeshDedupKey_t key = NULL)
+    {
+        uplink_filter->configure(window_ms, key);
+
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Copies the uplink filter counters (duplicates suppressed...).
+     */
+    void getUplinkStatistics(MeshUplinkStatistics& stats)
+    {
+        uplink_filter->getStatistics(stats);
+    }
+
+    /**
+     * Returns the uplink filter.
+     */
+    inline MeshUplinkFilter& getUplinkFilter(void)
+    {
+        return *uplink_filter;
+    }
+
+    /**
+     * Filters the uplink through a filter shared with other meshes, so that a message heard by
+     * several radios is delivered once (MeshRadioGroup).
+     *
+     * @param[in] filter: shared filter, NULL for the mesh's own filter
+     */
+    inline void setUplinkFilter(MeshUplinkFilter* filter)
+    {
+        uplink_filter = filter ? filter : &uplink;
+    }
+
+    /**
+     * Sets up the node registry caching the model states of the nodes.
+     *
+     * @param[in] first_address: unicast address of the first node, the table covers EMBEDDED_BLE_MESH_REGISTRY_NODES
+     * @param[in] decoder:       decodes the uplink proxy packets into states, NULL when they come from MeshNodeRegistry::update
+     * @param[in] refresh:       fetches stale states from the mesh (for example a Get sent with scheduleData), NULL for none
+     */
+    ble_error_t configureNodeRegistry(uint16_t first_address, MeshStateDecoder_t decoder, MeshStateRefresh_t refresh)
+    {
+        registry.configure(first_address, decoder, refresh);
+
+        return BLE_ERROR_NONE;
+    }
+
+    /**
+     * Reads the last known state of a node, answered from the node registry when not older than max_age_ms.
+     * A stale or unknown state is fetched with the refresh function and BLE_ERROR_INVALID_STATE
+     * (last known state copied) or BLE_ERROR_NOT_FOUND is returned: read again once the status came back.
+     */
+    ble_error_t readNodeState(uint16_t addr, uint16_t opcode, uint32_t max_age_ms, uint8_t* data, uint8_t max, uint8_t* length)
+    {
+        return registry.read(addr, opcode, max_age_ms, data, max, length);
+    }
+
+    /**
+     * Returns the node registry (updates, statistics).
+     */
+    inline MeshNodeRegistry& getNodeRegistry(void)
+    {
+        return registry;
+    }
 
     /**
      * Getter for Device's Provisioning state
      */
     BluetoothMeshProvisioningStatus getProvisionedState(void)
     {
-        return isProvisioned;
+        return state.isReached(MESH_STATE_PROVISIONED) ? BLUETOOTH_MESH_DEVICE_PROVISIONED : BLUETOOTH_MESH_DEVICE_UNPROVISIONED;
     }
 
     /**
@@ -198,7 +428,37 @@ public:
      */
     BluetoothMeshConnectionStatus getConnectionState(void)
     {
-        return isConnected;
+        return state.isReached(MESH_STATE_PROXY_CONNECTED) ? BLUETOOTH_MESH_NETWORK_CONNECTED : BLUETOOTH_MESH_NETWORK_DISCONNECTED;
+    }
+
+    /**
+     * Returns the gateway state: uninitialized, stack up, mesh started, provisioned or proxy connected.
+     */
+    inline MeshState getState(void)
+    {
+        return state.getState();
+    }
+
+    /**
+     * Waits until the gateway reaches a state (or a later one), for example MESH_STATE_STACK_UP after BLE::init.
+     * BLUETOOTH_MESH_STATE_CHANGED reports every transition to the Mesh Event callback.
+     *
+     * @param[in] target:     state to reach
+     * @param[in] timeout_ms: maximum wait, osWaitForever to wait without a timeout
+     *
+     * @return BLE_ERROR_INITIALIZATION_INCOMPLETE on timeout
+     */
+    ble_error_t waitForState(MeshState target, uint32_t timeout_ms)
+    {
+        return state.waitFor(target, timeout_ms) ? BLE_ERROR_NONE : BLE_ERROR_INITIALIZATION_INCOMPLETE;
+    }
+
+    /**
+     * Returns the gateway state machine (transition subscribers).
+     */
+    inline MeshStateMachine& getStateMachine(void)
+    {
+        return state;
     }
 
     /**
@@ -225,16 +485,36 @@ public:
 
 private:
 
-    BluetoothMeshConnectionStatus isConnected;
-    BluetoothMeshProvisioningStatus isProvisioned;
+    wiced_hci_controller_t controller;
+    MeshStateMachine state;
     MeshEventCallback_t mesh_callback;
+    NVStore* nvstore;
+    volatile bool restoring;
+    ProxyConnectionTable proxy_connections;
+    MeshUplinkFilter uplink;
+    MeshUplinkFilter* uplink_filter;
+    MeshNodeRegistry registry;
+    DownlinkScheduler downlink;
+    ProvisioningManager provisioning;
+    rtos::Mutex service_lock;
+    bool services_enabled;
+    volatile bool downlink_used;
+    volatile bool provisioning_used;
+
+    static bool proxyTransmit(uint16_t conn_id, const uint8_t* data, uint16_t length, void* context);
+    static void proxyControl(uint16_t conn_id, bool connected, void* context);
+    static bool downlinkTransmit(uint16_t conn_id, const uint8_t* data, uint16_t length, void* context);
+    static ProvisioningBearer& provisioningBearer(wiced_hci_controller_t controller);
+    static void stateChanged(const MeshStateTransition& transition, void* context);
 
     // Private so that it can  not be called
-    Mesh():isConnected(BLUETOOTH_MESH_NETWORK_DISCONNECTED),isProvisioned(BLUETOOTH_MESH_DEVICE_UNPROVISIONED),mesh_callback(NULL)
-    {};
-    Mesh(Mesh const&): isConnected(BLUETOOTH_MESH_NETWORK_DISCONNECTED),isProvisioned(BLUETOOTH_MESH_DEVICE_UNPROVISIONED),mesh_callback(NULL){};            // copy constructor is private
+    Mesh(wiced_hci_controller_t controller):controller(controller),mesh_callback(NULL),nvstore(NULL),restoring(false),proxy_connections(proxyTransmit, this, proxyControl),uplink_filter(&uplink),downlink(downlinkTransmit, this),provisioning(provisioningBearer(controller)),services_enabled(false),downlink_used(false),provisioning_used(false)
+    {
+        state.subscribe(stateChanged, this);
+    };
+    Mesh(Mesh const&): controller(WICED_HCI_DEFAULT_CONTROLLER),mesh_callback(NULL),nvstore(NULL),restoring(false),proxy_connections(proxyTransmit, this, proxyControl),uplink_filter(&uplink),downlink(downlinkTransmit, this),provisioning(provisioningBearer(WICED_HCI_DEFAULT_CONTROLLER)),services_enabled(false),downlink_used(false),provisioning_used(false){};            // copy constructor is private
     Mesh& operator=(Mesh const&);   // assignment operator is private
-    static Mesh* gmesh;
+    static Mesh* gmesh[BLE::NUM_INSTANCES];
 };
 /** @} */
 }
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth GATT notification table
+ */
+
+#include <string.h>
+#include "embedded_BLE_notification.h"
+
+using namespace cypress::embedded;
+
+#define NOTIFICATION_KEY(conn_id, handle)   (((uint32_t)(conn_id) << 16) | (handle))
+
+GattNotificationTable::GattNotificationTable() :
+    subscription_count(0), head(0), tail(0), used(0), records(0), available(lock)
+{
+    memset(subscriptions, 0, sizeof(subscriptions));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+/* Called with lock held: returns the index of key, or where it is to be inserted when not found */
+int GattNotificationTable::find(uint32_t key, bool& found)
+{
+    int low  = 0;
+    int high = subscription_count;
+
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+
+        if (subscriptions[middle].key < key)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    found = low < subscription_count && subscriptions[low].key == key;
+
+    return low;
+}
+
+ble_error_t GattNotificationTable::subscribe(uint16_t conn_id, uint16_t handle, GattNotificationCallback_t callback, void* context)
+{
+    uint32_t key = NOTIFICATION_KEY(conn_id, handle);
+    bool     found = false;
+    int      i = 0;
+
+    lock.lock();
+    i = find(key, found);
+    if (!found)
+    {
+        if (subscription_count == EMBEDDED_BLE_GATT_MAX_SUBSCRIPTIONS)
+        {
+            lock.unlock();
+            return BLE_ERROR_NO_MEM;
+        }
+        memmove(&subscriptions[i + 1], &subscriptions[i], (subscription_count - i) * sizeof(subscriptions[0]));
+        subscription_count++;
+        subscriptions[i].key   = key;
+        subscriptions[i].count = 0;
+    }
+    subscriptions[i].callback = callback;
+    subscriptions[i].context  = context;
+    statistics.subscriptions  = subscription_count;
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t GattNotificationTable::unsubscribe(uint16_t conn_id, uint16_t handle)
+{
+    bool found = false;
+    int  i = 0;
+
+    lock.lock();
+    i = find(NOTIFICATION_KEY(conn_id, handle), found);
+    if (found)
+    {
+        subscription_count--;
+        memmove(&subscriptions[i], &subscriptions[i + 1], (subscription_count - i) * sizeof(subscriptions[0]));
+        statistics.subscriptions = subscription_count;
+    }
+    lock.unlock();
+
+    return found ? BLE_ERROR_NONE : BLE_ERROR_NOT_FOUND;
+}
+
+void GattNotificationTable::removeConnection(uint16_t conn_id)
+{
+    bool found = false;
+    int  first = 0;
+    int  last = 0;
+
+    // The subscriptions of a connection are contiguous, its handles follow its id in the key
+    lock.lock();
+    first = find(NOTIFICATION_KEY(conn_id, 0), found);
+    last  = first;
+    while (last < subscription_count && (subscriptions[last].key >> 16) == conn_id)
+    {
+        last++;
+    }
+    memmove(&subscriptions[first], &subscriptions[last], (subscription_count - last) * sizeof(subscriptions[0]));
+    subscription_count -= last - first;
+    statistics.subscriptions = subscription_count;
+    lock.unlock();
+}
+
+/* Called with lock held */
+void GattNotificationTable::copyIn(const void* data, uint16_t length)
+{
+    uint32_t first = EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE - tail;
+
+    if (first > length)
+    {
+        first = length;
+    }
+    memcpy(&queue[tail], data, first);
+    memcpy(queue, (const uint8_t*)data + first, length - first);
+    tail = (tail + length) % EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE;
+    used += length;
+}
+
+/* Called with lock held */
+void GattNotificationTable::copyOut(uint32_t offset, void* data, uint16_t length)
+{
+    uint32_t first = EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE - offset;
+
+    if (first > length)
+    {
+        first = length;
+    }
+    memcpy(data, &queue[offset], first);
+    memcpy((uint8_t*)data + first, queue, length - first);
+}
+
+/* Called with lock held */
+void GattNotificationTable::dropOldest(void)
+{
+    RecordHeader header;
+    uint32_t     length = 0;
+
+    copyOut(head, &header, sizeof(header));
+    length = sizeof(header) + header.length;
+    head  = (head + length) % EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE;
+    used -= length;
+    records--;
+}
+
+bool GattNotificationTable::received(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint16_t length, bool indication)
+{
+    return received(conn_id, handle, data, length, indication, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+bool GattNotificationTable::received(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint16_t length, bool indication, uint32_t now_ms)
+{
+    GattNotificationCallback_t callback = NULL;
+    GattNotification notification;
+    RecordHeader     header;
+    void*            context = NULL;
+    bool             found = false;
+    int              i = 0;
+
+    lock.lock();
+    statistics.received++;
+    i = find(NOTIFICATION_KEY(conn_id, handle), found);
+    if (!found)
+    {
+        statistics.unrouted++;
+        lock.unlock();
+        return false;
+    }
+    subscriptions[i].count++;
+    callback = subscriptions[i].callback;
+    context  = subscriptions[i].context;
+
+    if (callback == NULL)
+    {
+        if (sizeof(header) + length > EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE)
+        {
+            statistics.too_long++;
+            lock.unlock();
+            return false;
+        }
+        while (used + sizeof(header) + length > EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE)
+        {
+            dropOldest();
+            statistics.dropped++;
+        }
+
+        header.timestamp_ms = now_ms;
+        header.conn_id      = conn_id;
+        header.handle       = handle;
+        header.length       = length;
+        header.indication   = indication;
+        header.reserved     = 0;
+        copyIn(&header, sizeof(header));
+        copyIn(data, length);
+        records++;
+        statistics.queued++;
+        if (used > statistics.queue_high_water)
+        {
+            statistics.queue_high_water = used;
+        }
+        available.notify_one();
+        lock.unlock();
+        return true;
+    }
+    statistics.delivered++;
+    lock.unlock();
+
+    notification.conn_id      = conn_id;
+    notification.handle       = handle;
+    notification.timestamp_ms = now_ms;
+    notification.indication   = indication;
+    notification.length       = length;
+    notification.data         = data;
+    callback(notification, context);
+
+    return true;
+}
+
+ble_error_t GattNotificationTable::read(GattNotification& notification, uint8_t* buffer, uint16_t size, uint32_t timeout_ms)
+{
+    RecordHeader header;
+    uint64_t     start = rtos::Kernel::get_ms_count();
+    uint64_t     elapsed = 0;
+
+    lock.lock();
+    while (records == 0)
+    {
+        elapsed = rtos::Kernel::get_ms_count() - start;
+        if (elapsed >= timeout_ms)
+        {
+            lock.unlock();
+            return BLE_ERROR_NOT_FOUND;
+        }
+        available.wait_for((uint32_t)(timeout_ms - elapsed));
+    }
+
+    copyOut(head, &header, sizeof(header));
+    notification.conn_id      = header.conn_id;
+    notification.handle       = header.handle;
+    notification.timestamp_ms = header.timestamp_ms;
+    notification.indication   = header.indication != 0;
+    notification.length       = header.length;
+    notification.data         = buffer;
+    if (header.length > size)
+    {
+        lock.unlock();
+        return BLE_ERROR_BUFFER_OVERFLOW;
+    }
+
+    copyOut((head + sizeof(header)) % EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE, buffer, header.length);
+    head  = (head + sizeof(header) + header.length) % EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE;
+    used -= sizeof(header) + header.length;
+    records--;
+    statistics.read++;
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+uint32_t GattNotificationTable::getQueued(void)
+{
+    uint32_t count = 0;
+
+    lock.lock();
+    count = records;
+    lock.unlock();
+
+    return count;
+}
+
+uint32_t GattNotificationTable::getCount(uint16_t conn_id, uint16_t handle, bool& found)
+{
+    uint32_t count = 0;
+    int      i = 0;
+
+    lock.lock();
+    i = find(NOTIFICATION_KEY(conn_id, handle), found);
+    if (found)
+    {
+        count = subscriptions[i].count;
+    }
+    lock.unlock();
+
+    return count;
+}
+
+void GattNotificationTable::getStatistics(GattNotificationStatistics& stats)
+{
+    lock.lock();
+    stats = statistics;
+    lock.unlock();
+}
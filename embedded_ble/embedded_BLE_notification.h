@@ -0,0 +1,199 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth GATT notification table
+ *
+ * Routes the notifications and indications of the connected peripherals to their consumers.
+ * A subscription is keyed by connection id and attribute handle, and the subscriptions are a
+ * flat array sorted by key so that a notification is routed with a binary search. A
+ * subscription hands the notifications to its callback, or to the aggregation queue when it has
+ * none, a ring of timestamped records read by the thread uploading them to the cloud.
+ *
+ * The table and the queue are sized at compile time: routing a notification does not allocate.
+ * When the queue is full the oldest records are dropped, the freshest sensor data is kept.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+
+/** Maximum number of subscriptions, all connections together */
+#ifndef EMBEDDED_BLE_GATT_MAX_SUBSCRIPTIONS
+#define EMBEDDED_BLE_GATT_MAX_SUBSCRIPTIONS         (128)
+#endif
+
+/** Size of the aggregation queue in bytes, each record takes a 12-byte header and its value */
+#ifndef EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE
+#define EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE   (4096)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble
+ *
+ * @{
+ */
+
+/** Defines a received notification or indication */
+struct GattNotification
+{
+    uint16_t       conn_id;                 /**< Connection id */
+    uint16_t       handle;                  /**< Attribute handle */
+    uint32_t       timestamp_ms;            /**< Reception time */
+    bool           indication;              /**< Indication, else notification */
+    uint16_t       length;                  /**< Value length */
+    const uint8_t* data;                    /**< Value */
+};
+
+/** Defines a subscription callback, called from the WICED HCI event worker (the read thread when
+ *  the controller runs no worker). The value is only valid during the call */
+typedef void (*GattNotificationCallback_t)(const GattNotification& notification, void* context);
+
+/** Defines the notification table counters */
+struct GattNotificationStatistics
+{
+    uint32_t received;                      /**< Notifications and indications received */
+    uint32_t delivered;                     /**< Handed to a subscription callback */
+    uint32_t queued;                        /**< Written to the aggregation queue */
+    uint32_t dropped;                       /**< Queued records dropped to make room for newer ones */
+    uint32_t too_long;                      /**< Values larger than the queue, not queued */
+    uint32_t unrouted;                      /**< Received without a subscription */
+    uint32_t read;                          /**< Records read from the queue */
+    uint16_t subscriptions;                 /**< Current subscriptions */
+    uint32_t queue_high_water;              /**< Most bytes used in the queue */
+};
+
+/** Defines the notification table */
+class GattNotificationTable
+{
+public:
+    GattNotificationTable();
+
+    /** Subscribes to the notifications of an attribute, replacing its previous subscription.
+     *
+     * @param[in] conn_id:  connection id
+     * @param[in] handle:   attribute handle
+     * @param[in] callback: callback, NULL to queue the notifications
+     * @param[in] context:  passed to the callback
+     *
+     * @return BLE_ERROR_NO_MEM when EMBEDDED_BLE_GATT_MAX_SUBSCRIPTIONS are in use
+     */
+    ble_error_t subscribe(uint16_t conn_id, uint16_t handle, GattNotificationCallback_t callback, void* context);
+
+    /** Drops a subscription. Its callback may still be running when this returns.
+     *
+     * @return BLE_ERROR_NOT_FOUND when there is none
+     */
+    ble_error_t unsubscribe(uint16_t conn_id, uint16_t handle);
+
+    /** Drops the subscriptions of a closed connection, whose id can be reused */
+    void removeConnection(uint16_t conn_id);
+
+    /** Routes a notification or indication.
+     *
+     * @return false when it has no subscription or could not be queued
+     */
+    bool received(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint16_t length, bool indication);
+
+    /** Routes a notification received at now_ms, for callers with their own clock */
+    bool received(uint16_t conn_id, uint16_t handle, const uint8_t* data, uint16_t length, bool indication, uint32_t now_ms);
+
+    /** Reads the oldest queued record, waiting for one up to timeout_ms.
+     *
+     * @param[out] notification: record, its data points to buffer
+     * @param[out] buffer:       value
+     * @param[in]  size:         size of buffer
+     * @param[in]  timeout_ms:   0 to return at once
+     *
+     * @return BLE_ERROR_NOT_FOUND when the queue stayed empty,
+     *         BLE_ERROR_BUFFER_OVERFLOW when the value is larger than size (the record stays queued, length is set)
+     */
+    ble_error_t read(GattNotification& notification, uint8_t* buffer, uint16_t size, uint32_t timeout_ms);
+
+    /** Returns the number of queued records */
+    uint32_t getQueued(void);
+
+    /** Returns the number of notifications of a subscription, with found false when there is none */
+    uint32_t getCount(uint16_t conn_id, uint16_t handle, bool& found);
+
+    /** Copies the counters */
+    void getStatistics(GattNotificationStatistics& stats);
+
+private:
+    struct Subscription
+    {
+        uint32_t                   key;
+        GattNotificationCallback_t callback;
+        void*                      context;
+        uint32_t                   count;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t timestamp_ms;
+        uint16_t conn_id;
+        uint16_t handle;
+        uint16_t length;
+        uint8_t  indication;
+        uint8_t  reserved;
+    };
+
+    int  find(uint32_t key, bool& found);
+    void copyIn(const void* data, uint16_t length);
+    void copyOut(uint32_t offset, void* data, uint16_t length);
+    void dropOldest(void);
+
+    Subscription               subscriptions[EMBEDDED_BLE_GATT_MAX_SUBSCRIPTIONS];
+    uint16_t                   subscription_count;
+    uint8_t                    queue[EMBEDDED_BLE_GATT_NOTIFICATION_QUEUE_SIZE];
+    uint32_t                   head;
+    uint32_t                   tail;
+    uint32_t                   used;
+    uint32_t                   records;
+    GattNotificationStatistics statistics;
+    rtos::Mutex                lock;
+    rtos::ConditionVariable    available;
+};
+
+/** @} */
+}
+
+}
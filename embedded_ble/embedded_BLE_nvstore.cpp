@@ -0,0 +1,828 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth NVRAM store
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "embedded_BLE_nvstore.h"
+
+using namespace cypress::embedded;
+
+#define NVSTORE_AREA_MAGIC          (0x3153564EUL)      /* "NVS1" */
+#define NVSTORE_AREA_HEADER_LENGTH  (8)
+#define NVSTORE_RECORD_MAGIC        (0x4E56)
+#define NVSTORE_RECORD_HEADER_LENGTH (8)
+
+#define NVSTORE_WAKE_FLAG           (0x1)
+#define NVSTORE_STOP_FLAG           (0x2)
+
+#define NVSTORE_INFO( X )           printf X
+
+static void nvstore_put16(uint8_t* p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t nvstore_get16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void nvstore_put32(uint8_t* p, uint32_t value)
+{
+    nvstore_put16(p, (uint16_t)value);
+    nvstore_put16(p + 2, (uint16_t)(value >> 16));
+}
+
+static uint32_t nvstore_get32(const uint8_t* p)
+{
+    return nvstore_get16(p) | ((uint32_t)nvstore_get16(p + 2) << 16);
+}
+
+/* CRC-16/CCITT */
+static uint16_t nvstore_crc16(const uint8_t* data, uint32_t length, uint16_t crc)
+{
+    uint8_t bit = 0;
+
+    while (length--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/* crc of the id and length fields of a record header and of its data */
+static uint16_t nvstore_record_crc(const uint8_t* header, const uint8_t* data, uint16_t length)
+{
+    return nvstore_crc16(data, length, nvstore_crc16(&header[2], 4, 0xFFFF));
+}
+
+static bool nvstore_is_erased(const uint8_t* data, uint32_t length)
+{
+    while (length--)
+    {
+        if (*data++ != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+NVStore::NVStore() :
+    media(NULL), area_size(0), program_size(1), header_size(0), active(0), sequence(0), tail(0),
+    index_count(0), record_buffer(NULL), work_buffer(NULL), buffer_size(0), thread(NULL)
+{
+    memset(pending, 0, sizeof(pending));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+NVStore::~NVStore()
+{
+    deinit();
+}
+
+ble_error_t NVStore::init(NVStoreMedia* store_media)
+{
+    bool mounted = false;
+
+    if (media != NULL)
+    {
+        return BLE_ERROR_ALREADY_INITIALIZED;
+    }
+    if (store_media == NULL || store_media->init() != 0)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    media        = store_media;
+    area_size    = media->getAreaSize();
+    program_size = media->getProgramSize() ? media->getProgramSize() : 1;
+    header_size  = align(NVSTORE_AREA_HEADER_LENGTH);
+    buffer_size  = align(NVSTORE_RECORD_HEADER_LENGTH + EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE);
+
+    if (area_size < header_size + buffer_size)
+    {
+        media = NULL;
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    record_buffer = new uint8_t[buffer_size];
+    work_buffer   = new uint8_t[buffer_size];
+
+    media_lock.lock();
+    mounted = mount();
+    media_lock.unlock();
+
+    if (!mounted)
+    {
+        delete[] record_buffer;
+        delete[] work_buffer;
+        record_buffer = NULL;
+        work_buffer   = NULL;
+        media         = NULL;
+        return BLE_ERROR_INTERNAL_STACK_FAILURE;
+    }
+
+    NVSTORE_INFO(("NVStore mounted area %d, %d records, %lu bytes free\n",
+                  active, index_count, (unsigned long)(area_size - tail)));
+
+    flags.clear(NVSTORE_WAKE_FLAG | NVSTORE_STOP_FLAG);
+    thread = new rtos::Thread(osPriorityBelowNormal, EMBEDDED_BLE_NVSTORE_THREAD_STACK_SIZE, NULL, "nvstore");
+    thread->start(callback(this, &NVStore::worker));
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t NVStore::deinit(void)
+{
+    if (media == NULL)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    /* The thread programs the pending records before leaving */
+    if (thread != NULL)
+    {
+        flags.set(NVSTORE_STOP_FLAG);
+        thread->join();
+        delete thread;
+        thread = NULL;
+    }
+
+    delete[] record_buffer;
+    delete[] work_buffer;
+    record_buffer = NULL;
+    work_buffer   = NULL;
+    media         = NULL;
+
+    return BLE_ERROR_NONE;
+}
+
+int NVStore::findIndex(uint16_t id) const
+{
+    int low  = 0;
+    int high = (int)index_count - 1;
+
+    while (low <= high)
+    {
+        int middle = (low + high) / 2;
+
+        if (index_ids[middle] == id)
+        {
+            return middle;
+        }
+        if (index_ids[middle] < id)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    return -1;
+}
+
+int NVStore::findPending(uint16_t id) const
+{
+    int i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_NVSTORE_PENDING_SLOTS; i++)
+    {
+        if (pending[i].used && pending[i].id == id)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Inserts, updates or (length 0) removes an index entry, keeping the ids sorted */
+void NVStore::setIndex(uint16_t id, uint32_t offset, uint16_t length, uint16_t crc)
+{
+    int i = findIndex(id);
+
+    if (length == 0)
+    {
+        if (i >= 0)
+        {
+            index_count--;
+            for (; i < (int)index_count; i++)
+            {
+                index_ids[i]     = index_ids[i + 1];
+                index_offsets[i] = index_offsets[i + 1];
+                index_lengths[i] = index_lengths[i + 1];
+                index_crcs[i]    = index_crcs[i + 1];
+            }
+        }
+        return;
+    }
+
+    if (i < 0)
+    {
+        if (index_count >= EMBEDDED_BLE_NVSTORE_MAX_RECORDS)
+        {
+            return;
+        }
+        for (i = index_count; i > 0 && index_ids[i - 1] > id; i--)
+        {
+            index_ids[i]     = index_ids[i - 1];
+            index_offsets[i] = index_offsets[i - 1];
+            index_lengths[i] = index_lengths[i - 1];
+            index_crcs[i]    = index_crcs[i - 1];
+        }
+        index_count++;
+    }
+
+    index_ids[i]     = id;
+    index_offsets[i] = offset;
+    index_lengths[i] = length;
+    index_crcs[i]    = crc;
+}
+
+/* Called with media_lock held */
+bool NVStore::format(uint8_t area, uint32_t area_sequence)
+{
+    if (media->erase(area) != 0)
+    {
+        statistics.errors++;
+        return false;
+    }
+    statistics.erases++;
+
+    memset(work_buffer, 0xFF, header_size);
+    nvstore_put32(&work_buffer[0], NVSTORE_AREA_MAGIC);
+    nvstore_put32(&work_buffer[4], area_sequence);
+    if (media->program(area, 0, work_buffer, header_size) != 0)
+    {
+        statistics.errors++;
+        return false;
+    }
+    statistics.bytes_programmed += header_size;
+
+    active      = area;
+    sequence    = area_sequence;
+    tail        = header_size;
+    index_count = 0;
+
+    return true;
+}
+
+/* Called with media_lock held */
+bool NVStore::mount(void)
+{
+    uint8_t  header[NVSTORE_AREA_HEADER_LENGTH];
+    bool     valid[2];
+    uint32_t sequences[2];
+    uint32_t offset  = 0;
+    bool     corrupt = false;
+    uint8_t  area    = 0;
+
+    for (area = 0; area < 2; area++)
+    {
+        valid[area]     = media->read(area, 0, header, sizeof(header)) == 0 &&
+                          nvstore_get32(&header[0]) == NVSTORE_AREA_MAGIC;
+        sequences[area] = nvstore_get32(&header[4]);
+    }
+
+    if (!valid[0] && !valid[1])
+    {
+        return format(0, 1);
+    }
+
+    /* A compaction interrupted before the old area was erased leaves two valid areas */
+    if (valid[0] && valid[1])
+    {
+        active = ((int32_t)(sequences[1] - sequences[0]) > 0) ? 1 : 0;
+    }
+    else
+    {
+        active = valid[1] ? 1 : 0;
+    }
+    sequence    = sequences[active];
+    index_count = 0;
+
+    for (offset = header_size; offset + NVSTORE_RECORD_HEADER_LENGTH <= area_size; )
+    {
+        uint16_t id     = 0;
+        uint16_t length = 0;
+        uint32_t size   = 0;
+
+        if (media->read(active, offset, work_buffer, NVSTORE_RECORD_HEADER_LENGTH) != 0)
+        {
+            corrupt = true;
+            break;
+        }
+
+        /* Erased space ends the log, anything else is an interrupted program */
+        if (nvstore_get16(&work_buffer[0]) != NVSTORE_RECORD_MAGIC)
+        {
+            corrupt = !nvstore_is_erased(work_buffer, NVSTORE_RECORD_HEADER_LENGTH);
+            break;
+        }
+
+        id     = nvstore_get16(&work_buffer[2]);
+        length = nvstore_get16(&work_buffer[4]);
+        size   = align(NVSTORE_RECORD_HEADER_LENGTH + length);
+
+        if (length > EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE || offset + size > area_size ||
+            (length && media->read(active, offset + NVSTORE_RECORD_HEADER_LENGTH, &work_buffer[NVSTORE_RECORD_HEADER_LENGTH], length) != 0) ||
+            nvstore_record_crc(work_buffer, &work_buffer[NVSTORE_RECORD_HEADER_LENGTH], length) != nvstore_get16(&work_buffer[6]))
+        {
+            corrupt = true;
+            break;
+        }
+
+        setIndex(id, offset, length, nvstore_get16(&work_buffer[6]));
+        offset += size;
+    }
+    tail = offset;
+
+    /* Move the verified records to a clean area, the log cannot be appended after a damaged record */
+    if (corrupt)
+    {
+        NVSTORE_INFO(("NVStore log damaged at %lu, compacting\n", (unsigned long)offset));
+        return compact(0);
+    }
+
+    return true;
+}
+
+/* Copies the live records to the other area. Called with media_lock held */
+bool NVStore::compact(uint32_t needed)
+{
+    uint32_t offsets[EMBEDDED_BLE_NVSTORE_MAX_RECORDS];
+    uint8_t  target = active ^ 1;
+    uint32_t offset = header_size;
+    uint16_t i      = 0;
+
+    if (media->erase(target) != 0)
+    {
+        statistics.errors++;
+        return false;
+    }
+    statistics.erases++;
+
+    for (i = 0; i < index_count; i++)
+    {
+        uint32_t length = NVSTORE_RECORD_HEADER_LENGTH + index_lengths[i];
+        uint32_t size   = align(length);
+
+        if (offset + size > area_size ||
+            media->read(active, index_offsets[i], work_buffer, length) != 0)
+        {
+            statistics.errors++;
+            return false;
+        }
+        memset(&work_buffer[length], 0xFF, size - length);
+        if (media->program(target, offset, work_buffer, size) != 0)
+        {
+            statistics.errors++;
+            return false;
+        }
+        statistics.bytes_programmed += size;
+        offsets[i] = offset;
+        offset += size;
+    }
+
+    /* The header is programmed last, an interrupted compaction leaves the old area in use */
+    memset(work_buffer, 0xFF, header_size);
+    nvstore_put32(&work_buffer[0], NVSTORE_AREA_MAGIC);
+    nvstore_put32(&work_buffer[4], sequence + 1);
+    if (media->program(target, 0, work_buffer, header_size) != 0)
+    {
+        statistics.errors++;
+        return false;
+    }
+    statistics.bytes_programmed += header_size;
+
+    memcpy(index_offsets, offsets, index_count * sizeof(offsets[0]));
+    active = target;
+    sequence++;
+    tail = offset;
+    statistics.compactions++;
+
+    if (media->erase(target ^ 1) == 0)
+    {
+        statistics.erases++;
+    }
+
+    return tail + needed <= area_size;
+}
+
+/* Appends the record staged in record_buffer. Called with media_lock held.
+ * Returns false when the record could not be programmed, it stays pending and is retried later
+ * (a deleted record may free an index entry or log space). */
+bool NVStore::append(uint16_t id, uint16_t length)
+{
+    uint32_t size  = align(NVSTORE_RECORD_HEADER_LENGTH + length);
+    int      entry = findIndex(id);
+    uint16_t crc   = 0;
+
+    nvstore_put16(&record_buffer[0], NVSTORE_RECORD_MAGIC);
+    nvstore_put16(&record_buffer[2], id);
+    nvstore_put16(&record_buffer[4], length);
+    crc = nvstore_record_crc(record_buffer, &record_buffer[NVSTORE_RECORD_HEADER_LENGTH], length);
+
+    /* Nothing to program when the log already holds this content */
+    if (entry < 0 ? (length == 0) :
+        (index_lengths[entry] == length && index_crcs[entry] == crc &&
+         media->read(active, index_offsets[entry] + NVSTORE_RECORD_HEADER_LENGTH, work_buffer, length) == 0 &&
+         memcmp(work_buffer, &record_buffer[NVSTORE_RECORD_HEADER_LENGTH], length) == 0))
+    {
+        statistics.redundant++;
+        return true;
+    }
+
+    if (entry < 0 && index_count >= EMBEDDED_BLE_NVSTORE_MAX_RECORDS)
+    {
+        NVSTORE_INFO(("NVStore index full, record %d not programmed\n", id));
+        statistics.errors++;
+        return false;
+    }
+
+    if (tail + size > area_size && !compact(size))
+    {
+        NVSTORE_INFO(("NVStore full, record %d not programmed\n", id));
+        statistics.errors++;
+        return false;
+    }
+
+    nvstore_put16(&record_buffer[6], crc);
+    memset(&record_buffer[NVSTORE_RECORD_HEADER_LENGTH + length], 0xFF, size - NVSTORE_RECORD_HEADER_LENGTH - length);
+
+    if (media->program(active, tail, record_buffer, size) != 0)
+    {
+        /* The space may be partially programmed, skip it */
+        statistics.errors++;
+        tail += size;
+        return false;
+    }
+    statistics.records_programmed++;
+    statistics.bytes_programmed += size;
+
+    setIndex(id, tail, length, crc);
+    tail += size;
+
+    return true;
+}
+
+/* Returns false when a record could not be programmed, the other records are still tried */
+bool NVStore::flush(FlushMode mode)
+{
+    bool failed[EMBEDDED_BLE_NVSTORE_PENDING_SLOTS];
+    bool result = true;
+
+    memset(failed, 0, sizeof(failed));
+
+    media_lock.lock();
+
+    for (;;)
+    {
+        uint32_t now     = (uint32_t)rtos::Kernel::get_ms_count();
+        int      slot    = -1;
+        int      i       = 0;
+        uint16_t id      = 0;
+        uint16_t length  = 0;
+        uint32_t version = 0;
+        bool     done    = false;
+
+        lock.lock();
+        for (i = 0; i < EMBEDDED_BLE_NVSTORE_PENDING_SLOTS; i++)
+        {
+            if (!pending[i].used || failed[i])
+            {
+                continue;
+            }
+            if ((mode == FLUSH_ALL) ||
+                (mode == FLUSH_DUE && (int32_t)(now - pending[i].deadline) >= 0) ||
+                (mode == FLUSH_OLDEST && (slot < 0 || (int32_t)(pending[i].deadline - pending[slot].deadline) < 0)))
+            {
+                slot = i;
+                if (mode != FLUSH_OLDEST)
+                {
+                    break;
+                }
+            }
+        }
+        if (slot < 0)
+        {
+            lock.unlock();
+            break;
+        }
+
+        /* Writes may go on while the record is programmed, they bump the version */
+        id      = pending[slot].id;
+        length  = pending[slot].length;
+        version = pending[slot].version;
+        memcpy(&record_buffer[NVSTORE_RECORD_HEADER_LENGTH], pending[slot].data, length);
+        lock.unlock();
+
+        done = append(id, length);
+
+        lock.lock();
+        if (pending[slot].version == version)
+        {
+            if (done)
+            {
+                pending[slot].used = false;
+            }
+            else
+            {
+                pending[slot].deadline = now + EMBEDDED_BLE_NVSTORE_COALESCE_WINDOW_MS;
+            }
+        }
+        lock.unlock();
+
+        if (!done)
+        {
+            failed[slot] = true;
+            result = false;
+        }
+        if (mode == FLUSH_OLDEST)
+        {
+            break;
+        }
+    }
+
+    media_lock.unlock();
+
+    return result;
+}
+
+void NVStore::worker(void)
+{
+    for (;;)
+    {
+        uint32_t now    = (uint32_t)rtos::Kernel::get_ms_count();
+        uint32_t wait   = osWaitForever;
+        uint32_t result = 0;
+        int      i      = 0;
+
+        lock.lock();
+        for (i = 0; i < EMBEDDED_BLE_NVSTORE_PENDING_SLOTS; i++)
+        {
+            if (pending[i].used)
+            {
+                int32_t remaining = (int32_t)(pending[i].deadline - now);
+
+                if (remaining <= 0)
+                {
+                    wait = 0;
+                }
+                else if ((uint32_t)remaining < wait)
+                {
+                    wait = (uint32_t)remaining;
+                }
+            }
+        }
+        lock.unlock();
+
+        if (wait)
+        {
+            result = flags.wait_any(NVSTORE_WAKE_FLAG | NVSTORE_STOP_FLAG, wait);
+            if (!(result & osFlagsError) && (result & NVSTORE_STOP_FLAG))
+            {
+                break;
+            }
+        }
+
+        flush(FLUSH_DUE);
+    }
+
+    flush(FLUSH_ALL);
+}
+
+ble_error_t NVStore::write(uint16_t id, const uint8_t* data, uint16_t length)
+{
+    int slot = -1;
+    int i    = 0;
+
+    if (media == NULL)
+    {
+        return BLE_ERROR_INITIALIZATION_INCOMPLETE;
+    }
+    if (length > EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE || (length && data == NULL))
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    lock.lock();
+    statistics.logical_writes++;
+
+    slot = findPending(id);
+    if (slot >= 0)
+    {
+        statistics.coalesced++;
+    }
+    else
+    {
+        for (i = 0; i < EMBEDDED_BLE_NVSTORE_PENDING_SLOTS && slot < 0; i++)
+        {
+            if (!pending[i].used)
+            {
+                slot = i;
+            }
+        }
+
+        /* Pool full: program the oldest pending record in the caller's context */
+        if (slot < 0)
+        {
+            statistics.stalls++;
+            lock.unlock();
+            flush(FLUSH_OLDEST);
+            lock.lock();
+            slot = findPending(id);
+            for (i = 0; i < EMBEDDED_BLE_NVSTORE_PENDING_SLOTS && slot < 0; i++)
+            {
+                if (!pending[i].used)
+                {
+                    slot = i;
+                }
+            }
+            if (slot < 0)
+            {
+                lock.unlock();
+                return BLE_ERROR_NO_MEM;
+            }
+        }
+
+        if (!pending[slot].used)
+        {
+            pending[slot].used     = true;
+            pending[slot].id       = id;
+            pending[slot].deadline = (uint32_t)rtos::Kernel::get_ms_count() + EMBEDDED_BLE_NVSTORE_COALESCE_WINDOW_MS;
+        }
+    }
+
+    memcpy(pending[slot].data, data, length);
+    pending[slot].length = length;
+    pending[slot].version++;
+    lock.unlock();
+
+    flags.set(NVSTORE_WAKE_FLAG);
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t NVStore::read(uint16_t id, uint8_t* buffer, uint16_t size, uint16_t* length)
+{
+    ble_error_t result = BLE_ERROR_NONE;
+    int         entry  = -1;
+
+    if (media == NULL)
+    {
+        return BLE_ERROR_INITIALIZATION_INCOMPLETE;
+    }
+
+    media_lock.lock();
+    lock.lock();
+
+    /* A pending record is newer than the log */
+    entry = findPending(id);
+    if (entry >= 0)
+    {
+        *length = pending[entry].length;
+        if (pending[entry].length == 0)
+        {
+            result = BLE_ERROR_NOT_FOUND;
+        }
+        else if (pending[entry].length > size)
+        {
+            result = BLE_ERROR_BUFFER_OVERFLOW;
+        }
+        else
+        {
+            memcpy(buffer, pending[entry].data, pending[entry].length);
+        }
+        lock.unlock();
+        media_lock.unlock();
+        return result;
+    }
+    lock.unlock();
+
+    entry = findIndex(id);
+    if (entry < 0)
+    {
+        result = BLE_ERROR_NOT_FOUND;
+    }
+    else
+    {
+        *length = index_lengths[entry];
+        if (index_lengths[entry] > size)
+        {
+            result = BLE_ERROR_BUFFER_OVERFLOW;
+        }
+        else if (media->read(active, index_offsets[entry] + NVSTORE_RECORD_HEADER_LENGTH, buffer, index_lengths[entry]) != 0)
+        {
+            result = BLE_ERROR_INTERNAL_STACK_FAILURE;
+        }
+    }
+
+    media_lock.unlock();
+
+    return result;
+}
+
+uint16_t NVStore::list(uint16_t* ids, uint16_t max)
+{
+    uint16_t count = 0;
+    uint16_t i     = 0;
+    int      slot  = 0;
+
+    media_lock.lock();
+    lock.lock();
+
+    for (i = 0; i < index_count && count < max; i++)
+    {
+        slot = findPending(index_ids[i]);
+        if (slot < 0 || pending[slot].length != 0)
+        {
+            ids[count++] = index_ids[i];
+        }
+    }
+
+    /* Pending records not in the log yet, kept in ascending order */
+    for (slot = 0; slot < EMBEDDED_BLE_NVSTORE_PENDING_SLOTS; slot++)
+    {
+        if (pending[slot].used && pending[slot].length && findIndex(pending[slot].id) < 0 && count < max)
+        {
+            for (i = count; i > 0 && ids[i - 1] > pending[slot].id; i--)
+            {
+                ids[i] = ids[i - 1];
+            }
+            ids[i] = pending[slot].id;
+            count++;
+        }
+    }
+
+    lock.unlock();
+    media_lock.unlock();
+
+    return count;
+}
+
+ble_error_t NVStore::sync(void)
+{
+    if (media == NULL)
+    {
+        return BLE_ERROR_INITIALIZATION_INCOMPLETE;
+    }
+
+    if (!flush(FLUSH_ALL))
+    {
+        return BLE_ERROR_NO_MEM;
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+void NVStore::getStatistics(NVStoreStatistics& stats)
+{
+    media_lock.lock();
+    lock.lock();
+    stats = statistics;
+    lock.unlock();
+    media_lock.unlock();
+}
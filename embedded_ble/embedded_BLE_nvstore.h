@@ -0,0 +1,260 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth NVRAM store
+ *
+ * Persists the NVRAM records reported by the controller (HCI_CONTROL_MESH_EVENT_NVRAM_DATA),
+ * keyed by their NVRAM id. Records are appended to a log in one of two media areas and
+ * located through an in-RAM index. Writes land in a small pending pool where repeated
+ * updates of the same id within the coalescing window are merged, a background thread
+ * programs them, and the live records are compacted into the other area when the active
+ * one is full.
+ *
+ * Log layout (little endian):
+ * - area header: magic "NVS1" (4), sequence number (4), padded to the program size
+ * - record: magic 0x4E56 (2), id (2), length (2), crc16 (2), data, padded to the program size
+ *   A record of length 0 deletes the id.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+
+/** Maximum number of distinct NVRAM ids */
+#ifndef EMBEDDED_BLE_NVSTORE_MAX_RECORDS
+#define EMBEDDED_BLE_NVSTORE_MAX_RECORDS        (64)
+#endif
+
+/** Maximum length of an NVRAM record */
+#ifndef EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE
+#define EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE      (512)
+#endif
+
+/** Number of records that can wait for the background write */
+#ifndef EMBEDDED_BLE_NVSTORE_PENDING_SLOTS
+#define EMBEDDED_BLE_NVSTORE_PENDING_SLOTS      (8)
+#endif
+
+/** Time repeated writes of the same id are merged before being programmed */
+#ifndef EMBEDDED_BLE_NVSTORE_COALESCE_WINDOW_MS
+#define EMBEDDED_BLE_NVSTORE_COALESCE_WINDOW_MS (2000)
+#endif
+
+/** Stack size of the background write thread */
+#ifndef EMBEDDED_BLE_NVSTORE_THREAD_STACK_SIZE
+#define EMBEDDED_BLE_NVSTORE_THREAD_STACK_SIZE  (2048)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines the storage used by the NVRAM store: two equally sized, separately erasable areas.
+ *  Methods return 0 on success.
+ */
+class NVStoreMedia
+{
+public:
+    virtual ~NVStoreMedia() {}
+
+    /** Prepares the media */
+    virtual int init(void) = 0;
+
+    /** Gets the size of one area */
+    virtual uint32_t getAreaSize(void) = 0;
+
+    /** Gets the program unit, programs are aligned to and multiple of it */
+    virtual uint32_t getProgramSize(void) = 0;
+
+    /** Reads from an area */
+    virtual int read(uint8_t area, uint32_t offset, void* buffer, uint32_t length) = 0;
+
+    /** Programs erased bytes of an area */
+    virtual int program(uint8_t area, uint32_t offset, const void* buffer, uint32_t length) = 0;
+
+    /** Erases a whole area */
+    virtual int erase(uint8_t area) = 0;
+};
+
+/** Defines the NVRAM store counters.
+ *  bytes_programmed / logical_writes is the flash cost of one update.
+ */
+struct NVStoreStatistics
+{
+    uint32_t logical_writes;        /**< Records written by the application or the controller */
+    uint32_t coalesced;             /**< Writes merged into a pending record */
+    uint32_t redundant;             /**< Pending records not programmed because the media already holds them */
+    uint32_t records_programmed;    /**< Records appended to the log */
+    uint32_t bytes_programmed;      /**< Bytes programmed, including padding and compaction */
+    uint32_t compactions;           /**< Compactions */
+    uint32_t erases;                /**< Area erases */
+    uint32_t stalls;                /**< Writes that waited for the media because the pending pool was full */
+    uint32_t errors;                /**< Media errors and records refused for lack of space */
+};
+
+/** Defines the NVRAM store */
+class NVStore
+{
+public:
+    NVStore();
+    ~NVStore();
+
+    /** Mounts the store (formatting the media when it holds no valid log) and starts the
+     *  background write thread.
+     *
+     * @param[in] media:  storage, owned by the caller
+     *
+     * @return ble_error_t
+     */
+    ble_error_t init(NVStoreMedia* media);
+
+    /** Writes the pending records and stops the background write thread */
+    ble_error_t deinit(void);
+
+    /** Writes a record, the data is copied and programmed in the background.
+     *
+     * @param[in] id:     NVRAM id
+     * @param[in] data:   record data
+     * @param[in] length: record length, 0 deletes the record
+     *
+     * @return BLE_ERROR_NO_MEM when every pending slot is used and the oldest pending record cannot be programmed
+     */
+    ble_error_t write(uint16_t id, const uint8_t* data, uint16_t length);
+
+    /** Reads a record, pending updates included.
+     *
+     * @param[in]  id:     NVRAM id
+     * @param[out] buffer: record data
+     * @param[in]  size:   buffer size
+     * @param[out] length: record length
+     *
+     * @return BLE_ERROR_NOT_FOUND when the id is not stored
+     */
+    ble_error_t read(uint16_t id, uint8_t* buffer, uint16_t size, uint16_t* length);
+
+    /** Lists the stored ids (pending ones included), in ascending order.
+     *
+     * @return number of ids written to ids
+     */
+    uint16_t list(uint16_t* ids, uint16_t max);
+
+    /** Programs every pending record now.
+     *
+     * @return BLE_ERROR_NO_MEM when a record could not be programmed (store or index full, media error),
+     *         it stays pending and is retried
+     */
+    ble_error_t sync(void);
+
+    /** Copies the counters */
+    void getStatistics(NVStoreStatistics& stats);
+
+private:
+    enum FlushMode
+    {
+        FLUSH_DUE,
+        FLUSH_ALL,
+        FLUSH_OLDEST,
+    };
+
+    struct PendingRecord
+    {
+        bool     used;
+        uint16_t id;
+        uint16_t length;
+        uint32_t version;
+        uint32_t deadline;
+        uint8_t  data[EMBEDDED_BLE_NVSTORE_MAX_DATA_SIZE];
+    };
+
+    uint32_t align(uint32_t length) const
+    {
+        return (length + program_size - 1) / program_size * program_size;
+    }
+
+    int  findIndex(uint16_t id) const;
+    int  findPending(uint16_t id) const;
+    void setIndex(uint16_t id, uint32_t offset, uint16_t length, uint16_t crc);
+    bool mount(void);
+    bool format(uint8_t area, uint32_t area_sequence);
+    bool compact(uint32_t needed);
+    bool append(uint16_t id, uint16_t length);
+    bool flush(FlushMode mode);
+    void worker(void);
+
+    NVStoreMedia*     media;
+    uint32_t          area_size;
+    uint32_t          program_size;
+    uint32_t          header_size;
+    uint8_t           active;
+    uint32_t          sequence;
+    uint32_t          tail;
+
+    /* index of the programmed records, sorted by id, protected by media_lock */
+    uint16_t          index_ids[EMBEDDED_BLE_NVSTORE_MAX_RECORDS];
+    uint32_t          index_offsets[EMBEDDED_BLE_NVSTORE_MAX_RECORDS];
+    uint16_t          index_lengths[EMBEDDED_BLE_NVSTORE_MAX_RECORDS];
+    uint16_t          index_crcs[EMBEDDED_BLE_NVSTORE_MAX_RECORDS];
+    uint16_t          index_count;
+
+    /* pending records, protected by lock */
+    PendingRecord     pending[EMBEDDED_BLE_NVSTORE_PENDING_SLOTS];
+
+    /* record being programmed (header, data and padding) and scratch record for mount, compaction
+     * and comparisons, both protected by media_lock */
+    uint8_t*          record_buffer;
+    uint8_t*          work_buffer;
+    uint32_t          buffer_size;
+
+    /* logical_writes, coalesced and stalls are protected by lock, the others by media_lock */
+    NVStoreStatistics statistics;
+    rtos::Mutex       lock;
+    rtos::Mutex       media_lock;
+    rtos::EventFlags  flags;
+    rtos::Thread*     thread;
+};
+
+/** @} */
+}
+
+}
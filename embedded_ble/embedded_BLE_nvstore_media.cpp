@@ -0,0 +1,247 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth NVRAM store media
+ */
+
+#include <string.h>
+#include "embedded_BLE_nvstore_media.h"
+
+using namespace cypress::embedded;
+
+#define NVSTORE_MEDIA_FILL_CHUNK    (64)
+
+FileNVStoreMedia::FileNVStoreMedia(const char* path, uint32_t area_size) :
+    path(path), area_size(area_size), file(NULL)
+{
+}
+
+FileNVStoreMedia::~FileNVStoreMedia()
+{
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+}
+
+int FileNVStoreMedia::init(void)
+{
+    long size = 0;
+
+    if (file != NULL)
+    {
+        return 0;
+    }
+
+    file = fopen(path, "r+b");
+    if (file == NULL)
+    {
+        file = fopen(path, "w+b");
+    }
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    /* A new or short file reads as two erased areas */
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0)
+    {
+        return -1;
+    }
+    if ((uint32_t)size < 2 * area_size)
+    {
+        if (erase(0) != 0 || erase(1) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+uint32_t FileNVStoreMedia::getAreaSize(void)
+{
+    return area_size;
+}
+
+uint32_t FileNVStoreMedia::getProgramSize(void)
+{
+    return 1;
+}
+
+int FileNVStoreMedia::read(uint8_t area, uint32_t offset, void* buffer, uint32_t length)
+{
+    if (file == NULL || area > 1 || offset + length > area_size ||
+        fseek(file, (long)(area * area_size + offset), SEEK_SET) != 0)
+    {
+        return -1;
+    }
+
+    return (fread(buffer, 1, length, file) == length) ? 0 : -1;
+}
+
+int FileNVStoreMedia::program(uint8_t area, uint32_t offset, const void* buffer, uint32_t length)
+{
+    if (file == NULL || area > 1 || offset + length > area_size ||
+        fseek(file, (long)(area * area_size + offset), SEEK_SET) != 0)
+    {
+        return -1;
+    }
+
+    if (fwrite(buffer, 1, length, file) != length)
+    {
+        return -1;
+    }
+
+    return fflush(file) == 0 ? 0 : -1;
+}
+
+int FileNVStoreMedia::erase(uint8_t area)
+{
+    uint8_t  fill[NVSTORE_MEDIA_FILL_CHUNK];
+    uint32_t offset = 0;
+
+    if (file == NULL || area > 1 || fseek(file, (long)(area * area_size), SEEK_SET) != 0)
+    {
+        return -1;
+    }
+
+    memset(fill, 0xFF, sizeof(fill));
+    for (offset = 0; offset < area_size; offset += sizeof(fill))
+    {
+        uint32_t length = (area_size - offset < sizeof(fill)) ? area_size - offset : sizeof(fill);
+
+        if (fwrite(fill, 1, length, file) != length)
+        {
+            return -1;
+        }
+    }
+
+    return fflush(file) == 0 ? 0 : -1;
+}
+
+BlockDeviceNVStoreMedia::BlockDeviceNVStoreMedia(BlockDevice* device) :
+    device(device), area_size(0), program_size(1), fill_on_erase(false)
+{
+}
+
+BlockDeviceNVStoreMedia::~BlockDeviceNVStoreMedia()
+{
+}
+
+int BlockDeviceNVStoreMedia::init(void)
+{
+    uint32_t erase_size = 0;
+
+    if (device == NULL || device->init() != 0)
+    {
+        return -1;
+    }
+
+    /* Devices that need no erase (erase value -1) are filled with 0xFF instead */
+    if (device->get_erase_value() != 0xFF && device->get_erase_value() != -1)
+    {
+        return -1;
+    }
+    fill_on_erase = (device->get_erase_value() == -1);
+
+    program_size = (uint32_t)device->get_program_size();
+    erase_size   = (uint32_t)device->get_erase_size();
+    if (erase_size == 0 || program_size == 0 || program_size > NVSTORE_MEDIA_FILL_CHUNK ||
+        NVSTORE_MEDIA_FILL_CHUNK % program_size != 0)
+    {
+        return -1;
+    }
+
+    area_size = (uint32_t)(device->size() / 2) / erase_size * erase_size;
+
+    return area_size ? 0 : -1;
+}
+
+uint32_t BlockDeviceNVStoreMedia::getAreaSize(void)
+{
+    return area_size;
+}
+
+uint32_t BlockDeviceNVStoreMedia::getProgramSize(void)
+{
+    return program_size;
+}
+
+int BlockDeviceNVStoreMedia::read(uint8_t area, uint32_t offset, void* buffer, uint32_t length)
+{
+    if (area > 1 || offset + length > area_size)
+    {
+        return -1;
+    }
+
+    return device->read(buffer, (bd_addr_t)area * area_size + offset, length);
+}
+
+int BlockDeviceNVStoreMedia::program(uint8_t area, uint32_t offset, const void* buffer, uint32_t length)
+{
+    if (area > 1 || offset + length > area_size)
+    {
+        return -1;
+    }
+
+    return device->program(buffer, (bd_addr_t)area * area_size + offset, length);
+}
+
+int BlockDeviceNVStoreMedia::erase(uint8_t area)
+{
+    uint8_t  fill[NVSTORE_MEDIA_FILL_CHUNK];
+    uint32_t offset = 0;
+    int      result = 0;
+
+    if (area > 1)
+    {
+        return -1;
+    }
+
+    result = device->erase((bd_addr_t)area * area_size, area_size);
+    if (result != 0 || !fill_on_erase)
+    {
+        return result;
+    }
+
+    memset(fill, 0xFF, sizeof(fill));
+    for (offset = 0; offset < area_size && result == 0; offset += sizeof(fill))
+    {
+        uint32_t length = (area_size - offset < sizeof(fill)) ? area_size - offset : sizeof(fill);
+
+        result = device->program(fill, (bd_addr_t)area * area_size + offset, length);
+    }
+
+    return result;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth NVRAM store media
+ *
+ * FileNVStoreMedia keeps both areas in one file (Linux tests, or a mounted file system),
+ * BlockDeviceNVStoreMedia uses the two halves of a block device.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "BlockDevice.h"
+#include "embedded_BLE_nvstore.h"
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines a media stored in a file, erased bytes read as 0xFF */
+class FileNVStoreMedia : public NVStoreMedia
+{
+public:
+    /** @param[in] path:      file, created when missing
+     *  @param[in] area_size: size of one area
+     */
+    FileNVStoreMedia(const char* path, uint32_t area_size);
+    virtual ~FileNVStoreMedia();
+
+    virtual int init(void);
+    virtual uint32_t getAreaSize(void);
+    virtual uint32_t getProgramSize(void);
+    virtual int read(uint8_t area, uint32_t offset, void* buffer, uint32_t length);
+    virtual int program(uint8_t area, uint32_t offset, const void* buffer, uint32_t length);
+    virtual int erase(uint8_t area);
+
+private:
+    const char* path;
+    uint32_t    area_size;
+    FILE*       file;
+};
+
+/** Defines a media using the first and second halves of a block device.
+ *  The block device must erase to 0xFF or not need erasing.
+ */
+class BlockDeviceNVStoreMedia : public NVStoreMedia
+{
+public:
+    /** @param[in] device: block device, owned by the caller */
+    BlockDeviceNVStoreMedia(BlockDevice* device);
+    virtual ~BlockDeviceNVStoreMedia();
+
+    virtual int init(void);
+    virtual uint32_t getAreaSize(void);
+    virtual uint32_t getProgramSize(void);
+    virtual int read(uint8_t area, uint32_t offset, void* buffer, uint32_t length);
+    virtual int program(uint8_t area, uint32_t offset, const void* buffer, uint32_t length);
+    virtual int erase(uint8_t area);
+
+private:
+    BlockDevice* device;
+    uint32_t     area_size;
+    uint32_t     program_size;
+    bool         fill_on_erase;
+};
+
+/** @} */
+}
+
+}
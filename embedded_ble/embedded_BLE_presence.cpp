@@ -0,0 +1,316 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth device presence table
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "embedded_BLE_presence.h"
+
+using namespace cypress::embedded;
+
+#define PRESENCE_KEY_VALID      (1ULL << 63)
+
+PresenceTable::PresenceTable() :
+    summary_interval(0), stale_timeout(0), last_summary(0), callback(NULL)
+{
+    clear();
+}
+
+void PresenceTable::configure(uint32_t summary_interval_ms, uint32_t stale_timeout_ms, PresenceSummaryCallback_t summary_callback)
+{
+    lock.lock();
+    summary_interval = summary_interval_ms;
+    stale_timeout    = stale_timeout_ms;
+    callback         = summary_callback;
+    lock.unlock();
+
+    clear();
+}
+
+void PresenceTable::clear(void)
+{
+    lock.lock();
+    memset(keys, 0, sizeof(keys));
+    memset(state, 0, sizeof(state));
+    memset(&statistics, 0, sizeof(statistics));
+    lock.unlock();
+}
+
+uint32_t PresenceTable::home(uint64_t key) const
+{
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (CAPACITY - 1);
+}
+
+void PresenceTable::update(const uint8_t* address, uint8_t address_type, int8_t rssi, uint32_t now_ms)
+{
+    uint64_t key    = PRESENCE_KEY_VALID | ((uint64_t)address_type << 48);
+    uint32_t slot   = 0;
+    uint32_t probes = 1;
+    uint8_t  i      = 0;
+
+    for (i = 0; i < 6; i++)
+    {
+        key |= (uint64_t)address[i] << (40 - 8 * i);
+    }
+
+    lock.lock();
+
+    statistics.updates++;
+
+    /* At most 3/4 of the slots are used, the probe always ends on a free slot */
+    for (slot = home(key); keys[slot] != 0 && keys[slot] != key; slot = (slot + 1) & (CAPACITY - 1))
+    {
+        probes++;
+    }
+    statistics.probes += probes;
+    if (probes > statistics.max_probes)
+    {
+        statistics.max_probes = probes;
+    }
+
+    if (keys[slot] == 0)
+    {
+        if (statistics.tracked >= MAX_TRACKED)
+        {
+            statistics.dropped++;
+            lock.unlock();
+            return;
+        }
+        keys[slot]         = key;
+        first_seen[slot]   = now_ms;
+        counts[slot]       = 0;
+        rssi_average[slot] = rssi * 256;
+        state[slot]        = PRESENCE_ARRIVED;
+        statistics.tracked++;
+        statistics.inserts++;
+    }
+    else if (state[slot] == 0)
+    {
+        state[slot] = PRESENCE_UPDATED;
+    }
+
+    /* min/max restart with every summary */
+    if (counts[slot] == 0 || rssi < rssi_min[slot])
+    {
+        rssi_min[slot] = rssi;
+    }
+    if (counts[slot] == 0 || rssi > rssi_max[slot])
+    {
+        rssi_max[slot] = rssi;
+    }
+    rssi_average[slot] += ((int32_t)rssi * 256 - rssi_average[slot]) / 8;
+    counts[slot]++;
+    last_seen[slot] = now_ms;
+
+    lock.unlock();
+}
+
+void PresenceTable::move(uint32_t from, uint32_t to)
+{
+    keys[to]         = keys[from];
+    first_seen[to]   = first_seen[from];
+    last_seen[to]    = last_seen[from];
+    counts[to]       = counts[from];
+    rssi_average[to] = rssi_average[from];
+    rssi_min[to]     = rssi_min[from];
+    rssi_max[to]     = rssi_max[from];
+    state[to]        = state[from];
+}
+
+/* Backward shift deletion, keeps every probe sequence intact without tombstones */
+void PresenceTable::remove(uint32_t slot)
+{
+    uint32_t next = slot;
+
+    for (;;)
+    {
+        uint32_t target = 0;
+
+        next = (next + 1) & (CAPACITY - 1);
+        if (keys[next] == 0)
+        {
+            break;
+        }
+
+        /* The entry stays when its home slot lies cyclically within (slot, next] */
+        target = home(keys[next]);
+        if ((slot <= next) ? (slot < target && target <= next) : (slot < target || target <= next))
+        {
+            continue;
+        }
+
+        move(next, slot);
+        slot = next;
+    }
+
+    keys[slot]  = 0;
+    state[slot] = 0;
+}
+
+void PresenceTable::fill(PresenceSummary& summary, uint32_t slot, uint8_t summary_state)
+{
+    uint8_t i = 0;
+
+    for (i = 0; i < 6; i++)
+    {
+        summary.address[i] = (uint8_t)(keys[slot] >> (40 - 8 * i));
+    }
+    summary.address_type = (uint8_t)(keys[slot] >> 48);
+    summary.state        = summary_state;
+    summary.rssi_min     = rssi_min[slot];
+    summary.rssi_max     = rssi_max[slot];
+    summary.rssi_average = (int8_t)((rssi_average[slot] + 128) >> 8);
+    summary.count        = counts[slot];
+    summary.first_seen   = first_seen[slot];
+    summary.last_seen    = last_seen[slot];
+}
+
+void PresenceTable::summarize(uint32_t now_ms)
+{
+    uint32_t slot  = 0;
+    uint16_t count = 0;
+
+    summary_lock.lock();
+    lock.lock();
+
+    while (slot < CAPACITY)
+    {
+        if (keys[slot] == 0)
+        {
+            slot++;
+            continue;
+        }
+
+        if ((int32_t)(now_ms - last_seen[slot]) > (int32_t)stale_timeout)
+        {
+            /* The slot is refilled by the backward shift, examine it again */
+            fill(pending[count++], slot, PRESENCE_DEPARTED);
+            remove(slot);
+            statistics.tracked--;
+            statistics.departed++;
+        }
+        else
+        {
+            if (state[slot] != 0)
+            {
+                fill(pending[count++], slot, state[slot]);
+                state[slot]  = 0;
+                counts[slot] = 0;
+            }
+            slot++;
+        }
+
+        /* Updates may go on while the application handles a full batch */
+        if (count == EMBEDDED_BLE_PRESENCE_SUMMARY_BATCH_SIZE)
+        {
+            statistics.summaries += count;
+            lock.unlock();
+            if (callback)
+            {
+                callback(pending, count);
+            }
+            count = 0;
+            lock.lock();
+        }
+    }
+
+    statistics.summaries += count;
+    last_summary = now_ms;
+    lock.unlock();
+
+    if (count && callback)
+    {
+        callback(pending, count);
+    }
+
+    summary_lock.unlock();
+}
+
+void PresenceTable::poll(uint32_t now_ms)
+{
+    if ((uint32_t)(now_ms - last_summary) >= summary_interval)
+    {
+        summarize(now_ms);
+    }
+}
+
+void PresenceTable::getStatistics(PresenceStatistics& stats)
+{
+    lock.lock();
+    stats = statistics;
+    lock.unlock();
+}
+
+uint32_t PresenceTable::serialize(const PresenceSummary* summaries, uint16_t count, char* buffer, uint32_t size)
+{
+    static const char* const states[] = { "", "arrived", "updated", "departed" };
+    uint32_t length = 0;
+    uint16_t i      = 0;
+    int      n      = 0;
+
+    if (size < 3)
+    {
+        return 0;
+    }
+
+    buffer[length++] = '[';
+    for (i = 0; i < count; i++)
+    {
+        const PresenceSummary& s = summaries[i];
+
+        n = snprintf(&buffer[length], size - length,
+                     "%s{\"addr\":\"%02X%02X%02X%02X%02X%02X\",\"type\":%u,\"state\":\"%s\","
+                     "\"count\":%lu,\"rssi_min\":%d,\"rssi_max\":%d,\"rssi_avg\":%d,\"first\":%lu,\"last\":%lu}",
+                     i ? "," : "",
+                     s.address[0], s.address[1], s.address[2], s.address[3], s.address[4], s.address[5],
+                     s.address_type, states[s.state <= PRESENCE_DEPARTED ? s.state : 0],
+                     (unsigned long)s.count, s.rssi_min, s.rssi_max, s.rssi_average,
+                     (unsigned long)s.first_seen, (unsigned long)s.last_seen);
+        if (n < 0 || (uint32_t)n >= size - length)
+        {
+            return 0;
+        }
+        length += n;
+    }
+
+    if (length + 2 > size)
+    {
+        return 0;
+    }
+    buffer[length++] = ']';
+    buffer[length]   = '\0';
+
+    return length;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth device presence table
+ *
+ * Aggregates the advertisement reports of every scanned device (first/last seen, report
+ * count, RSSI min/max/average) and periodically produces delta summaries of the devices that
+ * arrived, changed or departed, ready to be serialized and published to the cloud.
+ *
+ * The table is preallocated and stored as parallel arrays so that the per report lookup only
+ * touches the key array, the other fields are read or written once the slot is found.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+
+/** Number of slots of the presence table (power of two), up to 3/4 of them are used */
+#ifndef EMBEDDED_BLE_PRESENCE_TABLE_SIZE
+#define EMBEDDED_BLE_PRESENCE_TABLE_SIZE        (256)
+#endif
+
+/** Maximum number of summaries handed to the callback in one call */
+#ifndef EMBEDDED_BLE_PRESENCE_SUMMARY_BATCH_SIZE
+#define EMBEDDED_BLE_PRESENCE_SUMMARY_BATCH_SIZE (16)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_gap
+ *
+ * @{
+ */
+
+/** Defines the presence state reported in a summary */
+enum PresenceState
+{
+    PRESENCE_ARRIVED = 1,           /**< Device seen for the first time */
+    PRESENCE_UPDATED,               /**< Device seen again since the previous summary */
+    PRESENCE_DEPARTED,              /**< Device not seen for the stale timeout, removed from the table */
+};
+
+/** Defines the summary of one device since the previous summary */
+struct PresenceSummary
+{
+    uint8_t  address[6];            /**< Device address (most significant byte first) */
+    uint8_t  address_type;          /**< Device address type */
+    uint8_t  state;                 /**< Presence state (see #PresenceState) */
+    int8_t   rssi_min;              /**< Lowest RSSI since the previous summary */
+    int8_t   rssi_max;              /**< Highest RSSI since the previous summary */
+    int8_t   rssi_average;          /**< Exponentially weighted RSSI average */
+    uint32_t count;                 /**< Reports since the previous summary */
+    uint32_t first_seen;            /**< Time the device was first seen (ms) */
+    uint32_t last_seen;             /**< Time the device was last seen (ms) */
+};
+
+/** Defines the presence table counters */
+struct PresenceStatistics
+{
+    uint32_t tracked;               /**< Devices currently in the table */
+    uint32_t updates;               /**< Reports aggregated */
+    uint32_t inserts;               /**< Devices added */
+    uint32_t dropped;               /**< Reports of new devices dropped because the table was full */
+    uint32_t departed;              /**< Devices aged out */
+    uint32_t probes;                /**< Slots inspected by all updates, probes / updates is the lookup cost */
+    uint32_t max_probes;            /**< Longest lookup */
+    uint32_t summaries;             /**< Summaries emitted */
+};
+
+/** Defines the summary callback, summaries are only valid during the call */
+typedef void (*PresenceSummaryCallback_t)(const PresenceSummary* summaries, uint16_t count);
+
+/** Defines the device presence table */
+class PresenceTable
+{
+public:
+    PresenceTable();
+
+    /** Sets the summary interval, stale timeout and summary callback, clears the table.
+     *
+     * @param[in] summary_interval_ms: minimum time between two summaries
+     * @param[in] stale_timeout_ms:    time after which a device not seen departs
+     * @param[in] callback:            summary callback
+     */
+    void configure(uint32_t summary_interval_ms, uint32_t stale_timeout_ms, PresenceSummaryCallback_t callback);
+
+    /** Aggregates a report, called by the scan pipeline for every accepted report */
+    void update(const uint8_t* address, uint8_t address_type, int8_t rssi, uint32_t now_ms);
+
+    /** Emits a summary when the summary interval has elapsed.
+     *  The callback runs in the caller's context, call this from an application thread
+     *  so that publishing does not hold up the WICED HCI event worker.
+     */
+    void poll(uint32_t now_ms);
+
+    /** Ages out stale devices and emits the summary now */
+    void summarize(uint32_t now_ms);
+
+    /** Removes every device */
+    void clear(void);
+
+    /** Copies the counters */
+    void getStatistics(PresenceStatistics& stats);
+
+    /** Serializes summaries as a JSON array, for CloudClient::publish.
+     *
+     * @param[in]  summaries: summaries
+     * @param[in]  count:     number of summaries
+     * @param[out] buffer:    output buffer
+     * @param[in]  size:      output buffer size
+     *
+     * @return length of the JSON text, 0 if the buffer is too small
+     */
+    static uint32_t serialize(const PresenceSummary* summaries, uint16_t count, char* buffer, uint32_t size);
+
+private:
+    static const uint32_t CAPACITY    = EMBEDDED_BLE_PRESENCE_TABLE_SIZE;
+    static const uint32_t MAX_TRACKED = EMBEDDED_BLE_PRESENCE_TABLE_SIZE / 4 * 3;
+
+    uint32_t home(uint64_t key) const;
+    void     remove(uint32_t slot);
+    void     move(uint32_t from, uint32_t to);
+    void     fill(PresenceSummary& summary, uint32_t slot, uint8_t summary_state);
+
+    /* key 0 marks a free slot, otherwise valid bit | address type | address */
+    uint64_t keys[CAPACITY];
+    uint32_t first_seen[CAPACITY];
+    uint32_t last_seen[CAPACITY];
+    uint32_t counts[CAPACITY];
+    int16_t  rssi_average[CAPACITY];    /* 8.8 fixed point */
+    int8_t   rssi_min[CAPACITY];
+    int8_t   rssi_max[CAPACITY];
+    uint8_t  state[CAPACITY];
+
+    uint32_t                  summary_interval;
+    uint32_t                  stale_timeout;
+    uint32_t                  last_summary;
+    PresenceSummaryCallback_t callback;
+    PresenceStatistics        statistics;
+    rtos::Mutex               lock;
+    rtos::Mutex               summary_lock;
+
+    PresenceSummary           pending[EMBEDDED_BLE_PRESENCE_SUMMARY_BATCH_SIZE];
+};
+
+/** @} */
+}
+
+}
@@ -0,0 +1,601 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth Mesh provisioning manager
+ */
+
+#include <string.h>
+#include "embedded_BLE_provisioning.h"
+
+#include "wiced_hci_bt_mesh.h"
+
+using namespace cypress::embedded;
+
+#define PROVISIONING_WAKE_FLAG      (0x1)
+#define PROVISIONING_STOP_FLAG      (0x2)
+
+#define PROVISIONING_ACTION_NOTIFY  (0)
+#define PROVISIONING_ACTION_OPEN    (1)
+#define PROVISIONING_ACTION_CLOSE   (2)
+
+ProvisioningManager::ProvisioningManager(ProvisioningBearer& bearer) :
+    bearer(bearer), event_callback(NULL), event_context(NULL), sequence(0), next_conn_id(0), started(false), first_start_ms(0), thread(NULL)
+{
+    memset(devices, 0, sizeof(devices));
+    memset(sessions, 0, sizeof(sessions));
+    memset(&statistics, 0, sizeof(statistics));
+
+    params.sessions             = EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS;
+    if (params.sessions > bearer.getMaxSessions())
+    {
+        params.sessions = bearer.getMaxSessions();
+    }
+    params.max_attempts         = 3;
+    params.backoff_ms           = 2000;
+    params.backoff_max_ms       = 30000;
+    params.connect_timeout_ms   = 10000;
+    params.provision_timeout_ms = 60000;
+}
+
+ProvisioningManager::~ProvisioningManager()
+{
+    stop();
+}
+
+void ProvisioningManager::configure(const ProvisioningParameters& parameters)
+{
+    lock.lock();
+
+    params = parameters;
+    if (params.sessions == 0 || params.sessions > EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS)
+    {
+        params.sessions = EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS;
+    }
+    if (params.sessions > bearer.getMaxSessions())
+    {
+        params.sessions = bearer.getMaxSessions();
+    }
+    if (params.max_attempts == 0)
+    {
+        params.max_attempts = 1;
+    }
+
+    lock.unlock();
+
+    flags.set(PROVISIONING_WAKE_FLAG);
+}
+
+void ProvisioningManager::setEventCallback(ProvisioningEventCallback_t callback_function, void* context)
+{
+    lock.lock();
+    event_callback = callback_function;
+    event_context  = context;
+    lock.unlock();
+}
+
+ble_error_t ProvisioningManager::start(void)
+{
+    if (thread != NULL)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    flags.clear(PROVISIONING_WAKE_FLAG | PROVISIONING_STOP_FLAG);
+    thread = new rtos::Thread(osPriorityNormal, EMBEDDED_BLE_MESH_PROVISIONING_THREAD_STACK_SIZE, NULL, "provisioning");
+    thread->start(callback(this, &ProvisioningManager::worker));
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t ProvisioningManager::stop(void)
+{
+    if (thread == NULL)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    flags.set(PROVISIONING_STOP_FLAG);
+    thread->join();
+    delete thread;
+    thread = NULL;
+
+    return BLE_ERROR_NONE;
+}
+
+void ProvisioningManager::worker(void)
+{
+    for (;;)
+    {
+        uint32_t wait   = service((uint32_t)rtos::Kernel::get_ms_count());
+        uint32_t result = flags.wait_any(PROVISIONING_WAKE_FLAG | PROVISIONING_STOP_FLAG, wait);
+
+        if (!(result & osFlagsError) && (result & PROVISIONING_STOP_FLAG))
+        {
+            break;
+        }
+    }
+}
+
+ble_error_t ProvisioningManager::add(const uint8_t* uuid)
+{
+    return add(uuid, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+ble_error_t ProvisioningManager::add(const uint8_t* uuid, uint32_t now_ms)
+{
+    Actions actions;
+    Device* device = NULL;
+    int     i = 0;
+
+    if (uuid == NULL)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_PROVISIONING_QUEUE_SIZE; i++)
+    {
+        if (!devices[i].used)
+        {
+            if (device == NULL)
+            {
+                device = &devices[i];
+            }
+        }
+        else if (memcmp(devices[i].uuid, uuid, EMBEDDED_BLE_MESH_UUID_LENGTH) == 0)
+        {
+            lock.unlock();
+            return BLE_ERROR_INVALID_STATE;
+        }
+    }
+
+    if (device == NULL)
+    {
+        lock.unlock();
+        return BLE_ERROR_NO_MEM;
+    }
+
+    memset(device, 0, sizeof(*device));
+    memcpy(device->uuid, uuid, EMBEDDED_BLE_MESH_UUID_LENGTH);
+    device->used     = true;
+    device->state    = PROVISIONING_STATE_QUEUED;
+    device->sequence = sequence++;
+    device->added_ms = now_ms;
+    device->stage_ms = now_ms;
+
+    statistics.added++;
+    statistics.queued++;
+    actions.count = 0;
+    notify(*device, now_ms, actions);
+
+    lock.unlock();
+
+    dispatch(actions, now_ms);
+
+    flags.set(PROVISIONING_WAKE_FLAG);
+
+    return BLE_ERROR_NONE;
+}
+
+/* Called with the lock held */
+ProvisioningManager::Device* ProvisioningManager::findSession(uint16_t conn_id)
+{
+    uint8_t i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS; i++)
+    {
+        if (sessions[i] != NULL && sessions[i]->conn_id == conn_id)
+        {
+            return sessions[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Called with the lock held */
+void ProvisioningManager::leaveStage(Device& device, ProvisioningStage stage, uint32_t now_ms)
+{
+    ProvisioningStageStatistics& stats = statistics.stages[stage];
+    uint32_t elapsed = now_ms - device.stage_ms;
+
+    stats.count++;
+    stats.total_ms += elapsed;
+    if (elapsed > stats.max_ms)
+    {
+        stats.max_ms = elapsed;
+    }
+    device.stage_ms = now_ms;
+}
+
+/* Queues the progress event of a device, called with the lock held */
+void ProvisioningManager::notify(Device& device, uint32_t now_ms, Actions& actions)
+{
+    ProvisioningProgress& progress = actions.action[actions.count].progress;
+
+    if (event_callback == NULL)
+    {
+        return;
+    }
+
+    memcpy(progress.uuid, device.uuid, EMBEDDED_BLE_MESH_UUID_LENGTH);
+    progress.state      = (ProvisioningState)device.state;
+    progress.conn_id    = device.conn_id;
+    progress.attempt    = device.attempt;
+    progress.result     = device.result;
+    progress.elapsed_ms = now_ms - device.added_ms;
+    progress.remaining  = statistics.queued + statistics.active;
+
+    actions.action[actions.count++].type = PROVISIONING_ACTION_NOTIFY;
+    actions.callback = event_callback;
+    actions.context  = event_context;
+}
+
+/* Makes the collected callbacks and bearer calls, called without the lock */
+void ProvisioningManager::dispatch(Actions& actions, uint32_t now_ms)
+{
+    Actions failed;
+    Device* device = NULL;
+    uint8_t i = 0;
+
+    for (i = 0; i < actions.count; i++)
+    {
+        ProvisioningProgress& progress = actions.action[i].progress;
+
+        if (actions.action[i].type == PROVISIONING_ACTION_NOTIFY)
+        {
+            actions.callback(progress, actions.context);
+        }
+        else if (actions.action[i].type == PROVISIONING_ACTION_CLOSE)
+        {
+            bearer.close(progress.conn_id);
+        }
+        else if (bearer.open(progress.conn_id, progress.uuid) != BLE_ERROR_NONE)
+        {
+            /* The bearer may report the connection or the result before returning */
+            failed.count = 0;
+
+            lock.lock();
+            device = findSession(progress.conn_id);
+            if (device != NULL && device->state == PROVISIONING_STATE_CONNECTING)
+            {
+                leaveStage(*device, PROVISIONING_STAGE_CONNECT, now_ms);
+                finish(*device, WICED_BT_MESH_PROVISION_RESULT_FAILED, now_ms, failed);
+            }
+            lock.unlock();
+
+            dispatch(failed, now_ms);
+            flags.set(PROVISIONING_WAKE_FLAG);
+        }
+    }
+}
+
+/* Ends the attempt of a device in a session, called with the lock held */
+void ProvisioningManager::finish(Device& device, uint8_t result, uint32_t now_ms, Actions& actions)
+{
+    uint32_t backoff = 0;
+    uint8_t  i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS; i++)
+    {
+        if (sessions[i] == &device)
+        {
+            sessions[i] = NULL;
+        }
+    }
+    statistics.active--;
+    actions.action[actions.count].type = PROVISIONING_ACTION_CLOSE;
+    actions.action[actions.count++].progress.conn_id = device.conn_id;
+    device.result = result;
+
+    if (result == WICED_BT_MESH_PROVISION_RESULT_SUCCESS)
+    {
+        device.state = PROVISIONING_STATE_DONE;
+        statistics.provisioned++;
+        statistics.elapsed_ms = now_ms - first_start_ms;
+    }
+    else if (device.attempt < params.max_attempts)
+    {
+        /* Doubled on each retry, bounded by backoff_max_ms */
+        backoff = params.backoff_ms;
+        for (i = 1; i < device.attempt && backoff < params.backoff_max_ms; i++)
+        {
+            backoff <<= 1;
+        }
+        if (backoff > params.backoff_max_ms)
+        {
+            backoff = params.backoff_max_ms;
+        }
+
+        device.state  = PROVISIONING_STATE_RETRY_WAIT;
+        device.due_ms = now_ms + backoff;
+        statistics.retries++;
+        statistics.queued++;
+    }
+    else
+    {
+        device.state = PROVISIONING_STATE_FAILED;
+        statistics.failed++;
+    }
+
+    notify(device, now_ms, actions);
+
+    device.conn_id = 0;
+    if (device.state != PROVISIONING_STATE_RETRY_WAIT)
+    {
+        device.used = false;
+    }
+}
+
+bool ProvisioningManager::connected(uint16_t conn_id, bool is_connected)
+{
+    return connected(conn_id, is_connected, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+bool ProvisioningManager::connected(uint16_t conn_id, bool is_connected, uint32_t now_ms)
+{
+    Actions actions;
+    Device* device = NULL;
+
+    actions.count = 0;
+
+    lock.lock();
+
+    device = findSession(conn_id);
+    if (device == NULL)
+    {
+        lock.unlock();
+        return false;
+    }
+
+    if (device->state == PROVISIONING_STATE_CONNECTING && is_connected)
+    {
+        leaveStage(*device, PROVISIONING_STAGE_CONNECT, now_ms);
+        device->state = PROVISIONING_STATE_PROVISIONING;
+        notify(*device, now_ms, actions);
+    }
+    else if (!is_connected)
+    {
+        leaveStage(*device, (device->state == PROVISIONING_STATE_CONNECTING) ?
+                   PROVISIONING_STAGE_CONNECT : PROVISIONING_STAGE_PROVISION, now_ms);
+        finish(*device, WICED_BT_MESH_PROVISION_RESULT_FAILED, now_ms, actions);
+    }
+
+    lock.unlock();
+
+    dispatch(actions, now_ms);
+
+    flags.set(PROVISIONING_WAKE_FLAG);
+
+    return true;
+}
+
+bool ProvisioningManager::completed(uint16_t conn_id, uint8_t result)
+{
+    return completed(conn_id, result, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+bool ProvisioningManager::completed(uint16_t conn_id, uint8_t result, uint32_t now_ms)
+{
+    Actions actions;
+    Device* device = NULL;
+
+    actions.count = 0;
+
+    lock.lock();
+
+    device = findSession(conn_id);
+    if (device == NULL)
+    {
+        lock.unlock();
+        return false;
+    }
+
+    /* The controller may report the result without reporting the connection first */
+    if (device->state == PROVISIONING_STATE_CONNECTING)
+    {
+        leaveStage(*device, PROVISIONING_STAGE_CONNECT, now_ms);
+    }
+    leaveStage(*device, PROVISIONING_STAGE_PROVISION, now_ms);
+    finish(*device, result, now_ms, actions);
+
+    lock.unlock();
+
+    dispatch(actions, now_ms);
+
+    flags.set(PROVISIONING_WAKE_FLAG);
+
+    return true;
+}
+
+uint16_t ProvisioningManager::getSession(void)
+{
+    uint16_t conn_id = 0;
+    uint8_t  count = 0;
+    uint8_t  i = 0;
+
+    lock.lock();
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS; i++)
+    {
+        if (sessions[i] != NULL)
+        {
+            conn_id = sessions[i]->conn_id;
+            count++;
+        }
+    }
+
+    lock.unlock();
+
+    return (count == 1) ? conn_id : 0;
+}
+
+uint32_t ProvisioningManager::service(uint32_t now_ms)
+{
+    Actions  actions;
+    uint32_t wait = osWaitForever;
+    uint32_t limit = 0;
+    int32_t  remaining = 0;
+    Device*  device = NULL;
+    uint16_t conn_id = 0;
+    uint8_t  s = 0;
+    int      i = 0;
+
+    actions.count = 0;
+
+    lock.lock();
+
+    /* Time out the late sessions */
+    for (s = 0; s < EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS; s++)
+    {
+        device = sessions[s];
+        if (device == NULL)
+        {
+            continue;
+        }
+
+        limit = (device->state == PROVISIONING_STATE_CONNECTING) ? params.connect_timeout_ms : params.provision_timeout_ms;
+        if (limit == 0)
+        {
+            continue;
+        }
+
+        remaining = (int32_t)(device->stage_ms + limit - now_ms);
+        if (remaining > 0)
+        {
+            wait = ((uint32_t)remaining < wait) ? (uint32_t)remaining : wait;
+            continue;
+        }
+
+        statistics.timeouts++;
+        leaveStage(*device, (device->state == PROVISIONING_STATE_CONNECTING) ?
+                   PROVISIONING_STAGE_CONNECT : PROVISIONING_STAGE_PROVISION, now_ms);
+        finish(*device, WICED_BT_MESH_PROVISION_RESULT_TIMEOUT, now_ms, actions);
+    }
+
+    /* Start the oldest waiting devices on the free sessions */
+    for (s = 0; s < params.sessions; s++)
+    {
+        if (sessions[s] != NULL)
+        {
+            continue;
+        }
+
+        device = NULL;
+        for (i = 0; i < EMBEDDED_BLE_MESH_PROVISIONING_QUEUE_SIZE; i++)
+        {
+            Device& candidate = devices[i];
+
+            if (!candidate.used ||
+                (candidate.state != PROVISIONING_STATE_QUEUED &&
+                 (candidate.state != PROVISIONING_STATE_RETRY_WAIT || (int32_t)(candidate.due_ms - now_ms) > 0)))
+            {
+                continue;
+            }
+            if (device == NULL || (int32_t)(candidate.sequence - device->sequence) < 0)
+            {
+                device = &candidate;
+            }
+        }
+
+        if (device == NULL)
+        {
+            break;
+        }
+
+        /* Session connection ids rotate so that a late event of a closed session is not taken for a new one */
+        do
+        {
+            conn_id = EMBEDDED_BLE_MESH_PROVISIONING_CONN_ID_BASE + next_conn_id++;
+        } while (findSession(conn_id) != NULL);
+
+        if (!started)
+        {
+            started = true;
+            first_start_ms = now_ms;
+        }
+
+        leaveStage(*device, PROVISIONING_STAGE_QUEUE, now_ms);
+        device->attempt++;
+        device->state   = PROVISIONING_STATE_CONNECTING;
+        device->conn_id = conn_id;
+        sessions[s] = device;
+        statistics.queued--;
+        statistics.active++;
+        notify(*device, now_ms, actions);
+
+        /* Opened once the lock is released, a failed open ends the attempt then */
+        actions.action[actions.count].type = PROVISIONING_ACTION_OPEN;
+        actions.action[actions.count].progress.conn_id = conn_id;
+        memcpy(actions.action[actions.count++].progress.uuid, device->uuid, EMBEDDED_BLE_MESH_UUID_LENGTH);
+
+        if (params.connect_timeout_ms != 0 && params.connect_timeout_ms < wait)
+        {
+            wait = params.connect_timeout_ms;
+        }
+    }
+
+    /* Wake up for the next retry */
+    for (i = 0; i < EMBEDDED_BLE_MESH_PROVISIONING_QUEUE_SIZE; i++)
+    {
+        if (devices[i].used && devices[i].state == PROVISIONING_STATE_RETRY_WAIT)
+        {
+            remaining = (int32_t)(devices[i].due_ms - now_ms);
+            if (remaining > 0 && (uint32_t)remaining < wait)
+            {
+                wait = (uint32_t)remaining;
+            }
+        }
+    }
+
+    lock.unlock();
+
+    dispatch(actions, now_ms);
+
+    return wait;
+}
+
+void ProvisioningManager::getStatistics(ProvisioningStatistics& stats)
+{
+    lock.lock();
+
+    stats = statistics;
+    stats.nodes_per_minute = 0;
+    if (stats.elapsed_ms != 0)
+    {
+        stats.nodes_per_minute = (uint32_t)((uint64_t)stats.provisioned * 60000 / stats.elapsed_ms);
+    }
+
+    lock.unlock();
+}
@@ -0,0 +1,300 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth Mesh provisioning manager
+ *
+ * Onboards a list of devices: device UUIDs wait in a queue and a bounded number of provisioning
+ * sessions run at once, each on its own proxy connection. A session goes through
+ * - connect:   the bearer opens the connection to the device,
+ * - provision: the provisioner (usually the cloud, over Mesh::sendData) provisions the device,
+ *              the Bluetooth Controller reports the result.
+ * Failed and timed out sessions are retried with an exponential backoff, every state change is
+ * reported to the event callback, and the time spent in the queue and in each stage is accounted.
+ *
+ * The manager does not talk to the controller itself, a ProvisioningBearer opens and closes
+ * the sessions and the owner reports connections and results with ProvisioningManager::connected
+ * and ProvisioningManager::completed.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+
+/** Number of devices that can wait to be provisioned */
+#ifndef EMBEDDED_BLE_MESH_PROVISIONING_QUEUE_SIZE
+#define EMBEDDED_BLE_MESH_PROVISIONING_QUEUE_SIZE       (128)
+#endif
+
+/** Maximum number of concurrent provisioning sessions, each takes a proxy connection */
+#ifndef EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS
+#define EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS     (2)
+#endif
+
+/** First proxy connection id of the provisioning sessions, sessions use the 256 ids from there in turn */
+#ifndef EMBEDDED_BLE_MESH_PROVISIONING_CONN_ID_BASE
+#define EMBEDDED_BLE_MESH_PROVISIONING_CONN_ID_BASE     (0x0100)
+#endif
+
+/** Stack size of the provisioning manager thread */
+#ifndef EMBEDDED_BLE_MESH_PROVISIONING_THREAD_STACK_SIZE
+#define EMBEDDED_BLE_MESH_PROVISIONING_THREAD_STACK_SIZE (2048)
+#endif
+
+/** Length of a device UUID */
+#define EMBEDDED_BLE_MESH_UUID_LENGTH                   (16)
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines the provisioning state of a device */
+enum ProvisioningState
+{
+    PROVISIONING_STATE_QUEUED,          /**< Waiting for a session */
+    PROVISIONING_STATE_CONNECTING,      /**< Session opened, waiting for the connection */
+    PROVISIONING_STATE_PROVISIONING,    /**< Connected, waiting for the provisioning result */
+    PROVISIONING_STATE_RETRY_WAIT,      /**< Attempt failed, waiting for the backoff to elapse */
+    PROVISIONING_STATE_DONE,            /**< Provisioned, the device leaves the queue */
+    PROVISIONING_STATE_FAILED,          /**< Out of attempts, the device leaves the queue */
+};
+
+/** Defines the timed provisioning stages */
+enum ProvisioningStage
+{
+    PROVISIONING_STAGE_QUEUE,           /**< Queued or waiting for a retry */
+    PROVISIONING_STAGE_CONNECT,         /**< Session opened until connected */
+    PROVISIONING_STAGE_PROVISION,       /**< Connected until the provisioning result */
+    PROVISIONING_STAGES,                /**< Number of stages */
+};
+
+/** Defines a progress event */
+struct ProvisioningProgress
+{
+    uint8_t           uuid[EMBEDDED_BLE_MESH_UUID_LENGTH]; /**< Device UUID */
+    ProvisioningState state;            /**< New state of the device */
+    uint16_t          conn_id;          /**< Proxy connection of the session, 0 outside a session */
+    uint8_t           attempt;          /**< Attempt number, 1 for the first one */
+    uint8_t           result;           /**< WICED_BT_MESH_PROVISION_RESULT_... of the last attempt */
+    uint32_t          elapsed_ms;       /**< Time since the device was added */
+    uint16_t          remaining;        /**< Devices queued or in a session */
+};
+
+/** Defines the provisioning manager configuration */
+struct ProvisioningParameters
+{
+    uint8_t  sessions;                  /**< Concurrent sessions, at most EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS and ProvisioningBearer::getMaxSessions */
+    uint8_t  max_attempts;              /**< Attempts per device */
+    uint32_t backoff_ms;                /**< Delay before the first retry, doubled for each further retry */
+    uint32_t backoff_max_ms;            /**< Longest delay between retries */
+    uint32_t connect_timeout_ms;        /**< Time allowed to connect, 0 waits forever */
+    uint32_t provision_timeout_ms;      /**< Time allowed to provision once connected, 0 waits forever */
+};
+
+/** Defines the time spent in a stage */
+struct ProvisioningStageStatistics
+{
+    uint32_t count;                     /**< Times the stage was left */
+    uint32_t total_ms;                  /**< Time spent in the stage */
+    uint32_t max_ms;                    /**< Longest time in the stage */
+};
+
+/** Defines the provisioning manager counters */
+struct ProvisioningStatistics
+{
+    uint32_t added;                     /**< Devices added */
+    uint32_t provisioned;               /**< Devices provisioned */
+    uint32_t failed;                    /**< Devices out of attempts */
+    uint32_t retries;                   /**< Attempts retried */
+    uint32_t timeouts;                  /**< Attempts timed out */
+    uint16_t queued;                    /**< Devices waiting for a session */
+    uint16_t active;                    /**< Sessions running */
+    uint32_t elapsed_ms;                /**< Time from the first session to the last provisioned device */
+    uint32_t nodes_per_minute;          /**< Provisioned devices per minute over elapsed_ms */
+    ProvisioningStageStatistics stages[PROVISIONING_STAGES]; /**< Time per stage */
+};
+
+/** Defines the bearer opening the provisioning sessions */
+class ProvisioningBearer
+{
+public:
+    virtual ~ProvisioningBearer() {}
+
+    /** Opens a session with a device on a proxy connection.
+     *  The connection and the result are reported with ProvisioningManager::connected and
+     *  ProvisioningManager::completed, possibly before returning.
+     */
+    virtual ble_error_t open(uint16_t conn_id, const uint8_t* uuid) = 0;
+
+    /** Closes a session, the device is provisioned or the attempt failed */
+    virtual void close(uint16_t conn_id) = 0;
+
+    /** Returns the number of sessions the bearer can tell apart, ProvisioningParameters::sessions is bounded by it */
+    virtual uint8_t getMaxSessions(void) const
+    {
+        return EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS;
+    }
+};
+
+/** Defines the provisioning progress callback, called with the context given with it and without the manager locked */
+typedef void (*ProvisioningEventCallback_t)(const ProvisioningProgress& progress, void* context);
+
+/** Defines the provisioning manager */
+class ProvisioningManager
+{
+public:
+    ProvisioningManager(ProvisioningBearer& bearer);
+
+    ~ProvisioningManager();
+
+    /** Sets the configuration, applied to the sessions started from now */
+    void configure(const ProvisioningParameters& params);
+
+    /** Sets the progress callback */
+    void setEventCallback(ProvisioningEventCallback_t callback, void* context = NULL);
+
+    /** Queues a device.
+     *
+     * @return BLE_ERROR_INVALID_STATE when the device is already queued, BLE_ERROR_NO_MEM when the queue is full
+     */
+    ble_error_t add(const uint8_t* uuid);
+
+    /** Queues a device at now_ms, for callers driving ProvisioningManager::service with their own clock */
+    ble_error_t add(const uint8_t* uuid, uint32_t now_ms);
+
+    /** Reports a session connection opened or closed.
+     *
+     * @return false when conn_id is not a running session
+     */
+    bool connected(uint16_t conn_id, bool is_connected);
+
+    /** Reports a session connection opened or closed at now_ms */
+    bool connected(uint16_t conn_id, bool is_connected, uint32_t now_ms);
+
+    /** Reports the provisioning result of a session (WICED_BT_MESH_PROVISION_RESULT_...).
+     *
+     * @return false when conn_id is not a running session
+     */
+    bool completed(uint16_t conn_id, uint8_t result);
+
+    /** Reports the provisioning result of a session at now_ms */
+    bool completed(uint16_t conn_id, uint8_t result, uint32_t now_ms);
+
+    /** Returns the connection id of the running session when there is exactly one, 0 otherwise.
+     *  Lets the owner of a bearer running a single session attribute a result that does not name it.
+     */
+    uint16_t getSession(void);
+
+    /** Starts the sessions and retries due and times out the late ones.
+     *
+     * @return time until the next timeout or retry (ms), osWaitForever when there is none
+     */
+    uint32_t service(uint32_t now_ms);
+
+    /** Starts the manager thread */
+    ble_error_t start(void);
+
+    /** Stops the manager thread, running sessions are left to complete */
+    ble_error_t stop(void);
+
+    /** Copies the counters */
+    void getStatistics(ProvisioningStatistics& stats);
+
+private:
+    struct Device
+    {
+        uint8_t  uuid[EMBEDDED_BLE_MESH_UUID_LENGTH];
+        bool     used;
+        uint8_t  state;
+        uint8_t  attempt;
+        uint8_t  result;
+        uint16_t conn_id;
+        uint32_t sequence;
+        uint32_t added_ms;
+        uint32_t stage_ms;
+        uint32_t due_ms;
+    };
+
+    /* Callbacks and bearer calls collected with the lock held and made once it is released */
+    struct Actions
+    {
+        struct Action
+        {
+            uint8_t              type;
+            ProvisioningProgress progress;
+        };
+
+        /* A notify and a close for each timed out session, a notify and an open for each started one */
+        Action                      action[4 * EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS];
+        uint8_t                     count;
+        ProvisioningEventCallback_t callback;
+        void*                       context;
+    };
+
+    Device* findSession(uint16_t conn_id);
+    void leaveStage(Device& device, ProvisioningStage stage, uint32_t now_ms);
+    void finish(Device& device, uint8_t result, uint32_t now_ms, Actions& actions);
+    void notify(Device& device, uint32_t now_ms, Actions& actions);
+    void dispatch(Actions& actions, uint32_t now_ms);
+    void worker(void);
+
+    ProvisioningBearer&         bearer;
+    Device                      devices[EMBEDDED_BLE_MESH_PROVISIONING_QUEUE_SIZE];
+    Device*                     sessions[EMBEDDED_BLE_MESH_MAX_PROVISIONING_SESSIONS];
+    ProvisioningParameters      params;
+    ProvisioningEventCallback_t event_callback;
+    void*                       event_context;
+    ProvisioningStatistics      statistics;
+    uint32_t                    sequence;
+    uint8_t                     next_conn_id;
+    bool                        started;
+    uint32_t                    first_start_ms;
+    rtos::Mutex                 lock;
+    rtos::EventFlags            flags;
+    rtos::Thread*               thread;
+};
+
+/** @} */
+}
+
+}
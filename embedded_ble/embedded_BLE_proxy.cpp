@@ -0,0 +1,503 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth Mesh proxy connection table
+ */
+
+#include <string.h>
+#include "embedded_BLE_proxy.h"
+
+using namespace cypress::embedded;
+
+#define PROXY_RECORD_HEADER_LENGTH  (2)
+#define PROXY_RECORD_WRAP           (0xFFFF)
+
+ProxyConnectionTable::ProxyConnectionTable(ProxyTransmit_t transmit, void* context, ProxyControl_t control) :
+    next(0), draining(false), last_conn_id(0), switches(0), transmit_function(transmit), control_function(control),
+    transmit_context(context), changed(lock)
+{
+    memset(connections, 0, sizeof(connections));
+}
+
+int ProxyConnectionTable::find(uint16_t conn_id)
+{
+    int i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS; i++)
+    {
+        if (connections[i].used && connections[i].info.conn_id == conn_id)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void ProxyConnectionTable::reset(Connection& connection)
+{
+    connection.info.tx_dropped += connection.info.queued;
+    connection.info.queued = 0;
+    connection.head = 0;
+    connection.tail = 0;
+}
+
+ble_error_t ProxyConnectionTable::open(uint16_t conn_id)
+{
+    int i = 0;
+
+    if (conn_id == 0)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    lock.lock();
+    i = find(conn_id);
+    if (i < 0)
+    {
+        for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS && connections[i].used; i++)
+        {
+        }
+        // A closed connection with nothing left to send can be recycled
+        if (i == EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS && !draining)
+        {
+            for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS &&
+                        (connections[i].info.connected || connections[i].info.queued); i++)
+            {
+            }
+        }
+        if (i == EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS)
+        {
+            lock.unlock();
+            return BLE_ERROR_NO_MEM;
+        }
+        memset(&connections[i].info, 0, sizeof(connections[i].info));
+        connections[i].info.conn_id = conn_id;
+        connections[i].used = true;
+        connections[i].head = 0;
+        connections[i].tail = 0;
+    }
+    else if (!draining)
+    {
+        reset(connections[i]);
+    }
+    connections[i].info.connected = true;
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t ProxyConnectionTable::close(uint16_t conn_id)
+{
+    int i = 0;
+
+    lock.lock();
+    i = find(conn_id);
+    if (i < 0)
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    // While a thread is sending, it drops the packets of closed connections itself
+    connections[i].info.connected = false;
+    if (!draining)
+    {
+        reset(connections[i]);
+    }
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+/* Called with lock held */
+bool ProxyConnectionTable::enqueue(Connection& connection, const uint8_t* data, uint16_t length)
+{
+    uint16_t needed = PROXY_RECORD_HEADER_LENGTH + length;
+    uint16_t offset = connection.tail;
+
+    if (connection.info.queued && connection.tail <= connection.head)
+    {
+        // The free space is between tail and head
+        if (connection.tail + needed > connection.head)
+        {
+            return false;
+        }
+    }
+    else if (connection.tail + needed > EMBEDDED_BLE_MESH_PROXY_QUEUE_SIZE)
+    {
+        // No room up to the end: wrap to the start, in front of head
+        if (connection.info.queued && needed > connection.head)
+        {
+            return false;
+        }
+        if (EMBEDDED_BLE_MESH_PROXY_QUEUE_SIZE - connection.tail >= PROXY_RECORD_HEADER_LENGTH)
+        {
+            connection.queue[connection.tail]     = (uint8_t)PROXY_RECORD_WRAP;
+            connection.queue[connection.tail + 1] = (uint8_t)(PROXY_RECORD_WRAP >> 8);
+        }
+        offset = 0;
+        if (!connection.info.queued)
+        {
+            connection.head = 0;
+        }
+    }
+
+    connection.queue[offset]     = (uint8_t)length;
+    connection.queue[offset + 1] = (uint8_t)(length >> 8);
+    memcpy(&connection.queue[offset + PROXY_RECORD_HEADER_LENGTH], data, length);
+    connection.tail = offset + needed;
+    connection.info.queued++;
+
+    return true;
+}
+
+/* Called with lock held, releases it while the packet is sent */
+void ProxyConnectionTable::transmit(Connection& connection, const uint8_t* data, uint16_t length)
+{
+    uint16_t conn_id = connection.info.conn_id;
+    bool     sent    = false;
+
+    if (conn_id != last_conn_id)
+    {
+        switches++;
+        last_conn_id = conn_id;
+    }
+
+    lock.unlock();
+    sent = transmit_function(conn_id, data, length, transmit_context);
+    lock.lock();
+
+    if (sent)
+    {
+        connection.info.tx_packets++;
+        connection.info.tx_bytes += length;
+    }
+    else
+    {
+        connection.info.tx_dropped++;
+    }
+}
+
+/* Called with lock held and draining set */
+void ProxyConnectionTable::drain(void)
+{
+    for (;;)
+    {
+        int      chosen = -1;
+        int      i      = 0;
+        uint16_t burst  = 0;
+
+        for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS; i++)
+        {
+            int candidate = (next + i) % EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS;
+
+            if (connections[candidate].used && connections[candidate].info.queued)
+            {
+                chosen = candidate;
+                break;
+            }
+        }
+        if (chosen < 0)
+        {
+            return;
+        }
+        next = (chosen + 1) % EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS;
+
+        Connection& connection = connections[chosen];
+        for (burst = 0; burst < EMBEDDED_BLE_MESH_PROXY_BURST && connection.info.queued; burst++)
+        {
+            uint16_t length = 0;
+
+            if (EMBEDDED_BLE_MESH_PROXY_QUEUE_SIZE - connection.head < PROXY_RECORD_HEADER_LENGTH)
+            {
+                connection.head = 0;
+            }
+            length = connection.queue[connection.head] | (connection.queue[connection.head + 1] << 8);
+            if (length == PROXY_RECORD_WRAP)
+            {
+                connection.head = 0;
+                length = connection.queue[0] | (connection.queue[1] << 8);
+            }
+
+            // Senders only write to the free part of the queue, the record is sent from where it is
+            if (connection.info.connected)
+            {
+                transmit(connection, &connection.queue[connection.head + PROXY_RECORD_HEADER_LENGTH], length);
+            }
+            else
+            {
+                connection.info.tx_dropped++;
+            }
+
+            connection.head += PROXY_RECORD_HEADER_LENGTH + length;
+            connection.info.queued--;
+            if (connection.info.queued == 0)
+            {
+                connection.head = 0;
+                connection.tail = 0;
+            }
+            changed.notify_all();
+        }
+    }
+}
+
+/* Called with lock held: waits for the thread sending to finish, then sends the queues */
+void ProxyConnectionTable::acquire(void)
+{
+    while (draining)
+    {
+        changed.wait();
+    }
+    draining = true;
+    drain();
+}
+
+/* Called with lock held */
+void ProxyConnectionTable::release(void)
+{
+    draining = false;
+    changed.notify_all();
+}
+
+ble_error_t ProxyConnectionTable::connect(uint16_t conn_id)
+{
+    ble_error_t result = open(conn_id);
+
+    if (result != BLE_ERROR_NONE)
+    {
+        return result;
+    }
+
+    // Opening a connection selects it on the controller
+    lock.lock();
+    acquire();
+    if (control_function)
+    {
+        lock.unlock();
+        control_function(conn_id, true, transmit_context);
+        lock.lock();
+    }
+    last_conn_id = conn_id;
+    release();
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t ProxyConnectionTable::disconnect(uint16_t conn_id)
+{
+    int i = 0;
+
+    lock.lock();
+    acquire();
+    if (conn_id != 0 && find(conn_id) < 0)
+    {
+        release();
+        lock.unlock();
+        return BLE_ERROR_INVALID_PARAM;
+    }
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS; i++)
+    {
+        if (connections[i].used && (conn_id == 0 || connections[i].info.conn_id == conn_id))
+        {
+            connections[i].info.connected = false;
+            reset(connections[i]);
+        }
+    }
+    if (control_function)
+    {
+        lock.unlock();
+        control_function(conn_id, false, transmit_context);
+        lock.lock();
+    }
+    if (conn_id == 0 || last_conn_id == conn_id)
+    {
+        last_conn_id = 0;
+    }
+    release();
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t ProxyConnectionTable::send(uint16_t conn_id, const uint8_t* data, uint16_t length)
+{
+    int  i    = 0;
+    bool sent = false;
+
+    lock.lock();
+    if (conn_id == 0)
+    {
+        // Not tracked by the table: sent unqueued, when no other packet or selection is being written
+        acquire();
+        lock.unlock();
+        sent = transmit_function(0, data, length, transmit_context);
+        lock.lock();
+        release();
+        lock.unlock();
+        return sent ? BLE_ERROR_NONE : BLE_ERROR_INVALID_PARAM;
+    }
+
+    i = find(conn_id);
+    if (i < 0 || !connections[i].info.connected)
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_STATE;
+    }
+    Connection& connection = connections[i];
+
+    if (length > EMBEDDED_BLE_MESH_PROXY_QUEUE_SIZE - PROXY_RECORD_HEADER_LENGTH)
+    {
+        // Too large to be queued: wait for the queues to be sent, then send it from the caller's buffer
+        acquire();
+        if (connection.info.connected)
+        {
+            transmit(connection, data, length);
+        }
+        release();
+        lock.unlock();
+        return BLE_ERROR_NONE;
+    }
+
+    while (!enqueue(connection, data, length))
+    {
+        if (!draining)
+        {
+            draining = true;
+            drain();
+            draining = false;
+            changed.notify_all();
+        }
+        else
+        {
+            changed.wait();
+        }
+
+        if (!connection.info.connected)
+        {
+            lock.unlock();
+            return BLE_ERROR_INVALID_STATE;
+        }
+    }
+
+    if (!draining)
+    {
+        draining = true;
+        drain();
+        draining = false;
+        changed.notify_all();
+    }
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+void ProxyConnectionTable::received(uint16_t conn_id, uint16_t length)
+{
+    int i = 0;
+
+    lock.lock();
+    i = find(conn_id);
+    if (i >= 0)
+    {
+        connections[i].info.rx_packets++;
+        connections[i].info.rx_bytes += length;
+    }
+    lock.unlock();
+}
+
+uint16_t ProxyConnectionTable::getDefaultConnection(void)
+{
+    uint16_t conn_id = 0;
+    int      i       = 0;
+
+    lock.lock();
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS && conn_id == 0; i++)
+    {
+        if (connections[i].used && connections[i].info.connected)
+        {
+            conn_id = connections[i].info.conn_id;
+        }
+    }
+    lock.unlock();
+
+    return conn_id;
+}
+
+uint8_t ProxyConnectionTable::getConnections(ProxyConnectionInfo* info, uint8_t max)
+{
+    uint8_t count = 0;
+    int     i     = 0;
+
+    lock.lock();
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS && count < max; i++)
+    {
+        if (connections[i].used)
+        {
+            info[count++] = connections[i].info;
+        }
+    }
+    lock.unlock();
+
+    return count;
+}
+
+uint32_t ProxyConnectionTable::getQueueDepth(void)
+{
+    uint32_t depth = 0;
+    int      i     = 0;
+
+    lock.lock();
+    for (i = 0; i < EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS; i++)
+    {
+        if (connections[i].used)
+        {
+            depth += connections[i].info.queued;
+        }
+    }
+    lock.unlock();
+
+    return depth;
+}
+
+uint32_t ProxyConnectionTable::getSwitchCount(void)
+{
+    uint32_t count = 0;
+
+    lock.lock();
+    count = switches;
+    lock.unlock();
+
+    return count;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth Mesh proxy connection table
+ *
+ * Tracks the proxy connections opened on the Bluetooth Controller and schedules the outbound
+ * proxy packets across them. The controller applies proxy data to the connection selected
+ * last, so every change of connection costs a selection command: packets are queued per
+ * connection and the queues are served round robin, up to EMBEDDED_BLE_MESH_PROXY_BURST
+ * packets per turn.
+ *
+ * There is no scheduler thread: the thread whose packet finds no transmission in progress
+ * sends the queued packets of every connection (its own included) until the queues are empty,
+ * the other threads only queue theirs. Opening and closing a connection on the controller also
+ * changes its selection, so connect and disconnect wait for their turn the same way.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+
+/** Maximum number of simultaneous proxy connections */
+#ifndef EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS
+#define EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS     (4)
+#endif
+
+/** Bytes of outbound queue per connection, larger packets are sent without being queued */
+#ifndef EMBEDDED_BLE_MESH_PROXY_QUEUE_SIZE
+#define EMBEDDED_BLE_MESH_PROXY_QUEUE_SIZE          (1024)
+#endif
+
+/** Packets sent on a connection before moving to the next one */
+#ifndef EMBEDDED_BLE_MESH_PROXY_BURST
+#define EMBEDDED_BLE_MESH_PROXY_BURST               (4)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines the state and counters of a proxy connection */
+struct ProxyConnectionInfo
+{
+    uint16_t conn_id;               /**< Connection id */
+    bool     connected;             /**< Connection open */
+    uint32_t tx_packets;            /**< Packets sent */
+    uint32_t tx_bytes;              /**< Bytes sent */
+    uint32_t rx_packets;            /**< Packets received */
+    uint32_t rx_bytes;              /**< Bytes received */
+    uint32_t tx_dropped;            /**< Packets dropped because the connection closed or the send failed */
+    uint16_t queued;                /**< Packets waiting */
+};
+
+/** Defines the function sending a proxy packet on a connection, context is given with the function */
+typedef bool (*ProxyTransmit_t)(uint16_t conn_id, const uint8_t* data, uint16_t length, void* context);
+
+/** Defines the function opening (connected true) or closing a connection on the controller, 0 closes them all */
+typedef void (*ProxyControl_t)(uint16_t conn_id, bool connected, void* context);
+
+/** Defines the proxy connection table and outbound scheduler */
+class ProxyConnectionTable
+{
+public:
+    ProxyConnectionTable(ProxyTransmit_t transmit, void* context = NULL, ProxyControl_t control = NULL);
+
+    /** Adds a connection or marks it connected again, the entry of a closed connection may be reused */
+    ble_error_t open(uint16_t conn_id);
+
+    /** Marks a connection closed, its queued packets are dropped */
+    ble_error_t close(uint16_t conn_id);
+
+    /** Opens a connection and opens it on the controller, in turn with the packets being sent */
+    ble_error_t connect(uint16_t conn_id);
+
+    /** Closes a connection and closes it on the controller, in turn with the packets being sent.
+     *  0 closes every connection.
+     *
+     * @return BLE_ERROR_INVALID_PARAM when the connection is not in the table
+     */
+    ble_error_t disconnect(uint16_t conn_id);
+
+    /** Queues a packet on an open connection and sends the queues unless another thread is sending them.
+     *  A conn_id of 0 sends the packet, in turn, on the connection the controller has selected.
+     *
+     * @return BLE_ERROR_INVALID_STATE when the connection is not open
+     */
+    ble_error_t send(uint16_t conn_id, const uint8_t* data, uint16_t length);
+
+    /** Accounts a packet received on a connection */
+    void received(uint16_t conn_id, uint16_t length);
+
+    /** Gets the first open connection, 0 when none */
+    uint16_t getDefaultConnection(void);
+
+    /** Copies the connections state
+     *
+     * @return number of connections copied
+     */
+    uint8_t getConnections(ProxyConnectionInfo* info, uint8_t max);
+
+    /** Gets the number of packets waiting on all the connections */
+    uint32_t getQueueDepth(void);
+
+    /** Gets the number of connection selections, the cost the scheduler amortizes */
+    uint32_t getSwitchCount(void);
+
+private:
+    struct Connection
+    {
+        ProxyConnectionInfo info;
+        bool                used;
+        /* records [length (2)][data], a length of 0xFFFF sends the reader back to the start */
+        uint16_t            head;
+        uint16_t            tail;
+        uint8_t             queue[EMBEDDED_BLE_MESH_PROXY_QUEUE_SIZE];
+    };
+
+    int  find(uint16_t conn_id);
+    bool enqueue(Connection& connection, const uint8_t* data, uint16_t length);
+    void reset(Connection& connection);
+    void drain(void);
+    void acquire(void);
+    void release(void);
+    void transmit(Connection& connection, const uint8_t* data, uint16_t length);
+
+    Connection              connections[EMBEDDED_BLE_MESH_MAX_PROXY_CONNECTIONS];
+    uint8_t                 next;
+    bool                    draining;
+    uint16_t                last_conn_id;
+    uint32_t                switches;
+    ProxyTransmit_t         transmit_function;
+    ProxyControl_t          control_function;
+    void*                   transmit_context;
+    rtos::Mutex             lock;
+    rtos::ConditionVariable changed;
+};
+
+/** @} */
+}
+
+}
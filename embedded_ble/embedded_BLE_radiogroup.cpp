@@ -0,0 +1,239 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth Mesh radio group
+ */
+
+#include <string.h>
+#include "embedded_BLE_radiogroup.h"
+#include "embedded_BLE_mesh.h"
+
+using namespace cypress::embedded;
+
+MeshRadio::MeshRadio() :
+    uplink(NULL),
+    latency_us(EMBEDDED_BLE_MESH_RADIO_INITIAL_LATENCY_MS * 1000)
+{
+}
+
+void MeshRadio::acknowledged(uint32_t latency_ms)
+{
+    uint32_t sample  = latency_ms * 1000;
+    uint32_t current = latency_us;
+
+    // A slow link is avoided at once, a recovered one wins traffic back gradually
+    if (sample >= current)
+    {
+        latency_us = sample;
+    }
+    else
+    {
+        latency_us = current - (current - sample) / EMBEDDED_BLE_MESH_RADIO_LATENCY_DECAY;
+    }
+}
+
+/****************************************************************************************
+ *                              WICED radio
+ ***************************************************************************************/
+WicedMeshRadio::WicedMeshRadio(Mesh& mesh) :
+    mesh(mesh)
+{
+}
+
+bool WicedMeshRadio::isConnected(void)
+{
+    return mesh.getConnectionState() == Mesh::BLUETOOTH_MESH_NETWORK_CONNECTED;
+}
+
+uint32_t WicedMeshRadio::getQueueDepth(void)
+{
+    return mesh.getProxyConnectionTable().getQueueDepth();
+}
+
+ble_error_t WicedMeshRadio::send(const uint8_t* data, uint16_t length)
+{
+    uint32_t start_ms = rtos::Kernel::get_ms_count();
+    int      result   = mesh.sendData((uint8_t*) data, length);
+
+    if (result == BLE_ERROR_NONE)
+    {
+        // WICED HCI does not acknowledge proxy packets: the controller taking the packet
+        // (UART flow control, proxy connection queue) stands for the acknowledgement
+        acknowledged(rtos::Kernel::get_ms_count() - start_ms);
+    }
+
+    return (ble_error_t) result;
+}
+
+void WicedMeshRadio::setUplinkFilter(MeshUplinkFilter* filter)
+{
+    MeshRadio::setUplinkFilter(filter);
+    mesh.setUplinkFilter(filter);
+}
+
+/****************************************************************************************
+ *                              Radio group
+ ***************************************************************************************/
+MeshRadioGroup::MeshRadioGroup() :
+    count(0),
+    next(0)
+{
+    memset(members, 0, sizeof(members));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+ble_error_t MeshRadioGroup::addRadio(MeshRadio& radio)
+{
+    ble_error_t result = BLE_ERROR_NONE;
+
+    lock.lock();
+
+    if (count >= EMBEDDED_BLE_MESH_MAX_RADIOS)
+    {
+        result = BLE_ERROR_NO_MEM;
+    }
+    else
+    {
+        memset(&members[count], 0, sizeof(members[count]));
+        members[count].radio = &radio;
+        count++;
+        radio.setUplinkFilter(&uplink);
+    }
+
+    lock.unlock();
+
+    return result;
+}
+
+int MeshRadioGroup::select(uint32_t tried)
+{
+    uint64_t best_cost = 0;
+    uint64_t cost      = 0;
+    int      best      = -1;
+    int      i         = 0;
+    int      k         = 0;
+
+    // Scanned from the radio after the last one used: equal costs go round robin
+    for (k = 0; k < count; k++)
+    {
+        i = (next + k) % count;
+
+        if ((tried & (1 << i)) || !members[i].radio->isConnected())
+        {
+            continue;
+        }
+
+        cost = (uint64_t) (members[i].radio->getQueueDepth() + members[i].in_flight + 1) *
+               (members[i].radio->getLatency() + 1);
+        if (best < 0 || cost < best_cost)
+        {
+            best      = i;
+            best_cost = cost;
+        }
+    }
+
+    return best;
+}
+
+ble_error_t MeshRadioGroup::sendData(const uint8_t* data, uint16_t length)
+{
+    ble_error_t result = BLE_ERROR_INVALID_STATE;
+    uint32_t    tried  = 0;
+    int         i      = 0;
+
+    if (data == NULL || length == 0)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    lock.lock();
+
+    while ((i = select(tried)) >= 0)
+    {
+        tried |= (1 << i);
+
+        // Sent unlocked: a WICED radio blocks on the UART while the other radios take packets
+        members[i].in_flight++;
+        lock.unlock();
+        result = members[i].radio->send(data, length);
+        lock.lock();
+        members[i].in_flight--;
+
+        if (result == BLE_ERROR_NONE)
+        {
+            members[i].info.sent++;
+            members[i].info.bytes += length;
+            statistics.sent++;
+            if (tried != (uint32_t) (1 << i))
+            {
+                statistics.failovers++;
+            }
+            next = (i + 1) % count;
+            break;
+        }
+        members[i].info.refused++;
+    }
+
+    if (result != BLE_ERROR_NONE)
+    {
+        statistics.failed++;
+    }
+
+    lock.unlock();
+
+    return result;
+}
+
+uint8_t MeshRadioGroup::getRadios(MeshRadioInfo* info, uint8_t max)
+{
+    uint8_t copied = 0;
+
+    lock.lock();
+    for (copied = 0; copied < count && copied < max; copied++)
+    {
+        info[copied]            = members[copied].info;
+        info[copied].connected  = members[copied].radio->isConnected();
+        info[copied].queued     = members[copied].radio->getQueueDepth() + members[copied].in_flight;
+        info[copied].latency_us = members[copied].radio->getLatency();
+    }
+    lock.unlock();
+
+    return copied;
+}
+
+void MeshRadioGroup::getStatistics(MeshRadioGroupStatistics& stats)
+{
+    lock.lock();
+    stats = statistics;
+    lock.unlock();
+}
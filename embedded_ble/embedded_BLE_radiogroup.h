@@ -0,0 +1,228 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth Mesh radio group
+ *
+ * A building larger than what one proxy link carries is served by several Bluetooth Controllers
+ * (radios) attached to the same mesh network. The group spreads the downlink across the radios:
+ * each packet goes to the connected radio with the lowest cost, its outstanding packets plus one
+ * times its acknowledgement latency (peak EWMA: a slower acknowledgement is taken at once, faster
+ * ones are averaged in), so a congested or slow link receives less traffic. A radio refusing a
+ * packet (link dropped, queue full) is skipped and the packet fails over to the next one.
+ *
+ * The uplink of all the radios goes through one MeshUplinkFilter, so a message heard by several
+ * radios is delivered once. WicedMeshRadio drives a Mesh instance.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+#include "embedded_BLE_uplink.h"
+
+/** Maximum number of radios in a group */
+#ifndef EMBEDDED_BLE_MESH_MAX_RADIOS
+#define EMBEDDED_BLE_MESH_MAX_RADIOS            (4)
+#endif
+
+/** Acknowledgement latency assumed for a radio before its first acknowledgement */
+#ifndef EMBEDDED_BLE_MESH_RADIO_INITIAL_LATENCY_MS
+#define EMBEDDED_BLE_MESH_RADIO_INITIAL_LATENCY_MS  (10)
+#endif
+
+/** Weight of a faster acknowledgement in the latency average, 1/n */
+#ifndef EMBEDDED_BLE_MESH_RADIO_LATENCY_DECAY
+#define EMBEDDED_BLE_MESH_RADIO_LATENCY_DECAY   (8)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+class Mesh;
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines the state and counters of a radio of a group */
+struct MeshRadioInfo
+{
+    bool     connected;             /**< Proxy link open */
+    uint32_t sent;                  /**< Packets sent */
+    uint32_t bytes;                 /**< Bytes sent */
+    uint32_t refused;               /**< Packets the radio refused, sent on another radio or failed */
+    uint32_t queued;                /**< Packets outstanding */
+    uint32_t latency_us;            /**< Acknowledgement latency (peak EWMA) */
+};
+
+/** Defines the counters of a radio group */
+struct MeshRadioGroupStatistics
+{
+    uint32_t sent;                  /**< Packets sent */
+    uint32_t failovers;             /**< Packets sent on another radio after one refused them */
+    uint32_t failed;                /**< Packets no radio accepted */
+};
+
+/** Defines a radio attached to the mesh network */
+class MeshRadio
+{
+public:
+    MeshRadio();
+
+    virtual ~MeshRadio() {}
+
+    /** Tells whether the radio has a proxy link to the mesh network */
+    virtual bool isConnected(void) = 0;
+
+    /** Gets the number of packets sent and not acknowledged yet */
+    virtual uint32_t getQueueDepth(void) = 0;
+
+    /** Sends a proxy packet on the link.
+     *
+     * @return BLE_ERROR_INVALID_STATE when the link is down, BLE_ERROR_NO_MEM when the radio is full
+     */
+    virtual ble_error_t send(const uint8_t* data, uint16_t length) = 0;
+
+    /** Sets the filter the uplink of the radio goes through, NULL for the radio's own */
+    virtual void setUplinkFilter(MeshUplinkFilter* filter)
+    {
+        uplink = filter;
+    }
+
+    /** Gets the acknowledgement latency (us) */
+    inline uint32_t getLatency(void)
+    {
+        return latency_us;
+    }
+
+protected:
+    /** Accounts the acknowledgement of a packet sent latency_ms earlier */
+    void acknowledged(uint32_t latency_ms);
+
+    MeshUplinkFilter* uplink;
+
+private:
+    volatile uint32_t latency_us;
+};
+
+/** Defines a radio driving a Mesh instance (one Bluetooth Controller) */
+class WicedMeshRadio : public MeshRadio
+{
+public:
+    WicedMeshRadio(Mesh& mesh);
+
+    virtual bool isConnected(void);
+
+    /** Counts the packets waiting in the proxy connection table */
+    virtual uint32_t getQueueDepth(void);
+
+    /** Sends with Mesh::sendData, the time until the controller took the packet is the acknowledgement latency */
+    virtual ble_error_t send(const uint8_t* data, uint16_t length);
+
+    virtual void setUplinkFilter(MeshUplinkFilter* filter);
+
+private:
+    Mesh& mesh;
+};
+
+/** Defines a group of radios sharing the downlink and the uplink of a mesh network */
+class MeshRadioGroup
+{
+public:
+    MeshRadioGroup();
+
+    /** Adds a radio, its uplink goes through the filter of the group.
+     *
+     * @return BLE_ERROR_NO_MEM when EMBEDDED_BLE_MESH_MAX_RADIOS are in the group
+     */
+    ble_error_t addRadio(MeshRadio& radio);
+
+    /** Sends a proxy packet on the connected radio with the lowest cost, failing over to the next ones.
+     *
+     * @return BLE_ERROR_INVALID_STATE when no radio is connected, the error of the last radio tried
+     *         when none accepted the packet
+     */
+    ble_error_t sendData(const uint8_t* data, uint16_t length);
+
+    /** Configures the de-duplication of the uplink of all the radios, see Mesh::setUplinkDedup */
+    ble_error_t setUplinkDedup(uint32_t window_ms, MeshDedupKey_t key = NULL)
+    {
+        uplink.configure(window_ms, key);
+
+        return BLE_ERROR_NONE;
+    }
+
+    /** Copies the uplink filter counters */
+    void getUplinkStatistics(MeshUplinkStatistics& stats)
+    {
+        uplink.getStatistics(stats);
+    }
+
+    /** Copies the state and counters of the radios, in the order they were added
+     *
+     * @return number of radios copied
+     */
+    uint8_t getRadios(MeshRadioInfo* info, uint8_t max);
+
+    /** Copies the group counters */
+    void getStatistics(MeshRadioGroupStatistics& stats);
+
+private:
+    struct Member
+    {
+        MeshRadio*    radio;
+        MeshRadioInfo info;
+        uint32_t      in_flight;
+    };
+
+    int select(uint32_t tried);
+
+    Member                   members[EMBEDDED_BLE_MESH_MAX_RADIOS];
+    uint8_t                  count;
+    uint8_t                  next;
+    MeshUplinkFilter         uplink;
+    MeshRadioGroupStatistics statistics;
+    rtos::Mutex              lock;
+};
+
+/** @} */
+}
+
+}
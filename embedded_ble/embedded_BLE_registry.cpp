@@ -0,0 +1,315 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth Mesh node registry
+ */
+
+#include <string.h>
+#include "embedded_BLE_registry.h"
+
+using namespace cypress::embedded;
+
+#define REGISTRY_STATE_VALID            (0x01)
+#define REGISTRY_STATE_PENDING          (0x02)
+
+/* Unicast addresses are 0x0001 to 0x7FFF */
+#define REGISTRY_UNICAST_LAST           (0x7FFF)
+
+MeshNodeRegistry::MeshNodeRegistry() :
+    first_address(1), decoder(NULL), refresh(NULL)
+{
+    memset(nodes, 0, sizeof(nodes));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+void MeshNodeRegistry::configure(uint16_t first_address, MeshStateDecoder_t decoder, MeshStateRefresh_t refresh)
+{
+    lock.lock();
+
+    this->first_address = first_address ? first_address : 1;
+    this->decoder       = decoder;
+    this->refresh       = refresh;
+    memset(nodes, 0, sizeof(nodes));
+    memset(&statistics, 0, sizeof(statistics));
+
+    lock.unlock();
+}
+
+/* Called with lock held */
+MeshNodeRegistry::Node* MeshNodeRegistry::findNode(uint16_t addr)
+{
+    uint16_t index = (uint16_t)(addr - first_address);
+
+    if (addr == 0 || addr > REGISTRY_UNICAST_LAST || addr < first_address || index >= EMBEDDED_BLE_MESH_REGISTRY_NODES)
+    {
+        return NULL;
+    }
+
+    return &nodes[index];
+}
+
+/* Called with lock held */
+MeshNodeRegistry::State* MeshNodeRegistry::findState(Node& node, uint16_t opcode, bool create)
+{
+    State* oldest = NULL;
+    int i = 0;
+
+    for (i = 0; i < EMBEDDED_BLE_MESH_REGISTRY_STATES; i++)
+    {
+        State& state = node.states[i];
+
+        if (state.flags && state.opcode == opcode)
+        {
+            return &state;
+        }
+        if (!create)
+        {
+            continue;
+        }
+        if (!state.flags)
+        {
+            if (!oldest || oldest->flags)
+            {
+                oldest = &state;
+            }
+        }
+        else if (!oldest || (oldest->flags && (int32_t)(state.updated_ms - oldest->updated_ms) < 0))
+        {
+            oldest = &state;
+        }
+    }
+
+    if (oldest)
+    {
+        if (oldest->flags)
+        {
+            statistics.evictions++;
+        }
+        memset(oldest, 0, sizeof(*oldest));
+        oldest->opcode = opcode;
+    }
+
+    return oldest;
+}
+
+bool MeshNodeRegistry::received(const uint8_t* packet, uint32_t length, uint32_t now_ms)
+{
+    MeshStateDecoder_t decode = NULL;
+    MeshNodeState state;
+
+    lock.lock();
+    decode = decoder;
+    lock.unlock();
+
+    if (decode == NULL)
+    {
+        return false;
+    }
+
+    memset(&state, 0, sizeof(state));
+    if (!decode(packet, length, state))
+    {
+        lock.lock();
+        statistics.ignored++;
+        lock.unlock();
+        return false;
+    }
+
+    return update(state, now_ms) == BLE_ERROR_NONE;
+}
+
+ble_error_t MeshNodeRegistry::update(const MeshNodeState& state)
+{
+    return update(state, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+ble_error_t MeshNodeRegistry::update(const MeshNodeState& state, uint32_t now_ms)
+{
+    Node*  node = NULL;
+    State* cached = NULL;
+    uint32_t round_trip = 0;
+
+    lock.lock();
+    node = findNode(state.src);
+    if (node == NULL || state.length > EMBEDDED_BLE_MESH_REGISTRY_STATE_LENGTH)
+    {
+        statistics.ignored++;
+        lock.unlock();
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    node->seen    = true;
+    node->seen_ms = now_ms;
+
+    cached = findState(*node, state.opcode, true);
+    if (cached->flags & REGISTRY_STATE_PENDING)
+    {
+        // The status answering a refresh, or at least arriving while one is waited for
+        round_trip = now_ms - cached->requested_ms;
+        statistics.round_trips++;
+        statistics.round_trip_total_ms += round_trip;
+        if (round_trip > statistics.round_trip_max_ms)
+        {
+            statistics.round_trip_max_ms = round_trip;
+        }
+    }
+
+    cached->flags      = REGISTRY_STATE_VALID;
+    cached->length     = state.length;
+    cached->updated_ms = now_ms;
+    memcpy(cached->data, state.data, state.length);
+    statistics.updates++;
+    lock.unlock();
+
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t MeshNodeRegistry::read(uint16_t addr, uint16_t opcode, uint32_t max_age_ms, uint8_t* data, uint8_t max, uint8_t* length)
+{
+    return read(addr, opcode, max_age_ms, data, max, length, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+ble_error_t MeshNodeRegistry::read(uint16_t addr, uint16_t opcode, uint32_t max_age_ms, uint8_t* data, uint8_t max, uint8_t* length, uint32_t now_ms)
+{
+    ble_error_t        result = BLE_ERROR_NOT_FOUND;
+    MeshStateRefresh_t fetch = NULL;
+    Node*              node = NULL;
+    State*             cached = NULL;
+
+    lock.lock();
+    node = findNode(addr);
+    if (node == NULL)
+    {
+        lock.unlock();
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    statistics.reads++;
+    cached = findState(*node, opcode, false);
+    if (cached && (cached->flags & REGISTRY_STATE_VALID))
+    {
+        *length = cached->length;
+        memcpy(data, cached->data, cached->length < max ? cached->length : max);
+
+        if (now_ms - cached->updated_ms <= max_age_ms)
+        {
+            statistics.hits++;
+            statistics.saved_ms += statistics.round_trips ?
+                                   statistics.round_trip_total_ms / statistics.round_trips :
+                                   EMBEDDED_BLE_MESH_REGISTRY_ROUND_TRIP_MS;
+            lock.unlock();
+            return BLE_ERROR_NONE;
+        }
+        statistics.stale++;
+        result = BLE_ERROR_INVALID_STATE;
+    }
+    else
+    {
+        *length = 0;
+        statistics.misses++;
+    }
+
+    // One refresh at a time per state, repeated when it is not answered
+    if (refresh && !(cached && (cached->flags & REGISTRY_STATE_PENDING) &&
+                     now_ms - cached->requested_ms < EMBEDDED_BLE_MESH_REGISTRY_REFRESH_TIMEOUT_MS))
+    {
+        if (cached == NULL)
+        {
+            cached = findState(*node, opcode, true);
+            cached->updated_ms = now_ms;
+        }
+        cached->flags       |= REGISTRY_STATE_PENDING;
+        cached->requested_ms = now_ms;
+        fetch = refresh;
+    }
+    lock.unlock();
+
+    if (fetch)
+    {
+        if (fetch(addr, opcode))
+        {
+            lock.lock();
+            statistics.refreshes++;
+            lock.unlock();
+        }
+        else
+        {
+            lock.lock();
+            cached = findState(*node, opcode, false);
+            if (cached && cached->requested_ms == now_ms)
+            {
+                cached->flags &= ~REGISTRY_STATE_PENDING;
+            }
+            lock.unlock();
+        }
+    }
+
+    return result;
+}
+
+uint32_t MeshNodeRegistry::getLastSeen(uint16_t addr, bool& found)
+{
+    uint32_t seen_ms = 0;
+    Node* node = NULL;
+
+    lock.lock();
+    node = findNode(addr);
+    found = node && node->seen;
+    if (found)
+    {
+        seen_ms = node->seen_ms;
+    }
+    lock.unlock();
+
+    return seen_ms;
+}
+
+void MeshNodeRegistry::forget(uint16_t addr)
+{
+    Node* node = NULL;
+
+    lock.lock();
+    node = findNode(addr);
+    if (node)
+    {
+        memset(node, 0, sizeof(*node));
+    }
+    lock.unlock();
+}
+
+void MeshNodeRegistry::getStatistics(MeshNodeRegistryStatistics& stats)
+{
+    lock.lock();
+    stats = statistics;
+    lock.unlock();
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth Mesh node registry
+ *
+ * Keeps the last known model states of the nodes so that cloud reads of a node's state are
+ * answered by the gateway instead of a round trip over the mesh. Unicast addresses are
+ * allocated densely from the provisioner's first address, so the nodes are a table indexed by
+ * the address offset and each node holds a few states keyed by their status opcode.
+ *
+ * Network PDUs are encrypted with keys the gateway does not hold: the registry is fed with
+ * decoded states, either by a decoder set by the application for the uplink proxy packets or
+ * by MeshNodeRegistry::update. A read of a state older than the caller's maximum age asks the
+ * refresh function to fetch it (usually a Get message sent with Mesh::scheduleData), the
+ * status coming back over the uplink refreshes the cache and times the round trip.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+
+/** Number of nodes of the registry, from the first unicast address */
+#ifndef EMBEDDED_BLE_MESH_REGISTRY_NODES
+#define EMBEDDED_BLE_MESH_REGISTRY_NODES            (128)
+#endif
+
+/** Number of model states kept per node, the oldest one is replaced */
+#ifndef EMBEDDED_BLE_MESH_REGISTRY_STATES
+#define EMBEDDED_BLE_MESH_REGISTRY_STATES           (4)
+#endif
+
+/** Largest model state kept, status message parameters */
+#ifndef EMBEDDED_BLE_MESH_REGISTRY_STATE_LENGTH
+#define EMBEDDED_BLE_MESH_REGISTRY_STATE_LENGTH     (8)
+#endif
+
+/** Time a refresh is waited for before a read asks for another one */
+#ifndef EMBEDDED_BLE_MESH_REGISTRY_REFRESH_TIMEOUT_MS
+#define EMBEDDED_BLE_MESH_REGISTRY_REFRESH_TIMEOUT_MS (2000)
+#endif
+
+/** Mesh round trip assumed for the latency saved until one is measured */
+#ifndef EMBEDDED_BLE_MESH_REGISTRY_ROUND_TRIP_MS
+#define EMBEDDED_BLE_MESH_REGISTRY_ROUND_TRIP_MS    (500)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines a decoded model state */
+struct MeshNodeState
+{
+    uint16_t src;                   /**< Unicast address of the node */
+    uint16_t opcode;                /**< Status opcode */
+    uint8_t  length;                /**< Parameters length */
+    uint8_t  data[EMBEDDED_BLE_MESH_REGISTRY_STATE_LENGTH]; /**< Status parameters */
+};
+
+/** Defines the registry counters */
+struct MeshNodeRegistryStatistics
+{
+    uint32_t reads;                 /**< Reads */
+    uint32_t hits;                  /**< Reads answered from the cache */
+    uint32_t stale;                 /**< Reads of a state older than their maximum age */
+    uint32_t misses;                /**< Reads of a state never received */
+    uint32_t refreshes;             /**< Refreshes requested */
+    uint32_t updates;               /**< States stored */
+    uint32_t ignored;               /**< Packets without a decoded state, or from an address outside the table */
+    uint32_t evictions;             /**< States replaced by a node's newer opcode */
+    uint32_t round_trips;           /**< Refreshes answered */
+    uint32_t round_trip_total_ms;   /**< Sum of the refresh round trips */
+    uint32_t round_trip_max_ms;     /**< Longest refresh round trip */
+    uint32_t saved_ms;              /**< Latency saved by the hits, at the average round trip */
+};
+
+/** Defines the function decoding an uplink proxy packet into a model state.
+ *
+ * @return false when the packet does not carry a state to cache
+ */
+typedef bool (*MeshStateDecoder_t)(const uint8_t* packet, uint32_t length, MeshNodeState& state);
+
+/** Defines the function fetching a state from the mesh, usually by sending the matching Get message.
+ *
+ * @return false when the request was not sent
+ */
+typedef bool (*MeshStateRefresh_t)(uint16_t addr, uint16_t opcode);
+
+/** Defines the node registry */
+class MeshNodeRegistry
+{
+public:
+    MeshNodeRegistry();
+
+    /** Sets the address range and functions, clears the table and the counters.
+     *
+     * @param[in] first_address: unicast address of the first node of the table
+     * @param[in] decoder:       uplink packet decoder, NULL when states only come from MeshNodeRegistry::update
+     * @param[in] refresh:       function fetching stale states, NULL to only answer from the cache
+     */
+    void configure(uint16_t first_address, MeshStateDecoder_t decoder, MeshStateRefresh_t refresh);
+
+    /** Decodes an uplink proxy packet with the decoder and stores the state.
+     *
+     * @return false when no state was stored
+     */
+    bool received(const uint8_t* packet, uint32_t length, uint32_t now_ms);
+
+    /** Stores a decoded state.
+     *
+     * @return BLE_ERROR_INVALID_PARAM when the address is outside the table or the state too long
+     */
+    ble_error_t update(const MeshNodeState& state);
+
+    /** Stores a decoded state at now_ms, for callers with their own clock */
+    ble_error_t update(const MeshNodeState& state, uint32_t now_ms);
+
+    /** Reads a state from the cache. A stale or unknown state is refreshed with the refresh function.
+     *
+     * @param[in]  addr:       unicast address
+     * @param[in]  opcode:     status opcode
+     * @param[in]  max_age_ms: oldest state accepted
+     * @param[out] data:       status parameters
+     * @param[in]  max:        size of data
+     * @param[out] length:     parameters length
+     *
+     * @return BLE_ERROR_NONE when fresh, BLE_ERROR_INVALID_STATE when stale (the last known state is
+     *         copied), BLE_ERROR_NOT_FOUND when never received, BLE_ERROR_INVALID_PARAM when the
+     *         address is outside the table
+     */
+    ble_error_t read(uint16_t addr, uint16_t opcode, uint32_t max_age_ms, uint8_t* data, uint8_t max, uint8_t* length);
+
+    /** Reads a state at now_ms */
+    ble_error_t read(uint16_t addr, uint16_t opcode, uint32_t max_age_ms, uint8_t* data, uint8_t max, uint8_t* length, uint32_t now_ms);
+
+    /** Returns the time a node was last heard of, with found false when it never was */
+    uint32_t getLastSeen(uint16_t addr, bool& found);
+
+    /** Drops the states of a node, for example once it is removed from the network */
+    void forget(uint16_t addr);
+
+    /** Copies the counters */
+    void getStatistics(MeshNodeRegistryStatistics& stats);
+
+private:
+    struct State
+    {
+        uint16_t opcode;
+        uint8_t  length;
+        uint8_t  flags;
+        uint32_t updated_ms;
+        uint32_t requested_ms;
+        uint8_t  data[EMBEDDED_BLE_MESH_REGISTRY_STATE_LENGTH];
+    };
+
+    struct Node
+    {
+        uint32_t seen_ms;
+        bool     seen;
+        State    states[EMBEDDED_BLE_MESH_REGISTRY_STATES];
+    };
+
+    Node*  findNode(uint16_t addr);
+    State* findState(Node& node, uint16_t opcode, bool create);
+
+    Node                       nodes[EMBEDDED_BLE_MESH_REGISTRY_NODES];
+    uint16_t                   first_address;
+    MeshStateDecoder_t         decoder;
+    MeshStateRefresh_t         refresh;
+    MeshNodeRegistryStatistics statistics;
+    rtos::Mutex                lock;
+};
+
+/** @} */
+}
+
+}
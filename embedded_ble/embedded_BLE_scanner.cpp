@@ -0,0 +1,262 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth LE scan pipeline
+ */
+
+#include <string.h>
+#include "embedded_BLE_scanner.h"
+
+using namespace cypress::embedded;
+
+#define SCAN_WAKE_FLAG      (0x1)
+#define SCAN_STOP_FLAG      (0x2)
+
+ScanPipeline::ScanPipeline() :
+    callback(NULL),
+    presence(NULL),
+    dedup(dedup_entries, EMBEDDED_BLE_SCAN_DEDUP_CACHE_SIZE, 0),
+    batch_count(0),
+    thread(NULL)
+{
+    memset(&params, 0, sizeof(params));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+ScanPipeline::~ScanPipeline()
+{
+    if (thread != NULL)
+    {
+        flags.set(SCAN_STOP_FLAG);
+        thread->join();
+        delete thread;
+    }
+}
+
+void ScanPipeline::configure(const ScanParameters& scan_params, ScanReportCallback_t report_callback)
+{
+    lock.lock();
+
+    params   = scan_params;
+    callback = report_callback;
+
+    if (params.batch_size == 0)
+    {
+        params.batch_size = 1;
+    }
+    else if (params.batch_size > EMBEDDED_BLE_SCAN_MAX_BATCH_SIZE)
+    {
+        params.batch_size = EMBEDDED_BLE_SCAN_MAX_BATCH_SIZE;
+    }
+
+    dedup.setWindow(params.dedup_window_ms);
+    dedup.clear();
+    batch_count = 0;
+    memset(&statistics, 0, sizeof(statistics));
+
+    /* Kept for the life of the pipeline, the report callback may stop the scan from it */
+    if (thread == NULL && params.batch_size > 1 && params.batch_timeout_ms != 0)
+    {
+        thread = new rtos::Thread(osPriorityNormal, EMBEDDED_BLE_SCAN_FLUSH_STACK_SIZE, NULL, "scan_flush");
+        thread->start(mbed::callback(this, &ScanPipeline::worker));
+    }
+
+    lock.unlock();
+
+    flags.set(SCAN_WAKE_FLAG);
+}
+
+void ScanPipeline::process(const wiced_bt_ble_scan_results_t* result, const uint8_t* adv_data, uint32_t now_ms)
+{
+    AdvertisementReport* report = NULL;
+
+    lock.lock();
+
+    statistics.received++;
+
+    if (callback == NULL || result->adv_data_length > EMBEDDED_BLE_SCAN_MAX_ADV_DATA_LENGTH)
+    {
+        statistics.malformed++;
+        lock.unlock();
+        return;
+    }
+
+    if (!filter.evaluate(result->remote_bd_addr, result->rssi, adv_data, result->adv_data_length))
+    {
+        statistics.filtered++;
+        lock.unlock();
+        return;
+    }
+
+    /* Presence aggregation needs every report, including the ones de-duplicated below */
+    if (presence)
+    {
+        presence->update(result->remote_bd_addr, result->ble_addr_type, result->rssi, now_ms);
+    }
+
+    /* Identical payload from the same advertiser, RSSI and event type do not matter */
+    if (params.filter_duplicates)
+    {
+        uint32_t key = DedupCache::hash(result->remote_bd_addr, sizeof(result->remote_bd_addr));
+        key = DedupCache::hash(&result->ble_addr_type, 1, key);
+        key = DedupCache::hash(adv_data, result->adv_data_length, key);
+
+        if (dedup.isDuplicate(key, now_ms))
+        {
+            statistics.duplicates++;
+            lock.unlock();
+            return;
+        }
+    }
+
+    report = &batch[batch_count++];
+    memcpy(report->address, result->remote_bd_addr, sizeof(report->address));
+    report->address_type = result->ble_addr_type;
+    report->event_type   = result->ble_evt_type;
+    report->rssi         = result->rssi;
+    report->data_length  = result->adv_data_length;
+    report->timestamp    = now_ms;
+    memcpy(report->data, adv_data, result->adv_data_length);
+
+    if (batch_count >= params.batch_size ||
+        (uint32_t)(now_ms - batch[0].timestamp) >= params.batch_timeout_ms)
+    {
+        deliver();
+    }
+    else if (batch_count == 1 && thread != NULL)
+    {
+        /* A new batch, the flush thread waits for its timeout */
+        flags.set(SCAN_WAKE_FLAG);
+    }
+
+    lock.unlock();
+}
+
+void ScanPipeline::flush(void)
+{
+    lock.lock();
+    deliver();
+    lock.unlock();
+}
+
+uint32_t ScanPipeline::service(uint32_t now_ms)
+{
+    uint32_t wait = osWaitForever;
+    uint32_t age = 0;
+
+    lock.lock();
+
+    if (batch_count != 0)
+    {
+        age = now_ms - batch[0].timestamp;
+        if (age >= params.batch_timeout_ms)
+        {
+            deliver();
+        }
+        else
+        {
+            wait = params.batch_timeout_ms - age;
+        }
+    }
+
+    lock.unlock();
+
+    return wait;
+}
+
+void ScanPipeline::worker(void)
+{
+    for (;;)
+    {
+        uint32_t wait   = service((uint32_t)rtos::Kernel::get_ms_count());
+        uint32_t result = flags.wait_any(SCAN_WAKE_FLAG | SCAN_STOP_FLAG, wait);
+
+        if (!(result & osFlagsError) && (result & SCAN_STOP_FLAG))
+        {
+            break;
+        }
+    }
+}
+
+ble_error_t ScanPipeline::setFilter(const AdvertisementFilterRule* rules, uint8_t count)
+{
+    ble_error_t result;
+
+    lock.lock();
+    result = filter.compile(rules, count);
+    lock.unlock();
+
+    return result;
+}
+
+void ScanPipeline::setPresenceTable(PresenceTable* table)
+{
+    lock.lock();
+    presence = table;
+    lock.unlock();
+}
+
+void ScanPipeline::getFilterStatistics(AdvertisementFilterStatistics& stats)
+{
+    lock.lock();
+    filter.getStatistics(stats);
+    lock.unlock();
+}
+
+void ScanPipeline::getStatistics(ScanStatistics& stats)
+{
+    lock.lock();
+    statistics.evictions = dedup.getEvictionCount();
+    stats = statistics;
+    lock.unlock();
+}
+
+/* Called with the lock held, the lock is recursive so the callback may stop the scan */
+void ScanPipeline::deliver(void)
+{
+    uint16_t count = batch_count;
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    batch_count = 0;
+    statistics.delivered += count;
+    statistics.batches++;
+
+    if (callback)
+    {
+        callback(batch, count);
+    }
+}
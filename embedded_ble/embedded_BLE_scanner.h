@@ -0,0 +1,189 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth LE scan pipeline
+ *
+ * Advertisement reports arrive on the WICED HCI event worker (the read thread when the controller
+ * runs no worker). The pipeline rejects reports
+ * not matching the advertisement filter, drops duplicate reports within a time window and hands the remaining ones to the application in batches,
+ * so a busy RF environment costs one callback per batch instead of one per report. A partial batch is
+ * delivered by the flush thread once its oldest report is ScanParameters::batch_timeout_ms old.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "embedded_BLE_dedup.h"
+#include "embedded_BLE_advfilter.h"
+#include "embedded_BLE_presence.h"
+
+#include "wiced_hci_bt_ble.h"
+
+/** Number of slots of the advertisement report de-duplication cache (power of two) */
+#ifndef EMBEDDED_BLE_SCAN_DEDUP_CACHE_SIZE
+#define EMBEDDED_BLE_SCAN_DEDUP_CACHE_SIZE      (256)
+#endif
+
+/** Maximum number of advertisement reports delivered in one batch */
+#ifndef EMBEDDED_BLE_SCAN_MAX_BATCH_SIZE
+#define EMBEDDED_BLE_SCAN_MAX_BATCH_SIZE        (16)
+#endif
+
+/** Maximum advertisement data kept per report (advertisement and scan response) */
+#ifndef EMBEDDED_BLE_SCAN_MAX_ADV_DATA_LENGTH
+#define EMBEDDED_BLE_SCAN_MAX_ADV_DATA_LENGTH   (62)
+#endif
+
+/** Stack size of the thread delivering the partial batches */
+#ifndef EMBEDDED_BLE_SCAN_FLUSH_STACK_SIZE
+#define EMBEDDED_BLE_SCAN_FLUSH_STACK_SIZE      (1536)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_gap
+ *
+ * @{
+ */
+
+/** Defines an advertisement report delivered to the application */
+struct AdvertisementReport
+{
+    uint8_t  address[6];            /**< Advertiser address */
+    uint8_t  address_type;          /**< Advertiser address type (BLE_ADDR_PUBLIC, BLE_ADDR_RANDOM...) */
+    uint8_t  event_type;            /**< Advertising event type (see #wiced_bt_dev_ble_evt_type_e) */
+    int8_t   rssi;                  /**< Received signal strength */
+    uint8_t  data_length;           /**< Length of the advertisement data */
+    uint32_t timestamp;             /**< Time of reception (ms) */
+    uint8_t  data[EMBEDDED_BLE_SCAN_MAX_ADV_DATA_LENGTH]; /**< Advertisement data */
+};
+
+/** Defines the scan configuration */
+struct ScanParameters
+{
+    bool     filter_duplicates;     /**< Drop reports already delivered within dedup_window_ms */
+    uint32_t dedup_window_ms;       /**< Time an identical report is considered a duplicate */
+    uint16_t batch_size;            /**< Reports per delivered batch, 1 delivers every report immediately */
+    uint32_t batch_timeout_ms;      /**< Deliver a partial batch once its oldest report is this old */
+};
+
+/** Defines the scan pipeline counters */
+struct ScanStatistics
+{
+    uint32_t received;              /**< Reports received from the controller */
+    uint32_t filtered;              /**< Reports rejected by the advertisement filter */
+    uint32_t duplicates;            /**< Reports dropped as duplicates */
+    uint32_t malformed;             /**< Reports dropped because they could not be stored */
+    uint32_t delivered;             /**< Reports delivered to the application */
+    uint32_t batches;               /**< Number of batches delivered */
+    uint32_t evictions;             /**< De-duplication entries evicted before their window elapsed */
+};
+
+/** Defines the advertisement report callback, reports are only valid during the call */
+typedef void (*ScanReportCallback_t)(const AdvertisementReport* reports, uint16_t count);
+
+/** Defines the LE scan pipeline (de-duplication and batching of advertisement reports) */
+class ScanPipeline
+{
+public:
+    ScanPipeline();
+
+    ~ScanPipeline();
+
+    /** Applies a configuration, clears the de-duplication cache and pending reports.
+     *  Starts the flush thread the first time partial batches have a timeout.
+     */
+    void configure(const ScanParameters& params, ScanReportCallback_t callback);
+
+    /** Processes a report coming from the controller.
+     *
+     * @param[in] result:   scan result
+     * @param[in] adv_data: advertisement data (result->adv_data_length bytes)
+     * @param[in] now_ms:   time of reception (ms)
+     */
+    void process(const wiced_bt_ble_scan_results_t* result, const uint8_t* adv_data, uint32_t now_ms);
+
+    /** Compiles and installs advertisement filter rules, see AdvertisementFilter::compile */
+    ble_error_t setFilter(const AdvertisementFilterRule* rules, uint8_t count);
+
+    /** Attaches a presence table fed with every report accepted by the filter, NULL detaches it */
+    void setPresenceTable(PresenceTable* table);
+
+    /** Copies the advertisement filter counters */
+    void getFilterStatistics(AdvertisementFilterStatistics& stats);
+
+    /** Delivers the pending reports */
+    void flush(void);
+
+    /** Delivers a partial batch whose oldest report is batch_timeout_ms old.
+     *
+     * @return time until the pending batch is due (ms), osWaitForever when there is none
+     */
+    uint32_t service(uint32_t now_ms);
+
+    /** Copies the counters */
+    void getStatistics(ScanStatistics& stats);
+
+private:
+    void deliver(void);
+    void worker(void);
+
+    ScanParameters       params;
+    ScanReportCallback_t callback;
+    ScanStatistics       statistics;
+    rtos::Mutex          lock;
+
+    AdvertisementFilter  filter;
+    PresenceTable*       presence;
+
+    DedupCache::Entry    dedup_entries[EMBEDDED_BLE_SCAN_DEDUP_CACHE_SIZE];
+    DedupCache           dedup;
+
+    AdvertisementReport  batch[EMBEDDED_BLE_SCAN_MAX_BATCH_SIZE];
+    uint16_t             batch_count;
+
+    rtos::EventFlags     flags;
+    rtos::Thread*        thread;
+};
+
+/** @} */
+}
+
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth Mesh gateway state machine
+ */
+
+#include <string.h>
+#include "embedded_BLE_state.h"
+
+using namespace cypress::embedded;
+
+/* One event flag per state, set while the state is reached */
+#define MESH_STATE_FLAG(state)      (1UL << (state))
+#define MESH_STATE_FLAGS            (MESH_STATE_FLAG(MESH_STATES) - 1)
+
+MeshStateMachine::MeshStateMachine() :
+    state(MESH_STATE_UNINITIALIZED), sequence(0), state_ms(0)
+{
+    memset(subscribers, 0, sizeof(subscribers));
+    reached.set(MESH_STATE_FLAG(MESH_STATE_UNINITIALIZED));
+}
+
+/* Called with lock held, the transition is published by the caller once the lock is released */
+void MeshStateMachine::enter(MeshState to, MeshStateEvent event, uint32_t now_ms, MeshStateTransition& transition)
+{
+    transition.from     = state;
+    transition.to       = to;
+    transition.event    = event;
+    transition.sequence = ++sequence;
+    transition.time_ms  = now_ms;
+
+    state    = to;
+    state_ms = now_ms;
+
+    // Waiters on a state left behind keep waiting, the ones on a state now reached wake up
+    reached.clear(MESH_STATE_FLAGS & ~(MESH_STATE_FLAG(to + 1) - 1));
+    reached.set(MESH_STATE_FLAG(to + 1) - 1);
+}
+
+MeshState MeshStateMachine::event(MeshStateEvent event)
+{
+    return this->event(event, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+MeshState MeshStateMachine::event(MeshStateEvent event, uint32_t now_ms)
+{
+    Subscriber          notified[EMBEDDED_BLE_MESH_STATE_SUBSCRIBERS];
+    MeshStateTransition transition;
+    MeshState           to = MESH_STATE_UNINITIALIZED;
+    bool                changed = false;
+    int                 i = 0;
+
+    lock.lock();
+    to = state;
+    switch (event)
+    {
+    case MESH_STATE_EVENT_STACK_ENABLED:
+        // A controller starting again has lost the mesh state
+        to = MESH_STATE_STACK_UP;
+        break;
+
+    case MESH_STATE_EVENT_STACK_DISABLED:
+        to = MESH_STATE_UNINITIALIZED;
+        break;
+
+    // The later events also show the earlier stages are done, in case their events were missed
+    case MESH_STATE_EVENT_MESH_STATUS:
+        if (state < MESH_STATE_MESH_STARTED)
+        {
+            to = MESH_STATE_MESH_STARTED;
+        }
+        break;
+
+    case MESH_STATE_EVENT_PROVISIONED:
+        if (state < MESH_STATE_PROVISIONED)
+        {
+            to = MESH_STATE_PROVISIONED;
+        }
+        break;
+
+    // Only the mesh application opens network proxy connections, one reported before it runs is stale.
+    // A gateway restored from NVRAM reports no provisioning, its network connection shows it.
+    case MESH_STATE_EVENT_PROXY_CONNECTED:
+        if (state >= MESH_STATE_MESH_STARTED)
+        {
+            to = MESH_STATE_PROXY_CONNECTED;
+        }
+        break;
+
+    case MESH_STATE_EVENT_PROXY_DISCONNECTED:
+        if (state == MESH_STATE_PROXY_CONNECTED)
+        {
+            to = MESH_STATE_PROVISIONED;
+        }
+        break;
+    }
+
+    if (to != state)
+    {
+        enter(to, event, now_ms, transition);
+        memcpy(notified, subscribers, sizeof(notified));
+        changed = true;
+    }
+    lock.unlock();
+
+    for (i = 0; changed && i < EMBEDDED_BLE_MESH_STATE_SUBSCRIBERS; i++)
+    {
+        if (notified[i].callback)
+        {
+            notified[i].callback(transition, notified[i].context);
+        }
+    }
+
+    return to;
+}
+
+MeshState MeshStateMachine::getState(void)
+{
+    MeshState current = MESH_STATE_UNINITIALIZED;
+
+    lock.lock();
+    current = state;
+    lock.unlock();
+
+    return current;
+}
+
+bool MeshStateMachine::isReached(MeshState state)
+{
+    return getState() >= state;
+}
+
+bool MeshStateMachine::waitFor(MeshState state, uint32_t timeout_ms)
+{
+    uint32_t flags = 0;
+
+    if (state >= MESH_STATES)
+    {
+        return false;
+    }
+
+    flags = reached.wait_any(MESH_STATE_FLAG(state), timeout_ms, false);
+
+    return (flags & osFlagsError) == 0;
+}
+
+ble_error_t MeshStateMachine::subscribe(MeshStateCallback_t callback, void* context)
+{
+    ble_error_t result = BLE_ERROR_NO_MEM;
+    int i = 0;
+
+    if (callback == NULL)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+
+    lock.lock();
+    for (i = 0; i < EMBEDDED_BLE_MESH_STATE_SUBSCRIBERS; i++)
+    {
+        if (subscribers[i].callback == NULL)
+        {
+            subscribers[i].callback = callback;
+            subscribers[i].context  = context;
+            result = BLE_ERROR_NONE;
+            break;
+        }
+    }
+    lock.unlock();
+
+    return result;
+}
+
+ble_error_t MeshStateMachine::unsubscribe(MeshStateCallback_t callback, void* context)
+{
+    ble_error_t result = BLE_ERROR_INVALID_PARAM;
+    int i = 0;
+
+    lock.lock();
+    for (i = 0; i < EMBEDDED_BLE_MESH_STATE_SUBSCRIBERS; i++)
+    {
+        if (subscribers[i].callback == callback && subscribers[i].context == context)
+        {
+            subscribers[i].callback = NULL;
+            subscribers[i].context  = NULL;
+            result = BLE_ERROR_NONE;
+            break;
+        }
+    }
+    lock.unlock();
+
+    return result;
+}
+
+uint32_t MeshStateMachine::getStateTime(void)
+{
+    uint32_t time_ms = 0;
+
+    lock.lock();
+    time_ms = state_ms;
+    lock.unlock();
+
+    return time_ms;
+}
+
+const char* MeshStateMachine::stateToString(MeshState state)
+{
+    switch (state)
+    {
+    case MESH_STATE_UNINITIALIZED:
+        return "uninitialized";
+    case MESH_STATE_STACK_UP:
+        return "stack up";
+    case MESH_STATE_MESH_STARTED:
+        return "mesh started";
+    case MESH_STATE_PROVISIONED:
+        return "provisioned";
+    case MESH_STATE_PROXY_CONNECTED:
+        return "proxy connected";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth Mesh gateway state machine
+ *
+ * Tracks the bring-up of the gateway from the events of the Bluetooth Controller:
+ *
+ *   uninitialized -> stack up -> mesh started -> provisioned -> proxy connected
+ *
+ * Every transition is made under one lock and published to the subscribers once the lock is released.
+ * Callers can wait, with a timeout, for a state to be reached instead of sleeping for a fixed time.
+ * States are ordered: a state is reached when the current state is the same or a later one.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "ble/blecommon.h"
+
+/** Maximum number of state transition subscribers */
+#ifndef EMBEDDED_BLE_MESH_STATE_SUBSCRIBERS
+#define EMBEDDED_BLE_MESH_STATE_SUBSCRIBERS     (4)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines the gateway states, in bring-up order */
+enum MeshState
+{
+    MESH_STATE_UNINITIALIZED,           /**< Bluetooth stack not running */
+    MESH_STATE_STACK_UP,                /**< The Bluetooth Controller reported the stack enabled */
+    MESH_STATE_MESH_STARTED,            /**< The mesh application of the Bluetooth Controller is running */
+    MESH_STATE_PROVISIONED,             /**< The gateway is provisioned to a mesh network */
+    MESH_STATE_PROXY_CONNECTED,         /**< At least one proxy connection to the mesh network is open */
+    MESH_STATES,                        /**< Number of states */
+};
+
+/** Defines the events driving the state machine */
+enum MeshStateEvent
+{
+    MESH_STATE_EVENT_STACK_ENABLED,     /**< BTM_ENABLED_EVT: the controller (re)started */
+    MESH_STATE_EVENT_STACK_DISABLED,    /**< BTM_DISABLED_EVT or BLE::shutdown */
+    MESH_STATE_EVENT_MESH_STATUS,       /**< Mesh status reported by the mesh application */
+    MESH_STATE_EVENT_PROVISIONED,       /**< The gateway's own provisioning succeeded */
+    MESH_STATE_EVENT_PROXY_CONNECTED,   /**< A proxy connection to the network opened, ignored before mesh started */
+    MESH_STATE_EVENT_PROXY_DISCONNECTED,/**< The last proxy connection closed */
+};
+
+/** Defines a state transition */
+struct MeshStateTransition
+{
+    MeshState      from;                /**< Previous state */
+    MeshState      to;                  /**< New state */
+    MeshStateEvent event;               /**< Event causing the transition */
+    uint32_t       sequence;            /**< Transition number, starting at 1 */
+    uint32_t       time_ms;             /**< Time of the transition */
+};
+
+/** Defines the transition subscriber callback, called without the state machine locked so it may apply events.
+ *  Events applied from several threads may be published out of order, MeshStateTransition::sequence gives the order. */
+typedef void (*MeshStateCallback_t)(const MeshStateTransition& transition, void* context);
+
+/** Defines the gateway state machine */
+class MeshStateMachine
+{
+public:
+    MeshStateMachine();
+
+    /** Applies an event.
+     *
+     * @return state after the event
+     */
+    MeshState event(MeshStateEvent event);
+
+    /** Applies an event at now_ms, for callers with their own clock */
+    MeshState event(MeshStateEvent event, uint32_t now_ms);
+
+    /** Returns the current state */
+    MeshState getState(void);
+
+    /** Returns whether state is reached: the current state is state or a later one */
+    bool isReached(MeshState state);
+
+    /** Waits until state is reached.
+     *
+     * @param[in] state:      target state
+     * @param[in] timeout_ms: maximum wait, osWaitForever to wait without a timeout, 0 to poll
+     *
+     * @return false on timeout
+     */
+    bool waitFor(MeshState state, uint32_t timeout_ms);
+
+    /** Adds a transition subscriber.
+     *
+     * @return BLE_ERROR_NO_MEM when EMBEDDED_BLE_MESH_STATE_SUBSCRIBERS are registered
+     */
+    ble_error_t subscribe(MeshStateCallback_t callback, void* context);
+
+    /** Removes a transition subscriber */
+    ble_error_t unsubscribe(MeshStateCallback_t callback, void* context);
+
+    /** Returns the time the current state was entered */
+    uint32_t getStateTime(void);
+
+    /** Returns the name of a state, for logs */
+    static const char* stateToString(MeshState state);
+
+private:
+    struct Subscriber
+    {
+        MeshStateCallback_t callback;
+        void*               context;
+    };
+
+    void enter(MeshState to, MeshStateEvent event, uint32_t now_ms, MeshStateTransition& transition);
+
+    MeshState        state;
+    uint32_t         sequence;
+    uint32_t         state_ms;
+    Subscriber       subscribers[EMBEDDED_BLE_MESH_STATE_SUBSCRIBERS];
+    rtos::Mutex      lock;
+    rtos::EventFlags reached;
+};
+
+/** @} */
+}
+
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file Cypress' Embedded Bluetooth Mesh uplink filter
+ */
+
+#include <string.h>
+#include "embedded_BLE_uplink.h"
+
+using namespace cypress::embedded;
+
+/* Proxy PDU header: SAR (2 bits), message type (6 bits) */
+#define PROXY_PDU_SAR(header)           ((header) >> 6)
+#define PROXY_PDU_TYPE(header)          ((header) & 0x3F)
+#define PROXY_PDU_SAR_COMPLETE          (0x00)
+#define PROXY_PDU_TYPE_NETWORK          (0x00)
+
+MeshUplinkFilter::MeshUplinkFilter() :
+    cache(entries, EMBEDDED_BLE_MESH_DEDUP_CACHE_SIZE, EMBEDDED_BLE_MESH_DEDUP_WINDOW_MS),
+    key_function(networkPduKey),
+    enabled(EMBEDDED_BLE_MESH_DEDUP_WINDOW_MS != 0)
+{
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+void MeshUplinkFilter::configure(uint32_t window_ms, MeshDedupKey_t key)
+{
+    lock.lock();
+
+    key_function = key ? key : networkPduKey;
+    enabled      = (window_ms != 0);
+    cache.setWindow(window_ms);
+    cache.clear();
+    memset(&statistics, 0, sizeof(statistics));
+
+    lock.unlock();
+}
+
+bool MeshUplinkFilter::accept(const uint8_t* packet, uint32_t length, uint32_t now_ms)
+{
+    uint32_t key = 0;
+    bool     duplicate = false;
+
+    lock.lock();
+
+    statistics.received++;
+
+    if (enabled)
+    {
+        key = key_function(packet, length);
+    }
+
+    if (key == 0)
+    {
+        statistics.bypassed++;
+    }
+    else if (cache.isDuplicate(key, now_ms))
+    {
+        statistics.duplicates++;
+        duplicate = true;
+    }
+
+    if (!duplicate)
+    {
+        statistics.delivered++;
+    }
+
+    lock.unlock();
+
+    return !duplicate;
+}
+
+void MeshUplinkFilter::getStatistics(MeshUplinkStatistics& stats)
+{
+    lock.lock();
+    statistics.evictions = cache.getEvictionCount();
+    stats = statistics;
+    lock.unlock();
+}
+
+uint32_t MeshUplinkFilter::networkPduKey(const uint8_t* packet, uint32_t length)
+{
+    if (length < 2 ||
+        PROXY_PDU_SAR(packet[0]) != PROXY_PDU_SAR_COMPLETE ||
+        PROXY_PDU_TYPE(packet[0]) != PROXY_PDU_TYPE_NETWORK)
+    {
+        return 0;
+    }
+
+    return DedupCache::hash(&packet[1], length - 1);
+}
+
+uint32_t MeshUplinkFilter::sourceSequenceKey(uint16_t src, uint32_t seq)
+{
+    uint8_t fields[5];
+
+    fields[0] = (uint8_t)src;
+    fields[1] = (uint8_t)(src >> 8);
+    fields[2] = (uint8_t)seq;
+    fields[3] = (uint8_t)(seq >> 8);
+    fields[4] = (uint8_t)(seq >> 16);
+
+    return DedupCache::hash(fields, sizeof(fields));
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+/*
+ * @file
+ *
+ * Embedded Bluetooth Mesh uplink filter
+ *
+ * The same mesh message reaches the gateway once per proxy path and relay it travels, the
+ * filter drops the copies before they are handed to the application. Messages are identified
+ * by a 32-bit key remembered for a time window in a DedupCache.
+ *
+ * By default the key is a digest of the whole network PDU. Relays decrement the TTL, which is
+ * part of the obfuscated header and of the network nonce, so every hop changes the bytes of
+ * the PDU and the digest cannot leave the TTL out without the network keys. It therefore only
+ * matches copies that took the same number of hops, for example through several proxies at
+ * the same distance. The (SRC, SEQ) pair, which relays do not change, matches every copy: use
+ * sourceSequenceKey from a key function when the application can decode the network header.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "mbed.h"
+#include "embedded_BLE_dedup.h"
+
+/** Number of slots of the uplink de-duplication cache (power of two), at least the messages expected in a window */
+#ifndef EMBEDDED_BLE_MESH_DEDUP_CACHE_SIZE
+#define EMBEDDED_BLE_MESH_DEDUP_CACHE_SIZE      (256)
+#endif
+
+/** Default time an uplink message is remembered, 0 disables the filter */
+#ifndef EMBEDDED_BLE_MESH_DEDUP_WINDOW_MS
+#define EMBEDDED_BLE_MESH_DEDUP_WINDOW_MS       (10000)
+#endif
+
+namespace cypress
+{
+namespace embedded
+{
+
+/**
+ * @addtogroup embedded_ble_mesh
+ *
+ * @{
+ */
+
+/** Defines the uplink filter counters */
+struct MeshUplinkStatistics
+{
+    uint32_t received;              /**< Proxy packets received from the controller */
+    uint32_t delivered;             /**< Packets handed to the application */
+    uint32_t duplicates;            /**< Packets suppressed as duplicates */
+    uint32_t bypassed;              /**< Packets without a key, delivered unfiltered */
+    uint32_t evictions;             /**< Keys dropped before their window elapsed, raise EMBEDDED_BLE_MESH_DEDUP_CACHE_SIZE when growing */
+};
+
+/** Defines the function identifying an uplink proxy packet, 0 delivers the packet unfiltered */
+typedef uint32_t (*MeshDedupKey_t)(const uint8_t* packet, uint32_t length);
+
+/** Defines the uplink de-duplication stage */
+class MeshUplinkFilter
+{
+public:
+    MeshUplinkFilter();
+
+    /** Sets the window and key function, clears the cache and the counters.
+     *
+     * @param[in] window_ms: time a message is remembered, 0 delivers every packet
+     * @param[in] key:       key function, NULL for MeshUplinkFilter::networkPduKey
+     */
+    void configure(uint32_t window_ms, MeshDedupKey_t key = NULL);
+
+    /** Processes a packet received from the controller.
+     *
+     * @return false when the packet is a duplicate to be dropped
+     */
+    bool accept(const uint8_t* packet, uint32_t length, uint32_t now_ms);
+
+    /** Copies the counters */
+    void getStatistics(MeshUplinkStatistics& stats);
+
+    /** Default key: digest of a complete network PDU, TTL included, so copies relayed over a
+     *  different number of hops get different keys. Other proxy PDUs (beacons, proxy
+     *  configuration, provisioning) are not filtered.
+     */
+    static uint32_t networkPduKey(const uint8_t* packet, uint32_t length);
+
+    /** Key of a message from its decoded source address and sequence number, for key functions */
+    static uint32_t sourceSequenceKey(uint16_t src, uint32_t seq);
+
+private:
+    DedupCache::Entry    entries[EMBEDDED_BLE_MESH_DEDUP_CACHE_SIZE];
+    DedupCache           cache;
+    MeshDedupKey_t       key_function;
+    bool                 enabled;
+    MeshUplinkStatistics statistics;
+    rtos::Mutex          lock;
+};
+
+/** @} */
+}
+
+}
@@ -38,18 +38,20 @@
 #include <string.h>
 #include "embedded_BLE.h"
 #include "embedded_GAP.h"
+#include "embedded_BLE_hcicommand.h"
 
 #include "wiced_hci_bt_dm.h"
+#include "wiced_hci_bt_ble.h"
 
 using namespace cypress::embedded;
 
-Gap* Gap::gap = NULL;
+Gap* Gap::gap[WICED_HCI_MAX_CONTROLLERS];
 
 ble_error_t Gap::getAddress(BluetoothAddress addr)
 {
     wiced_bt_device_address_t waddr = {0};
 
-    wiced_bt_dev_read_local_addr(waddr);
+    wiced_bt_dev_read_local_addr(controller, waddr);
     memcpy(addr, waddr, 6);
 
     return BLE_ERROR_NONE;
@@ -59,7 +61,7 @@ ble_error_t Gap::setAddress(BluetoothAddress addr)
 {
     wiced_bt_device_address_t waddr = {0};
     memcpy(waddr, addr, 6);
-    wiced_bt_set_local_bdaddr(waddr);
+    sendHciCommand(controller, HciSetLocalBdaddr(waddr));
     return BLE_ERROR_NONE;
 }
 
@@ -78,28 +80,119 @@ ble_error_t Gap::setName(const char* name)
 /* Bluetooth Low Energy Advertisement APIs */
 ble_error_t Gap::setAdvertisementData(uint8_t* adv_data, uint8_t length)
 {
-    (void)adv_data;
+    return advertiser.setRawData(adv_data, length);
+}
+
+ble_error_t Gap::setAdvertisingPayloads(AdvertisingData* const* payloads, uint8_t count, uint32_t rotation_interval_ms)
+{
+    return advertiser.setPayloads(payloads, count, rotation_interval_ms);
+}
+
+ble_error_t Gap::setScanResponseData(uint8_t* scan_rsp_data, uint8_t length)
+{
+    (void)scan_rsp_data;
     (void)length;
     return BLE_ERROR_NOT_IMPLEMENTED;
 }
 
+void Gap::beginAdvertisingUpdate(void)
+{
+    advertiser.beginUpdate();
+}
+
+ble_error_t Gap::commitAdvertisingUpdate(void)
+{
+    return advertiser.commitUpdate();
+}
+
 ble_error_t Gap::startAdvertisements(void)
 {
-    return BLE_ERROR_NOT_IMPLEMENTED;
+    return advertiser.start();
 }
 
 ble_error_t Gap::stopAdvertisements(void)
 {
-    return BLE_ERROR_NOT_IMPLEMENTED;
+    return advertiser.stop();
+}
+
+void Gap::getAdvertisingStatistics(AdvertisingStatistics& stats)
+{
+    advertiser.getStatistics(stats);
 }
 
 /* Bluetooth Low Energy Scan APIs */
+void Gap::scanResultCallback(wiced_hci_controller_t controller, wiced_bt_ble_scan_results_t* p_scan_result, uint8_t* p_adv_data)
+{
+    getGapInstance(controller).scanner.process(p_scan_result, p_adv_data, (uint32_t)rtos::Kernel::get_ms_count());
+}
+
+ble_error_t Gap::setScanParameters(const ScanParameters& params)
+{
+    if (params.batch_size > EMBEDDED_BLE_SCAN_MAX_BATCH_SIZE)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
+    scan_params = params;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::registerScanReportCallback(ScanReportCallback_t callback)
+{
+    scan_callback = callback;
+    return BLE_ERROR_NONE;
+}
+
+ble_error_t Gap::setScanFilter(const AdvertisementFilterRule* rules, uint8_t count)
+{
+    return scanner.setFilter(rules, count);
+}
+
+ble_error_t Gap::setPresenceTable(PresenceTable* table)
+{
+    scanner.setPresenceTable(table);
+    return BLE_ERROR_NONE;
+}
+
 ble_error_t Gap::startScan(void)
 {
-    return BLE_ERROR_NOT_IMPLEMENTED;
+    if (scan_callback == NULL)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    scanner.configure(scan_params, scan_callback);
+
+    /* Duplicates are filtered by the pipeline, the controller filter would also hide RSSI updates.
+     * The WICED HCI scan command has no duty cycle, the controller applies its own configuration. */
+    if (wiced_bt_ble_scan(controller, BTM_BLE_SCAN_TYPE_HIGH_DUTY, FALSE, scanResultCallback) != CY_RSLT_SUCCESS)
+    {
+        return BLE_ERROR_UNSPECIFIED;
+    }
+    scanning = true;
+
+    return BLE_ERROR_NONE;
 }
 
 ble_error_t Gap::stopScan(void)
 {
-    return BLE_ERROR_NOT_IMPLEMENTED;
+    if (!scanning)
+    {
+        return BLE_ERROR_INVALID_STATE;
+    }
+
+    wiced_bt_ble_scan(controller, BTM_BLE_SCAN_TYPE_NONE, FALSE, NULL);
+    scanning = false;
+    scanner.flush();
+
+    return BLE_ERROR_NONE;
+}
+
+void Gap::getScanStatistics(ScanStatistics& stats)
+{
+    scanner.getStatistics(stats);
+}
+
+void Gap::getScanFilterStatistics(AdvertisementFilterStatistics& stats)
+{
+    scanner.getFilterStatistics(stats);
 }
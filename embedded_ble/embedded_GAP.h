@@ -38,6 +38,9 @@
 
 #pragma once
 
+#include "embedded_BLE_scanner.h"
+#include "embedded_BLE_advertiser.h"
+
 /**
  * \defgroup embedded_ble_gap Embedded BLE GAP Interface
  * @ingroup embedded_ble
@@ -63,15 +66,19 @@ class Gap
 
 public:
     /**
-     * Gets static singleton instance of Embedded BLE GAP interface
+     * Gets static singleton instance of Embedded BLE GAP interface of a Bluetooth Controller
      */
-    static Gap& getGapInstance(void)
+    static Gap& getGapInstance(wiced_hci_controller_t controller = WICED_HCI_DEFAULT_CONTROLLER)
     {
-        if (gap == NULL)
+        if (controller >= WICED_HCI_MAX_CONTROLLERS)
+        {
+            controller = WICED_HCI_DEFAULT_CONTROLLER;
+        }
+        if (gap[controller] == NULL)
         {
-            gap = new Gap;
+            gap[controller] = new Gap(controller);
         }
-        return (Gap&)(*gap);
+        return (Gap&)(*gap[controller]);
     }
 
     /** Generic Bluetooth Controller/Device Management routine */
@@ -118,13 +125,54 @@ public:
 
     /** Set Advertisement data.
      *
-     * @param[in] adv_data:  Advertising data payload pointer
-     * @param[in] length: Advertising data payload length
+     * @param[in] adv_data:  Advertising data payload pointer (LTV encoded AD structures)
+     * @param[in] length: Advertising data payload length (up to 31 bytes)
      *
      * @return ble_error_t
      *
      */
     ble_error_t setAdvertisementData(uint8_t* adv_data, uint8_t length);
+
+    /** Set the advertising payloads, rotating between them when more than one is given.
+     *
+     * @param[in] payloads:  payloads, owned by the application
+     * @param[in] count:  number of payloads (up to EMBEDDED_BLE_ADV_MAX_PAYLOADS)
+     * @param[in] rotation_interval_ms:  time each payload is advertised, 0 disables the rotation
+     *
+     * @return ble_error_t
+     *
+     */
+    ble_error_t setAdvertisingPayloads(AdvertisingData* const* payloads, uint8_t count, uint32_t rotation_interval_ms);
+
+    /** Set Scan response data.
+     *  Not supported, WICED HCI has no command to set the scan response.
+     *
+     * @return ble_error_t
+     *
+     */
+    ble_error_t setScanResponseData(uint8_t* scan_rsp_data, uint8_t length);
+
+    /** Begins an update of the advertising payloads.
+     *  Payload fields may be changed until commitAdvertisingUpdate without the
+     *  controller ever seeing a partial update.
+     */
+    void beginAdvertisingUpdate(void);
+
+    /** Ends an update of the advertising payloads, the advertised payload is
+     *  pushed to the controller only if its content changed.
+     *
+     * @return ble_error_t
+     *
+     */
+    ble_error_t commitAdvertisingUpdate(void);
+
+    /** Gets the advertising counters.
+     *
+     * @param[out] stats:  advertising statistics
+     *
+     */
+    void getAdvertisingStatistics(AdvertisingStatistics& stats);
+
     /** Start Advertising
      *
      * @return ble_error_t
@@ -141,6 +189,45 @@ public:
 
     /** Bluetooth Low Energy Scan APIs */
 
+    /** Sets the scan configuration, applied on the next startScan.
+     *
+     * @param[in] params:  scan parameters
+     *
+     * @return ble_error_t
+     *
+     */
+    ble_error_t setScanParameters(const ScanParameters& params);
+
+    /** Registers the callback receiving the advertisement reports.
+     *
+     * @param[in] callback:  advertisement report callback
+     *
+     * @return ble_error_t
+     *
+     */
+    ble_error_t registerScanReportCallback(ScanReportCallback_t callback);
+
+    /** Installs the advertisement filter, reports not matching the rules are dropped
+     *  before de-duplication. Can be changed while scanning.
+     *
+     * @param[in] rules:  filter rules, NULL with count 0 accepts every report
+     * @param[in] count:  number of rules (up to EMBEDDED_BLE_ADV_FILTER_MAX_RULES)
+     *
+     * @return ble_error_t
+     *
+     */
+    ble_error_t setScanFilter(const AdvertisementFilterRule* rules, uint8_t count);
+
+    /** Attaches a presence table aggregating the reports accepted by the advertisement filter.
+     *  The application owns the table and calls PresenceTable::poll to get the summaries.
+     *
+     * @param[in] table:  presence table, NULL detaches the current one
+     *
+     * @return ble_error_t
+     *
+     */
+    ble_error_t setPresenceTable(PresenceTable* table);
+
     /** Start Scanning of nearby advertising devices.
      * @return ble_error_t
      *
@@ -149,14 +236,44 @@ public:
     ble_error_t startScan(void);
 
     /** Stop Scanning of nearby advertising devices.
+     *  Pending advertisement reports are delivered before returning.
      * @return ble_error_t
      *
      */
     ble_error_t stopScan(void);
 
+    /** Gets the scan pipeline counters of the current scan.
+     *
+     * @param[out] stats:  scan statistics
+     *
+     */
+    void getScanStatistics(ScanStatistics& stats);
+
+    /** Gets the accepted and rejected report counters of the advertisement filter.
+     *
+     * @param[out] stats:  filter statistics
+     *
+     */
+    void getScanFilterStatistics(AdvertisementFilterStatistics& stats);
+
 private:
-    static Gap* gap;
-    Gap(){};
+    static void scanResultCallback(wiced_hci_controller_t controller, wiced_bt_ble_scan_results_t* p_scan_result, uint8_t* p_adv_data);
+
+    static Gap* gap[WICED_HCI_MAX_CONTROLLERS];
+    wiced_hci_controller_t controller;
+    ScanPipeline         scanner;
+    Advertiser           advertiser;
+    ScanParameters       scan_params;
+    ScanReportCallback_t scan_callback;
+    bool                 scanning;
+
+    Gap(wiced_hci_controller_t controller) : controller(controller), advertiser(controller), scan_callback(NULL), scanning(false)
+    {
+        scan_params.filter_duplicates = true;
+        scan_params.dedup_window_ms   = 1000;
+        scan_params.batch_size        = 1;
+        scan_params.batch_timeout_ms  = 0;
+    };
     Gap(Gap const&){};            // copy constructor is private
     Gap& operator=(Gap const&);   // assignment operator is private
 };
@@ -39,6 +39,18 @@
 extern "C" {
 #endif
 
+/** Bluetooth Controllers attached to the host, each on its own UART */
+#ifndef WICED_HCI_MAX_CONTROLLERS
+#define WICED_HCI_MAX_CONTROLLERS       (1)
+#endif
+
+/** Controller of the single controller applications */
+#define WICED_HCI_DEFAULT_CONTROLLER    (0)
+
+/** Handle of a Bluetooth Controller: its index, below WICED_HCI_MAX_CONTROLLERS.
+ *  Every function and callback of the API is given the controller it applies to. */
+typedef uint8_t wiced_hci_controller_t;
+
 typedef uint8_t wiced_bt_management_evt_t;
 
 /** Bluetooth Management events */
@@ -100,6 +112,8 @@ typedef union
 {
     /* Bluetooth status event data types*/
     wiced_bt_dev_enabled_t                  enabled;                            /**< Data for BTM_ENABLED_EVT */
+    uint8_t                                 ble_scan_state_changed;             /**< Data for BTM_BLE_SCAN_STATE_CHANGED_EVT */
+    uint8_t                                 ble_advert_state_changed;           /**< Data for BTM_BLE_ADVERT_STATE_CHANGED_EVT */
 } wiced_bt_management_evt_data_t;
 
 /**
@@ -108,12 +122,13 @@ typedef union
  * Callback for Bluetooth Management event notifications.
  * Registered using wiced_bt_stack_init()
  *
+ * @param controller        : Controller reporting the event
  * @param event             : Event ID
  * @param p_event_data      : Event data
  *
  * @return Status of event handling
  */
-typedef cy_rslt_t (wiced_bt_management_cback_t) (wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data);
+typedef cy_rslt_t (wiced_bt_management_cback_t) (wiced_hci_controller_t controller, wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data);
 
 #ifdef __cplusplus
 } ;
@@ -30,7 +30,67 @@
  * of such system or application assumes all risk of such use and in doing
  * so agrees to indemnify Cypress against all liability.
  */
+#pragma once
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "cy_result.h"
+#include "wiced_defs.h"
+#include "wiced_hci_bt_gatt.h"
+
+/** scan type (used when calling wiced_bt_ble_scan) */
+enum wiced_bt_ble_scan_type_e
+{
+    BTM_BLE_SCAN_TYPE_NONE,         /**< Stop scanning */
+    BTM_BLE_SCAN_TYPE_HIGH_DUTY,    /**< High duty cycle scan */
+    BTM_BLE_SCAN_TYPE_LOW_DUTY      /**< Low duty cycle scan */
+};
+typedef uint8_t wiced_bt_ble_scan_type_t;   /**< scan type (see #wiced_bt_ble_scan_type_e) */
+
+/** Advertising event types reported in an LE scan result */
+enum wiced_bt_dev_ble_evt_type_e {
+    BTM_BLE_EVT_CONNECTABLE_ADVERTISEMENT           = 0x00,     /**< Connectable undirected advertisement */
+    BTM_BLE_EVT_CONNECTABLE_DIRECTED_ADVERTISEMENT  = 0x01,     /**< Connectable directed advertisement */
+    BTM_BLE_EVT_SCANNABLE_ADVERTISEMENT             = 0x02,     /**< Scannable undirected advertisement */
+    BTM_BLE_EVT_NON_CONNECTABLE_ADVERTISEMENT       = 0x03,     /**< Non connectable undirected advertisement */
+    BTM_BLE_EVT_SCAN_RSP                            = 0x04      /**< Scan response */
+};
+typedef uint8_t wiced_bt_dev_ble_evt_type_t;    /**< Scan result event type (see #wiced_bt_dev_ble_evt_type_e) */
+
+/** LE scan result (reported to the wiced_bt_ble_scan_result_cback_t) */
+typedef struct
+{
+    wiced_bt_device_address_t       remote_bd_addr;     /**< Device address */
+    wiced_bt_ble_address_type_t     ble_addr_type;      /**< LE Address type */
+    wiced_bt_dev_ble_evt_type_t     ble_evt_type;       /**< Scan result event type */
+    int8_t                          rssi;               /**< Received signal strength */
+    uint8_t                         adv_data_length;    /**< Length of the advertisement data passed along with the result */
+} wiced_bt_ble_scan_results_t;
+
+/**
+ * LE scan result callback
+ *
+ * Called from the WICED HCI event worker (the read thread when the controller has no worker)
+ * for every advertisement report received while scanning.
+ * The advertisement data is only valid for the duration of the call.
+ *
+ * @param controller        : Controller that received the advertisement
+ * @param p_scan_result     : scan result data
+ * @param p_adv_data        : advertisement data (p_scan_result->adv_data_length bytes, LTV encoded)
+ *
+ * @return          void
+ */
+typedef void (wiced_bt_ble_scan_result_cback_t) (wiced_hci_controller_t controller, wiced_bt_ble_scan_results_t *p_scan_result, uint8_t *p_adv_data);
+
+/** LE connection parameters (used when calling wiced_bt_ble_set_conn_params) */
+typedef struct
+{
+    uint16_t    interval_min;           /**< Minimum connection interval, 1.25 ms units (0x0006 - 0x0C80) */
+    uint16_t    interval_max;           /**< Maximum connection interval, 1.25 ms units (0x0006 - 0x0C80) */
+    uint16_t    latency;                /**< Peripheral latency, connection events (0x0000 - 0x01F3) */
+    uint16_t    supervision_timeout;    /**< Supervision timeout, 10 ms units (0x000A - 0x0C80) */
+} wiced_bt_ble_conn_params_t;
 
 /**
  *
@@ -44,6 +104,7 @@
  *                  The <b>advert_mode</b> parameter determines what advertising parameters and durations
  *                  to use (as specified by the application configuration).
  *
+ * @param[in]       controller                          : Bluetooth Controller to use
  * @param[in]       advert_mode                         : advertisement mode
  * @param[in]       directed_advertisement_bdaddr_type  : BLE_ADDR_PUBLIC or BLE_ADDR_RANDOM (if using directed advertisement mode)
  * @param[in]       directed_advertisement_bdaddr_ptr   : Directed advertisement address (NULL if not using directed advertisement)
@@ -51,7 +112,7 @@
  * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  *
  */
-cy_rslt_t wiced_bt_start_advertisements(wiced_bt_ble_advert_mode_t advert_mode, wiced_bt_ble_address_type_t directed_advertisement_bdaddr_type, wiced_bt_device_address_ptr_t directed_advertisement_bdaddr_ptr);
+cy_rslt_t wiced_bt_start_advertisements(wiced_hci_controller_t controller, wiced_bt_ble_advert_mode_t advert_mode, wiced_bt_ble_address_type_t directed_advertisement_bdaddr_type, wiced_bt_device_address_ptr_t directed_advertisement_bdaddr_ptr);
 
 /**
  *
@@ -59,13 +120,14 @@ cy_rslt_t wiced_bt_start_advertisements(wiced_bt_ble_advert_mode_t advert_mode,
  *
  *                  Set advertisement raw data.
  *
+ * @param[in] controller : Bluetooth Controller to use
  * @param[in] data_mask :   number of ADV data element
  * @param[in] p_data :      advertisement raw data
  *
  * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  *
  */
-cy_rslt_t wiced_bt_ble_set_raw_advertisement_data(UINT8 num_elem, wiced_bt_ble_advert_elem_t *p_data);
+cy_rslt_t wiced_bt_ble_set_raw_advertisement_data(wiced_hci_controller_t controller, UINT8 num_elem, wiced_bt_ble_advert_elem_t *p_data);
 
 /**
  *
@@ -73,10 +135,101 @@ cy_rslt_t wiced_bt_ble_set_raw_advertisement_data(UINT8 num_elem, wiced_bt_ble_a
  *
  *                  Grant or deny access.  Used in response to an BTM_SECURITY_REQUEST_EVT event.
  *
+ * @param[in]       controller  : Bluetooth Controller to use
  * @param[in]       bd_addr     : peer device bd address.
  * @param[in]       res         : BTM_SUCCESS to grant access; BTM_REPEATED_ATTEMPTS otherwise
  *
  * @return          <b> None </b>
  *
  */
-void wiced_bt_ble_security_grant(wiced_bt_device_address_t bd_addr, uint8_t res);
+void wiced_bt_ble_security_grant(wiced_hci_controller_t controller, wiced_bt_device_address_t bd_addr, uint8_t res);
+
+/**
+ *
+ * Function         wiced_bt_ble_scan
+ *
+ *                  Start or stop LE scanning.
+ *
+ *                  Every advertisement report received while the scan is active is passed
+ *                  to <b>p_scan_result_cback</b>. The result of the command is reported
+ *                  with the BTM_BLE_SCAN_STATE_CHANGED_EVT management event.
+ *
+ * @param[in]       controller               : Bluetooth Controller to use
+ * @param[in]       scan_type                : BTM_BLE_SCAN_TYPE_NONE to stop scanning, high or low duty cycle scan otherwise
+ * @param[in]       duplicate_filter_enable  : TRUE to let the controller filter duplicate reports
+ * @param[in]       p_scan_result_cback      : scan result callback (ignored when stopping the scan)
+ *
+ * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ *
+ */
+cy_rslt_t wiced_bt_ble_scan(wiced_hci_controller_t controller, wiced_bt_ble_scan_type_t scan_type, BOOLEAN duplicate_filter_enable, wiced_bt_ble_scan_result_cback_t *p_scan_result_cback);
+
+/**
+ *
+ * Function         wiced_bt_ble_connect
+ *
+ *                  Create an LE connection to a peripheral, as central.
+ *
+ *                  The connection is reported with GATT_CONNECTION_STATUS_EVT to the GATT
+ *                  callback. The controller creates one connection at a time and reports no
+ *                  failure: an attempt that does not complete is cancelled with
+ *                  #wiced_bt_ble_cancel_connect.
+ *
+ * @param[in]       controller  : Bluetooth Controller to use
+ * @param[in]       addr_type   : BLE_ADDR_PUBLIC or BLE_ADDR_RANDOM
+ * @param[in]       bd_addr     : peer device bd address
+ *
+ * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ *
+ */
+cy_rslt_t wiced_bt_ble_connect(wiced_hci_controller_t controller, wiced_bt_ble_address_type_t addr_type, const wiced_bt_device_address_t bd_addr);
+
+/**
+ *
+ * Function         wiced_bt_ble_cancel_connect
+ *
+ *                  Cancel a connection started with #wiced_bt_ble_connect.
+ *
+ * @param[in]       controller  : Bluetooth Controller to use
+ * @param[in]       addr_type   : BLE_ADDR_PUBLIC or BLE_ADDR_RANDOM
+ * @param[in]       bd_addr     : peer device bd address
+ *
+ * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ *
+ */
+cy_rslt_t wiced_bt_ble_cancel_connect(wiced_hci_controller_t controller, wiced_bt_ble_address_type_t addr_type, const wiced_bt_device_address_t bd_addr);
+
+/**
+ *
+ * Function         wiced_bt_ble_disconnect
+ *
+ *                  Disconnect an LE connection. The disconnection is reported with
+ *                  GATT_CONNECTION_STATUS_EVT.
+ *
+ * @param[in]       controller  : Bluetooth Controller to use
+ * @param[in]       conn_id     : connection id
+ *
+ * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ *
+ */
+cy_rslt_t wiced_bt_ble_disconnect(wiced_hci_controller_t controller, uint16_t conn_id);
+
+/**
+ *
+ * Function         wiced_bt_ble_set_conn_params
+ *
+ *                  Request new connection parameters for a connection, for example a short
+ *                  interval for a bulk transfer and a long one when the link is idle.
+ *
+ * @param[in]       controller  : Bluetooth Controller to use
+ * @param[in]       bd_addr     : peer device bd address
+ * @param[in]       p_params    : connection parameters
+ *
+ * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR when the parameters are out of range
+ *
+ */
+cy_rslt_t wiced_bt_ble_set_conn_params(wiced_hci_controller_t controller, const wiced_bt_device_address_t bd_addr, const wiced_bt_ble_conn_params_t *p_params);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
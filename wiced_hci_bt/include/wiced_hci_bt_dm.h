@@ -45,12 +45,37 @@ extern "C" {
  * Callback for Bluetooth Management event notifications.
  * Registered using wiced_bt_stack_init()
  *
+ * @param controller        : Controller reporting the event
  * @param event             : Event ID
  * @param p_event_data      : Event data
  *
  * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  */
-typedef cy_rslt_t (wiced_bt_management_cback_t) (wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data);
+typedef cy_rslt_t (wiced_bt_management_cback_t) (wiced_hci_controller_t controller, wiced_bt_management_evt_t event, wiced_bt_management_evt_data_t *p_event_data);
+
+/** Buffer pools reported by wiced_bt_dev_read_buffer_stats */
+#define WICED_BT_BUFFER_POOLS   ( 4 )
+
+/** Usage of a controller buffer pool */
+typedef struct
+{
+    uint8_t     pool_id;                    /**< pool id */
+    uint16_t    pool_size;                  /**< size of the buffers of the pool */
+    uint16_t    current_allocated_count;    /**< buffers in use */
+    uint16_t    max_allocated_count;        /**< most buffers ever in use */
+    uint16_t    total_count;                /**< buffers of the pool */
+} wiced_bt_buffer_statistics_t;
+
+/**
+ * Buffer statistics callback
+ *
+ * Registered using wiced_bt_dev_read_buffer_stats()
+ *
+ * @param controller        : Controller owning the pools
+ * @param p_stats           : pools, ordered by buffer size
+ * @param count             : number of pools
+ */
+typedef void (wiced_bt_buffer_stats_cback_t) (wiced_hci_controller_t controller, const wiced_bt_buffer_statistics_t *p_stats, uint8_t count);
 
 /****************************************************************************/
 
@@ -58,13 +83,15 @@ typedef cy_rslt_t (wiced_bt_management_cback_t) (wiced_bt_management_evt_t event
  * Function         wiced_bt_stack_init
  *
  *                  Initialize the Bluetooth controller and stack; register
- *                  callback for Bluetooth event notification.
+ *                  callback for Bluetooth event notification. Each controller
+ *                  is started on its own, with its own WICED HCI threads.
  *
+ * @param[in] controller                : Controller to start
  * @param[in] p_bt_management_cback     : Callback for receiving Bluetooth management events
  *
  * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  */
-cy_rslt_t wiced_bt_stack_init(wiced_bt_management_cback_t *p_bt_management_cback);
+cy_rslt_t wiced_bt_stack_init(wiced_hci_controller_t controller, wiced_bt_management_cback_t *p_bt_management_cback);
 
 /**
  * Function         wiced_bt_stack_deinit
@@ -72,33 +99,52 @@ cy_rslt_t wiced_bt_stack_init(wiced_bt_management_cback_t *p_bt_management_cback
  *                  This function blocks until all de-initialisation procedures are complete.
  *                  It is recommended that the application disconnect any outstanding connections prior to invoking this function.
  *
+ * @param[in] controller                : Controller to stop
+ *
  * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  */
-cy_rslt_t wiced_bt_stack_deinit(void);
+cy_rslt_t wiced_bt_stack_deinit(wiced_hci_controller_t controller);
 
 /**
  * Function         wiced_bt_set_local_bdaddr
  *
  *                  Set Local Bluetooth Device Address
  *
+ * @param[in]      controller : Bluetooth Controller to use
  * @param[in]      bd_addr    : device address to use
  *
  * @return          void
  *
  */
-void wiced_bt_set_local_bdaddr( wiced_bt_device_address_t  bda );
+void wiced_bt_set_local_bdaddr( wiced_hci_controller_t controller, wiced_bt_device_address_t  bda );
 
 /**
  * Function         wiced_bt_dev_read_local_addr
  *
  * Read the local device address
  *
+ * @param[in]       controller     : Bluetooth Controller to use
  * @param[out]      bd_addr        : Local bd address
  *
  * @return          void
  *
  */
-void wiced_bt_dev_read_local_addr (wiced_bt_device_address_t bd_addr);
+void wiced_bt_dev_read_local_addr (wiced_hci_controller_t controller, wiced_bt_device_address_t bd_addr);
+
+/**
+ * Function         wiced_bt_dev_read_buffer_stats
+ *
+ *                  Read the buffer pool usage of the controller. The answer comes after every
+ *                  command sent before it has been processed, the callback is called from the
+ *                  WICED HCI event worker (the read thread when the controller has no worker).
+ *
+ * @param[in]      controller     : Bluetooth Controller to use
+ * @param[in]      p_cback        : callback receiving the pools
+ *
+ * @return cy_rslt_t : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ *
+ */
+cy_rslt_t wiced_bt_dev_read_buffer_stats(wiced_hci_controller_t controller, wiced_bt_buffer_stats_cback_t *p_cback);
 
 #ifdef __cplusplus
 } /* extern C */
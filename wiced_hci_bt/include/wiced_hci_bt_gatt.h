@@ -30,6 +30,8 @@
  * of such system or application assumes all risk of such use and in doing
  * so agrees to indemnify Cypress against all liability.
  */
+#pragma once
+
 #include "cy_result.h"
 #include "wiced_bt_hci.h"
 #include "wiced_defs.h"
@@ -521,7 +523,8 @@ typedef enum
     GATT_OPERATION_CPLT_EVT,                            /**< GATT operation complete. Event data: #wiced_bt_gatt_event_data_t */
     GATT_DISCOVERY_RESULT_EVT,                          /**< GATT attribute discovery result. Event data: #wiced_bt_gatt_discovery_result_t */
     GATT_DISCOVERY_CPLT_EVT,                            /**< GATT attribute discovery complete. Event data: #wiced_bt_gatt_event_data_t */
-    GATT_ATTRIBUTE_REQUEST_EVT                          /**< GATT attribute request (from remote client). Event data: #wiced_bt_gatt_attribute_request_t */
+    GATT_ATTRIBUTE_REQUEST_EVT,                         /**< GATT attribute request (from remote client). Event data: #wiced_bt_gatt_attribute_request_t */
+    GATT_PEER_MTU_EVT                                   /**< ATT MTU negotiated with the peer. Event data: #wiced_bt_gatt_peer_mtu_t */
 } wiced_bt_gatt_evt_t;
 
 /** Discovery result (used by GATT_DISCOVERY_RESULT_EVT notification) */
@@ -576,6 +579,13 @@ typedef struct
     BOOLEAN                                 congested;          /**< congestion state */
 } wiced_bt_gatt_congestion_event_t;
 
+/** ATT MTU of a connection (used by GATT_PEER_MTU_EVT notification) */
+typedef struct
+{
+    uint16_t                                conn_id;            /**< ID of the connection */
+    uint16_t                                mtu;                /**< negotiated ATT MTU */
+} wiced_bt_gatt_peer_mtu_t;
+
 /** Stuctures for GATT event notifications */
 typedef union
 {
@@ -585,6 +595,7 @@ typedef union
     wiced_bt_gatt_connection_status_t       connection_status;  /**< Data for GATT_CONNECTION_STATUS_EVT */
     wiced_bt_gatt_attribute_request_t       attribute_request;  /**< Data for GATT_ATTRIBUTE_REQUEST_EVT */
     wiced_bt_gatt_congestion_event_t        congestion;         /**< Data for GATT_CONGESTION_EVT */
+    wiced_bt_gatt_peer_mtu_t                peer_mtu;           /**< Data for GATT_PEER_MTU_EVT */
 } wiced_bt_gatt_event_data_t;
 
 /**
@@ -593,9 +604,113 @@ typedef union
  * Callback for GATT event notifications
  * Registered using wiced_bt_gatt_register()
  *
+ * @param controller        : Controller reporting the event
  * @param event             : Event ID
  * @param p_event_data      : Event data
  *
  * @return Status of event handling
 */
-typedef wiced_bt_gatt_status_t wiced_bt_gatt_cback_t(wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_event_data);
+typedef wiced_bt_gatt_status_t wiced_bt_gatt_cback_t(wiced_hci_controller_t controller, wiced_bt_gatt_evt_t event, wiced_bt_gatt_event_data_t *p_event_data);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Function         wiced_bt_gatt_register
+ *
+ *                  Register the GATT client callback and route the GATT events of the
+ *                  controller to it (GATT_DISCOVERY_RESULT_EVT, GATT_DISCOVERY_CPLT_EVT,
+ *                  GATT_OPERATION_CPLT_EVT), and GATT_CONNECTION_STATUS_EVT once registered.
+ *                  The read and write requests of the peers to the database given with
+ *                  wiced_bt_gatt_db_init are GATT_ATTRIBUTE_REQUEST_EVT: a read fills p_val and
+ *                  *p_val_len, and the response is sent with the status returned.
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] p_gatt_cback          : GATT event callback, called from the WICED HCI event worker
+ *                                    (the read thread when the controller has no worker)
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_gatt_register(wiced_hci_controller_t controller, wiced_bt_gatt_cback_t *p_gatt_cback);
+
+/**
+ * Function         wiced_bt_gatt_send_discover
+ *
+ *                  Start a GATT discovery in a handle range: GATT_DISCOVER_SERVICES_ALL,
+ *                  GATT_DISCOVER_CHARACTERISTICS or GATT_DISCOVER_CHARACTERISTIC_DESCRIPTORS.
+ *                  One discovery at a time per connection.
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] conn_id               : connection id
+ * @param[in] discovery_type        : discovery type
+ * @param[in] p_discovery_param     : handle range (the uuid is ignored)
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_gatt_send_discover(wiced_hci_controller_t controller, uint16_t conn_id, wiced_bt_gatt_discovery_type_t discovery_type, wiced_bt_gatt_discovery_param_t *p_discovery_param);
+
+/**
+ * Function         wiced_bt_gatt_send_read
+ *
+ *                  Read an attribute, GATT_READ_BY_HANDLE only. One read at a time per connection.
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] conn_id               : connection id
+ * @param[in] type                  : GATT_READ_BY_HANDLE
+ * @param[in] p_read                : handle to read
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_gatt_send_read(wiced_hci_controller_t controller, uint16_t conn_id, wiced_bt_gatt_read_type_t type, wiced_bt_gatt_read_param_t *p_read);
+
+/**
+ * Function         wiced_bt_gatt_send_write
+ *
+ *                  Write an attribute with (GATT_WRITE) or without (GATT_WRITE_NO_RSP) response.
+ *                  One write with response at a time per connection.
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] conn_id               : connection id
+ * @param[in] type                  : GATT_WRITE or GATT_WRITE_NO_RSP
+ * @param[in] p_data                : handle and value
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_gatt_send_write(wiced_hci_controller_t controller, uint16_t conn_id, wiced_bt_gatt_write_type_t type, wiced_bt_gatt_value_t *p_data);
+
+/**
+ * Function         wiced_bt_gatt_db_init
+ *
+ *                  Give the GATT server database to the controller, in the controller's
+ *                  format (the WICED PRIMARY_SERVICE_UUID16, CHARACTERISTIC_UUID16... layout).
+ *                  The controller serves the declarations and forwards the requests to the
+ *                  values as GATT_ATTRIBUTE_REQUEST_EVT.
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] p_gatt_db             : database
+ * @param[in] db_size               : database length
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_gatt_db_init(wiced_hci_controller_t controller, const uint8_t *p_gatt_db, uint16_t db_size);
+
+/**
+ * Function         wiced_bt_gatt_send_write_command
+ *
+ *                  Write an attribute without response, the value is sent from the caller's
+ *                  buffer without being copied.
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] conn_id               : connection id
+ * @param[in] handle                : attribute handle
+ * @param[in] p_value               : value
+ * @param[in] len                   : value length, at most the peer ATT MTU - 3
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_gatt_send_write_command(wiced_hci_controller_t controller, uint16_t conn_id, uint16_t handle, const uint8_t *p_value, uint16_t len);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
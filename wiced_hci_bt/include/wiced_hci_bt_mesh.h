@@ -39,10 +39,24 @@ extern "C"
 
 #include "cy_result.h"
 #include "wiced_defs.h"
+#include "wiced_bt_hci.h"
 /******************************************************
  *                    Constants
  ******************************************************/
 
+/** Proxy connection used by wiced_bt_mesh_proxy_connect */
+#define WICED_BT_MESH_DEFAULT_CONNECTION_ID         (0x0003)
+
+/** Number of NVRAM chunks sent ahead of their command status during a restore */
+#ifndef WICED_BT_MESH_NVRAM_RESTORE_WINDOW
+#define WICED_BT_MESH_NVRAM_RESTORE_WINDOW          (4)
+#endif
+
+/** Time to wait for the command status of an NVRAM chunk during a restore */
+#ifndef WICED_BT_MESH_NVRAM_RESTORE_TIMEOUT_MS
+#define WICED_BT_MESH_NVRAM_RESTORE_TIMEOUT_MS      (1000)
+#endif
+
 /******************************************************
  *                   Structures
  ******************************************************/
@@ -68,12 +82,16 @@ extern "C"
  * GATT notification or even external function (for example MeshController).
  * Called by core to send packet to the proxy client.
  *
+ * @param[in]   controller      :Controller the proxy packet was received from
  * @param[in]   packet          :Packet to send
  * @param[in]   packet_len      :Length of the packet to send
  *
  * @return      None
  */
-typedef void(*wiced_bt_mesh_core_gatt_send_cb_t)(const uint8_t *packet, uint32_t packet_len);
+typedef void(*wiced_bt_mesh_core_gatt_send_cb_t)(wiced_hci_controller_t controller, const uint8_t *packet, uint32_t packet_len);
+
+/* The packets of wiced_bt_mesh_core_gatt_send_cb_t are complete proxy PDUs, SAR segments are
+ * reassembled first. The packet is only valid during the callback. */
 
 /**
  * @anchor BT_MESH_PROVISION_RESULT
@@ -89,24 +107,37 @@ typedef void(*wiced_bt_mesh_core_gatt_send_cb_t)(const uint8_t *packet, uint32_t
  * \brief Definition of the callback function on provisioning end.
  * \details Provisioner or/and provisioning application implements that function to be called on successfull or failed end of provisioning.
  *
+ * @param[in]   controller  :Controller of the provisioning connection
  * @param[in]   conn_id     :Connection ID of the provisioning connection
  * @param[in]   result      ::Provisioning Result code (see @ref BT_MESH_PROVISION_RESULT "Provisioning Result codes")
  *
  * @return   None
  */
-typedef void (*wiced_bt_mesh_provision_end_cb_t)(uint32_t  conn_id, uint8_t   result);
+typedef void (*wiced_bt_mesh_provision_end_cb_t)(wiced_hci_controller_t controller, uint32_t  conn_id, uint8_t   result);
 
-typedef void (*wiced_bt_mesh_write_nvram_data_cb_t) (int id, uint8_t *payload, uint32_t payload_len);
+typedef void (*wiced_bt_mesh_write_nvram_data_cb_t) (wiced_hci_controller_t controller, int id, uint8_t *payload, uint32_t payload_len);
 
 /**
  * \brief Definition of the callback function of mesh status
  * \details Application implements the function to know the current status of the mesh.
  *
+  * @param[in]   controller :: Controller of the mesh
   * @param[in]   status     :: Mesh status
  *
  * @return   None
  */
-typedef void (*wiced_bt_mesh_status_cb_t)(uint8_t status);
+typedef void (*wiced_bt_mesh_status_cb_t)(wiced_hci_controller_t controller, uint8_t status);
+
+/**
+ * \brief Definition of the callback function of proxy connection status
+ *
+ * @param[in]   controller  :: Controller of the proxy connection
+ * @param[in]   conn_id     :: Proxy connection id
+ * @param[in]   connected   :: 1 when connected, 0 when disconnected
+ *
+ * @return   None
+ */
+typedef void (*wiced_bt_mesh_proxy_connection_cb_t)(wiced_hci_controller_t controller, uint16_t conn_id, uint8_t connected);
 
 /**
  * Function         wiced_bt_mesh_init
@@ -114,6 +145,7 @@ typedef void (*wiced_bt_mesh_status_cb_t)(uint8_t status);
  *                  Initialize the Mesh stack; register
  *                  callback for Bluetooth event notification.
  *
+ * @param[in] controller            : Bluetooth Controller to use
  * @param[in] prov_end_cb           : Callback for receiving provisioning status
  * @param[in] proxy_data_cb         : Callback for receiving proxy data
  * @param[in] write_nvram_data_cb   : Callback for receiving nvram data
@@ -121,19 +153,26 @@ typedef void (*wiced_bt_mesh_status_cb_t)(uint8_t status);
  *
  * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  */
-cy_rslt_t wiced_bt_mesh_init(wiced_bt_mesh_provision_end_cb_t prov_end_cb,wiced_bt_mesh_core_gatt_send_cb_t proxy_data_cb, wiced_bt_mesh_write_nvram_data_cb_t write_nvram_data_cb, wiced_bt_mesh_status_cb_t mesh_status_cb);
+cy_rslt_t wiced_bt_mesh_init(wiced_hci_controller_t controller, wiced_bt_mesh_provision_end_cb_t prov_end_cb,wiced_bt_mesh_core_gatt_send_cb_t proxy_data_cb, wiced_bt_mesh_write_nvram_data_cb_t write_nvram_data_cb, wiced_bt_mesh_status_cb_t mesh_status_cb);
 
 /**
  * Function         wiced_bt_mesh_send_proxy_packet
  *
- *                  send proxy packet to the proxy interface
+ *                  send proxy packet to the proxy interface. A complete proxy PDU longer than
+ *                  the transport MTU (WICED_HCI_MAX_PAYLOAD_LENGTH) is sent as proxy SAR
+ *                  segments, so the only bound on the length sent is its uint16_t type. The
+ *                  mesh core must be able to reassemble it. In the other direction the
+ *                  segments from the mesh core are reassembled in a static buffer of
+ *                  WICED_BT_MESH_PROXY_REASSEMBLY_LENGTH bytes per controller (4 times the
+ *                  MTU by default), longer received PDUs are dropped.
  *
- * @param[in] p_data                : proxy packet
- * @param[in] data_lem              : proxy data length
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] p_data                : proxy packet, starting with the proxy PDU header
+ * @param[in] data_len              : proxy data length, up to 65535 bytes
  *
  * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  */
-cy_rslt_t wiced_bt_mesh_send_proxy_packet(uint8_t* p_data, uint8_t data_len);
+cy_rslt_t wiced_bt_mesh_send_proxy_packet(wiced_hci_controller_t controller, const uint8_t* p_data, uint16_t data_len);
 
 
 /**
@@ -141,24 +180,107 @@ cy_rslt_t wiced_bt_mesh_send_proxy_packet(uint8_t* p_data, uint8_t data_len);
  *
  *                  request proxy connection to the mesh stack.
  *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] connection_state      : 1 - for connect , and 0 - for disconnect
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_mesh_proxy_connect(wiced_hci_controller_t controller, uint8_t connection_state);
+
+/**
+ * Function         wiced_bt_mesh_proxy_connection
+ *
+ *                  open or close one of several proxy connections
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] conn_id               : connection id, not 0
  * @param[in] connection_state      : 1 - for connect , and 0 - for disconnect
  *
  * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  */
-cy_rslt_t wiced_bt_mesh_proxy_connect(uint8_t connection_state);
+cy_rslt_t wiced_bt_mesh_proxy_connection(wiced_hci_controller_t controller, uint16_t conn_id, uint8_t connection_state);
+
+/**
+ * Function         wiced_bt_mesh_send_proxy_packet_to
+ *
+ *                  send proxy packet on a proxy connection. The connection is selected with
+ *                  HCI_CONTROL_MESH_COMMAND_CONNECTION_STATE when it differs from the previous one,
+ *                  the selection and the packet are written under the write lock of the controller.
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] conn_id               : connection id
+ * @param[in] p_data                : proxy packet, starting with the proxy PDU header
+ * @param[in] data_len              : proxy data length
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_mesh_send_proxy_packet_to(wiced_hci_controller_t controller, uint16_t conn_id, const uint8_t* p_data, uint16_t data_len);
+
+/**
+ * Function         wiced_bt_mesh_proxy_selected_connection
+ *
+ *                  the controller does not tag proxy data with a connection: received proxy
+ *                  data belongs to the connection selected last
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ *
+ * @return uint16_t                 : connection id, 0 when none is selected
+ */
+uint16_t wiced_bt_mesh_proxy_selected_connection(wiced_hci_controller_t controller);
+
+/**
+ * Function         wiced_bt_mesh_register_proxy_connection_cb
+ *
+ *                  register the callback for HCI_CONTROL_MESH_EVENT_PROXY_CONNECTION_STATUS
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] proxy_connection_cb   : callback, NULL to unregister
+ */
+void wiced_bt_mesh_register_proxy_connection_cb(wiced_hci_controller_t controller, wiced_bt_mesh_proxy_connection_cb_t proxy_connection_cb);
 
 /**
  * Function         wiced_bt_mesh_push_nvram_data
  *
- *                  push the stored mesh nvram data
+ *                  push the stored mesh nvram data. Between wiced_bt_mesh_restore_nvram_begin
+ *                  and wiced_bt_mesh_restore_nvram_end, waits until fewer than the restore
+ *                  window chunks are waiting for their command status.
  *
+ * @param[in] controller            : Bluetooth Controller to use
  * @param[in] data                  : nvram data
  * @param[in] data_len              : data length
  * @param[in] idx                   : index
  *
  * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
  */
-cy_rslt_t wiced_bt_mesh_push_nvram_data(uint8_t *data , uint8_t data_len , uint16_t idx);
+cy_rslt_t wiced_bt_mesh_push_nvram_data(wiced_hci_controller_t controller, const uint8_t *data , uint16_t data_len , uint16_t idx);
+
+/**
+ * Function         wiced_bt_mesh_restore_nvram_begin
+ *
+ *                  start a restore: the following wiced_bt_mesh_push_nvram_data calls are
+ *                  pipelined, with up to window chunks waiting for their command status.
+ *                  Other device commands can be sent during the restore, their command
+ *                  statuses are told from the ones of the chunks by the order of the commands;
+ *                  no device command sent before the restore may still wait for its status.
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ * @param[in] window                : chunks in flight, 0 for WICED_BT_MESH_NVRAM_RESTORE_WINDOW
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_mesh_restore_nvram_begin(wiced_hci_controller_t controller, uint8_t window);
+
+/**
+ * Function         wiced_bt_mesh_restore_nvram_end
+ *
+ *                  wait for the command status of every chunk pushed since
+ *                  wiced_bt_mesh_restore_nvram_begin and end the restore
+ *
+ * @param[in] controller            : Bluetooth Controller to use
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS when every chunk was accepted, CY_RESULT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_bt_mesh_restore_nvram_end(wiced_hci_controller_t controller);
 
 
 #ifdef __cplusplus
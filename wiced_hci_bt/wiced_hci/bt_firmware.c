@@ -103,7 +103,7 @@ do \
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
-cy_rslt_t bt_issue_reset ( void );
+cy_rslt_t bt_issue_reset ( wiced_hci_controller_t controller );
 
 /******************************************************
  *               Variable Definitions
@@ -112,7 +112,7 @@ cy_rslt_t bt_issue_reset ( void );
 /******************************************************
  *               Function Definitions
  ******************************************************/
-cy_rslt_t bt_issue_reset ( void )
+cy_rslt_t bt_issue_reset ( wiced_hci_controller_t controller )
 {
     uint32_t length = 4;
     uint8_t hci_data[ 8 ] = { 0x00 };
@@ -120,17 +120,17 @@ cy_rslt_t bt_issue_reset ( void )
     uint8_t hardware_error[ 4 ] = { 0x04, 0x10, 0x01, 0x00 };
     uint8_t hci_reset_expected_event[] = {0x04, 0x0E, 0x04, 0x01, 0x03, 0x0C, 0x00};
 
-    cy_hci_uart_write(hci_reset_cmd, length);
+    cy_hci_uart_write(controller, hci_reset_cmd, length);
 
     length = 7; /* length of expected response */
     /* if any hardware parsing error event just ignore it and read next bytes */
-    cy_hci_uart_read(hci_data, &length, 110);
+    cy_hci_uart_read(controller, hci_data, &length, 110);
 
     if ( !memcmp( hardware_error, hci_data, 4 ) )
     {
         printf(( "hardware parsing error received \n" ));
         length = sizeof(hardware_error);
-        VERIFY_RETVAL( cy_hci_uart_read(hci_data, &length,100) );
+        VERIFY_RETVAL( cy_hci_uart_read(controller, hci_data, &length,100) );
     }
 
     if ( memcmp( hci_data, hci_reset_expected_event, 7 )!=0 )
@@ -142,21 +142,21 @@ cy_rslt_t bt_issue_reset ( void )
 }
 
 
-cy_rslt_t bt_firmware_download( const uint8_t* firmware_image, uint32_t size, const char* version )
+cy_rslt_t bt_firmware_download( wiced_hci_controller_t controller, const uint8_t* firmware_image, uint32_t size, const char* version )
 {
     uint8_t* data = (uint8_t*) firmware_image;
     uint32_t remaining_length = size;
     uint8_t hci_event[100];
 
-    if(bt_issue_reset()!= CY_RSLT_SUCCESS)
+    if(bt_issue_reset(controller)!= CY_RSLT_SUCCESS)
         return CY_RSLT_MW_ERROR;
 
     /* Send hci_download_minidriver command */
     uint8_t minidrv[] = {0x1, 0x2e, 0xfc, 00};
     uint8_t hci_data[100];
     uint32_t length = 7;
-    cy_hci_uart_write(minidrv, 4);
-    cy_hci_uart_read(hci_data, &length,100);
+    cy_hci_uart_write(controller, minidrv, 4);
+    cy_hci_uart_read(controller, hci_data, &length,100);
     /* The firmware image (.hcd format) contains a collection of hci_write_ram command + a block of the image,
      * followed by a hci_write_ram image at the end. Parse and send each individual command and wait for the response.
      * This is to ensure the integrity of the firmware image sent to the bluetooth chip.
@@ -176,9 +176,9 @@ cy_rslt_t bt_firmware_download( const uint8_t* firmware_image, uint32_t size, co
        // printf ("remaiing length = %d \n", remaining_length);
 
         /* Send hci_write_ram command. The length of the data immediately follows the command opcode */
-        cy_hci_uart_write(temp_data, data_length+1);
+        cy_hci_uart_write(controller, temp_data, data_length+1);
         bytes_read = 7;
-        cy_hci_uart_read(hci_event, &bytes_read,220);
+        cy_hci_uart_read(controller, hci_event, &bytes_read,220);
 
         switch ( command_opcode )
         {
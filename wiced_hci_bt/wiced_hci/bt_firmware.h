@@ -34,6 +34,7 @@
 
 
 #include "cy_result.h"
+#include "wiced_bt_hci.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -67,7 +68,7 @@ extern "C" {
  *               Function Declarations
  ******************************************************/
 
-cy_rslt_t bt_firmware_download( const uint8_t* firmware_image, uint32_t size, const char* version );
+cy_rslt_t bt_firmware_download( wiced_hci_controller_t controller, const uint8_t* firmware_image, uint32_t size, const char* version );
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -43,7 +43,9 @@
 #include <stdio.h>
 #include "bt_firmware.h"
 #include "wiced_hci.h"
+#include "wiced_hci_events.h"
 #include "wiced_uart.h"
+#include "wiced_hci_capture.h"
 #include "cy_result_mw.h"
 #include "cyabs_rtos.h"
 
@@ -54,7 +56,6 @@
 #define WICED_HCI_QUEUE_MAX_ENTRIES                20
 #define WICED_HCI_CMD_THREAD_STACK_SIZE            (4096)
 #define WICED_HCI_NUM_UART_THREADS                 3
-#define WICED_HCI_HEADER_LENGTH                    5
 
 #define WICED_NO_WAIT       0
 #define WICED_WAIT_FOREVER  ((uint32_t) 0xFFFFFFFF)
@@ -63,6 +64,18 @@
 #define HCI_CMD_THREAD_STACK_SIZE                  (4*1024)
 #define HCI_READ_THREAD_STACK_SIZE                 (4*1024)
 
+/* length and opcode precede the payload of a queued event */
+#define WICED_HCI_EVENT_RECORD_HEADER_LENGTH       4
+#define WICED_HCI_EVENT_RECORD_WRAP                0xFFFF
+
+#if WICED_HCI_MAX_RX_PAYLOAD_LENGTH < WICED_HCI_MAX_PAYLOAD_LENGTH
+#error "WICED_HCI_MAX_RX_PAYLOAD_LENGTH must not be less than WICED_HCI_MAX_PAYLOAD_LENGTH"
+#endif
+
+#if WICED_HCI_EVENT_QUEUE_SIZE < ( WICED_HCI_EVENT_RECORD_HEADER_LENGTH + WICED_HCI_MAX_RX_PAYLOAD_LENGTH )
+#error "WICED_HCI_EVENT_QUEUE_SIZE must hold an event of WICED_HCI_MAX_RX_PAYLOAD_LENGTH"
+#endif
+
 /******************************************************
  *                   Structures
  ******************************************************/
@@ -77,18 +90,78 @@ typedef struct
 } thread_queue_element_t;
 
 /**
- * Context data for the big HCI.
+ * Callback subscribed to a single event.
+ */
+typedef struct
+{
+    wiced_hci_cb                evt_cb;
+    uint16_t                    opcode;
+} wiced_hci_subscriber_t;
+
+/**
+ * Worker thread running the handlers of the events queued to it, in order.
+ * The event being handled stays in the queue until its handler returns.
+ */
+typedef struct
+{
+    cy_thread_t                 thread;
+    wiced_hci_controller_t      controller;             /* controller whose events are queued */
+    cy_semaphore_t              pending;                /* one count per queued event */
+    cy_mutex_t                  lock;                   /* protects the queue indexes and counters */
+    uint16_t                    head;
+    uint16_t                    tail;
+    uint16_t                    events;
+    uint32_t                    queued;
+    uint32_t                    dropped;
+    uint32_t                    max_level;
+    uint8_t                     queue[WICED_HCI_EVENT_QUEUE_SIZE];
+} wiced_hci_worker_t;
+
+/**
+ * Event workers of a controller, kept across wiced_hci_down(), set by wiced_hci_set_event_workers()
+ */
+typedef struct
+{
+    uint8_t                     count;
+    wiced_hci_event_order_t     order;
+} wiced_hci_worker_config_t;
+
+/**
+ * Locks of a controller, created by its first wiced_hci_up() and kept across wiced_hci_down()
+ */
+typedef struct
+{
+    cy_mutex_t                  write_lock;             /* held for each frame written to the UART, recursive */
+    cy_mutex_t                  subscribe_lock;         /* held while the subscribers are changed */
+    uint8_t                     initialized;
+} wiced_hci_locks_t;
+
+/**
+ * Context data for the big HCI, one per controller.
  *
  */
 typedef struct
 {
-    wiced_hci_cb                evt_cb[MAX_CONTROL_GROUP];
+    wiced_hci_cb                evt_cb[WICED_HCI_GROUP_SLOTS];
+    wiced_hci_subscriber_t      subscribers[WICED_HCI_MAX_EVENT_SUBSCRIBERS];
+    uint32_t                    subscribed[WICED_HCI_EVENT_SLOTS / 32];     /* one bit per dispatch table entry */
+
+    cy_thread_t                 read_thread;
+    uint8_t                     workers_running;
+    wiced_hci_event_order_t     worker_order;
+    wiced_hci_worker_t          workers[WICED_HCI_MAX_EVENT_WORKERS];
+
+    /* moving this to global, as the Free RTOS stack size is only 4096 bytes
+     * the wiced_hci_read_thread()  thread is declaring a stack buffer of 2048
+     * and in turn calls parse_wiced_pkt() which is also declaring local variable of
+     * buffer size 2048 bytes on stack causing stack overflow in FreeRTOS-LwIP
+     */
+    uint8_t                     data_parsepkt[WICED_HCI_MAX_RX_PAYLOAD_LENGTH];
+    uint8_t                     data_hciread[WICED_HCI_HEADER_LENGTH];
 } wiced_hci_context_t;
 
-static cy_thread_t hci_read_thread;
-
 //MBED_ALIGN(8) uint8_t hci_cmd_thread_cb[HCI_CMD_THREAD_STACK_SIZE] = {0};
-__attribute__((aligned(8))) uint8_t hci_read_thread_stack [HCI_READ_THREAD_STACK_SIZE] =  { 0 };
+__attribute__((aligned(8))) uint8_t hci_read_thread_stack [WICED_HCI_MAX_CONTROLLERS][HCI_READ_THREAD_STACK_SIZE] =  { { 0 } };
 __attribute__((aligned(8))) uint8_t hci_cmd_thread_stack  [HCI_CMD_THREAD_STACK_SIZE]  = { 0 };
 
 /******************************************************
@@ -96,15 +169,8 @@ __attribute__((aligned(8))) uint8_t hci_cmd_thread_stack  [HCI_CMD_THREAD_STACK_
  ******************************************************/
 
 static void wiced_hci_read_thread(uint32_t args);
-static void wiced_hci_write_command(uint16_t command, uint8_t* payload, uint16_t length);
-
-/* moving this to global, as the Free RTOS stack size is only 4096 bytes
- * the wiced_hci_read_thread()  thread is declaring a stack buffer of 2048
- * and in turn calls parse_wiced_pkt() which is also declaring local variable of
- * buffer size 2048 bytes on stack causing stack overflow in FreeRTOS-LwIP
- */
-static uint8_t data_parsepkt[2048];
-static uint8_t data_hciread[2048];
+static void wiced_hci_worker_thread(cy_thread_arg_t args);
+static void wiced_hci_write_command(wiced_hci_controller_t controller, uint16_t command, const uint8_t* prefix, uint16_t prefix_length, const uint8_t* payload, uint16_t length);
 
 /******************************************************
  *               External Function Declarations
@@ -116,7 +182,34 @@ extern const int cy_patch_ram_length;
 /******************************************************
  *               Variable Definitions
  ******************************************************/
-wiced_hci_context_t   wiced_hci_context;
+static wiced_hci_context_t     wiced_hci_context[WICED_HCI_MAX_CONTROLLERS];
+static wiced_hci_locks_t       wiced_hci_locks[WICED_HCI_MAX_CONTROLLERS];
+
+/* One event worker per controller by default */
+static wiced_hci_worker_config_t wiced_hci_worker_config[WICED_HCI_MAX_CONTROLLERS] =
+{
+    [0 ... WICED_HCI_MAX_CONTROLLERS - 1] = { 1, WICED_HCI_ORDER_GROUP }
+};
+
+__attribute__((aligned(8))) static uint8_t wiced_hci_worker_stacks[WICED_HCI_MAX_CONTROLLERS][WICED_HCI_MAX_EVENT_WORKERS][WICED_HCI_EVENT_WORKER_STACK_SIZE];
+
+/* Dispatch table row + 1 of each control group, 0 for the groups without events */
+static const uint8_t wiced_hci_group_slot[256] =
+{
+    [HCI_CONTROL_GROUP_DEVICE] = WICED_HCI_GROUP_SLOT( HCI_CONTROL_GROUP_DEVICE ) + 1,
+    [HCI_CONTROL_GROUP_LE]     = WICED_HCI_GROUP_SLOT( HCI_CONTROL_GROUP_LE ) + 1,
+    [HCI_CONTROL_GROUP_GATT]   = WICED_HCI_GROUP_SLOT( HCI_CONTROL_GROUP_GATT ) + 1,
+    [HCI_CONTROL_GROUP_MESH]   = WICED_HCI_GROUP_SLOT( HCI_CONTROL_GROUP_MESH ) + 1,
+};
+
+/* Handler of each event, generated from the event registry. An event of a group
+ * without events does not compile: its entry would be out of the table. */
+#define WICED_HCI_EVENT_TABLE_ENTRY( opcode, handler )  [ WICED_HCI_EVENT_SLOT( opcode ) ] = handler,
+static const wiced_hci_cb wiced_hci_event_table[WICED_HCI_EVENT_SLOTS] =
+{
+    WICED_HCI_EVENT_REGISTRY( WICED_HCI_EVENT_TABLE_ENTRY )
+};
+#undef WICED_HCI_EVENT_TABLE_ENTRY
 /******************************************************
  *               Function Definitions
  ******************************************************/
@@ -138,15 +231,213 @@ uint8_t *copyStreamToBda(uint8_t *pBDA, uint8_t *pStream)
     return (pStream);
 }
 
-static void parse_wiced_pkt(void)
+/* Never called: an event listed twice in the registry is rejected as a duplicate case value */
+#define WICED_HCI_EVENT_CASE( opcode, handler )  case opcode:
+static inline void wiced_hci_event_registry_check(uint16_t opcode)
 {
+    switch ( opcode )
+    {
+        WICED_HCI_EVENT_REGISTRY( WICED_HCI_EVENT_CASE )
+        default:
+            break;
+    }
+}
+#undef WICED_HCI_EVENT_CASE
+
+void wiced_hci_process_event(wiced_hci_controller_t controller, uint16_t control_cmd, uint8_t* payload, uint32_t length)
+{
+    wiced_hci_context_t* context = NULL;
+    uint8_t      group_slot = wiced_hci_group_slot[HCI_CONTROL_GROUP(control_cmd)];
+    uint16_t     slot = 0;
+    wiced_hci_cb handler = NULL;
+    int          i = 0;
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        return;
+    }
+    context = &wiced_hci_context[controller];
+
+    if ( group_slot == 0 )
+    {
+        WICED_INFO(("[%s %d]COMMAND NOT SUPPORTED\n",__func__,__LINE__));
+        return;
+    }
+    group_slot--;
+    slot = ( group_slot << 8 ) | ( control_cmd & 0xff );
+
+    handler = wiced_hci_event_table[slot];
+    if ( handler )
+    {
+        handler( controller, control_cmd, payload, length );
+    }
+    else
+    {
+        WICED_DEBUG(("[%s] event %04x not handled\n", __func__, control_cmd));
+    }
+
+    if ( context->subscribed[slot / 32] & ( 1UL << ( slot % 32 ) ) )
+    {
+        for ( i = 0; i < WICED_HCI_MAX_EVENT_SUBSCRIBERS; i++ )
+        {
+            wiced_hci_cb evt_cb = context->subscribers[i].evt_cb;
+
+            if ( evt_cb && context->subscribers[i].opcode == control_cmd )
+            {
+                evt_cb( controller, control_cmd, payload, length );
+            }
+        }
+    }
+
+    if ( context->evt_cb[group_slot] )
+    {
+        context->evt_cb[group_slot]( controller, control_cmd, payload, length );
+    }
+}
+
+/* The worker keeping the event in order with the others of its group or connection. The events of a
+ * connection start with its id, but for the connection event which has it after the peer address.
+ * The GATT server requests stay on the worker of the GATT group: read responses are built in one
+ * buffer per controller and the server's value store is not shared between workers. */
+static wiced_hci_worker_t* wiced_hci_event_worker(wiced_hci_context_t* context, uint16_t opcode, const uint8_t* payload, uint32_t length)
+{
+    uint32_t key = HCI_CONTROL_GROUP(opcode);
+
+    if ( context->worker_order == WICED_HCI_ORDER_CONNECTION )
+    {
+        if ( opcode == HCI_CONTROL_LE_EVENT_CONNECTED && length >= 9 )
+        {
+            key = payload[7] | ( payload[8] << 8 );
+        }
+        else if ( ( ( HCI_CONTROL_GROUP(opcode) == HCI_CONTROL_GROUP_GATT && opcode != HCI_CONTROL_GATT_EVENT_COMMAND_STATUS &&
+                      opcode != HCI_CONTROL_GATT_EVENT_READ_REQUEST && opcode != HCI_CONTROL_GATT_EVENT_WRITE_REQUEST ) ||
+                    opcode == HCI_CONTROL_LE_EVENT_DISCONNECTED || opcode == HCI_CONTROL_LE_EVENT_PEER_MTU ) && length >= 2 )
+        {
+            key = payload[0] | ( payload[1] << 8 );
+        }
+    }
+
+    return &context->workers[key % context->workers_running];
+}
+
+/* Called by the read thread: copies the event to the queue of its worker, or drops it if it does not fit */
+static void wiced_hci_queue_event(wiced_hci_context_t* context, uint16_t opcode, const uint8_t* payload, uint32_t length)
+{
+    wiced_hci_worker_t* worker = wiced_hci_event_worker( context, opcode, payload, length );
+    uint32_t            needed = WICED_HCI_EVENT_RECORD_HEADER_LENGTH + length;
+    uint32_t            offset = 0;
+    uint32_t            level = 0;
+
+    cy_rtos_get_mutex( &worker->lock, CY_RTOS_NEVER_TIMEOUT );
+    if ( worker->events == 0 )
+    {
+        worker->head = 0;
+        worker->tail = 0;
+    }
+
+    offset = worker->tail;
+    if ( worker->events && worker->tail <= worker->head )
+    {
+        /* the free space is between tail and head */
+        if ( worker->head - worker->tail < needed )
+        {
+            offset = WICED_HCI_EVENT_QUEUE_SIZE;
+        }
+    }
+    else if ( WICED_HCI_EVENT_QUEUE_SIZE - worker->tail < needed )
+    {
+        /* no room up to the end: wrap to the start, in front of head */
+        if ( worker->events && worker->head < needed )
+        {
+            offset = WICED_HCI_EVENT_QUEUE_SIZE;
+        }
+        else
+        {
+            if ( WICED_HCI_EVENT_QUEUE_SIZE - worker->tail >= 2 )
+            {
+                worker->queue[worker->tail]     = WICED_HCI_EVENT_RECORD_WRAP & 0xff;
+                worker->queue[worker->tail + 1] = ( WICED_HCI_EVENT_RECORD_WRAP >> 8 ) & 0xff;
+            }
+            offset = 0;
+        }
+    }
+
+    if ( offset == WICED_HCI_EVENT_QUEUE_SIZE )
+    {
+        worker->dropped++;
+        cy_rtos_set_mutex( &worker->lock );
+        WICED_ERROR(("[%s] event %04x dropped, worker queue full\n", __func__, opcode));
+        return;
+    }
+
+    worker->queue[offset]     = length & 0xff;
+    worker->queue[offset + 1] = ( length >> 8 ) & 0xff;
+    worker->queue[offset + 2] = opcode & 0xff;
+    worker->queue[offset + 3] = ( opcode >> 8 ) & 0xff;
+    memcpy( &worker->queue[offset + WICED_HCI_EVENT_RECORD_HEADER_LENGTH], payload, length );
+    worker->tail = offset + needed;
+    worker->events++;
+    worker->queued++;
+
+    level = ( worker->tail > worker->head ) ? worker->tail - worker->head : WICED_HCI_EVENT_QUEUE_SIZE - worker->head + worker->tail;
+    if ( level > worker->max_level )
+    {
+        worker->max_level = level;
+    }
+    cy_rtos_set_mutex( &worker->lock );
+
+    cy_rtos_set_semaphore( &worker->pending, false );
+}
+
+static void wiced_hci_worker_thread(cy_thread_arg_t args)
+{
+    wiced_hci_worker_t* worker = (wiced_hci_worker_t*)args;
+    uint16_t            length = 0;
+    uint16_t            opcode = 0;
+    uint16_t            offset = 0;
+
+    while ( CY_TRUE )
+    {
+        cy_rtos_get_semaphore( &worker->pending, CY_RTOS_NEVER_TIMEOUT, false );
+
+        cy_rtos_get_mutex( &worker->lock, CY_RTOS_NEVER_TIMEOUT );
+        offset = worker->head;
+        if ( WICED_HCI_EVENT_QUEUE_SIZE - offset < 2 )
+        {
+            offset = 0;
+        }
+        length = worker->queue[offset] | ( worker->queue[offset + 1] << 8 );
+        if ( length == WICED_HCI_EVENT_RECORD_WRAP )
+        {
+            offset = 0;
+            length = worker->queue[0] | ( worker->queue[1] << 8 );
+        }
+        opcode = worker->queue[offset + 2] | ( worker->queue[offset + 3] << 8 );
+        cy_rtos_set_mutex( &worker->lock );
+
+        /* the read thread does not write over an event until it is released below */
+        wiced_hci_process_event( worker->controller, opcode, &worker->queue[offset + WICED_HCI_EVENT_RECORD_HEADER_LENGTH], length );
+
+        cy_rtos_get_mutex( &worker->lock, CY_RTOS_NEVER_TIMEOUT );
+        worker->head = offset + WICED_HCI_EVENT_RECORD_HEADER_LENGTH + length;
+        worker->events--;
+        cy_rtos_set_mutex( &worker->lock );
+    }
+}
+
+static void parse_wiced_pkt(wiced_hci_controller_t controller)
+{
+    wiced_hci_context_t* context = &wiced_hci_context[controller];
+    uint8_t* data_parsepkt = context->data_parsepkt;
     uint32_t length = 2;
-    uint8_t control_gp = 0;
     uint16_t control_cmd = 0;
+#ifdef ENABLE_WICED_HCI_CAPTURE
+    uint8_t  header[WICED_HCI_HEADER_LENGTH];
+#endif
 
-    memset(data_parsepkt, 0, sizeof(data_parsepkt));
+    memset(data_parsepkt, 0, sizeof(context->data_parsepkt));
 
-    if( (cy_hci_uart_read(data_parsepkt, &length, WICED_NEVER_TIMEOUT)) != CY_RSLT_SUCCESS)
+    if( (cy_hci_uart_read(controller, data_parsepkt, &length, WICED_NEVER_TIMEOUT)) != CY_RSLT_SUCCESS)
     {
         WICED_ERROR(("[%s]\n",__func__));
         return;
@@ -156,10 +447,9 @@ static void parse_wiced_pkt(void)
         return;
 
     control_cmd = data_parsepkt[0] + (data_parsepkt[1] << 8);
-    control_gp = HCI_CONTROL_GROUP(data_parsepkt[0] + (data_parsepkt[1] << 8) );
 
     length= 2;
-    if( (cy_hci_uart_read(data_parsepkt, &length,WICED_NEVER_TIMEOUT)) != CY_RSLT_SUCCESS)
+    if( (cy_hci_uart_read(controller, data_parsepkt, &length,WICED_NEVER_TIMEOUT)) != CY_RSLT_SUCCESS)
     {
         WICED_ERROR(("[%s]\n",__func__));
         return;
@@ -170,9 +460,35 @@ static void parse_wiced_pkt(void)
 
     length = data_parsepkt[0] + (data_parsepkt[1] << 8);
 
+#ifdef ENABLE_WICED_HCI_CAPTURE
+    header[0] = HCI_WICED_PKT;
+    header[1] = control_cmd & 0xff;
+    header[2] = (control_cmd >> 8) & 0xff;
+    header[3] = length & 0xff;
+    header[4] = (length >> 8) & 0xff;
+#endif
+
+    /* Drain a packet larger than the receive buffer to stay in sync with the stream */
+    if ( length > sizeof(context->data_parsepkt) )
+    {
+        uint32_t remaining = length;
+
+        WICED_ERROR(("[%s] event %04x length %lu too long, dropped\n", __func__, control_cmd, (unsigned long)length));
+        while ( remaining > 0 )
+        {
+            length = (remaining > sizeof(context->data_parsepkt)) ? sizeof(context->data_parsepkt) : remaining;
+            if( (cy_hci_uart_read(controller, data_parsepkt, &length, WICED_NEVER_TIMEOUT)) != CY_RSLT_SUCCESS || length == 0)
+            {
+                return;
+            }
+            remaining -= length;
+        }
+        return;
+    }
+
     if ( length > 0 )
     {
-        if( (cy_hci_uart_read(data_parsepkt, &length, WICED_NEVER_TIMEOUT)) != CY_RSLT_SUCCESS)
+        if( (cy_hci_uart_read(controller, data_parsepkt, &length, WICED_NEVER_TIMEOUT)) != CY_RSLT_SUCCESS)
         {
             WICED_ERROR(("[%s]\n",__func__));
             return;
@@ -180,32 +496,28 @@ static void parse_wiced_pkt(void)
         if (length == 0)
             return;
     }
-    switch(control_gp)
-    {
-        case HCI_CONTROL_GROUP_DEVICE:
-        case HCI_CONTROL_GROUP_LE:
-        case HCI_CONTROL_GROUP_GATT:
-        case HCI_CONTROL_GROUP_MESH:
-            if(wiced_hci_context.evt_cb[control_gp])
-            {
-                wiced_hci_context.evt_cb[control_gp]( control_cmd, data_parsepkt, length );
-            }
-            break;
-        case HCI_CONTROL_GROUP_MISC:
-        default:
-            WICED_INFO(("[%s %d]COMMAND NOT SUPPORTED\n",__func__,__LINE__));
-            break;
 
+    WICED_HCI_CAPTURE(( controller, WICED_HCI_CAPTURE_RX, header, sizeof(header), data_parsepkt, length ));
+
+    if ( context->workers_running && wiced_hci_group_slot[HCI_CONTROL_GROUP(control_cmd)] )
+    {
+        wiced_hci_queue_event(context, control_cmd, data_parsepkt, length);
+    }
+    else
+    {
+        wiced_hci_process_event(controller, control_cmd, data_parsepkt, length);
     }
 }
 
 static void wiced_hci_read_thread(uint32_t args)
 {
+    wiced_hci_controller_t controller = (wiced_hci_controller_t)args;
+    uint8_t*  data_hciread = wiced_hci_context[controller].data_hciread;
     uint32_t  length = 1;
     cy_rslt_t result = CY_RSLT_SUCCESS;
 #if !defined(WICED_HCI_FW_DOWNLOAD_BYPASS)
     WICED_INFO(("[HCI] Downloading Firmware...\n"));
-    result = bt_firmware_download( cy_patchram_buf, cy_patch_ram_length, cy_patch_version );
+    result = bt_firmware_download( controller, cy_patchram_buf, cy_patch_ram_length, cy_patch_version );
     if ( result != CY_RSLT_SUCCESS )
     {
         WICED_ERROR(("[HCI] Error downloading HCI firmware\n"));
@@ -216,14 +528,15 @@ static void wiced_hci_read_thread(uint32_t args)
     UNUSED_VARIABLE( result );
     UNUSED_VARIABLE( bt_uart_config );
 #endif
-    cy_rtos_delay_milliseconds(1000);
+    /* No settling delay: the read blocks until the controller has booted and
+     * reports HCI_CONTROL_EVENT_DEVICE_STARTED, which marks the stack up */
     while( CY_TRUE )
     {
-        cy_hci_uart_read(data_hciread, &length, WICED_NEVER_TIMEOUT);
+        cy_hci_uart_read(controller, data_hciread, &length, WICED_NEVER_TIMEOUT);
         switch(data_hciread[0])
         {
             case HCI_WICED_PKT:
-                parse_wiced_pkt();
+                parse_wiced_pkt(controller);
                 /*
                  * call the appropriate evt_cb in the wiced_hci_context
                  */
@@ -235,45 +548,209 @@ static void wiced_hci_read_thread(uint32_t args)
     }
 }
 
-static void wiced_hci_write_command(uint16_t command, uint8_t* payload, uint16_t length)
+/* The UART is written a byte at a time by the application threads, the event workers and the
+ * threads of the embedded_ble managers: a frame is written whole, under the write lock */
+static void wiced_hci_write_frame(wiced_hci_controller_t controller, uint16_t command, uint8_t* frame, uint16_t length)
 {
-    uint8_t    data[1040]; // TODO: make this dynamic
+    wiced_hci_lock_writes(controller);
+    if (HCI_CONTROL_GROUP(command) == HCI_CONTROL_GROUP_DEVICE)
+        wiced_hci_mesh_write_device_command(controller, command, frame, length);
+    else
+        cy_hci_uart_write(controller, frame, length);
+    wiced_hci_unlock_writes(controller);
+}
+
+static void wiced_hci_write_command(wiced_hci_controller_t controller, uint16_t command, const uint8_t* prefix, uint16_t prefix_length, const uint8_t* payload, uint16_t length)
+{
+    uint8_t    data[WICED_HCI_HEADER_LENGTH + WICED_HCI_MAX_PAYLOAD_LENGTH];
     uint32_t   header = 0;
+    uint32_t   total  = (uint32_t)prefix_length + length;
+
+    if (controller >= WICED_HCI_MAX_CONTROLLERS)
+    {
+        WICED_ERROR(("[%s] no controller %d\n", __func__, controller));
+        return;
+    }
+
+    if (total > WICED_HCI_MAX_PAYLOAD_LENGTH)
+    {
+        WICED_ERROR(("[%s] command %04x length %lu too long\n", __func__, command, (unsigned long)total));
+        return;
+    }
 
     data[header++] = HCI_WICED_PKT;
     data[header++] = command & 0xff;
     data[header++] = (command >> 8) & 0xff;
-    data[header++] = length & 0xff;
-    data[header++] = (length >> 8) & 0xff;
+    data[header++] = total & 0xff;
+    data[header++] = (total >> 8) & 0xff;
 
+    if(prefix_length != 0)
+        memcpy(&data[header], prefix, prefix_length);
     if(length != 0)
-        memcpy(&data[header], payload, length);
-    cy_hci_uart_write(data,length+WICED_HCI_HEADER_LENGTH);
+        memcpy(&data[header + prefix_length], payload, length);
+
+    wiced_hci_write_frame(controller, command, data, total+WICED_HCI_HEADER_LENGTH);
+}
+
+void wiced_hci_send(wiced_hci_controller_t controller, uint32_t opcode, uint8_t* data, uint16_t length)
+{
+    wiced_hci_write_command(controller, opcode, NULL, 0, data, length);
+}
+
+void wiced_hci_send_gather(wiced_hci_controller_t controller, uint32_t opcode, const uint8_t* header, uint16_t header_length, const uint8_t* data, uint16_t length)
+{
+    wiced_hci_write_command(controller, opcode, header, header_length, data, length);
 }
 
-void wiced_hci_send(uint32_t opcode, uint8_t* data, uint16_t length)
+void wiced_hci_send_frame(wiced_hci_controller_t controller, const uint8_t* frame, uint16_t length)
 {
-    wiced_hci_write_command(opcode, data, length);
+    if (controller >= WICED_HCI_MAX_CONTROLLERS)
+    {
+        WICED_ERROR(("[%s] no controller %d\n", __func__, controller));
+        return;
+    }
+
+    if (length < WICED_HCI_HEADER_LENGTH || frame[0] != HCI_WICED_PKT ||
+        (uint16_t)(frame[3] | (frame[4] << 8)) != length - WICED_HCI_HEADER_LENGTH)
+    {
+        WICED_ERROR(("[%s] malformed packet, length %d\n", __func__, length));
+        return;
+    }
+
+    wiced_hci_write_frame(controller, frame[1] | (frame[2] << 8), (uint8_t*)frame, length);
+}
+
+void wiced_hci_lock_writes(wiced_hci_controller_t controller)
+{
+    if ( controller < WICED_HCI_MAX_CONTROLLERS && wiced_hci_locks[controller].initialized )
+    {
+        cy_rtos_get_mutex( &wiced_hci_locks[controller].write_lock, CY_RTOS_NEVER_TIMEOUT );
+    }
+}
+
+void wiced_hci_unlock_writes(wiced_hci_controller_t controller)
+{
+    if ( controller < WICED_HCI_MAX_CONTROLLERS && wiced_hci_locks[controller].initialized )
+    {
+        cy_rtos_set_mutex( &wiced_hci_locks[controller].write_lock );
+    }
 }
 
-cy_rslt_t wiced_hci_up()
+/* Subscriptions made before the first wiced_hci_up() come from the only thread using the controller */
+static void wiced_hci_lock_subscribers(wiced_hci_controller_t controller)
 {
+    if ( wiced_hci_locks[controller].initialized )
+    {
+        cy_rtos_get_mutex( &wiced_hci_locks[controller].subscribe_lock, CY_RTOS_NEVER_TIMEOUT );
+    }
+}
+
+static void wiced_hci_unlock_subscribers(wiced_hci_controller_t controller)
+{
+    if ( wiced_hci_locks[controller].initialized )
+    {
+        cy_rtos_set_mutex( &wiced_hci_locks[controller].subscribe_lock );
+    }
+}
+
+/* Workers have the priority of the read thread, which busy-waits for UART data */
+static cy_rslt_t wiced_hci_start_workers(wiced_hci_controller_t controller)
+{
+    wiced_hci_context_t* context = &wiced_hci_context[controller];
     cy_rslt_t result = CY_RSLT_SUCCESS;
+    uint8_t   i = 0;
+
+    context->worker_order = wiced_hci_worker_config[controller].order;
+    for ( i = 0; i < wiced_hci_worker_config[controller].count; i++ )
+    {
+        wiced_hci_worker_t* worker = &context->workers[i];
+
+        memset( worker, 0, sizeof( *worker ) );
+        worker->controller = controller;
+        cy_rtos_init_mutex( &worker->lock );
+        cy_rtos_init_semaphore( &worker->pending, 0xFFFF, 0 );
+        result = cy_rtos_create_thread( &worker->thread, wiced_hci_worker_thread, "hci_event_worker",
+                                        wiced_hci_worker_stacks[controller][i], WICED_HCI_EVENT_WORKER_STACK_SIZE,
+                                        CY_RTOS_PRIORITY_NORMAL, (cy_thread_arg_t)worker );
+        if ( result != CY_RSLT_SUCCESS )
+        {
+            WICED_ERROR(("[HCI] Could not create event worker %d of controller %d\n", i, controller));
+            cy_rtos_deinit_semaphore( &worker->pending );
+            cy_rtos_deinit_mutex( &worker->lock );
+            return result;
+        }
+        context->workers_running++;
+    }
+
+    return result;
+}
+
+static void wiced_hci_stop_workers(wiced_hci_controller_t controller)
+{
+    wiced_hci_context_t* context = &wiced_hci_context[controller];
+
+    while ( context->workers_running )
+    {
+        wiced_hci_worker_t* worker = &context->workers[--context->workers_running];
+
+        cy_rtos_terminate_thread( &worker->thread );
+        cy_rtos_deinit_semaphore( &worker->pending );
+        cy_rtos_deinit_mutex( &worker->lock );
+    }
+}
+
+cy_rslt_t wiced_hci_up(wiced_hci_controller_t controller)
+{
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        WICED_ERROR(("[HCI] No controller %d\n", controller));
+        return CY_RSLT_MW_ERROR;
+    }
+
+    /* the locks are created while the calling thread is the only one using the controller */
+    if ( !wiced_hci_locks[controller].initialized )
+    {
+        result = cy_rtos_init_mutex( &wiced_hci_locks[controller].write_lock );
+        if ( result != CY_RSLT_SUCCESS )
+        {
+            WICED_ERROR(("[HCI] Could not create the write lock of controller %d\n", controller));
+            return result;
+        }
+        result = cy_rtos_init_mutex( &wiced_hci_locks[controller].subscribe_lock );
+        if ( result != CY_RSLT_SUCCESS )
+        {
+            WICED_ERROR(("[HCI] Could not create the subscribe lock of controller %d\n", controller));
+            cy_rtos_deinit_mutex( &wiced_hci_locks[controller].write_lock );
+            return result;
+        }
+        wiced_hci_locks[controller].initialized = 1;
+    }
 
     /* initialize the uart */
-    result = cy_hci_uart_init();
+    result = cy_hci_uart_init(controller);
     if ( result != CY_RSLT_SUCCESS )
     {
         WICED_ERROR(("[HCI] UART initialization failed(result: %lu)\n", result));
         return result;
     }
 
+    /* the workers are ready before the first event is read */
+    result = wiced_hci_start_workers(controller);
+    if ( result != CY_RSLT_SUCCESS )
+    {
+        wiced_hci_stop_workers(controller);
+        return result;
+    }
+
     /* create a read thread for the hci */
-    result = cy_rtos_create_thread(&hci_read_thread, wiced_hci_read_thread, "hci_read_thread",
-                            hci_read_thread_stack, sizeof(hci_read_thread_stack), CY_RTOS_PRIORITY_NORMAL, (cy_thread_arg_t)NULL);
+    result = cy_rtos_create_thread(&wiced_hci_context[controller].read_thread, wiced_hci_read_thread, "hci_read_thread",
+                            hci_read_thread_stack[controller], sizeof(hci_read_thread_stack[controller]), CY_RTOS_PRIORITY_NORMAL, (cy_thread_arg_t)(uintptr_t)controller);
     if (result != CY_RSLT_SUCCESS)
     {
         WICED_ERROR(("[HCI] Fatal Error - Could not create Read Thread\n"));
+        wiced_hci_stop_workers(controller);
         return result;
     }
 
@@ -282,20 +759,29 @@ cy_rslt_t wiced_hci_up()
 
 
 
-cy_rslt_t wiced_hci_down(void)
+cy_rslt_t wiced_hci_down(wiced_hci_controller_t controller)
 {
+    wiced_hci_context_t* context = NULL;
     cy_rslt_t result= CY_RSLT_SUCCESS;
 
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    context = &wiced_hci_context[controller];
+
     /* Kill the thread */
-    result = cy_rtos_terminate_thread(&hci_read_thread);
+    result = cy_rtos_terminate_thread(&context->read_thread);
     if (result != CY_RSLT_SUCCESS)
     {
         WICED_ERROR(("[HCI] Fatal Error - Could not terminate Read Thread\n"));
         return result;
     }
 
+    wiced_hci_stop_workers(controller);
+
     /* de-initialize the UART */
-    result = cy_hci_uart_deinit();
+    result = cy_hci_uart_deinit(controller);
     if ( result != CY_RSLT_SUCCESS )
     {
         WICED_ERROR(("[HCI] UART de-initialization failed (result: %lu)\n",result));
@@ -303,21 +789,139 @@ cy_rslt_t wiced_hci_down(void)
     }
 
     /* set the control block to 0 */
-    memset(data_parsepkt, 0, sizeof(data_parsepkt));
-    memset(data_hciread, 0, sizeof(data_hciread));
-    memset(&wiced_hci_context, 0 ,sizeof(wiced_hci_context));
+    memset(context, 0 ,sizeof(*context));
     return result;
 }
 
-cy_rslt_t wiced_hci_set_event_callback(control_group_t group, wiced_hci_cb evt_cb)
+cy_rslt_t wiced_hci_set_event_callback(wiced_hci_controller_t controller, control_group_t group, wiced_hci_cb evt_cb)
+{
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS || WICED_HCI_GROUP_SLOT( group ) >= WICED_HCI_GROUP_SLOTS )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    wiced_hci_context[controller].evt_cb[WICED_HCI_GROUP_SLOT( group )] = evt_cb;
+
+    return CY_RSLT_SUCCESS;
+}
+
+/* Marks the table entry of an event if any callback is subscribed to it, called with the subscribe lock
+ * held. The entry is written once so event dispatch never sees it cleared for a remaining subscriber. */
+static void wiced_hci_update_subscribed(wiced_hci_context_t* context, uint16_t opcode)
+{
+    uint16_t slot = WICED_HCI_EVENT_SLOT( opcode );
+    uint32_t bit = 1UL << ( slot % 32 );
+    uint32_t subscribed = 0;
+    int      i = 0;
+
+    for ( i = 0; i < WICED_HCI_MAX_EVENT_SUBSCRIBERS && !subscribed; i++ )
+    {
+        if ( context->subscribers[i].evt_cb && context->subscribers[i].opcode == opcode )
+        {
+            subscribed = bit;
+        }
+    }
+    context->subscribed[slot / 32] = ( context->subscribed[slot / 32] & ~bit ) | subscribed;
+}
+
+cy_rslt_t wiced_hci_subscribe_event(wiced_hci_controller_t controller, uint16_t opcode, wiced_hci_cb evt_cb)
+{
+    wiced_hci_context_t* context = NULL;
+    int i = 0;
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS || evt_cb == NULL || WICED_HCI_GROUP_SLOT( HCI_CONTROL_GROUP( opcode ) ) >= WICED_HCI_GROUP_SLOTS )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    context = &wiced_hci_context[controller];
+
+    wiced_hci_lock_subscribers( controller );
+    for ( i = 0; i < WICED_HCI_MAX_EVENT_SUBSCRIBERS; i++ )
+    {
+        if ( context->subscribers[i].evt_cb == NULL )
+        {
+            /* event dispatch (read thread or workers) only looks at the opcode of a subscriber with a callback */
+            context->subscribers[i].opcode = opcode;
+            context->subscribers[i].evt_cb = evt_cb;
+            wiced_hci_update_subscribed( context, opcode );
+            wiced_hci_unlock_subscribers( controller );
+            return CY_RSLT_SUCCESS;
+        }
+    }
+    wiced_hci_unlock_subscribers( controller );
+
+    WICED_ERROR(("[%s] no room for a subscriber to %04x\n", __func__, opcode));
+    return CY_RSLT_MW_ERROR;
+}
+
+cy_rslt_t wiced_hci_unsubscribe_event(wiced_hci_controller_t controller, uint16_t opcode, wiced_hci_cb evt_cb)
 {
-    if ( group >= MAX_CONTROL_GROUP)
+    wiced_hci_context_t* context = NULL;
+    int i = 0;
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
     {
         return CY_RSLT_MW_ERROR;
     }
+    context = &wiced_hci_context[controller];
 
-    wiced_hci_context.evt_cb[group] = evt_cb;
+    wiced_hci_lock_subscribers( controller );
+    for ( i = 0; i < WICED_HCI_MAX_EVENT_SUBSCRIBERS; i++ )
+    {
+        if ( evt_cb && context->subscribers[i].evt_cb == evt_cb && context->subscribers[i].opcode == opcode )
+        {
+            context->subscribers[i].evt_cb = NULL;
+            wiced_hci_update_subscribed( context, opcode );
+            wiced_hci_unlock_subscribers( controller );
+            return CY_RSLT_SUCCESS;
+        }
+    }
+    wiced_hci_unlock_subscribers( controller );
+
+    return CY_RSLT_MW_ERROR;
+}
+
+cy_rslt_t wiced_hci_set_event_workers(wiced_hci_controller_t controller, uint8_t workers, wiced_hci_event_order_t order)
+{
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS || workers > WICED_HCI_MAX_EVENT_WORKERS )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    wiced_hci_worker_config[controller].count = workers;
+    wiced_hci_worker_config[controller].order = order;
 
     return CY_RSLT_SUCCESS;
 }
 
+void wiced_hci_get_event_stats(wiced_hci_controller_t controller, wiced_hci_event_stats_t* stats)
+{
+    wiced_hci_context_t* context = NULL;
+    cy_hci_uart_stats_t uart_stats;
+    uint8_t             i = 0;
+
+    memset( stats, 0, sizeof( *stats ) );
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        return;
+    }
+    context = &wiced_hci_context[controller];
+
+    for ( i = 0; i < context->workers_running; i++ )
+    {
+        wiced_hci_worker_t* worker = &context->workers[i];
+
+        cy_rtos_get_mutex( &worker->lock, CY_RTOS_NEVER_TIMEOUT );
+        stats->events_queued  += worker->queued;
+        stats->events_dropped += worker->dropped;
+        if ( worker->max_level > stats->queue_max_level )
+        {
+            stats->queue_max_level = worker->max_level;
+        }
+        cy_rtos_set_mutex( &worker->lock );
+    }
+
+    cy_hci_uart_get_stats( controller, &uart_stats );
+    stats->uart_overflow_bytes = uart_stats.overflow_bytes;
+    stats->uart_max_level      = uart_stats.max_level;
+}
@@ -33,6 +33,7 @@
 #pragma once
 
 #include "cy_result_mw.h"
+#include "wiced_bt_hci.h"
 /** @file
  *
  * HCI Control Protocol Definitions
@@ -65,6 +66,42 @@ extern "C" {
  * -------------------------------------------------------------------------------------------------------
  */
 
+/* Transport MTU: largest payload of a packet sent to the hci_control application.
+ * Sizes the transmit buffers; larger mesh proxy PDUs are segmented. */
+#ifndef WICED_HCI_MAX_PAYLOAD_LENGTH
+#define WICED_HCI_MAX_PAYLOAD_LENGTH    (1035)
+#endif
+
+/* Largest payload of a packet received from the hci_control application, larger ones are
+ * dropped. Events (e.g. the GATT database dump or NVRAM data) can exceed the transport MTU. */
+#ifndef WICED_HCI_MAX_RX_PAYLOAD_LENGTH
+#define WICED_HCI_MAX_RX_PAYLOAD_LENGTH (2048)
+#endif
+
+/* Callbacks that can be subscribed to individual events at once, see wiced_hci_subscribe_event() */
+#ifndef WICED_HCI_MAX_EVENT_SUBSCRIBERS
+#define WICED_HCI_MAX_EVENT_SUBSCRIBERS (8)
+#endif
+
+/* Worker threads that can run the event handlers, see wiced_hci_set_event_workers().
+ * The stack and the event queue of every worker are reserved statically for each controller,
+ * whatever number of workers is configured: WICED_HCI_MAX_CONTROLLERS * WICED_HCI_MAX_EVENT_WORKERS
+ * * (WICED_HCI_EVENT_WORKER_STACK_SIZE + WICED_HCI_EVENT_QUEUE_SIZE) bytes, 16 KB per controller
+ * with the defaults. Lower it to the number of workers actually used. */
+#ifndef WICED_HCI_MAX_EVENT_WORKERS
+#define WICED_HCI_MAX_EVENT_WORKERS     (2)
+#endif
+
+/* Bytes of events waiting for each worker, 4 bytes of header per event. Events that
+ * do not fit are dropped and counted, the read thread never waits for a worker. */
+#ifndef WICED_HCI_EVENT_QUEUE_SIZE
+#define WICED_HCI_EVENT_QUEUE_SIZE      (4096)
+#endif
+
+#ifndef WICED_HCI_EVENT_WORKER_STACK_SIZE
+#define WICED_HCI_EVENT_WORKER_STACK_SIZE   (4*1024)
+#endif
+
 /******************************************************
  *                   Enumerations
  ******************************************************/
@@ -76,6 +113,13 @@ typedef enum control_group_enum {
     MAX_CONTROL_GROUP
 } control_group_t;
 
+/** Events handled in order by the event workers */
+typedef enum
+{
+    WICED_HCI_ORDER_GROUP,              /**< The events of a control group, by one worker */
+    WICED_HCI_ORDER_CONNECTION,         /**< The events of an LE connection, the others per control group */
+} wiced_hci_event_order_t;
+
 /******************************************************
  *                 Type Definitions
  ******************************************************/
@@ -83,6 +127,9 @@ typedef enum control_group_enum {
 #define HCI_ACL_DATA_PKT                                    2
 #define HCI_WICED_PKT                                       25
 
+/* Bytes of the header preceding the payload of a WICED HCI packet */
+#define WICED_HCI_HEADER_LENGTH                             5
+
 #define CY_TRUE     1
 #define CY_FALSE    0
 #define BD_ADDR_LEN     6
@@ -263,12 +310,22 @@ typedef enum control_group_enum {
 #define HCI_CONTROL_STATUS_CLIENT_NOT_REGISTERED            10
 #define HCI_CONTROL_STATUS_OUT_OF_MEMORY                    11
 
-typedef void (*wiced_hci_cb)(uint16_t command, uint8_t* payload, uint32_t len);
+typedef void (*wiced_hci_cb)(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len);
 
 /******************************************************
  *                    Structures
  ******************************************************/
 
+/** Event reception counters of a controller, since wiced_hci_up() */
+typedef struct
+{
+    uint32_t    events_queued;          /**< Events handed to a worker */
+    uint32_t    events_dropped;         /**< Events lost because the queue of their worker was full */
+    uint32_t    queue_max_level;        /**< Most bytes waiting in the queue of a worker */
+    uint32_t    uart_overflow_bytes;    /**< Bytes lost because the UART receive ring was full */
+    uint32_t    uart_max_level;         /**< Most bytes waiting in the UART receive ring */
+} wiced_hci_event_stats_t;
+
 /******************************************************
  *                 Global Variables
  ******************************************************/
@@ -276,21 +333,140 @@ typedef void (*wiced_hci_cb)(uint16_t command, uint8_t* payload, uint32_t len);
 /******************************************************
  *               Function Declarations
  ******************************************************/
-cy_rslt_t wiced_hci_up();
-cy_rslt_t wiced_hci_down(void);
-cy_rslt_t wiced_hci_set_event_callback(control_group_t group, wiced_hci_cb evt_cb);
+
+/**
+ * Start the UART, the read thread and the event workers of a controller, after
+ * downloading its firmware. Each controller has its own UART, threads and buffers,
+ * the controllers run independently of each other.
+ *
+ * @param controller The controller.
+ * @return CY_RSLT_SUCCESS, or CY_RSLT_MW_ERROR if there is no such controller.
+ */
+cy_rslt_t wiced_hci_up(wiced_hci_controller_t controller);
+cy_rslt_t wiced_hci_down(wiced_hci_controller_t controller);
+
+/**
+ * Register a callback receiving every event of a control group, after the handler of
+ * the event and its subscribers. Replaces the callback registered before for the group.
+ *
+ * @param controller The controller.
+ * @param group  The control group.
+ * @param evt_cb The callback, NULL to remove it.
+ * @return CY_RSLT_SUCCESS, or CY_RSLT_MW_ERROR if the group has no events.
+ */
+cy_rslt_t wiced_hci_set_event_callback(wiced_hci_controller_t controller, control_group_t group, wiced_hci_cb evt_cb);
+
+/**
+ * Subscribe a callback to one event, called after the handler of the event.
+ * An event can have several subscribers, called in no particular order.
+ * Subscriptions from several threads are serialised, but event dispatch (the read thread
+ * or the event workers) does not wait for them: a callback being unsubscribed may still
+ * be running, or be called for an event already dispatched.
+ *
+ * @param controller The controller.
+ * @param opcode The event code, including the group code.
+ * @param evt_cb The callback.
+ * @return CY_RSLT_SUCCESS, or CY_RSLT_MW_ERROR if the group has no events
+ *         or WICED_HCI_MAX_EVENT_SUBSCRIBERS callbacks are subscribed already.
+ */
+cy_rslt_t wiced_hci_subscribe_event(wiced_hci_controller_t controller, uint16_t opcode, wiced_hci_cb evt_cb);
+
+/**
+ * Remove a callback subscribed to an event with wiced_hci_subscribe_event().
+ *
+ * @param controller The controller.
+ * @param opcode The event code, including the group code.
+ * @param evt_cb The callback.
+ * @return CY_RSLT_SUCCESS, or CY_RSLT_MW_ERROR if the callback was not subscribed to the event.
+ */
+cy_rslt_t wiced_hci_unsubscribe_event(wiced_hci_controller_t controller, uint16_t opcode, wiced_hci_cb evt_cb);
+
+/**
+ * Choose the threads running the event handlers and the application callbacks.
+ * The read thread only frames the received packets and queues them to a worker,
+ * so a slow callback does not stop the UART from being drained. The events that
+ * must stay in order go to the same worker. Takes effect at the next wiced_hci_up(),
+ * which is called by wiced_bt_stack_init(). By default one worker handles all events.
+ *
+ * @param controller The controller.
+ * @param workers Number of worker threads, up to WICED_HCI_MAX_EVENT_WORKERS.
+ *                0 runs the handlers on the read thread.
+ * @param order   The events kept in order.
+ * @return CY_RSLT_SUCCESS, or CY_RSLT_MW_ERROR if there are too many workers.
+ */
+cy_rslt_t wiced_hci_set_event_workers(wiced_hci_controller_t controller, uint8_t workers, wiced_hci_event_order_t order);
+
+/**
+ * Read the event reception counters.
+ *
+ * @param controller The controller.
+ * @param stats The counters.
+ */
+void wiced_hci_get_event_stats(wiced_hci_controller_t controller, wiced_hci_event_stats_t* stats);
 
 /**
  * Send data over the wiced_hci interface.
  *
+ * @param controller The controller.
  * @param opcode The operation code as above for commands.
  * @param data   The data to be send as per opcode
  * @param length The length of the data being sent.
  * @return WICED_SUCCESS if the operation succeeded
  *         WICED_ERROR   if the operation failed.
  */
-void wiced_hci_send(uint32_t opcode, uint8_t* data, uint16_t length);
-cy_rslt_t wiced_hci_configure(wiced_hci_cb rx_cb);
+void wiced_hci_send(wiced_hci_controller_t controller, uint32_t opcode, uint8_t* data, uint16_t length);
+
+/**
+ * Send a packet whose payload is a header followed by data, without assembling
+ * the payload in a separate buffer first.
+ *
+ * @param controller    The controller.
+ * @param opcode        The operation code as above for commands.
+ * @param header        The bytes sent first, may be NULL when header_length is 0.
+ * @param header_length The length of the header.
+ * @param data          The bytes sent after the header.
+ * @param length        The length of the data.
+ */
+void wiced_hci_send_gather(wiced_hci_controller_t controller, uint32_t opcode, const uint8_t* header, uint16_t header_length, const uint8_t* data, uint16_t length);
+
+/**
+ * Send a packet built by the caller, header included, as it is.
+ *
+ * @param controller The controller.
+ * @param frame      The packet: HCI_WICED_PKT, opcode, payload length and payload.
+ * @param length     The length of the packet, WICED_HCI_HEADER_LENGTH plus the payload length.
+ */
+void wiced_hci_send_frame(wiced_hci_controller_t controller, const uint8_t* frame, uint16_t length);
+
+/**
+ * Hold the UART of a controller for a sequence of frames that must reach the controller
+ * without the frames of other threads in between, such as the segments of a mesh proxy PDU.
+ * Every frame is written under this lock, which is recursive, so the holder keeps sending
+ * with the functions above. Frames written before the first wiced_hci_up() are not locked.
+ *
+ * @param controller The controller.
+ */
+void wiced_hci_lock_writes(wiced_hci_controller_t controller);
+
+/**
+ * Release the UART held with wiced_hci_lock_writes().
+ *
+ * @param controller The controller.
+ */
+void wiced_hci_unlock_writes(wiced_hci_controller_t controller);
+cy_rslt_t wiced_hci_configure(wiced_hci_controller_t controller, wiced_hci_cb rx_cb);
+
+/**
+ * Hand a received WICED HCI event to its handler in the event registry, then to the callbacks
+ * subscribed to it and to the callback registered for its control group.
+ * Called by the read thread for every frame, and by the replay tool for captured frames.
+ *
+ * @param controller The controller that received the event.
+ * @param opcode  The event code, including the group code.
+ * @param payload The event payload.
+ * @param length  The length of the payload.
+ */
+void wiced_hci_process_event(wiced_hci_controller_t controller, uint16_t opcode, uint8_t* payload, uint32_t length);
 
 
 #ifdef __cplusplus
@@ -42,14 +42,29 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "wiced_hci.h"
+#include "wiced_hci_events.h"
 #include "cy_result_mw.h"
 #include "wiced_defs.h"
 #include "wiced_hci_bt_common_internal.h"
+#include "wiced_hci_bt_ble.h"
 
 /******************************************************
  *                    Constants
  ******************************************************/
 
+/* element count, then type, 16-bit length, data and a null byte per element */
+#define WICED_BT_RAW_ADVERTISEMENT_BUFFER_SIZE  ( 100 )
+
+/* event type, address type, bd address and rssi precede the advertisement data */
+#define ADVERTISEMENT_REPORT_HEADER_LENGTH  ( 2 + BD_ADDR_LEN + 1 )
+
+/* connection parameter limits of the Core specification */
+#define BLE_CONN_INTERVAL_MIN               ( 0x0006 )      /* 7.5 ms */
+#define BLE_CONN_INTERVAL_MAX               ( 0x0C80 )      /* 4 s */
+#define BLE_CONN_LATENCY_MAX                ( 0x01F3 )
+#define BLE_SUPERVISION_TIMEOUT_MIN         ( 0x000A )      /* 100 ms */
+#define BLE_SUPERVISION_TIMEOUT_MAX         ( 0x0C80 )      /* 32 s */
+
 /******************************************************
  *                   Structures
  ******************************************************/
@@ -57,7 +72,8 @@
 
 typedef struct _wiced_hci_bt_ble_context
 {
-        wiced_hci_cb                  ble_context_cb;
+        wiced_hci_cb                        ble_context_cb;
+        wiced_bt_ble_scan_result_cback_t*   scan_result_cb;
 } wiced_hci_bt_ble_context_t;
 /******************************************************
  *               Static Function Declarations
@@ -70,13 +86,13 @@ typedef struct _wiced_hci_bt_ble_context
 /******************************************************
  *               Variable Definitions
  ******************************************************/
-wiced_hci_bt_ble_context_t     wh_bt_ble_context;
+wiced_hci_bt_ble_context_t     wh_bt_ble_context[WICED_HCI_MAX_CONTROLLERS];
 
 /******************************************************
  *               Function Definitions
  ******************************************************/
 
-cy_rslt_t wiced_bt_start_advertisements(wiced_bt_ble_advert_mode_t advert_mode, wiced_bt_ble_address_type_t directed_advertisement_bdaddr_type, wiced_bt_device_address_ptr_t directed_advertisement_bdaddr_ptr)
+cy_rslt_t wiced_bt_start_advertisements(wiced_hci_controller_t controller, wiced_bt_ble_advert_mode_t advert_mode, wiced_bt_ble_address_type_t directed_advertisement_bdaddr_type, wiced_bt_device_address_ptr_t directed_advertisement_bdaddr_ptr)
 {
     cy_rslt_t result = CY_RSLT_SUCCESS;
     uint8_t        data[2] ;
@@ -85,7 +101,7 @@ cy_rslt_t wiced_bt_start_advertisements(wiced_bt_ble_advert_mode_t advert_mode,
     switch(advert_mode)
     {
         case BTM_BLE_ADVERT_OFF:
-            data[0] = 1; /* Dont send advertisements */
+            data[0] = 0; /* Dont send advertisements */
             length = 1;
             break;
 
@@ -106,32 +122,39 @@ cy_rslt_t wiced_bt_start_advertisements(wiced_bt_ble_advert_mode_t advert_mode,
             break;
 
         default:
-            break;
+            WICED_ERROR(("[%s] invalid advertisement mode %d\n",__func__,advert_mode));
+            return CY_RSLT_MW_ERROR;
     }
 
-    wiced_hci_send(HCI_CONTROL_LE_COMMAND_ADVERTISE,
+    wiced_hci_send(controller, HCI_CONTROL_LE_COMMAND_ADVERTISE,
                    &data[0],
                    length);
 
     return result;
 }
 
-cy_rslt_t wiced_bt_ble_set_raw_advertisement_data(UINT8 num_elem,
+cy_rslt_t wiced_bt_ble_set_raw_advertisement_data(wiced_hci_controller_t controller, UINT8 num_elem,
                                                        wiced_bt_ble_advert_elem_t *p_data)
 {
     cy_rslt_t result = CY_RSLT_SUCCESS;
-    uint8_t data[100] ;
+    uint8_t data[WICED_BT_RAW_ADVERTISEMENT_BUFFER_SIZE] ;
     uint16_t length       = 0;
     uint16_t count        = 0;
     uint16_t point        = 1;
 
     for ( count = 0; count  < num_elem; count++ )
     {
-        length += sizeof(wiced_bt_ble_advert_type_t); /* advert_type */
+        length += sizeof(uint8_t); /* advert_type */
         length += sizeof(uint16_t);/* length field */
         length += p_data[count].len * sizeof(uint8_t) + sizeof(uint8_t); //adding null char byte
     }
 
+    if ( length + 1 > sizeof(data) )
+    {
+        WICED_ERROR(("[%s] advertisement data too long [%d]\n",__func__,length));
+        return CY_RSLT_MW_ERROR;
+    }
+
     data[0] = num_elem;
 
     for ( count = 0; count < num_elem; count++ )
@@ -141,25 +164,166 @@ cy_rslt_t wiced_bt_ble_set_raw_advertisement_data(UINT8 num_elem,
         data[point++] = (uint8_t)((p_data[count].len & 0xff00)>> 8);
         data[point++] = (p_data[count].len & 0x00ff);
 
-        memcpy(&data[point], p_data[count].p_data, (p_data[count].len)*sizeof(uint8_t) + 1 );
-        point += (p_data[count].len)*sizeof(uint8_t) + 1;
+        /* The element is followed by a null byte, it is not part of the caller's data */
+        memcpy(&data[point], p_data[count].p_data, (p_data[count].len)*sizeof(uint8_t));
+        point += (p_data[count].len)*sizeof(uint8_t);
+        data[point++] = 0;
     }
 
-    wiced_hci_send(HCI_CONTROL_LE_COMMAND_SET_RAW_ADVERTISE_DATA,
+    wiced_hci_send(controller, HCI_CONTROL_LE_COMMAND_SET_RAW_ADVERTISE_DATA,
                    data,
-                   length);
+                   point);
 
     WICED_INFO(("[%s %d] done\n",__func__,__LINE__));
     return result;
 }
 
-void wiced_bt_ble_security_grant(wiced_bt_device_address_t bd_addr, uint8_t res)
+void wiced_bt_ble_security_grant(wiced_hci_controller_t controller, wiced_bt_device_address_t bd_addr, uint8_t res)
 {
     uint8_t data[sizeof(wiced_bt_device_address_t) + sizeof(uint8_t)];
     uint16_t length = sizeof(wiced_bt_device_address_t) + sizeof(uint8_t);
 
     memcpy(data, bd_addr, sizeof(wiced_bt_device_address_t));
     memcpy(&data[sizeof(wiced_bt_device_address_t)],&res,sizeof(uint8_t));
-    wiced_hci_send(HCI_CONTROL_LE_COMMAND_SECURITY_GRANT, data, length);
+    wiced_hci_send(controller, HCI_CONTROL_LE_COMMAND_SECURITY_GRANT, data, length);
+
+}
+
+cy_rslt_t wiced_bt_ble_scan(wiced_hci_controller_t controller, wiced_bt_ble_scan_type_t scan_type, BOOLEAN duplicate_filter_enable, wiced_bt_ble_scan_result_cback_t *p_scan_result_cback)
+{
+    uint8_t data[2];
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    if ( ( scan_type != BTM_BLE_SCAN_TYPE_NONE ) && ( p_scan_result_cback == NULL ) )
+    {
+        WICED_ERROR(("[%s] scan result callback is required\n",__func__));
+        return CY_RSLT_MW_ERROR;
+    }
+
+    /* The duty cycle of the scan is selected by the embedded application configuration */
+    data[0] = ( scan_type != BTM_BLE_SCAN_TYPE_NONE ) ? 1 : 0;
+    data[1] = duplicate_filter_enable ? 1 : 0;
+
+    /* Install the callback before enabling the scan so that no report is missed,
+     * reports still in flight after a stop request are dropped */
+    wh_bt_ble_context[controller].scan_result_cb = ( scan_type != BTM_BLE_SCAN_TYPE_NONE ) ? p_scan_result_cback : NULL;
+
+    wiced_hci_send(controller, HCI_CONTROL_LE_COMMAND_SCAN, data, sizeof(data));
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_ble_connect(wiced_hci_controller_t controller, wiced_bt_ble_address_type_t addr_type, const wiced_bt_device_address_t bd_addr)
+{
+    uint8_t  data[1 + BD_ADDR_LEN];
+    uint8_t* p = &data[1];
+
+    if ( bd_addr == NULL )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    data[0] = addr_type;
+    BDADDR_TO_STREAM( p, bd_addr );
+    wiced_hci_send( controller, HCI_CONTROL_LE_COMMAND_CONNECT, data, sizeof( data ) );
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_ble_cancel_connect(wiced_hci_controller_t controller, wiced_bt_ble_address_type_t addr_type, const wiced_bt_device_address_t bd_addr)
+{
+    uint8_t  data[1 + BD_ADDR_LEN];
+    uint8_t* p = &data[1];
+
+    if ( bd_addr == NULL )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    data[0] = addr_type;
+    BDADDR_TO_STREAM( p, bd_addr );
+    wiced_hci_send( controller, HCI_CONTROL_LE_COMMAND_CANCEL_CONNECT, data, sizeof( data ) );
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_ble_disconnect(wiced_hci_controller_t controller, uint16_t conn_id)
+{
+    uint8_t data[2];
+
+    data[0] = conn_id & 0xff;
+    data[1] = (conn_id >> 8) & 0xff;
+    wiced_hci_send( controller, HCI_CONTROL_LE_COMMAND_DISCONNECT, data, sizeof( data ) );
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_ble_set_conn_params(wiced_hci_controller_t controller, const wiced_bt_device_address_t bd_addr, const wiced_bt_ble_conn_params_t *p_params)
+{
+    uint8_t  data[BD_ADDR_LEN + 8];
+    uint8_t* p = data;
+
+    if ( bd_addr == NULL || p_params == NULL ||
+         p_params->interval_min < BLE_CONN_INTERVAL_MIN || p_params->interval_max > BLE_CONN_INTERVAL_MAX ||
+         p_params->interval_min > p_params->interval_max || p_params->latency > BLE_CONN_LATENCY_MAX ||
+         p_params->supervision_timeout < BLE_SUPERVISION_TIMEOUT_MIN || p_params->supervision_timeout > BLE_SUPERVISION_TIMEOUT_MAX )
+    {
+        WICED_ERROR(("[%s] invalid connection parameters\n",__func__));
+        return CY_RSLT_MW_ERROR;
+    }
+
+    /* The supervision timeout (10 ms units) must exceed twice the time the peripheral may stay silent
+     * (1 + latency intervals of 1.25 ms) */
+    if ( (uint32_t)p_params->supervision_timeout * 4 <= ( 1 + (uint32_t)p_params->latency ) * p_params->interval_max )
+    {
+        WICED_ERROR(("[%s] supervision timeout too short for the latency\n",__func__));
+        return CY_RSLT_MW_ERROR;
+    }
+
+    BDADDR_TO_STREAM( p, bd_addr );
+    *p++ = p_params->interval_min & 0xff;
+    *p++ = (p_params->interval_min >> 8) & 0xff;
+    *p++ = p_params->interval_max & 0xff;
+    *p++ = (p_params->interval_max >> 8) & 0xff;
+    *p++ = p_params->latency & 0xff;
+    *p++ = (p_params->latency >> 8) & 0xff;
+    *p++ = p_params->supervision_timeout & 0xff;
+    *p++ = (p_params->supervision_timeout >> 8) & 0xff;
+    wiced_hci_send( controller, HCI_CONTROL_LE_COMMAND_SET_CONN_PARAMS, data, sizeof( data ) );
+
+    return CY_RSLT_SUCCESS;
+}
+
+void wiced_hci_ble_advertisement_report(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_ble_scan_results_t         scan_result;
+    wiced_bt_ble_scan_result_cback_t*   scan_result_cb = wh_bt_ble_context[controller].scan_result_cb;
+    uint8_t                             rssi;
+
+    if ( scan_result_cb == NULL )
+    {
+        return;
+    }
+
+    if ( ( payload == NULL ) || ( len < ADVERTISEMENT_REPORT_HEADER_LENGTH ) )
+    {
+        WICED_ERROR(("[%s] malformed advertisement report [%d]\n",__func__,(int)len));
+        return;
+    }
+
+    /* Parse in place, the advertisement data is handed over without copying */
+    STREAM_TO_UINT8( scan_result.ble_evt_type, payload );
+    STREAM_TO_UINT8( scan_result.ble_addr_type, payload );
+    STREAM_TO_BDADDR( scan_result.remote_bd_addr, payload );
+    STREAM_TO_UINT8( rssi, payload );
+    scan_result.rssi = (int8_t)rssi;
+
+    len -= ADVERTISEMENT_REPORT_HEADER_LENGTH;
+    scan_result.adv_data_length = ( len > 0xff ) ? 0xff : (uint8_t)len;
 
+    scan_result_cb( controller, &scan_result, payload );
 }
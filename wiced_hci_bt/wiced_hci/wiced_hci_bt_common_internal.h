@@ -32,17 +32,38 @@
  */
 
 #include "wiced_hci_bt_gatt.h"
+#include "wiced_hci_bt_dm.h"
+#include "cyabs_rtos.h"
 
 /******************************************************
   *                    Constants
   ******************************************************/
 
+/* Connections with a GATT client procedure tracked at once */
+#ifndef WICED_HCI_GATT_MAX_CONNECTIONS
+#define WICED_HCI_GATT_MAX_CONNECTIONS  ( 4 )
+#endif
+
 /******************************************************
  *                   Structures
  ******************************************************/
+
+/* GATT client procedure of a connection, the controller does not repeat the request in its results */
+typedef struct _wiced_hci_gatt_procedure {
+        uint8_t                       used;
+        uint16_t                      conn_id;
+        uint8_t                       discovery_type;
+        uint16_t                      read_handle;
+        uint16_t                      write_handle;
+} wiced_hci_gatt_procedure_t;
+
 typedef struct _wiced_hci_bt_gatt_context {
         wiced_hci_cb                  gatt_context_cb;
         wiced_bt_gatt_cback_t*        gatt_mgmt_cb;
+        wiced_hci_gatt_procedure_t    procedures[WICED_HCI_GATT_MAX_CONNECTIONS];
+        cy_mutex_t                    procedures_lock;                              /* claims and releases of procedures */
+        uint8_t                       procedures_lock_initialized;
+        uint8_t                       response[WICED_HCI_MAX_PAYLOAD_LENGTH];       /* read response being built, by the GATT group worker only */
 } wiced_hci_bt_gatt_context_t;
 
 typedef struct _wiced_hci_bt_dm_context {
@@ -50,5 +71,21 @@ typedef struct _wiced_hci_bt_dm_context {
     wiced_bt_management_cback_t*               dm_mgmt_cb;
     wiced_bt_device_address_t                  bd_addr;
     uint16_t                                   nvram_id;
+    wiced_bt_buffer_stats_cback_t*             buffer_stats_cb;
 } wiced_hci_bt_dm_context_t;
 
+/******************************************************
+ *                 Global Variables
+ ******************************************************/
+
+/* Contexts of each controller */
+extern wiced_hci_bt_dm_context_t    wh_bt_dm_context[WICED_HCI_MAX_CONTROLLERS];
+extern wiced_hci_bt_gatt_context_t  wh_bt_gatt_context[WICED_HCI_MAX_CONTROLLERS];
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/* Forgets the GATT client procedure of a closed connection */
+void wiced_hci_gatt_process_disconnection(wiced_hci_controller_t controller, uint16_t conn_id);
+
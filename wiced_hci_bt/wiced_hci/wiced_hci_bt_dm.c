@@ -42,7 +42,9 @@
 #include <stdio.h>
 #include "cy_result_mw.h"
 #include "wiced_hci.h"
+#include "wiced_hci_events.h"
 #include "wiced_hci_bt_common_internal.h"
+#include "wiced_hci_bt_ble.h"
 #include "wiced_defs.h"
 
 /******************************************************
@@ -53,137 +55,196 @@
  *                   Structures
  ******************************************************/
 
+/* pool id, pad, pool size, current, max and total counts: wiced_bt_buffer_statistics_t as laid out by the controller */
+#define BUFFER_STATS_ENTRY_LENGTH   ( 10 )
+
+/* Longest WICED trace message printed */
+#define TRACE_MESSAGE_LENGTH        ( 200 )
+
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
 
-static void wiced_hci_dm_cb(uint16_t command, uint8_t* payload, uint32_t len);
-
 /******************************************************
  *               External Function Declarations
  ******************************************************/
 
-extern cy_rslt_t wiced_hci_up();
-
 /******************************************************
  *               Variable Definitions
  ******************************************************/
 
-wiced_hci_bt_dm_context_t              wh_bt_dm_context;
-wiced_hci_bt_gatt_context_t            wh_bt_gatt_context;
+wiced_hci_bt_dm_context_t              wh_bt_dm_context[WICED_HCI_MAX_CONTROLLERS];
+wiced_hci_bt_gatt_context_t            wh_bt_gatt_context[WICED_HCI_MAX_CONTROLLERS];
 
 /******************************************************
  *               Function Definitions
  ******************************************************/
 
-static void wiced_hci_dm_cb(uint16_t command, uint8_t* payload, uint32_t len)
+static void wiced_hci_dm_notify(wiced_hci_controller_t controller, wiced_bt_management_evt_t evt, wiced_bt_management_evt_data_t* p_data)
+{
+    if ( wh_bt_dm_context[controller].dm_mgmt_cb )
+    {
+        wh_bt_dm_context[controller].dm_mgmt_cb( controller, evt, p_data );
+    }
+}
+
+void wiced_hci_dm_trace(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+#ifdef ENABLE_BT_PROTOCOL_TRACES
+    char str[TRACE_MESSAGE_LENGTH];
+
+    if ( len >= sizeof( str ) )
+    {
+        len = sizeof( str ) - 1;
+    }
+    memcpy(str,payload,len);
+    str[len]='\0';
+    WICED_DEBUG((" Trace message:\n------------------------\n%s------------------------\n",str));
+#endif
+}
+
+void wiced_hci_dm_device_started(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
 {
-    wiced_bt_management_evt_t evt = 0;
     wiced_bt_management_evt_data_t data;
 
-    WICED_DEBUG((" [%s] [%x] [%d]\n\n", __func__, command, (int)len));
+    WICED_INFO(("[%s] HCI_CONTROL_EVENT_DEVICE_STARTED\n",__func__));
+    if ( payload )
+    {
+        STREAM_TO_UINT8(data.enabled.status, payload);
+        wiced_hci_dm_notify( controller, BTM_ENABLED_EVT, &data );
+    }
+}
 
-    switch(command)
+void wiced_hci_dm_local_bda(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    if ( payload && len >= BD_ADDR_LEN )
     {
+        STREAM_TO_BDADDR( wh_bt_dm_context[controller].bd_addr, payload );
+    }
+}
 
-        case HCI_CONTROL_EVENT_READ_LOCAL_BDA:
-            STREAM_TO_BDADDR( wh_bt_dm_context.bd_addr, payload );
-            evt = 0xff;
-            break;
+void wiced_hci_dm_buffer_stats(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_buffer_statistics_t stats[WICED_BT_BUFFER_POOLS];
+    wiced_bt_buffer_stats_cback_t* p_cback = wh_bt_dm_context[controller].buffer_stats_cb;
+    uint8_t count = 0;
 
-        case HCI_CONTROL_EVENT_DEVICE_STARTED:
-            WICED_INFO(("[%s] HCI_CONTROL_EVENT_DEVICE_STARTED\n",__func__));
-            if ( payload )
-            {
-                STREAM_TO_UINT8(data.enabled.status, payload);
-                evt = BTM_ENABLED_EVT;
-            }
-            break;
+    memset( stats, 0, sizeof( stats ) );
+    while ( payload && len >= BUFFER_STATS_ENTRY_LENGTH && count < WICED_BT_BUFFER_POOLS )
+    {
+        STREAM_TO_UINT8( stats[count].pool_id, payload );
+        payload++;
+        STREAM_TO_UINT16( stats[count].pool_size, payload );
+        STREAM_TO_UINT16( stats[count].current_allocated_count, payload );
+        STREAM_TO_UINT16( stats[count].max_allocated_count, payload );
+        STREAM_TO_UINT16( stats[count].total_count, payload );
+        len -= BUFFER_STATS_ENTRY_LENGTH;
+        count++;
+    }
+    if ( p_cback )
+    {
+        p_cback( controller, stats, count );
+    }
+}
 
-        case HCI_CONTROL_LE_EVENT_CONNECTED:
-        {
-            wiced_bt_gatt_event_data_t    event_data;
-            wiced_bt_device_address_t  temp_bdadr;
-            WICED_INFO(("[%d] LE Device Connected event\n",(int)len));
-
-            if(payload)
-            {
-                STREAM_TO_UINT8( event_data.connection_status.addr_type , payload );
-                STREAM_TO_BDADDR(temp_bdadr, payload);
-                event_data.connection_status.bd_addr = temp_bdadr;
-                STREAM_TO_UINT16( event_data.connection_status.conn_id, payload );
-                STREAM_TO_UINT8( event_data.connection_status.link_role, payload );
-                event_data.connection_status.transport = BT_TRANSPORT_LE;
-                event_data.connection_status.connected = TRUE;
-
-                wh_bt_gatt_context.gatt_mgmt_cb( GATT_CONNECTION_STATUS_EVT, &event_data );
-
-                evt = 0xff;
-            }
-            break;
-        }
+void wiced_hci_dm_scan_status(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_management_evt_data_t data;
+    uint8_t scan_state;
 
-        case HCI_CONTROL_LE_EVENT_DISCONNECTED:
-        {
-            wiced_bt_gatt_event_data_t    event_data;
-            WICED_INFO(("HCI_CONTROL_LE_EVENT_DISCONNECTED:[%s]\n",__func__));
-
-            evt = 0xff;
-            memset(&event_data, 0, sizeof(wiced_bt_gatt_event_data_t));
-            if(payload)
-            {
-                STREAM_TO_UINT16( event_data.connection_status.conn_id, payload );
-                STREAM_TO_UINT8( event_data.connection_status.reason, payload );
-                event_data.connection_status.connected = FALSE;
-
-                wh_bt_gatt_context.gatt_mgmt_cb( GATT_CONNECTION_STATUS_EVT, &event_data );
-            }
-            break;
-        }
+    if ( payload == NULL )
+    {
+        return;
+    }
 
-        case HCI_CONTROL_EVENT_COMMAND_STATUS:
-        {
-#ifdef ENABLE_BT_PROTOCOL_TRACES
-            uint8_t control_event_status;
-            STREAM_TO_UINT8(control_event_status, payload);
-            WICED_DEBUG(("HCI_CONTROL_EVENT_COMMAND_STATUS: %d\n", control_event_status));
-#endif
-            evt = 0xff;
+    STREAM_TO_UINT8( scan_state, payload );
+    switch ( scan_state )
+    {
+        case HCI_CONTROL_SCAN_EVENT_HIGH_SCAN:
+        case HCI_CONTROL_SCAN_EVENT_HIGH_CONN:
+            data.ble_scan_state_changed = BTM_BLE_SCAN_TYPE_HIGH_DUTY;
             break;
-        }
-        case HCI_CONTROL_EVENT_WICED_TRACE:
-        {
-#ifdef ENABLE_BT_PROTOCOL_TRACES
-            char str[200];
-            memcpy(str,payload,len);
-            str[len]='\0';
-            WICED_DEBUG((" Trace message:\n------------------------\n%s------------------------\n",str));
-#endif
-            evt = 0xff;
+        case HCI_CONTROL_SCAN_EVENT_LOW_SCAN:
+        case HCI_CONTROL_SCAN_EVENT_LOW_CONN:
+            data.ble_scan_state_changed = BTM_BLE_SCAN_TYPE_LOW_DUTY;
             break;
-        }
-
         default:
-            evt = 0xff;
+            data.ble_scan_state_changed = BTM_BLE_SCAN_TYPE_NONE;
             break;
+    }
+    wiced_hci_dm_notify( controller, BTM_BLE_SCAN_STATE_CHANGED_EVT, &data );
+}
 
+void wiced_hci_dm_advertisement_state(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_management_evt_data_t data;
+
+    if ( payload )
+    {
+        STREAM_TO_UINT8( data.ble_advert_state_changed, payload );
+        wiced_hci_dm_notify( controller, BTM_BLE_ADVERT_STATE_CHANGED_EVT, &data );
     }
-    if(evt != 0xff)
-        wh_bt_dm_context.dm_mgmt_cb( evt, &data );
 }
 
-cy_rslt_t wiced_bt_stack_init(wiced_bt_management_cback_t *p_bt_management_cback)
+void wiced_hci_dm_le_connected(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_gatt_event_data_t    event_data;
+    wiced_bt_device_address_t  temp_bdadr;
+    WICED_INFO(("[%d] LE Device Connected event\n",(int)len));
+
+    memset(&event_data, 0, sizeof(wiced_bt_gatt_event_data_t));
+    if(payload)
+    {
+        STREAM_TO_UINT8( event_data.connection_status.addr_type , payload );
+        STREAM_TO_BDADDR(temp_bdadr, payload);
+        event_data.connection_status.bd_addr = temp_bdadr;
+        STREAM_TO_UINT16( event_data.connection_status.conn_id, payload );
+        STREAM_TO_UINT8( event_data.connection_status.link_role, payload );
+        event_data.connection_status.transport = BT_TRANSPORT_LE;
+        event_data.connection_status.connected = TRUE;
+
+        if ( wh_bt_gatt_context[controller].gatt_mgmt_cb )
+        {
+            wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_CONNECTION_STATUS_EVT, &event_data );
+        }
+    }
+}
+
+void wiced_hci_dm_le_disconnected(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_gatt_event_data_t    event_data;
+    WICED_INFO(("HCI_CONTROL_LE_EVENT_DISCONNECTED:[%s]\n",__func__));
+
+    memset(&event_data, 0, sizeof(wiced_bt_gatt_event_data_t));
+    if(payload)
+    {
+        STREAM_TO_UINT16( event_data.connection_status.conn_id, payload );
+        STREAM_TO_UINT8( event_data.connection_status.reason, payload );
+        event_data.connection_status.connected = FALSE;
+        wiced_hci_gatt_process_disconnection( controller, event_data.connection_status.conn_id );
+
+        if ( wh_bt_gatt_context[controller].gatt_mgmt_cb )
+        {
+            wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_CONNECTION_STATUS_EVT, &event_data );
+        }
+    }
+}
+
+cy_rslt_t wiced_bt_stack_init(wiced_hci_controller_t controller, wiced_bt_management_cback_t *p_bt_management_cback)
 {
     cy_rslt_t result = CY_RSLT_SUCCESS;
 
-    wh_bt_dm_context.dm_mgmt_cb = p_bt_management_cback;
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        WICED_ERROR(( "[%s] No controller %d\n",__FUNCTION__, controller));
+        return CY_RSLT_MW_ERROR;
+    }
 
-    /* Setting the event callbacks as the first step to ensure that any data from the BT chip is routed to the right callback */
-    wiced_hci_set_event_callback(DEVICE, wiced_hci_dm_cb);
-    wiced_hci_set_event_callback(LE, wiced_hci_dm_cb);
+    /* Set before wiced_hci starts, the device management events are dispatched as soon as it is up */
+    wh_bt_dm_context[controller].dm_mgmt_cb = p_bt_management_cback;
 
     /* start wiced_hci only here. Once started, it stays up. */
-    if ( (result = wiced_hci_up() ) != CY_RSLT_SUCCESS )
+    if ( (result = wiced_hci_up( controller ) ) != CY_RSLT_SUCCESS )
     {
         WICED_ERROR(( "[%s] Failed to initialize wiced hci\n",__FUNCTION__));
         return result;
@@ -193,28 +254,28 @@ cy_rslt_t wiced_bt_stack_init(wiced_bt_management_cback_t *p_bt_management_cback
     return result;
 }
 
-cy_rslt_t wiced_bt_stack_deinit(void)
+cy_rslt_t wiced_bt_stack_deinit(wiced_hci_controller_t controller)
 {
     cy_rslt_t result = CY_RSLT_SUCCESS;
 
     WICED_INFO(("[%s]\n",__func__));
 
     /* Call the wiced_hci_down */
-    if ( (result = wiced_hci_down() ) != CY_RSLT_SUCCESS )
+    if ( (result = wiced_hci_down( controller ) ) != CY_RSLT_SUCCESS )
     {
         WICED_ERROR(( "[%s] Failed to initialize wiced hci\n",__FUNCTION__));
         return result;
     }
 
     /* Send BTM_DISABLED_EVENT */
-    wh_bt_dm_context.dm_mgmt_cb( BTM_DISABLED_EVT, NULL );
+    wh_bt_dm_context[controller].dm_mgmt_cb( controller, BTM_DISABLED_EVT, NULL );
 
-    memset(&wh_bt_dm_context, 0 ,sizeof(wh_bt_dm_context));
+    memset(&wh_bt_dm_context[controller], 0 ,sizeof(wh_bt_dm_context[controller]));
 
     return result;
 }
 
-void wiced_bt_set_local_bdaddr( wiced_bt_device_address_t  bda )
+void wiced_bt_set_local_bdaddr( wiced_hci_controller_t controller, wiced_bt_device_address_t  bda )
 {
     uint8_t*        data  = NULL;
     uint8_t*        p     = NULL;
@@ -225,12 +286,25 @@ void wiced_bt_set_local_bdaddr( wiced_bt_device_address_t  bda )
     data = (uint8_t*)calloc(length, sizeof(uint8_t));
     p = data;
     BDADDR_TO_STREAM(p, bda);
-    wiced_hci_send(HCI_CONTROL_COMMAND_SET_LOCAL_BDA, data, length);
+    wiced_hci_send(controller, HCI_CONTROL_COMMAND_SET_LOCAL_BDA, data, length);
     free(data);
 }
 
-void wiced_bt_dev_read_local_addr (wiced_bt_device_address_t bd_addr)
+void wiced_bt_dev_read_local_addr (wiced_hci_controller_t controller, wiced_bt_device_address_t bd_addr)
 {
     wiced_bt_device_address_t bda = {0,0,0,0,0,0};
-    wiced_hci_send( HCI_CONTROL_COMMAND_READ_LOCAL_BDA, bda, sizeof(bda) );
+    wiced_hci_send( controller, HCI_CONTROL_COMMAND_READ_LOCAL_BDA, bda, sizeof(bda) );
+}
+
+cy_rslt_t wiced_bt_dev_read_buffer_stats(wiced_hci_controller_t controller, wiced_bt_buffer_stats_cback_t *p_cback)
+{
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS || p_cback == NULL )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    wh_bt_dm_context[controller].buffer_stats_cb = p_cback;
+    wiced_hci_send( controller, HCI_CONTROL_COMMAND_READ_BUFF_STATS, NULL, 0 );
+
+    return CY_RSLT_SUCCESS;
 }
@@ -0,0 +1,644 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/**
+ * @file wiced_hci_bt_gatt.c
+ *
+ * This handles the GATT client api functions when USE_WICED_HCI is defined.
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "wiced_hci.h"
+#include "wiced_hci_events.h"
+#include "cy_result_mw.h"
+#include "wiced_defs.h"
+#include "wiced_hci_bt_common_internal.h"
+#include "wiced_hci_bt_gatt.h"
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/* connection id, start and end handles */
+#define GATT_DISCOVER_COMMAND_LENGTH        ( 6 )
+
+/* connection id and attribute handle precede the value */
+#define GATT_HANDLE_HEADER_LENGTH           ( 4 )
+
+/* connection id, uuid, start and end handles */
+#define GATT_SERVICE_EVENT_LENGTH(uuid)     ( 6 + (uuid) )
+
+/* connection id, declaration handle, uuid, properties and value handle */
+#define GATT_CHARACTERISTIC_EVENT_LENGTH(uuid) ( 7 + (uuid) )
+
+/* connection id, uuid and handle */
+#define GATT_DESCRIPTOR_EVENT_LENGTH(uuid)  ( 4 + (uuid) )
+
+/******************************************************
+ *                   Structures
+ ******************************************************/
+
+/******************************************************
+ *               Static Function Declarations
+ ******************************************************/
+
+/******************************************************
+ *               External Variable Declarations
+ ******************************************************/
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+/* Procedures are claimed by the application threads and the event workers of several connections at once */
+static void wiced_hci_gatt_lock_procedures(wiced_hci_controller_t controller)
+{
+    if ( wh_bt_gatt_context[controller].procedures_lock_initialized )
+    {
+        cy_rtos_get_mutex( &wh_bt_gatt_context[controller].procedures_lock, CY_RTOS_NEVER_TIMEOUT );
+    }
+}
+
+static void wiced_hci_gatt_unlock_procedures(wiced_hci_controller_t controller)
+{
+    if ( wh_bt_gatt_context[controller].procedures_lock_initialized )
+    {
+        cy_rtos_set_mutex( &wh_bt_gatt_context[controller].procedures_lock );
+    }
+}
+
+/* The controller reports GATT results by connection only: remember what each connection is doing.
+ * The fields of a procedure are only used by its connection, whose events are handled in order. */
+static wiced_hci_gatt_procedure_t* wiced_hci_gatt_procedure(wiced_hci_controller_t controller, uint16_t conn_id, uint8_t create)
+{
+    wiced_hci_gatt_procedure_t* procedure = NULL;
+    wiced_hci_gatt_procedure_t* free_procedure = NULL;
+    int i = 0;
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        return NULL;
+    }
+
+    wiced_hci_gatt_lock_procedures( controller );
+    for ( i = 0; i < WICED_HCI_GATT_MAX_CONNECTIONS && procedure == NULL; i++ )
+    {
+        if ( wh_bt_gatt_context[controller].procedures[i].used && wh_bt_gatt_context[controller].procedures[i].conn_id == conn_id )
+        {
+            procedure = &wh_bt_gatt_context[controller].procedures[i];
+        }
+        else if ( !wh_bt_gatt_context[controller].procedures[i].used && free_procedure == NULL )
+        {
+            free_procedure = &wh_bt_gatt_context[controller].procedures[i];
+        }
+    }
+
+    if ( procedure == NULL && create && free_procedure )
+    {
+        memset( free_procedure, 0, sizeof( *free_procedure ) );
+        free_procedure->used    = 1;
+        free_procedure->conn_id = conn_id;
+        procedure = free_procedure;
+    }
+    wiced_hci_gatt_unlock_procedures( controller );
+
+    return procedure;
+}
+
+/* Reads a 16 or 128-bit uuid of uuid_len bytes */
+static void wiced_hci_gatt_read_uuid(wiced_bt_uuid_t* uuid, uint8_t** p, uint32_t uuid_len)
+{
+    uint8_t* stream = *p;
+
+    memset( uuid, 0, sizeof( *uuid ) );
+    if ( uuid_len == LEN_UUID_16 )
+    {
+        uuid->len = LEN_UUID_16;
+        STREAM_TO_UINT16( uuid->uu.uuid16, stream );
+    }
+    else
+    {
+        uuid->len = LEN_UUID_128;
+        STREAM_TO_ARRAY( uuid->uu.uuid128, stream, LEN_UUID_128 );
+    }
+    *p = stream;
+}
+
+/* Every GATT event but the command status starts with the connection id: reads it.
+ * Returns 0 if the event is too short or no GATT callback is registered. */
+static uint8_t wiced_hci_gatt_event_header(wiced_hci_controller_t controller, uint16_t command, uint8_t** p, uint32_t* len, uint16_t* conn_id)
+{
+    uint8_t* stream = *p;
+
+    if ( wh_bt_gatt_context[controller].gatt_mgmt_cb == NULL )
+    {
+        return 0;
+    }
+
+    if ( stream == NULL || *len < 2 )
+    {
+        WICED_ERROR(("[%s] event %04x too short\n", __func__, command));
+        return 0;
+    }
+    STREAM_TO_UINT16( *conn_id, stream );
+    *p = stream;
+    *len -= 2;
+
+    return 1;
+}
+
+static void wiced_hci_gatt_operation_complete(wiced_hci_controller_t controller, uint16_t conn_id, wiced_bt_gatt_optype_t op, wiced_bt_gatt_status_t status,
+                                              uint16_t handle, uint8_t* data, uint16_t len)
+{
+    wiced_bt_gatt_event_data_t event_data;
+
+    memset( &event_data, 0, sizeof( event_data ) );
+    event_data.operation_complete.conn_id = conn_id;
+    event_data.operation_complete.op      = op;
+    event_data.operation_complete.status  = status;
+    if ( op == GATTC_OPTYPE_WRITE )
+    {
+        event_data.operation_complete.response_data.handle = handle;
+    }
+    else
+    {
+        event_data.operation_complete.response_data.att_value.handle = handle;
+        event_data.operation_complete.response_data.att_value.len    = len;
+        event_data.operation_complete.response_data.att_value.p_data = data;
+    }
+
+    wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_OPERATION_CPLT_EVT, &event_data );
+}
+
+/* Answers a read or write request of a peer to the host database. The controller checks the handles and
+ * permissions against the database given with wiced_bt_gatt_db_init, and the host serves the values. */
+void wiced_hci_gatt_attribute_request(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_gatt_event_data_t event_data;
+    wiced_bt_gatt_status_t     status = WICED_BT_GATT_SUCCESS;
+    uint16_t                   conn_id = 0;
+    uint16_t                   handle = 0;
+    uint16_t                   value_len = 0;
+    uint8_t                    data[GATT_HANDLE_HEADER_LENGTH + 1];
+    uint8_t*                   p = payload;
+    uint8_t*                   response = NULL;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) || len < 2 )
+    {
+        return;
+    }
+    STREAM_TO_UINT16( handle, p );
+    len -= 2;
+
+    memset( &event_data, 0, sizeof( event_data ) );
+    event_data.attribute_request.conn_id = conn_id;
+
+    if ( command == HCI_CONTROL_GATT_EVENT_READ_REQUEST )
+    {
+        event_data.attribute_request.request_type            = GATTS_REQ_TYPE_READ;
+        event_data.attribute_request.data.read_req.handle    = handle;
+        if ( len >= 2 )
+        {
+            STREAM_TO_UINT16( event_data.attribute_request.data.read_req.offset, p );
+        }
+        /* built in place behind its connection id and handle */
+        response  = wh_bt_gatt_context[controller].response;
+        value_len = sizeof( wh_bt_gatt_context[controller].response ) - GATT_HANDLE_HEADER_LENGTH;
+        event_data.attribute_request.data.read_req.p_val_len = &value_len;
+        event_data.attribute_request.data.read_req.p_val     = &response[GATT_HANDLE_HEADER_LENGTH];
+
+        /* a failed read answers an empty value */
+        status = wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_ATTRIBUTE_REQUEST_EVT, &event_data );
+        if ( status != WICED_BT_GATT_SUCCESS || value_len > sizeof( wh_bt_gatt_context[controller].response ) - GATT_HANDLE_HEADER_LENGTH )
+        {
+            value_len = 0;
+        }
+        response[0] = conn_id & 0xff;
+        response[1] = (conn_id >> 8) & 0xff;
+        response[2] = handle & 0xff;
+        response[3] = (handle >> 8) & 0xff;
+        wiced_hci_send( controller, HCI_CONTROL_GATT_COMMAND_READ_RESPONSE, response, GATT_HANDLE_HEADER_LENGTH + value_len );
+        return;
+    }
+
+    event_data.attribute_request.request_type          = GATTS_REQ_TYPE_WRITE;
+    event_data.attribute_request.data.write_req.handle  = handle;
+    event_data.attribute_request.data.write_req.val_len = (uint16_t)len;
+    event_data.attribute_request.data.write_req.p_val   = p;
+    status = wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_ATTRIBUTE_REQUEST_EVT, &event_data );
+
+    data[0] = conn_id & 0xff;
+    data[1] = (conn_id >> 8) & 0xff;
+    data[2] = handle & 0xff;
+    data[3] = (handle >> 8) & 0xff;
+    data[4] = status;
+    wiced_hci_send( controller, HCI_CONTROL_GATT_COMMAND_WRITE_RESPONSE, data, sizeof( data ) );
+}
+
+void wiced_hci_gatt_command_status(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+#ifdef ENABLE_BT_PROTOCOL_TRACES
+    WICED_DEBUG(("HCI_CONTROL_GATT_EVENT_COMMAND_STATUS: %d\n", len ? payload[0] : 0));
+#endif
+}
+
+void wiced_hci_gatt_service_discovered(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_gatt_event_data_t  event_data;
+    uint16_t                    conn_id = 0;
+    uint8_t*                    p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) ||
+         ( len != GATT_SERVICE_EVENT_LENGTH( LEN_UUID_16 ) - 2 && len != GATT_SERVICE_EVENT_LENGTH( LEN_UUID_128 ) - 2 ) )
+    {
+        return;
+    }
+
+    memset( &event_data, 0, sizeof( event_data ) );
+    event_data.discovery_result.conn_id        = conn_id;
+    event_data.discovery_result.discovery_type = GATT_DISCOVER_SERVICES_ALL;
+    wiced_hci_gatt_read_uuid( &event_data.discovery_result.discovery_data.group_value.service_type, &p, len - 4 );
+    STREAM_TO_UINT16( event_data.discovery_result.discovery_data.group_value.s_handle, p );
+    STREAM_TO_UINT16( event_data.discovery_result.discovery_data.group_value.e_handle, p );
+    wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_DISCOVERY_RESULT_EVT, &event_data );
+}
+
+void wiced_hci_gatt_characteristic_discovered(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_gatt_event_data_t  event_data;
+    uint16_t                    conn_id = 0;
+    uint8_t*                    p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) ||
+         ( len != GATT_CHARACTERISTIC_EVENT_LENGTH( LEN_UUID_16 ) - 2 && len != GATT_CHARACTERISTIC_EVENT_LENGTH( LEN_UUID_128 ) - 2 ) )
+    {
+        return;
+    }
+
+    memset( &event_data, 0, sizeof( event_data ) );
+    event_data.discovery_result.conn_id        = conn_id;
+    event_data.discovery_result.discovery_type = GATT_DISCOVER_CHARACTERISTICS;
+    STREAM_TO_UINT16( event_data.discovery_result.discovery_data.characteristic_declaration.handle, p );
+    wiced_hci_gatt_read_uuid( &event_data.discovery_result.discovery_data.characteristic_declaration.char_uuid, &p, len - 5 );
+    STREAM_TO_UINT8( event_data.discovery_result.discovery_data.characteristic_declaration.characteristic_properties, p );
+    STREAM_TO_UINT16( event_data.discovery_result.discovery_data.characteristic_declaration.val_handle, p );
+    wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_DISCOVERY_RESULT_EVT, &event_data );
+}
+
+void wiced_hci_gatt_descriptor_discovered(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_gatt_event_data_t  event_data;
+    uint16_t                    conn_id = 0;
+    uint8_t*                    p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) ||
+         ( len != GATT_DESCRIPTOR_EVENT_LENGTH( LEN_UUID_16 ) - 2 && len != GATT_DESCRIPTOR_EVENT_LENGTH( LEN_UUID_128 ) - 2 ) )
+    {
+        return;
+    }
+
+    memset( &event_data, 0, sizeof( event_data ) );
+    event_data.discovery_result.conn_id        = conn_id;
+    event_data.discovery_result.discovery_type = GATT_DISCOVER_CHARACTERISTIC_DESCRIPTORS;
+    wiced_hci_gatt_read_uuid( &event_data.discovery_result.discovery_data.char_descr_info.type, &p, len - 2 );
+    STREAM_TO_UINT16( event_data.discovery_result.discovery_data.char_descr_info.handle, p );
+    wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_DISCOVERY_RESULT_EVT, &event_data );
+}
+
+void wiced_hci_gatt_discovery_complete(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_gatt_event_data_t  event_data;
+    wiced_hci_gatt_procedure_t* procedure = NULL;
+    uint16_t                    conn_id = 0;
+    uint8_t*                    p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) )
+    {
+        return;
+    }
+    procedure = wiced_hci_gatt_procedure( controller, conn_id, 0 );
+
+    memset( &event_data, 0, sizeof( event_data ) );
+    event_data.discovery_complete.conn_id   = conn_id;
+    event_data.discovery_complete.disc_type = procedure ? procedure->discovery_type : GATT_DISCOVER_SERVICES_ALL;
+    event_data.discovery_complete.status    = WICED_BT_GATT_SUCCESS;
+    if ( procedure )
+    {
+        procedure->discovery_type = 0;
+    }
+    wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_DISCOVERY_CPLT_EVT, &event_data );
+}
+
+void wiced_hci_gatt_read_response(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_hci_gatt_procedure_t* procedure = NULL;
+    uint16_t                    conn_id = 0;
+    uint8_t*                    p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) )
+    {
+        return;
+    }
+    procedure = wiced_hci_gatt_procedure( controller, conn_id, 0 );
+
+    wiced_hci_gatt_operation_complete( controller, conn_id, GATTC_OPTYPE_READ, WICED_BT_GATT_SUCCESS,
+                                       procedure ? procedure->read_handle : 0, p, (uint16_t)len );
+}
+
+void wiced_hci_gatt_read_error(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_hci_gatt_procedure_t* procedure = NULL;
+    uint16_t                    conn_id = 0;
+    uint8_t                     status = WICED_BT_GATT_SUCCESS;
+    uint8_t*                    p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) )
+    {
+        return;
+    }
+    procedure = wiced_hci_gatt_procedure( controller, conn_id, 0 );
+
+    if ( len )
+    {
+        STREAM_TO_UINT8( status, p );
+    }
+    wiced_hci_gatt_operation_complete( controller, conn_id, GATTC_OPTYPE_READ, status ? status : WICED_BT_GATT_ERROR,
+                                       procedure ? procedure->read_handle : 0, NULL, 0 );
+}
+
+/* Handles both the write response and the write error, which may carry no status */
+void wiced_hci_gatt_write_response(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_hci_gatt_procedure_t* procedure = NULL;
+    uint16_t                    conn_id = 0;
+    uint8_t                     status = WICED_BT_GATT_SUCCESS;
+    uint8_t*                    p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) )
+    {
+        return;
+    }
+    procedure = wiced_hci_gatt_procedure( controller, conn_id, 0 );
+
+    if ( len )
+    {
+        STREAM_TO_UINT8( status, p );
+    }
+    if ( command == HCI_CONTROL_GATT_EVENT_WRITE_ERROR && status == WICED_BT_GATT_SUCCESS )
+    {
+        status = WICED_BT_GATT_ERROR;
+    }
+    wiced_hci_gatt_operation_complete( controller, conn_id, GATTC_OPTYPE_WRITE, status,
+                                       procedure ? procedure->write_handle : 0, NULL, 0 );
+}
+
+/* Handles both notifications and indications */
+void wiced_hci_gatt_notification(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    uint16_t                    conn_id = 0;
+    uint16_t                    handle = 0;
+    uint8_t*                    p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) || len < 2 )
+    {
+        return;
+    }
+
+    STREAM_TO_UINT16( handle, p );
+    wiced_hci_gatt_operation_complete( controller, conn_id,
+                                       command == HCI_CONTROL_GATT_EVENT_NOTIFICATION ? GATTC_OPTYPE_NOTIFICATION : GATTC_OPTYPE_INDICATION,
+                                       WICED_BT_GATT_SUCCESS, handle, p, (uint16_t)(len - 2) );
+
+    /* the peer sends no other indication until this one is confirmed */
+    if ( command == HCI_CONTROL_GATT_EVENT_INDICATION )
+    {
+        uint8_t data[GATT_HANDLE_HEADER_LENGTH];
+
+        data[0] = conn_id & 0xff;
+        data[1] = (conn_id >> 8) & 0xff;
+        data[2] = handle & 0xff;
+        data[3] = (handle >> 8) & 0xff;
+        wiced_hci_send( controller, HCI_CONTROL_GATT_COMMAND_INDICATE_CONFIRM, data, sizeof( data ) );
+    }
+}
+
+cy_rslt_t wiced_bt_gatt_register(wiced_hci_controller_t controller, wiced_bt_gatt_cback_t *p_gatt_cback)
+{
+    WICED_INFO(("[%s]\n",__func__));
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    /* the lock is kept across registrations, events may still be handled */
+    if ( !wh_bt_gatt_context[controller].procedures_lock_initialized )
+    {
+        if ( cy_rtos_init_mutex( &wh_bt_gatt_context[controller].procedures_lock ) != CY_RSLT_SUCCESS )
+        {
+            return CY_RSLT_MW_ERROR;
+        }
+        wh_bt_gatt_context[controller].procedures_lock_initialized = 1;
+    }
+
+    wh_bt_gatt_context[controller].gatt_mgmt_cb = p_gatt_cback;
+    wiced_hci_gatt_lock_procedures( controller );
+    memset( wh_bt_gatt_context[controller].procedures, 0, sizeof( wh_bt_gatt_context[controller].procedures ) );
+    wiced_hci_gatt_unlock_procedures( controller );
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_gatt_send_discover(wiced_hci_controller_t controller, uint16_t conn_id, wiced_bt_gatt_discovery_type_t discovery_type, wiced_bt_gatt_discovery_param_t *p_discovery_param)
+{
+    wiced_hci_gatt_procedure_t* procedure = NULL;
+    uint8_t  data[GATT_DISCOVER_COMMAND_LENGTH];
+    uint16_t opcode = 0;
+
+    switch ( discovery_type )
+    {
+        case GATT_DISCOVER_SERVICES_ALL:
+            opcode = HCI_CONTROL_GATT_COMMAND_DISCOVER_SERVICES;
+            break;
+        case GATT_DISCOVER_CHARACTERISTICS:
+            opcode = HCI_CONTROL_GATT_COMMAND_DISCOVER_CHARACTERISTICS;
+            break;
+        case GATT_DISCOVER_CHARACTERISTIC_DESCRIPTORS:
+            opcode = HCI_CONTROL_GATT_COMMAND_DISCOVER_DESCRIPTORS;
+            break;
+        default:
+            WICED_ERROR(("[%s] discovery type %d not supported\n", __func__, discovery_type));
+            return CY_RSLT_MW_ERROR;
+    }
+
+    procedure = wiced_hci_gatt_procedure( controller, conn_id, 1 );
+    if ( procedure == NULL || p_discovery_param == NULL )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    procedure->discovery_type = discovery_type;
+
+    data[0] = conn_id & 0xff;
+    data[1] = (conn_id >> 8) & 0xff;
+    data[2] = p_discovery_param->s_handle & 0xff;
+    data[3] = (p_discovery_param->s_handle >> 8) & 0xff;
+    data[4] = p_discovery_param->e_handle & 0xff;
+    data[5] = (p_discovery_param->e_handle >> 8) & 0xff;
+    wiced_hci_send( controller, opcode, data, sizeof( data ) );
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_gatt_send_read(wiced_hci_controller_t controller, uint16_t conn_id, wiced_bt_gatt_read_type_t type, wiced_bt_gatt_read_param_t *p_read)
+{
+    wiced_hci_gatt_procedure_t* procedure = NULL;
+    uint8_t data[GATT_HANDLE_HEADER_LENGTH];
+
+    if ( type != GATT_READ_BY_HANDLE || p_read == NULL )
+    {
+        WICED_ERROR(("[%s] read type %d not supported\n", __func__, type));
+        return CY_RSLT_MW_ERROR;
+    }
+
+    procedure = wiced_hci_gatt_procedure( controller, conn_id, 1 );
+    if ( procedure == NULL )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+    procedure->read_handle = p_read->by_handle.handle;
+
+    data[0] = conn_id & 0xff;
+    data[1] = (conn_id >> 8) & 0xff;
+    data[2] = p_read->by_handle.handle & 0xff;
+    data[3] = (p_read->by_handle.handle >> 8) & 0xff;
+    wiced_hci_send( controller, HCI_CONTROL_GATT_COMMAND_READ_REQUEST, data, sizeof( data ) );
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_gatt_send_write(wiced_hci_controller_t controller, uint16_t conn_id, wiced_bt_gatt_write_type_t type, wiced_bt_gatt_value_t *p_data)
+{
+    wiced_hci_gatt_procedure_t* procedure = NULL;
+    uint8_t header[GATT_HANDLE_HEADER_LENGTH];
+
+    if ( ( type != GATT_WRITE && type != GATT_WRITE_NO_RSP ) || p_data == NULL ||
+         (uint32_t)p_data->len + sizeof( header ) > WICED_HCI_MAX_PAYLOAD_LENGTH )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    if ( type == GATT_WRITE )
+    {
+        procedure = wiced_hci_gatt_procedure( controller, conn_id, 1 );
+        if ( procedure == NULL )
+        {
+            return CY_RSLT_MW_ERROR;
+        }
+        procedure->write_handle = p_data->handle;
+    }
+
+    header[0] = conn_id & 0xff;
+    header[1] = (conn_id >> 8) & 0xff;
+    header[2] = p_data->handle & 0xff;
+    header[3] = (p_data->handle >> 8) & 0xff;
+    wiced_hci_send_gather( controller, type == GATT_WRITE ? HCI_CONTROL_GATT_COMMAND_WRITE_REQUEST : HCI_CONTROL_GATT_COMMAND_WRITE_COMMAND,
+                           header, sizeof( header ), p_data->value, p_data->len );
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_gatt_db_init(wiced_hci_controller_t controller, const uint8_t *p_gatt_db, uint16_t db_size)
+{
+    if ( p_gatt_db == NULL || db_size == 0 || db_size > WICED_HCI_MAX_PAYLOAD_LENGTH )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    wiced_hci_send_gather( controller, HCI_CONTROL_GATT_COMMAND_DB_INIT, NULL, 0, p_gatt_db, db_size );
+
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_gatt_send_write_command(wiced_hci_controller_t controller, uint16_t conn_id, uint16_t handle, const uint8_t *p_value, uint16_t len)
+{
+    uint8_t header[GATT_HANDLE_HEADER_LENGTH];
+
+    if ( ( p_value == NULL && len ) || (uint32_t)len + sizeof( header ) > WICED_HCI_MAX_PAYLOAD_LENGTH )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    header[0] = conn_id & 0xff;
+    header[1] = (conn_id >> 8) & 0xff;
+    header[2] = handle & 0xff;
+    header[3] = (handle >> 8) & 0xff;
+    wiced_hci_send_gather( controller, HCI_CONTROL_GATT_COMMAND_WRITE_COMMAND, header, sizeof( header ), p_value, len );
+
+    return CY_RSLT_SUCCESS;
+}
+
+void wiced_hci_gatt_peer_mtu(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_bt_gatt_event_data_t event_data;
+    uint16_t                   conn_id = 0;
+    uint8_t*                   p = payload;
+
+    if ( !wiced_hci_gatt_event_header( controller, command, &p, &len, &conn_id ) || len < 2 )
+    {
+        return;
+    }
+
+    memset( &event_data, 0, sizeof( event_data ) );
+    event_data.peer_mtu.conn_id = conn_id;
+    STREAM_TO_UINT16( event_data.peer_mtu.mtu, p );
+    wh_bt_gatt_context[controller].gatt_mgmt_cb( controller, GATT_PEER_MTU_EVT, &event_data );
+}
+
+void wiced_hci_gatt_process_disconnection(wiced_hci_controller_t controller, uint16_t conn_id)
+{
+    wiced_hci_gatt_procedure_t* procedure = wiced_hci_gatt_procedure( controller, conn_id, 0 );
+
+    if ( procedure )
+    {
+        wiced_hci_gatt_lock_procedures( controller );
+        procedure->used = 0;
+        wiced_hci_gatt_unlock_procedures( controller );
+    }
+}
@@ -41,16 +41,47 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "wiced_hci.h"
+#include "wiced_hci_events.h"
 #include "wiced_hci_bt_mesh.h"
 #include "wiced_hci_bt_common_internal.h"
+#include "wiced_uart.h"
 #include "cyabs_rtos.h"
 
 /******************************************************
  *                    Constants
  ******************************************************/
 #define CONNECTION_STATUS_LENGTH 3
+#define CONNECTION_STATE_LENGTH   3
 
-#define DEFAULT_CONNECTION_ID     0x03
+#define NO_CONNECTION_ID          0x0000
+
+/* Device commands answered by HCI_CONTROL_EVENT_COMMAND_STATUS, the others answer with their own event or not at all */
+#define DEVICE_COMMAND_HAS_STATUS(command)  ( (command) != HCI_CONTROL_COMMAND_RESET && \
+                                              (command) != HCI_CONTROL_COMMAND_READ_LOCAL_BDA && \
+                                              (command) != HCI_CONTROL_COMMAND_READ_BUFF_STATS )
+
+/* Other device commands that can wait for their command status during an NVRAM restore */
+#ifndef WICED_BT_MESH_NVRAM_RESTORE_OTHER_COMMANDS
+#define WICED_BT_MESH_NVRAM_RESTORE_OTHER_COMMANDS  (4)
+#endif
+
+/* Proxy PDU header: SAR in the 2 upper bits, message type in the others */
+#define PROXY_SAR_COMPLETE        0x00
+#define PROXY_SAR_FIRST           0x01
+#define PROXY_SAR_CONTINUATION    0x02
+#define PROXY_SAR_LAST            0x03
+#define PROXY_SAR(header)         ((header) >> 6)
+#define PROXY_TYPE(header)        ((header) & 0x3F)
+
+/* Largest proxy PDU sent to the mesh core in one packet, longer ones are segmented */
+#ifndef WICED_BT_MESH_PROXY_SEGMENT_LENGTH
+#define WICED_BT_MESH_PROXY_SEGMENT_LENGTH          WICED_HCI_MAX_PAYLOAD_LENGTH
+#endif
+
+/* Largest proxy PDU reassembled from the segments sent by the mesh core */
+#ifndef WICED_BT_MESH_PROXY_REASSEMBLY_LENGTH
+#define WICED_BT_MESH_PROXY_REASSEMBLY_LENGTH       (4 * WICED_HCI_MAX_PAYLOAD_LENGTH)
+#endif
 
 /******************************************************
   *                   Structures
@@ -61,162 +92,581 @@
          wiced_bt_mesh_core_gatt_send_cb_t    proxy_data_cb;
          wiced_bt_mesh_write_nvram_data_cb_t  write_nvram_data_cb;
          wiced_bt_mesh_status_cb_t            mesh_status_cb;
+         wiced_bt_mesh_proxy_connection_cb_t  proxy_connection_cb;
+
+         /* connection the mesh core applies proxy data to, set by HCI_CONTROL_MESH_COMMAND_CONNECTION_STATE.
+          * Read and changed under the write lock of the controller, with the command selecting it. */
+         uint16_t                             selected_conn_id;
+
+         /* NVRAM restore: one semaphore credit per chunk allowed in flight. The command status
+          * does not name its command and comes back in the order the commands were written, so
+          * the device commands are written under restore_lock, which also protects the counters.
+          * restore_other holds, for each other device command waiting for its status, the
+          * number of chunks written before it. */
+         cy_semaphore_t                       restore_credits;
+         cy_mutex_t                           restore_lock;
+         uint8_t                              restore_initialized;
+         uint8_t                              restore_window;
+         uint32_t                             restore_pushed;
+         uint32_t                             restore_acked;
+         uint32_t                             restore_other[WICED_BT_MESH_NVRAM_RESTORE_OTHER_COMMANDS];
+         uint8_t                              restore_other_head;
+         uint8_t                              restore_other_count;
+         volatile uint8_t                     restore_failed;
+         volatile uint8_t                     restore_active;
+
+         /* proxy PDU being reassembled, only used by the thread handling the mesh events */
+         uint8_t                              proxy_rx_active;
+         uint16_t                             proxy_rx_length;
+         uint8_t                              proxy_rx_buffer[WICED_BT_MESH_PROXY_REASSEMBLY_LENGTH];
 }wiced_hci_bt_mesh_context_t;
 
 /******************************************************
   *               Variable Definitions
   ******************************************************/
 
-wiced_hci_bt_mesh_context_t wh_bt_mesh_context;
+wiced_hci_bt_mesh_context_t wh_bt_mesh_context[WICED_HCI_MAX_CONTROLLERS];
 
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
 
-static void wiced_hci_mesh_cb(uint16_t event, uint8_t* payload, uint32_t len);
-
 /******************************************************
   *               Function Definitions
   ******************************************************/
 
-static void wiced_hci_mesh_cb(uint16_t event, uint8_t* payload, uint32_t len)
+void wiced_hci_mesh_proxy_data(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
 {
-    uint8_t*                     p = payload;
+    uint8_t header = 0;
 
-    switch(event)
+    WICED_INFO(("HCI_CONTROL_MESH_EVENT_PROXY_DATA\n "));
+    if ( len == 0 || wh_bt_mesh_context[controller].proxy_data_cb == NULL )
     {
-        case HCI_CONTROL_MESH_EVENT_PROVISIONING_STATUS:
-        {
-            uint32_t conn_id = 0x01;
-            uint8_t result = *p;
-            WICED_INFO(("HCI_CONTROL_MESH_EVENT_PROVISIONING_STATUS : %02X \n",result));
-            (*wh_bt_mesh_context.prov_end_cb)(conn_id, result);
-        }
-        break;
-        case HCI_CONTROL_MESH_EVENT_PROXY_DATA:
-        {
-            WICED_INFO(("HCI_CONTROL_MESH_EVENT_PROXY_DATA\n "));
-            uint32_t packet_len;
-            uint8_t *packet;
-            packet_len = len;
-            packet = (uint8_t*) malloc(len);
-            memcpy(packet, p, len);
-            (*wh_bt_mesh_context.proxy_data_cb)(packet, packet_len);
-        }
-        break;
-        case HCI_CONTROL_EVENT_DEVICE_STARTED :
-        {
+        return;
+    }
 
-            WICED_INFO(("HCI_CONTROL_EVENT_DEVICE_STARTED "));
-            cy_rtos_delay_milliseconds(1000);
-        }
-        break;
-        case HCI_CONTROL_MESH_EVENT_NVRAM_DATA:
-        {
-            uint16_t nvram_id;
-            uint8_t *packet;
-            STREAM_TO_UINT16(nvram_id, p);
-            packet = (uint8_t*) malloc(len-2);
-            memcpy(packet, p, len-2);
-            (*wh_bt_mesh_context.write_nvram_data_cb)(nvram_id, packet, len - 2);
-        }
-        break;
+    header = payload[0];
+    switch ( PROXY_SAR(header) )
+    {
+        case PROXY_SAR_COMPLETE:
+            wh_bt_mesh_context[controller].proxy_rx_active = 0;
+            (*wh_bt_mesh_context[controller].proxy_data_cb)(controller, payload, len);
+            return;
+
+        case PROXY_SAR_FIRST:
+            /* the reassembled PDU carries a complete header */
+            wh_bt_mesh_context[controller].proxy_rx_buffer[0] = PROXY_TYPE(header);
+            wh_bt_mesh_context[controller].proxy_rx_length    = 1;
+            wh_bt_mesh_context[controller].proxy_rx_active    = 1;
+            break;
 
-        case HCI_CONTROL_MESH_EVENT_MESH_STATUS :
-        {
-            uint8_t result = *p;
-            WICED_INFO(("\n Received HCI_CONTROL_MESH_EVENT_MESH_STATUS = %02X\n ", result));
-            (*wh_bt_mesh_context.mesh_status_cb)(result);
-             break;
-        }
         default:
-            WICED_INFO(("%s EVENT not handled\n", __FUNCTION__));
+            if ( !wh_bt_mesh_context[controller].proxy_rx_active ||
+                 PROXY_TYPE(header) != wh_bt_mesh_context[controller].proxy_rx_buffer[0] )
+            {
+                WICED_ERROR(("[%s] unexpected proxy segment %02x\n", __func__, header));
+                wh_bt_mesh_context[controller].proxy_rx_active = 0;
+                return;
+            }
             break;
     }
+
+    if ( wh_bt_mesh_context[controller].proxy_rx_length + len - 1 > sizeof(wh_bt_mesh_context[controller].proxy_rx_buffer) )
+    {
+        WICED_ERROR(("[%s] proxy PDU over %d bytes dropped\n", __func__, (int)sizeof(wh_bt_mesh_context[controller].proxy_rx_buffer)));
+        wh_bt_mesh_context[controller].proxy_rx_active = 0;
+        return;
+    }
+    memcpy(&wh_bt_mesh_context[controller].proxy_rx_buffer[wh_bt_mesh_context[controller].proxy_rx_length], &payload[1], len - 1);
+    wh_bt_mesh_context[controller].proxy_rx_length += len - 1;
+
+    if ( PROXY_SAR(header) == PROXY_SAR_LAST )
+    {
+        wh_bt_mesh_context[controller].proxy_rx_active = 0;
+        (*wh_bt_mesh_context[controller].proxy_data_cb)(controller, wh_bt_mesh_context[controller].proxy_rx_buffer, wh_bt_mesh_context[controller].proxy_rx_length);
+    }
+}
+
+void wiced_hci_mesh_provisioning_status(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    uint32_t conn_id = wiced_bt_mesh_proxy_selected_connection(controller);
+    uint8_t  result = 0;
+
+    if ( len == 0 )
+    {
+        return;
+    }
+    STREAM_TO_UINT8(result, payload);
+    WICED_INFO(("HCI_CONTROL_MESH_EVENT_PROVISIONING_STATUS : %02X \n",result));
+    if ( wh_bt_mesh_context[controller].prov_end_cb )
+    {
+        (*wh_bt_mesh_context[controller].prov_end_cb)(controller, conn_id, result);
+    }
 }
 
-cy_rslt_t wiced_bt_mesh_proxy_connect(uint8_t connection_state)
+void wiced_hci_mesh_provision_end(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    /* The gateway itself was provisioned: [result], no payload for success */
+    uint8_t result = WICED_BT_MESH_PROVISION_RESULT_SUCCESS;
+
+    if ( len >= 1 )
+    {
+        STREAM_TO_UINT8(result, payload);
+    }
+    WICED_INFO(("HCI_CONTROL_MESH_EVENT_CORE_PROVISION_END : %02X \n", result));
+    if ( wh_bt_mesh_context[controller].prov_end_cb )
+    {
+        (*wh_bt_mesh_context[controller].prov_end_cb)(controller, NO_CONNECTION_ID, result);
+    }
+}
+
+void wiced_hci_mesh_nvram_data(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    uint16_t nvram_id;
+
+    if (len < 2)
+    {
+        WICED_ERROR(("%s NVRAM data too short %d\n", __FUNCTION__, (int)len));
+        return;
+    }
+    STREAM_TO_UINT16(nvram_id, payload);
+    /* The data is only valid during the callback */
+    if ( wh_bt_mesh_context[controller].write_nvram_data_cb )
+    {
+        (*wh_bt_mesh_context[controller].write_nvram_data_cb)(controller, nvram_id, payload, len - 2);
+    }
+}
+
+void wiced_hci_mesh_proxy_connection_status(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    /* [connection id (2)] [connected], or [connected] for the selected connection */
+    uint16_t conn_id = wiced_bt_mesh_proxy_selected_connection(controller);
+    uint8_t  connected = 0;
+
+    if ( len >= 3 )
+    {
+        STREAM_TO_UINT16(conn_id, payload);
+    }
+    if ( len == 0 )
+    {
+        return;
+    }
+    STREAM_TO_UINT8(connected, payload);
+    WICED_INFO(("HCI_CONTROL_MESH_EVENT_PROXY_CONNECTION_STATUS id %04x connected %d\n", conn_id, connected));
+    wiced_hci_lock_writes( controller );
+    if ( !connected && conn_id == wh_bt_mesh_context[controller].selected_conn_id )
+    {
+        wh_bt_mesh_context[controller].selected_conn_id = NO_CONNECTION_ID;
+    }
+    wiced_hci_unlock_writes( controller );
+    if ( wh_bt_mesh_context[controller].proxy_connection_cb )
+    {
+        (*wh_bt_mesh_context[controller].proxy_connection_cb)(controller, conn_id, connected);
+    }
+}
+
+void wiced_hci_mesh_status(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    uint8_t result = 0;
+
+    if ( len == 0 )
+    {
+        return;
+    }
+    STREAM_TO_UINT8(result, payload);
+    WICED_INFO(("\n Received HCI_CONTROL_MESH_EVENT_MESH_STATUS = %02X\n ", result));
+    if ( wh_bt_mesh_context[controller].mesh_status_cb )
+    {
+        (*wh_bt_mesh_context[controller].mesh_status_cb)(controller, result);
+    }
+}
+
+cy_rslt_t wiced_bt_mesh_proxy_connect(wiced_hci_controller_t controller, uint8_t connection_state)
 {
     uint8_t     data[CONNECTION_STATUS_LENGTH];
     cy_rslt_t   result = CY_RSLT_SUCCESS;
 
     WICED_INFO(("proxy connect state = %d \n", connection_state));
+    wiced_hci_lock_writes( controller );
      if (connection_state)
      {
-         /*TBD : provide flexibility to pass connection id from the MCU application */
-         data[0]  = DEFAULT_CONNECTION_ID;
-         data[1]  = 0x00;
+         data[0]  = (uint8_t)WICED_BT_MESH_DEFAULT_CONNECTION_ID;
+         data[1]  = (uint8_t)(WICED_BT_MESH_DEFAULT_CONNECTION_ID >> 8);
+         wh_bt_mesh_context[controller].selected_conn_id = WICED_BT_MESH_DEFAULT_CONNECTION_ID;
      }
      else
      {
          /* for disconnection connection id should be zero */
          data[0]  = 0x00;
          data[1]  = 0x00;
+         wh_bt_mesh_context[controller].selected_conn_id = NO_CONNECTION_ID;
      }
     data[2] = 0;
-    wiced_hci_send( HCI_CONTROL_MESH_COMMAND_SEND_CONN_STATUS, data, CONNECTION_STATUS_LENGTH );
+    wiced_hci_send( controller, HCI_CONTROL_MESH_COMMAND_SEND_CONN_STATUS, data, CONNECTION_STATUS_LENGTH );
+    wiced_hci_unlock_writes( controller );
     return result;
 }
 
+cy_rslt_t wiced_bt_mesh_proxy_connection(wiced_hci_controller_t controller, uint16_t conn_id, uint8_t connection_state)
+{
+    uint8_t     data[CONNECTION_STATE_LENGTH];
+
+    WICED_INFO(("proxy connection %04x state = %d \n", conn_id, connection_state));
+
+    if ( conn_id == NO_CONNECTION_ID )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    data[0] = (uint8_t)conn_id;
+    data[1] = (uint8_t)(conn_id >> 8);
+    data[2] = 0;
+    wiced_hci_lock_writes( controller );
+    if ( connection_state )
+    {
+        wiced_hci_send( controller, HCI_CONTROL_MESH_COMMAND_SEND_CONN_STATUS, data, CONNECTION_STATUS_LENGTH );
+        wh_bt_mesh_context[controller].selected_conn_id = conn_id;
+    }
+    else
+    {
+        /* the mesh core closes the connection it is given a disconnected state for */
+        wiced_hci_send( controller, HCI_CONTROL_MESH_COMMAND_CONNECTION_STATE, data, CONNECTION_STATE_LENGTH );
+        if ( wh_bt_mesh_context[controller].selected_conn_id == conn_id )
+        {
+            wh_bt_mesh_context[controller].selected_conn_id = NO_CONNECTION_ID;
+        }
+    }
+    wiced_hci_unlock_writes( controller );
+
+    return CY_RSLT_SUCCESS;
+}
+
+uint16_t wiced_bt_mesh_proxy_selected_connection(wiced_hci_controller_t controller)
+{
+    uint16_t conn_id = NO_CONNECTION_ID;
+
+    wiced_hci_lock_writes( controller );
+    conn_id = wh_bt_mesh_context[controller].selected_conn_id;
+    wiced_hci_unlock_writes( controller );
 
-cy_rslt_t wiced_bt_mesh_send_proxy_packet(uint8_t* p_data, uint8_t data_len)
+    return conn_id;
+}
+
+cy_rslt_t wiced_bt_mesh_send_proxy_packet_to(wiced_hci_controller_t controller, uint16_t conn_id, const uint8_t* p_data, uint16_t data_len)
 {
-    uint8_t*        data  = NULL;
-    uint16_t        length  = data_len;
+    uint8_t     data[CONNECTION_STATE_LENGTH];
     cy_rslt_t   result = CY_RSLT_SUCCESS;
 
-    WICED_INFO(("[%s]\n",__func__));
-    /* allocate memory for the data */
-    data = (uint8_t*)calloc(length, sizeof(uint8_t));
-    memcpy(data,p_data,length);
-    wiced_hci_send( HCI_CONTROL_MESH_COMMAND_SEND_PROXY_DATA , data, length );
-    free(data);
+    if ( conn_id == NO_CONNECTION_ID )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    /* The mesh core applies proxy data to the connection selected last: no other selection
+     * can come between the selection and the packet */
+    wiced_hci_lock_writes( controller );
+    if ( conn_id != wh_bt_mesh_context[controller].selected_conn_id )
+    {
+        data[0] = (uint8_t)conn_id;
+        data[1] = (uint8_t)(conn_id >> 8);
+        data[2] = 1;
+        wiced_hci_send( controller, HCI_CONTROL_MESH_COMMAND_CONNECTION_STATE, data, CONNECTION_STATE_LENGTH );
+        wh_bt_mesh_context[controller].selected_conn_id = conn_id;
+    }
+    result = wiced_bt_mesh_send_proxy_packet(controller, p_data, data_len);
+    wiced_hci_unlock_writes( controller );
+
     return result;
 }
 
+void wiced_bt_mesh_register_proxy_connection_cb(wiced_hci_controller_t controller, wiced_bt_mesh_proxy_connection_cb_t proxy_connection_cb)
+{
+    wh_bt_mesh_context[controller].proxy_connection_cb = proxy_connection_cb;
+}
+
+
+cy_rslt_t wiced_bt_mesh_send_proxy_packet(wiced_hci_controller_t controller, const uint8_t* p_data, uint16_t data_len)
+{
+    uint8_t         header;
+    uint8_t         sar;
+    uint16_t        offset = 1;
+    uint16_t        length = 0;
+
+    WICED_INFO(("[%s]\n",__func__));
+
+    if ( p_data == NULL || data_len == 0 )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    if ( data_len <= WICED_BT_MESH_PROXY_SEGMENT_LENGTH )
+    {
+        wiced_hci_send_gather( controller, HCI_CONTROL_MESH_COMMAND_SEND_PROXY_DATA, NULL, 0, p_data, data_len );
+        return CY_RSLT_SUCCESS;
+    }
+
+    /* Only a complete PDU can be segmented */
+    if ( PROXY_SAR(p_data[0]) != PROXY_SAR_COMPLETE )
+    {
+        WICED_ERROR(("[%s] proxy segment of %d bytes over the MTU\n", __func__, data_len));
+        return CY_RSLT_MW_ERROR;
+    }
+
+    /* Each segment repeats the header with its SAR and carries the next part of the PDU, sent from where it is.
+     * The segments of two PDUs must not interleave: the UART is held until the last one is written. */
+    wiced_hci_lock_writes( controller );
+    sar = PROXY_SAR_FIRST;
+    while ( offset < data_len )
+    {
+        length = data_len - offset;
+        if ( length > WICED_BT_MESH_PROXY_SEGMENT_LENGTH - 1 )
+        {
+            length = WICED_BT_MESH_PROXY_SEGMENT_LENGTH - 1;
+        }
+        else
+        {
+            sar = PROXY_SAR_LAST;
+        }
+
+        header = (uint8_t)((sar << 6) | PROXY_TYPE(p_data[0]));
+        wiced_hci_send_gather( controller, HCI_CONTROL_MESH_COMMAND_SEND_PROXY_DATA, &header, 1, &p_data[offset], length );
+
+        offset += length;
+        sar = PROXY_SAR_CONTINUATION;
+    }
+    wiced_hci_unlock_writes( controller );
+
+    return CY_RSLT_SUCCESS;
+}
+
 
-cy_rslt_t wiced_bt_mesh_init( wiced_bt_mesh_provision_end_cb_t prov_end_cb,
+cy_rslt_t wiced_bt_mesh_init( wiced_hci_controller_t controller, wiced_bt_mesh_provision_end_cb_t prov_end_cb,
                                    wiced_bt_mesh_core_gatt_send_cb_t proxy_data_cb,
                                    wiced_bt_mesh_write_nvram_data_cb_t write_nvram_data_cb,
                                    wiced_bt_mesh_status_cb_t mesh_status_cb )
 {
     cy_rslt_t result = CY_RSLT_SUCCESS;
     WICED_INFO(("[%s]\n",__func__));
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
     /* Copy the callback information */
-    wh_bt_mesh_context.prov_end_cb         = prov_end_cb;
-    wh_bt_mesh_context.proxy_data_cb       = proxy_data_cb;
-    wh_bt_mesh_context.write_nvram_data_cb = write_nvram_data_cb;
-    wh_bt_mesh_context.mesh_status_cb      = mesh_status_cb;
-    /* set the event callback */
-    wiced_hci_set_event_callback( MESH, wiced_hci_mesh_cb );
-    wiced_hci_send( HCI_CONTROL_MESH_COMMAND_APP_START , NULL, 1 );
+    wh_bt_mesh_context[controller].prov_end_cb         = prov_end_cb;
+    wh_bt_mesh_context[controller].proxy_data_cb       = proxy_data_cb;
+    wh_bt_mesh_context[controller].write_nvram_data_cb = write_nvram_data_cb;
+    wh_bt_mesh_context[controller].mesh_status_cb      = mesh_status_cb;
+    wiced_hci_send( controller, HCI_CONTROL_MESH_COMMAND_APP_START , NULL, 1 );
     return result;
 }
 
-cy_rslt_t wiced_bt_mesh_reboot()
+cy_rslt_t wiced_bt_mesh_reboot(wiced_hci_controller_t controller)
 {
     cy_rslt_t result = CY_RSLT_SUCCESS;
     WICED_INFO(("[%s]\n",__func__));
-    wiced_hci_send( HCI_CONTROL_MESH_COMMAND_STACK_INIT , NULL, 1 );
+    wiced_hci_send( controller, HCI_CONTROL_MESH_COMMAND_STACK_INIT , NULL, 1 );
     return result;
 }
 
-cy_rslt_t wiced_bt_mesh_push_nvram_data(uint8_t *data_in , uint8_t data_len , uint16_t idx)
+cy_rslt_t wiced_bt_mesh_push_nvram_data(wiced_hci_controller_t controller, const uint8_t *data_in , uint16_t data_len , uint16_t idx)
 {
-    uint8_t*                data  = NULL;
-    uint8_t*                p     = NULL;
-    uint16_t                length  = 0;
-    length = data_len + 2;
-    /* allocate memory for the data */
-    data = (uint8_t*)calloc(length, sizeof(uint8_t));
-    p = data;
-    p[0] = (uint8_t)idx;
-    p[1] = (uint8_t)(idx >> 8);
-    p = p+2;
-    memcpy( p, data_in, data_len );
+    uint8_t                 header[2];
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    if ( (uint32_t)data_len + sizeof(header) > WICED_HCI_MAX_PAYLOAD_LENGTH )
+    {
+        WICED_ERROR(("[%s] nvram id %d length %d too long\n", __func__, idx, data_len));
+        return CY_RSLT_MW_ERROR;
+    }
+
+    if ( wh_bt_mesh_context[controller].restore_active )
+    {
+        if ( wh_bt_mesh_context[controller].restore_failed ||
+             cy_rtos_get_semaphore(&wh_bt_mesh_context[controller].restore_credits, WICED_BT_MESH_NVRAM_RESTORE_TIMEOUT_MS, false) != CY_RSLT_SUCCESS )
+        {
+            WICED_ERROR(("[%s] no command status for nvram data\n", __func__));
+            wh_bt_mesh_context[controller].restore_failed = 1;
+            return CY_RSLT_MW_ERROR;
+        }
+    }
+
+    /* the id and the data are sent from where they are, the chunk is counted as it is written */
+    header[0] = (uint8_t)idx;
+    header[1] = (uint8_t)(idx >> 8);
+    wiced_hci_send_gather(controller, HCI_CONTROL_COMMAND_PUSH_NVRAM_DATA, header, sizeof(header), data_in, data_len);
 
-    wiced_hci_send(HCI_CONTROL_COMMAND_PUSH_NVRAM_DATA, data, length);
-    free(data);
     return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_mesh_restore_nvram_begin(wiced_hci_controller_t controller, uint8_t window)
+{
+    uint8_t i = 0;
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS || wh_bt_mesh_context[controller].restore_active )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    /* the semaphore is kept across restores, a late command status may still release it */
+    if ( !wh_bt_mesh_context[controller].restore_initialized )
+    {
+        if ( cy_rtos_init_semaphore(&wh_bt_mesh_context[controller].restore_credits, 0xFF, 0) != CY_RSLT_SUCCESS )
+        {
+            WICED_ERROR(("[%s] semaphore init failed\n", __func__));
+            return CY_RSLT_MW_ERROR;
+        }
+        if ( cy_rtos_init_mutex(&wh_bt_mesh_context[controller].restore_lock) != CY_RSLT_SUCCESS )
+        {
+            WICED_ERROR(("[%s] mutex init failed\n", __func__));
+            cy_rtos_deinit_semaphore(&wh_bt_mesh_context[controller].restore_credits);
+            return CY_RSLT_MW_ERROR;
+        }
+        wh_bt_mesh_context[controller].restore_initialized = 1;
+    }
+    while ( cy_rtos_get_semaphore(&wh_bt_mesh_context[controller].restore_credits, 0, false) == CY_RSLT_SUCCESS )
+    {
+    }
+
+    window = window ? window : WICED_BT_MESH_NVRAM_RESTORE_WINDOW;
+    for ( i = 0; i < window; i++ )
+    {
+        cy_rtos_set_semaphore(&wh_bt_mesh_context[controller].restore_credits, false);
+    }
+
+    cy_rtos_get_mutex(&wh_bt_mesh_context[controller].restore_lock, CY_RTOS_NEVER_TIMEOUT);
+    wh_bt_mesh_context[controller].restore_window = window;
+    wh_bt_mesh_context[controller].restore_pushed = 0;
+    wh_bt_mesh_context[controller].restore_acked  = 0;
+    wh_bt_mesh_context[controller].restore_other_head  = 0;
+    wh_bt_mesh_context[controller].restore_other_count = 0;
+    wh_bt_mesh_context[controller].restore_failed = 0;
+    wh_bt_mesh_context[controller].restore_active = 1;
+    cy_rtos_set_mutex(&wh_bt_mesh_context[controller].restore_lock);
 
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_bt_mesh_restore_nvram_end(wiced_hci_controller_t controller)
+{
+    uint8_t   i      = 0;
+    cy_rslt_t result = CY_RSLT_SUCCESS;
+
+    if ( controller >= WICED_HCI_MAX_CONTROLLERS || !wh_bt_mesh_context[controller].restore_active )
+    {
+        return CY_RSLT_MW_ERROR;
+    }
+
+    /* all credits back means every chunk got its command status */
+    for ( i = 0; i < wh_bt_mesh_context[controller].restore_window; i++ )
+    {
+        if ( cy_rtos_get_semaphore(&wh_bt_mesh_context[controller].restore_credits, WICED_BT_MESH_NVRAM_RESTORE_TIMEOUT_MS, false) != CY_RSLT_SUCCESS )
+        {
+            WICED_ERROR(("[%s] %lu nvram chunks without command status\n", __func__,
+                         (unsigned long)(wh_bt_mesh_context[controller].restore_pushed - wh_bt_mesh_context[controller].restore_acked)));
+            wh_bt_mesh_context[controller].restore_failed = 1;
+            break;
+        }
+    }
+
+    cy_rtos_get_mutex(&wh_bt_mesh_context[controller].restore_lock, CY_RTOS_NEVER_TIMEOUT);
+    wh_bt_mesh_context[controller].restore_active = 0;
+    cy_rtos_set_mutex(&wh_bt_mesh_context[controller].restore_lock);
+
+    if ( wh_bt_mesh_context[controller].restore_failed )
+    {
+        result = CY_RSLT_MW_ERROR;
+    }
+
+    return result;
+}
+
+void wiced_hci_mesh_command_status(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len)
+{
+    wiced_hci_bt_mesh_context_t* context = &wh_bt_mesh_context[controller];
+    uint8_t status = HCI_CONTROL_STATUS_FAILED;
+
+    if ( payload && len )
+    {
+        STREAM_TO_UINT8(status, payload);
+    }
+#ifdef ENABLE_BT_PROTOCOL_TRACES
+    WICED_DEBUG(("HCI_CONTROL_EVENT_COMMAND_STATUS: %d\n", status));
+#endif
+
+    if ( !context->restore_initialized )
+    {
+        return;
+    }
+
+    cy_rtos_get_mutex(&context->restore_lock, CY_RTOS_NEVER_TIMEOUT);
+
+    /* The status answers the oldest command still waiting: another device command written
+     * after restore_acked chunks, else the oldest chunk */
+    if ( !context->restore_active )
+    {
+        cy_rtos_set_mutex(&context->restore_lock);
+        return;
+    }
+    if ( context->restore_other_count && context->restore_other[context->restore_other_head] == context->restore_acked )
+    {
+        context->restore_other_head = ( context->restore_other_head + 1 ) % WICED_BT_MESH_NVRAM_RESTORE_OTHER_COMMANDS;
+        context->restore_other_count--;
+        cy_rtos_set_mutex(&context->restore_lock);
+        return;
+    }
+    if ( context->restore_acked == context->restore_pushed )
+    {
+        cy_rtos_set_mutex(&context->restore_lock);
+        return;
+    }
+
+    if ( status != HCI_CONTROL_STATUS_SUCCESS )
+    {
+        WICED_ERROR(("[%s] nvram data rejected, status %d\n", __func__, status));
+        context->restore_failed = 1;
+    }
+
+    context->restore_acked++;
+    cy_rtos_set_mutex(&context->restore_lock);
+    cy_rtos_set_semaphore(&context->restore_credits, false);
+}
+
+void wiced_hci_mesh_write_device_command(wiced_hci_controller_t controller, uint16_t command, uint8_t* frame, uint16_t length)
+{
+    wiced_hci_bt_mesh_context_t* context = &wh_bt_mesh_context[controller];
+
+    if ( !context->restore_initialized )
+    {
+        cy_hci_uart_write(controller, frame, length);
+        return;
+    }
+
+    cy_rtos_get_mutex(&context->restore_lock, CY_RTOS_NEVER_TIMEOUT);
+    if ( context->restore_active )
+    {
+        if ( command == HCI_CONTROL_COMMAND_PUSH_NVRAM_DATA )
+        {
+            context->restore_pushed++;
+        }
+        else if ( DEVICE_COMMAND_HAS_STATUS(command) )
+        {
+            if ( context->restore_other_count == WICED_BT_MESH_NVRAM_RESTORE_OTHER_COMMANDS )
+            {
+                /* its status could no longer be told from the ones of the chunks */
+                WICED_ERROR(("[%s] too many device commands during the nvram restore\n", __func__));
+                context->restore_failed = 1;
+            }
+            else
+            {
+                context->restore_other[( context->restore_other_head + context->restore_other_count ) % WICED_BT_MESH_NVRAM_RESTORE_OTHER_COMMANDS] = context->restore_pushed;
+                context->restore_other_count++;
+            }
+        }
+    }
+    cy_hci_uart_write(controller, frame, length);
+    cy_rtos_set_mutex(&context->restore_lock);
 }
@@ -0,0 +1,455 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+
+/** @file
+ *
+ * WICED HCI wire capture (btsnoop) and offline replay
+ *
+ */
+
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "wiced_hci.h"
+#include "wiced_hci_capture.h"
+#include "cy_result_mw.h"
+#include "cyabs_rtos.h"
+
+#ifdef ENABLE_WICED_HCI_CAPTURE
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+#define WICED_HCI_REPLAY_MAX_PAYLOAD            (WICED_HCI_CAPTURE_SNAP_LENGTH)
+
+/* btsnoop record flags */
+#define BTSNOOP_FLAG_RECEIVED                   0x01
+#define BTSNOOP_FLAG_COMMAND_OR_EVENT           0x02
+
+/* Bits 8 to 15 of the flags, reserved by btsnoop, carry the index of the controller the frame belongs to */
+#define BTSNOOP_FLAG_CONTROLLER_SHIFT           8
+#define BTSNOOP_FLAG_CONTROLLER_MASK            0xff00
+
+/* btsnoop time stamps count microseconds from midnight, January 1st, 0 AD; this is the offset
+ * of January 1st, 1970 used by the btsnoop writers and readers */
+#define BTSNOOP_EPOCH_DELTA_US                  0x00dcddb30f2f8000ULL
+
+/* H4 packet types */
+#define H4_COMMAND_PKT                          1
+#define H4_ACL_DATA_PKT                         2
+#define H4_EVENT_PKT                            4
+
+/******************************************************
+ *                   Structures
+ ******************************************************/
+
+typedef struct
+{
+    cy_mutex_t      lock;
+    bool            lock_initialized;
+    bool            running;
+    bool            file_header_pending;
+    uint32_t        head;               /* write offset into the ring */
+    uint32_t        tail;               /* read offset into the ring */
+    uint32_t        used;               /* bytes between tail and head */
+    uint32_t        frames_captured;
+    uint32_t        frames_dropped;
+    uint32_t        frames_overwritten;
+} wiced_hci_capture_context_t;
+
+/******************************************************
+ *               Variable Definitions
+ ******************************************************/
+
+static wiced_hci_capture_context_t capture;
+static uint8_t capture_ring[WICED_HCI_CAPTURE_BUFFER_SIZE];
+
+/* Replay hands a writable copy of each event to the callbacks, as the read thread does */
+static uint8_t replay_record[BTSNOOP_RECORD_HEADER_LENGTH + WICED_HCI_REPLAY_MAX_PAYLOAD];
+static uint8_t dump_buffer[BTSNOOP_RECORD_HEADER_LENGTH + WICED_HCI_CAPTURE_SNAP_LENGTH];
+
+static const uint8_t btsnoop_file_header[BTSNOOP_FILE_HEADER_LENGTH] =
+{
+    'b', 't', 's', 'n', 'o', 'o', 'p', '\0',
+    0x00, 0x00, 0x00, 0x01,                                     /* version 1 */
+    0x00, 0x00, (BTSNOOP_DATALINK_HCI_UART >> 8) & 0xff, BTSNOOP_DATALINK_HCI_UART & 0xff
+};
+
+/******************************************************
+ *               Function Definitions
+ ******************************************************/
+
+static uint8_t* uint32_to_be_stream(uint8_t* p, uint32_t value)
+{
+    *p++ = (uint8_t)(value >> 24);
+    *p++ = (uint8_t)(value >> 16);
+    *p++ = (uint8_t)(value >> 8);
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static uint32_t be_stream_to_uint32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t be_stream_to_uint64(const uint8_t* p)
+{
+    return ((uint64_t)be_stream_to_uint32(p) << 32) | be_stream_to_uint32(p + 4);
+}
+
+static void capture_ring_write(const uint8_t* data, uint32_t length)
+{
+    uint32_t first = WICED_HCI_CAPTURE_BUFFER_SIZE - capture.head;
+
+    if (first > length)
+        first = length;
+
+    memcpy(&capture_ring[capture.head], data, first);
+    memcpy(capture_ring, data + first, length - first);
+    capture.head = (capture.head + length) % WICED_HCI_CAPTURE_BUFFER_SIZE;
+    capture.used += length;
+}
+
+static void capture_ring_peek(uint8_t* data, uint32_t offset, uint32_t length)
+{
+    uint32_t start = (capture.tail + offset) % WICED_HCI_CAPTURE_BUFFER_SIZE;
+    uint32_t first = WICED_HCI_CAPTURE_BUFFER_SIZE - start;
+
+    if (first > length)
+        first = length;
+
+    memcpy(data, &capture_ring[start], first);
+    memcpy(data + first, capture_ring, length - first);
+}
+
+static void capture_ring_consume(uint32_t length)
+{
+    capture.tail = (capture.tail + length) % WICED_HCI_CAPTURE_BUFFER_SIZE;
+    capture.used -= length;
+}
+
+/* Discard the oldest record. The included length sits at offset 4 of the record header */
+static void capture_ring_drop_oldest(void)
+{
+    uint8_t included[4];
+
+    capture_ring_peek(included, 4, sizeof(included));
+    capture_ring_consume(BTSNOOP_RECORD_HEADER_LENGTH + be_stream_to_uint32(included));
+    capture.frames_overwritten++;
+}
+
+cy_rslt_t wiced_hci_capture_start(void)
+{
+    if (!capture.lock_initialized)
+    {
+        if (cy_rtos_init_mutex(&capture.lock) != CY_RSLT_SUCCESS)
+        {
+            WICED_ERROR(("[%s] Could not create capture lock\n", __func__));
+            return CY_RSLT_MW_ERROR;
+        }
+        capture.lock_initialized = true;
+    }
+
+    cy_rtos_get_mutex(&capture.lock, CY_RTOS_NEVER_TIMEOUT);
+    capture.head = 0;
+    capture.tail = 0;
+    capture.used = 0;
+    capture.frames_captured = 0;
+    capture.frames_dropped = 0;
+    capture.frames_overwritten = 0;
+    capture.file_header_pending = true;
+    capture.running = true;
+    cy_rtos_set_mutex(&capture.lock);
+
+    WICED_INFO(("[HCI] capture started (%d bytes)\n", WICED_HCI_CAPTURE_BUFFER_SIZE));
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_hci_capture_stop(void)
+{
+    capture.running = false;
+    return CY_RSLT_SUCCESS;
+}
+
+void wiced_hci_capture_packet(wiced_hci_controller_t controller, wiced_hci_capture_direction_t direction,
+                              const uint8_t* header, uint32_t header_length,
+                              const uint8_t* payload, uint32_t payload_length)
+{
+    uint8_t    record_header[BTSNOOP_RECORD_HEADER_LENGTH];
+    uint8_t*   p = record_header;
+    uint32_t   original_length = header_length + payload_length;
+    uint32_t   included_length = original_length;
+    uint32_t   flags = ((uint32_t)controller << BTSNOOP_FLAG_CONTROLLER_SHIFT) & BTSNOOP_FLAG_CONTROLLER_MASK;
+    cy_time_t  now = 0;
+    uint64_t   timestamp;
+
+    if (!capture.running || header_length == 0)
+        return;
+
+    if (included_length > WICED_HCI_CAPTURE_SNAP_LENGTH)
+        included_length = WICED_HCI_CAPTURE_SNAP_LENGTH;
+
+    /* Never wait on the lock: a reader draining the ring must not stall the UART */
+    if (BTSNOOP_RECORD_HEADER_LENGTH + included_length > WICED_HCI_CAPTURE_BUFFER_SIZE ||
+        cy_rtos_get_mutex(&capture.lock, 0) != CY_RSLT_SUCCESS)
+    {
+        capture.frames_dropped++;
+        return;
+    }
+
+    while (WICED_HCI_CAPTURE_BUFFER_SIZE - capture.used < BTSNOOP_RECORD_HEADER_LENGTH + included_length)
+    {
+        capture_ring_drop_oldest();
+    }
+
+    if (direction == WICED_HCI_CAPTURE_RX)
+        flags |= BTSNOOP_FLAG_RECEIVED;
+    if (header[0] != H4_ACL_DATA_PKT)
+        flags |= BTSNOOP_FLAG_COMMAND_OR_EVENT;
+
+    cy_rtos_get_time(&now);
+    timestamp = BTSNOOP_EPOCH_DELTA_US + (uint64_t)now * 1000;
+
+    p = uint32_to_be_stream(p, original_length);
+    p = uint32_to_be_stream(p, included_length);
+    p = uint32_to_be_stream(p, flags);
+    p = uint32_to_be_stream(p, capture.frames_dropped);
+    p = uint32_to_be_stream(p, (uint32_t)(timestamp >> 32));
+    uint32_to_be_stream(p, (uint32_t)timestamp);
+
+    capture_ring_write(record_header, sizeof(record_header));
+    if (header_length > included_length)
+        header_length = included_length;
+    capture_ring_write(header, header_length);
+    if (payload && included_length > header_length)
+        capture_ring_write(payload, included_length - header_length);
+
+    capture.frames_captured++;
+    cy_rtos_set_mutex(&capture.lock);
+}
+
+uint32_t wiced_hci_capture_read(uint8_t* buffer, uint32_t size)
+{
+    uint32_t copied = 0;
+    uint32_t length;
+
+    if (!buffer || !capture.lock_initialized)
+        return 0;
+
+    cy_rtos_get_mutex(&capture.lock, CY_RTOS_NEVER_TIMEOUT);
+
+    if (capture.file_header_pending)
+    {
+        if (size < sizeof(btsnoop_file_header))
+        {
+            cy_rtos_set_mutex(&capture.lock);
+            return 0;
+        }
+        memcpy(buffer, btsnoop_file_header, sizeof(btsnoop_file_header));
+        copied = sizeof(btsnoop_file_header);
+        capture.file_header_pending = false;
+    }
+
+    /* Records are only handed out whole, so the reader never sees a torn frame */
+    while (capture.used >= BTSNOOP_RECORD_HEADER_LENGTH)
+    {
+        uint8_t included[4];
+
+        capture_ring_peek(included, 4, sizeof(included));
+        length = BTSNOOP_RECORD_HEADER_LENGTH + be_stream_to_uint32(included);
+        if (length > size - copied)
+            break;
+
+        capture_ring_peek(buffer + copied, 0, length);
+        capture_ring_consume(length);
+        copied += length;
+    }
+
+    cy_rtos_set_mutex(&capture.lock);
+    return copied;
+}
+
+cy_rslt_t wiced_hci_capture_dump(FILE* file)
+{
+    uint32_t length;
+
+    if (!file)
+        return CY_RSLT_MW_ERROR;
+
+    while ((length = wiced_hci_capture_read(dump_buffer, sizeof(dump_buffer))) > 0)
+    {
+        if (fwrite(dump_buffer, 1, length, file) != length)
+        {
+            WICED_ERROR(("[%s] write failed\n", __func__));
+            return CY_RSLT_MW_ERROR;
+        }
+    }
+    fflush(file);
+    return CY_RSLT_SUCCESS;
+}
+
+void wiced_hci_capture_get_stats(wiced_hci_capture_stats_t* stats)
+{
+    if (!stats)
+        return;
+
+    stats->frames_captured    = capture.frames_captured;
+    stats->frames_dropped     = capture.frames_dropped;
+    stats->frames_overwritten = capture.frames_overwritten;
+    stats->bytes_pending      = capture.used;
+}
+
+static cy_rslt_t replay_check_file_header(const uint8_t* header)
+{
+    /* Only the magic and version are checked, the datalink type depends on the tool that wrote the file */
+    if (memcmp(header, btsnoop_file_header, 12) != 0)
+    {
+        WICED_ERROR(("[%s] not a btsnoop v1 capture\n", __func__));
+        return CY_RSLT_MW_ERROR;
+    }
+    return CY_RSLT_SUCCESS;
+}
+
+/* Dispatch one record whose header sits at the start of 'record' and whose data follows it */
+static void replay_dispatch(wiced_hci_controller_t controller, uint8_t* record, wiced_hci_replay_speed_t speed,
+                            uint64_t* previous_us, wiced_hci_replay_stats_t* stats)
+{
+    uint32_t  included = be_stream_to_uint32(record + 4);
+    uint32_t  flags    = be_stream_to_uint32(record + 8);
+    uint64_t  time_us  = be_stream_to_uint64(record + 16);
+    uint8_t*  frame    = record + BTSNOOP_RECORD_HEADER_LENGTH;
+    uint16_t  opcode;
+    uint32_t  length;
+
+    if (!(flags & BTSNOOP_FLAG_RECEIVED) || included < WICED_HCI_HEADER_LENGTH || frame[0] != HCI_WICED_PKT ||
+        ((flags & BTSNOOP_FLAG_CONTROLLER_MASK) >> BTSNOOP_FLAG_CONTROLLER_SHIFT) != (uint32_t)controller)
+    {
+        stats->frames_skipped++;
+        return;
+    }
+
+    opcode = frame[1] | (frame[2] << 8);
+    length = frame[3] | (frame[4] << 8);
+
+    /* A truncated frame is replayed with the bytes that were captured */
+    if (length > included - WICED_HCI_HEADER_LENGTH)
+        length = included - WICED_HCI_HEADER_LENGTH;
+
+    if (speed == WICED_HCI_REPLAY_ORIGINAL_SPEED && *previous_us != 0 && time_us > *previous_us)
+    {
+        cy_rtos_delay_milliseconds((cy_time_t)((time_us - *previous_us) / 1000));
+    }
+    *previous_us = time_us;
+
+    wiced_hci_process_event(controller, opcode, frame + WICED_HCI_HEADER_LENGTH, length);
+    stats->frames_replayed++;
+    stats->bytes_replayed += length;
+}
+
+cy_rslt_t wiced_hci_replay(wiced_hci_controller_t controller, const uint8_t* capture_data, uint32_t length, wiced_hci_replay_speed_t speed, wiced_hci_replay_stats_t* stats)
+{
+    wiced_hci_replay_stats_t local_stats;
+    uint32_t   offset = BTSNOOP_FILE_HEADER_LENGTH;
+    uint64_t   previous_us = 0;
+    cy_time_t  start = 0;
+    cy_time_t  end = 0;
+
+    if (!stats)
+        stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+
+    if (!capture_data || length < BTSNOOP_FILE_HEADER_LENGTH || replay_check_file_header(capture_data) != CY_RSLT_SUCCESS)
+        return CY_RSLT_MW_ERROR;
+
+    cy_rtos_get_time(&start);
+    while (length - offset >= BTSNOOP_RECORD_HEADER_LENGTH)
+    {
+        uint32_t included = be_stream_to_uint32(capture_data + offset + 4);
+
+        if (included > length - offset - BTSNOOP_RECORD_HEADER_LENGTH || included > WICED_HCI_REPLAY_MAX_PAYLOAD)
+        {
+            WICED_ERROR(("[%s] malformed record at offset %u\n", __func__, (unsigned int)offset));
+            return CY_RSLT_MW_ERROR;
+        }
+
+        memcpy(replay_record, capture_data + offset, BTSNOOP_RECORD_HEADER_LENGTH + included);
+        replay_dispatch(controller, replay_record, speed, &previous_us, stats);
+        offset += BTSNOOP_RECORD_HEADER_LENGTH + included;
+    }
+    cy_rtos_get_time(&end);
+    stats->elapsed_ms = end - start;
+
+    WICED_INFO(("[HCI] replayed %u frames in %u ms\n", (unsigned int)stats->frames_replayed, (unsigned int)stats->elapsed_ms));
+    return CY_RSLT_SUCCESS;
+}
+
+cy_rslt_t wiced_hci_replay_file(wiced_hci_controller_t controller, FILE* file, wiced_hci_replay_speed_t speed, wiced_hci_replay_stats_t* stats)
+{
+    wiced_hci_replay_stats_t local_stats;
+    uint8_t    file_header[BTSNOOP_FILE_HEADER_LENGTH];
+    uint64_t   previous_us = 0;
+    cy_time_t  start = 0;
+    cy_time_t  end = 0;
+
+    if (!stats)
+        stats = &local_stats;
+    memset(stats, 0, sizeof(*stats));
+
+    if (!file || fread(file_header, 1, sizeof(file_header), file) != sizeof(file_header) ||
+        replay_check_file_header(file_header) != CY_RSLT_SUCCESS)
+        return CY_RSLT_MW_ERROR;
+
+    cy_rtos_get_time(&start);
+    while (fread(replay_record, 1, BTSNOOP_RECORD_HEADER_LENGTH, file) == BTSNOOP_RECORD_HEADER_LENGTH)
+    {
+        uint32_t included = be_stream_to_uint32(replay_record + 4);
+
+        if (included > WICED_HCI_REPLAY_MAX_PAYLOAD ||
+            fread(replay_record + BTSNOOP_RECORD_HEADER_LENGTH, 1, included, file) != included)
+        {
+            WICED_ERROR(("[%s] malformed or truncated record\n", __func__));
+            return CY_RSLT_MW_ERROR;
+        }
+        replay_dispatch(controller, replay_record, speed, &previous_us, stats);
+    }
+    cy_rtos_get_time(&end);
+    stats->elapsed_ms = end - start;
+
+    WICED_INFO(("[HCI] replayed %u frames in %u ms\n", (unsigned int)stats->frames_replayed, (unsigned int)stats->elapsed_ms));
+    return CY_RSLT_SUCCESS;
+}
+
+#endif /* ENABLE_WICED_HCI_CAPTURE */
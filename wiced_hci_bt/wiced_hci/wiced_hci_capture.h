@@ -0,0 +1,237 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+#pragma once
+
+#include <stdio.h>
+#include "cy_result_mw.h"
+#include "wiced_hci.h"
+
+/** @file
+ *
+ * WICED HCI wire capture and offline replay
+ *
+ * When ENABLE_WICED_HCI_CAPTURE is defined, every frame written to or read from the
+ * controller UART is copied into a RAM ring in btsnoop format, so it can be dumped to
+ * a file. Capturing never blocks the data path: if the ring is busy the frame is dropped
+ * and counted, and when the ring is full the oldest frames are overwritten.
+ *
+ * All controllers share the ring. Each record carries the index of its controller in
+ * bits 8 to 15 of the btsnoop flags, which btsnoop leaves reserved.
+ *
+ * The records hold the frames as they cross the UART: H4 framing with the WICED HCI
+ * packet type (0x19) followed by the WICED HCI header and payload, not standard HCI
+ * commands and events. The file header declares the H4 datalink (1002) because that is
+ * the framing in use, but only WICED HCI aware tools and wiced_hci_replay() decode the
+ * frames; generic HCI trace viewers open the file and list the frames as unknown.
+ *
+ * Time stamps count from the btsnoop epoch (midnight, January 1st, 0 AD) with the time
+ * since boot added to 1970, as the RTOS clock has no date.
+ *
+ * A capture can be fed back through the WICED HCI event dispatch with wiced_hci_replay(),
+ * either with the original inter-frame timing or as fast as possible.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/* Size of the RAM ring holding captured records (btsnoop record headers included) */
+#ifndef WICED_HCI_CAPTURE_BUFFER_SIZE
+#define WICED_HCI_CAPTURE_BUFFER_SIZE           (16 * 1024)
+#endif
+
+/* Maximum number of bytes stored per frame (WICED HCI header included), longer frames are truncated */
+#ifndef WICED_HCI_CAPTURE_SNAP_LENGTH
+#define WICED_HCI_CAPTURE_SNAP_LENGTH           (5 + WICED_HCI_MAX_RX_PAYLOAD_LENGTH)
+#endif
+
+#define BTSNOOP_FILE_HEADER_LENGTH              16
+#define BTSNOOP_RECORD_HEADER_LENGTH            24
+/* H4 framing; the packet type of every frame is HCI_WICED_PKT, see above */
+#define BTSNOOP_DATALINK_HCI_UART               1002
+
+/******************************************************
+ *                   Enumerations
+ ******************************************************/
+
+/** Direction of a captured frame */
+typedef enum
+{
+    WICED_HCI_CAPTURE_TX = 0,           /**< Host to controller */
+    WICED_HCI_CAPTURE_RX = 1,           /**< Controller to host */
+} wiced_hci_capture_direction_t;
+
+/** Replay pacing */
+typedef enum
+{
+    WICED_HCI_REPLAY_ORIGINAL_SPEED,    /**< Honour the time stamps recorded in the capture */
+    WICED_HCI_REPLAY_MAX_SPEED,         /**< Dispatch frames back to back */
+} wiced_hci_replay_speed_t;
+
+/******************************************************
+ *                    Structures
+ ******************************************************/
+
+/** Capture counters */
+typedef struct
+{
+    uint32_t    frames_captured;        /**< Frames stored in the ring since wiced_hci_capture_start() */
+    uint32_t    frames_dropped;         /**< Frames lost because the ring was locked by a reader or too small */
+    uint32_t    frames_overwritten;     /**< Old frames discarded to make room for new ones */
+    uint32_t    bytes_pending;          /**< btsnoop bytes waiting to be read out */
+} wiced_hci_capture_stats_t;
+
+/** Replay counters */
+typedef struct
+{
+    uint32_t    frames_replayed;        /**< Controller events dispatched */
+    uint32_t    frames_skipped;         /**< Host commands, non WICED HCI frames and other controllers' frames that were not dispatched */
+    uint32_t    bytes_replayed;         /**< Payload bytes handed to the event callbacks */
+    uint32_t    elapsed_ms;             /**< Wall time spent replaying */
+} wiced_hci_replay_stats_t;
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+#ifdef ENABLE_WICED_HCI_CAPTURE
+
+/**
+ * Function         wiced_hci_capture_start
+ *
+ *                  Clear the capture ring and start recording frames.
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RSLT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_hci_capture_start(void);
+
+/**
+ * Function         wiced_hci_capture_stop
+ *
+ *                  Stop recording. Frames already in the ring can still be read out.
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RSLT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_hci_capture_stop(void);
+
+/**
+ * Function         wiced_hci_capture_packet
+ *
+ *                  Record one frame. The frame may be passed as a header and a payload so that
+ *                  callers do not need to assemble it first. Called from the transport.
+ *
+ * @param[in] controller            : controller the frame was exchanged with
+ * @param[in] direction             : WICED_HCI_CAPTURE_TX or WICED_HCI_CAPTURE_RX
+ * @param[in] header                : first part of the frame, starting with the packet type
+ * @param[in] header_length         : length of the first part
+ * @param[in] payload               : second part of the frame, may be NULL
+ * @param[in] payload_length        : length of the second part
+ */
+void wiced_hci_capture_packet(wiced_hci_controller_t controller, wiced_hci_capture_direction_t direction,
+                              const uint8_t* header, uint32_t header_length,
+                              const uint8_t* payload, uint32_t payload_length);
+
+/**
+ * Function         wiced_hci_capture_read
+ *
+ *                  Move captured data out of the ring. The first read after wiced_hci_capture_start()
+ *                  returns the btsnoop file header, so concatenating all reads gives a valid btsnoop file.
+ *
+ * @param[out] buffer               : destination buffer
+ * @param[in]  size                 : size of the destination buffer
+ *
+ * @return uint32_t                 : number of bytes copied
+ */
+uint32_t wiced_hci_capture_read(uint8_t* buffer, uint32_t size);
+
+/**
+ * Function         wiced_hci_capture_dump
+ *
+ *                  Drain the ring into a file opened for binary writing.
+ *
+ * @param[in] file                  : destination file
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RSLT_MW_ERROR otherwise
+ */
+cy_rslt_t wiced_hci_capture_dump(FILE* file);
+
+/**
+ * Function         wiced_hci_capture_get_stats
+ *
+ * @param[out] stats                : capture counters
+ */
+void wiced_hci_capture_get_stats(wiced_hci_capture_stats_t* stats);
+
+/**
+ * Function         wiced_hci_replay
+ *
+ *                  Feed a btsnoop capture held in memory back through the WICED HCI event dispatch.
+ *                  Only controller to host WICED HCI frames captured from @p controller are
+ *                  dispatched; the event callbacks must be registered beforehand.
+ *
+ * @param[in]  controller           : controller whose frames are replayed, and dispatched as
+ * @param[in]  capture              : btsnoop data, starting with the file header
+ * @param[in]  length               : length of the capture
+ * @param[in]  speed                : replay pacing
+ * @param[out] stats                : replay counters, may be NULL
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RSLT_MW_ERROR if the capture is malformed
+ */
+cy_rslt_t wiced_hci_replay(wiced_hci_controller_t controller, const uint8_t* capture, uint32_t length, wiced_hci_replay_speed_t speed, wiced_hci_replay_stats_t* stats);
+
+/**
+ * Function         wiced_hci_replay_file
+ *
+ *                  Same as wiced_hci_replay() but reads the capture record by record from a file.
+ *
+ * @param[in]  controller           : controller whose frames are replayed, and dispatched as
+ * @param[in]  file                 : btsnoop file opened for binary reading
+ * @param[in]  speed                : replay pacing
+ * @param[out] stats                : replay counters, may be NULL
+ *
+ * @return cy_rslt_t                : CY_RSLT_SUCCESS - on success, CY_RSLT_MW_ERROR if the capture is malformed
+ */
+cy_rslt_t wiced_hci_replay_file(wiced_hci_controller_t controller, FILE* file, wiced_hci_replay_speed_t speed, wiced_hci_replay_stats_t* stats);
+
+#define WICED_HCI_CAPTURE( X )      wiced_hci_capture_packet X
+#else
+#define WICED_HCI_CAPTURE( X )
+#endif /* ENABLE_WICED_HCI_CAPTURE */
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2020, Cypress Semiconductor Corporation or a subsidiary of
+ * Cypress Semiconductor Corporation. All Rights Reserved.
+ *
+ * This software, including source code, documentation and related
+ * materials ("Software"), is owned by Cypress Semiconductor Corporation
+ * or one of its subsidiaries ("Cypress") and is protected by and subject to
+ * worldwide patent protection (United States and foreign),
+ * United States copyright laws and international treaty provisions.
+ * Therefore, you may use this Software only as provided in the license
+ * agreement accompanying the software package from which you
+ * obtained this Software ("EULA").
+ * If no EULA applies, Cypress hereby grants you a personal, non-exclusive,
+ * non-transferable license to copy, modify, and compile the Software
+ * source code solely for use in connection with Cypress's
+ * integrated circuit products. Any reproduction, modification, translation,
+ * compilation, or representation of this Software except as specified
+ * above is prohibited without the express written permission of Cypress.
+ *
+ * Disclaimer: THIS SOFTWARE IS PROVIDED AS-IS, WITH NO WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, NONINFRINGEMENT, IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. Cypress
+ * reserves the right to make changes to the Software without notice. Cypress
+ * does not assume any liability arising out of the application or use of the
+ * Software or any product or circuit described in the Software. Cypress does
+ * not authorize its products for use in any products where a malfunction or
+ * failure of the Cypress product may reasonably be expected to result in
+ * significant property damage, injury or death ("High Risk Product"). By
+ * including Cypress's product in a High Risk Product, the manufacturer
+ * of such system or application assumes all risk of such use and in doing
+ * so agrees to indemnify Cypress against all liability.
+ */
+#pragma once
+
+#include "wiced_hci.h"
+
+/** @file
+ *
+ * WICED HCI event registry
+ *
+ * Every event the host handles is listed once below with the function handling it.
+ * The dispatch table of wiced_hci_process_event() and the declarations of the
+ * handlers are generated from this list, so adding an event is one line here and
+ * the handler itself. An event can have a single handler; more callbacks can be
+ * added at run time with wiced_hci_subscribe_event().
+ *
+ * The table is indexed by the event code within its group, for the groups that
+ * have events, rather than by the whole 16-bit opcode: the groups are sparse
+ * (0x00 to 0x02 and 0x16) and a full table would not fit the flash budget.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************
+ *                    Constants
+ ******************************************************/
+
+/* Number of control groups in the dispatch table */
+#define WICED_HCI_GROUP_SLOTS                   ( 4 )
+
+/* Row of a control group in the dispatch table, WICED_HCI_GROUP_SLOTS for the groups without events */
+#define WICED_HCI_GROUP_SLOT( group )           ( (group) == HCI_CONTROL_GROUP_DEVICE ? 0 : \
+                                                  (group) == HCI_CONTROL_GROUP_LE     ? 1 : \
+                                                  (group) == HCI_CONTROL_GROUP_GATT   ? 2 : \
+                                                  (group) == HCI_CONTROL_GROUP_MESH   ? 3 : WICED_HCI_GROUP_SLOTS )
+
+/* Number of entries of the dispatch table */
+#define WICED_HCI_EVENT_SLOTS                   ( WICED_HCI_GROUP_SLOTS << 8 )
+
+/* Entry of an event in the dispatch table, out of the table for the groups without events */
+#define WICED_HCI_EVENT_SLOT( opcode )          ( ( WICED_HCI_GROUP_SLOT( HCI_CONTROL_GROUP( opcode ) ) << 8 ) | ( (opcode) & 0xff ) )
+
+/******************************************************
+ *                 Event Registry
+ ******************************************************/
+
+#define WICED_HCI_EVENT_REGISTRY( EVENT ) \
+    /* Device */ \
+    EVENT( HCI_CONTROL_EVENT_COMMAND_STATUS,                wiced_hci_mesh_command_status ) \
+    EVENT( HCI_CONTROL_EVENT_WICED_TRACE,                   wiced_hci_dm_trace ) \
+    EVENT( HCI_CONTROL_EVENT_DEVICE_STARTED,                wiced_hci_dm_device_started ) \
+    EVENT( HCI_CONTROL_EVENT_READ_LOCAL_BDA,                wiced_hci_dm_local_bda ) \
+    EVENT( HCI_CONTROL_EVENT_READ_BUFFER_STATS,             wiced_hci_dm_buffer_stats ) \
+    /* LE */ \
+    EVENT( HCI_CONTROL_LE_EVENT_SCAN_STATUS,                wiced_hci_dm_scan_status ) \
+    EVENT( HCI_CONTROL_LE_EVENT_ADVERTISEMENT_REPORT,       wiced_hci_ble_advertisement_report ) \
+    EVENT( HCI_CONTROL_LE_EVENT_ADVERTISEMENT_STATE,        wiced_hci_dm_advertisement_state ) \
+    EVENT( HCI_CONTROL_LE_EVENT_CONNECTED,                  wiced_hci_dm_le_connected ) \
+    EVENT( HCI_CONTROL_LE_EVENT_DISCONNECTED,               wiced_hci_dm_le_disconnected ) \
+    EVENT( HCI_CONTROL_LE_EVENT_PEER_MTU,                   wiced_hci_gatt_peer_mtu ) \
+    /* GATT */ \
+    EVENT( HCI_CONTROL_GATT_EVENT_COMMAND_STATUS,           wiced_hci_gatt_command_status ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_DISCOVERY_COMPLETE,       wiced_hci_gatt_discovery_complete ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_SERVICE_DISCOVERED,       wiced_hci_gatt_service_discovered ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_CHARACTERISTIC_DISCOVERED, wiced_hci_gatt_characteristic_discovered ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_DESCRIPTOR_DISCOVERED,    wiced_hci_gatt_descriptor_discovered ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_READ_REQUEST,             wiced_hci_gatt_attribute_request ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_READ_RESPONSE,            wiced_hci_gatt_read_response ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_WRITE_REQUEST,            wiced_hci_gatt_attribute_request ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_WRITE_RESPONSE,           wiced_hci_gatt_write_response ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_INDICATION,               wiced_hci_gatt_notification ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_NOTIFICATION,             wiced_hci_gatt_notification ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_READ_ERROR,               wiced_hci_gatt_read_error ) \
+    EVENT( HCI_CONTROL_GATT_EVENT_WRITE_ERROR,              wiced_hci_gatt_write_response ) \
+    /* Mesh */ \
+    EVENT( HCI_CONTROL_MESH_EVENT_CORE_PROVISION_END,       wiced_hci_mesh_provision_end ) \
+    EVENT( HCI_CONTROL_MESH_EVENT_NVRAM_DATA,               wiced_hci_mesh_nvram_data ) \
+    EVENT( HCI_CONTROL_MESH_EVENT_MESH_STATUS,              wiced_hci_mesh_status ) \
+    EVENT( HCI_CONTROL_MESH_EVENT_PROVISIONING_STATUS,      wiced_hci_mesh_provisioning_status ) \
+    EVENT( HCI_CONTROL_MESH_EVENT_PROXY_CONNECTION_STATUS,  wiced_hci_mesh_proxy_connection_status ) \
+    EVENT( HCI_CONTROL_MESH_EVENT_PROXY_DATA,               wiced_hci_mesh_proxy_data )
+
+/******************************************************
+ *               Function Declarations
+ ******************************************************/
+
+/* Every handler has the wiced_hci_cb signature and runs in the event worker of its group,
+ * or in the read thread when the controller has no worker (see wiced_hci_set_event_workers) */
+#define WICED_HCI_EVENT_HANDLER_DECLARATION( opcode, handler )    void handler(wiced_hci_controller_t controller, uint16_t command, uint8_t* payload, uint32_t len);
+WICED_HCI_EVENT_REGISTRY( WICED_HCI_EVENT_HANDLER_DECLARATION )
+#undef WICED_HCI_EVENT_HANDLER_DECLARATION
+
+/* Writes a command of the device group to the UART. HCI_CONTROL_EVENT_COMMAND_STATUS does not
+ * name the command it answers: the mesh NVRAM restore records the order of these commands to
+ * tell the statuses of its chunks from the others */
+void wiced_hci_mesh_write_device_command(wiced_hci_controller_t controller, uint16_t command, uint8_t* frame, uint16_t length);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
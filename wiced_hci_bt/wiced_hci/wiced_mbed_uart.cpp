@@ -35,6 +35,7 @@
 #include "cy_result_mw.h"
 #include "mbed.h"
 #include "wiced_mbed_uart.h"
+#include "wiced_hci_capture.h"
 #include "embedded_BLE_hcidriver.h"
 #include "platform/CircularBuffer.h"
 
@@ -43,23 +44,43 @@
 
 using cypress::embedded::EmbeddedHCIDriver;
 
-extern cypress::embedded::EmbeddedHCIDriver& ble_get_embedded_hci_driver();
+/* Transport and receive ring of a controller */
+struct HciUart
+{
+    EmbeddedHCIDriver* driver;
+    CircularBuffer<uint8_t, HCI_UART_BUFFER_SIZE> buffer;
+
+    /* Only written by the receive handler */
+    volatile uint32_t overflow_bytes;
+    volatile uint32_t max_level;
+};
 
-static EmbeddedHCIDriver* hci_driver;
-static CircularBuffer<uint8_t, HCI_UART_BUFFER_SIZE> hci_uart_buffer;
+static HciUart hci_uart[WICED_HCI_MAX_CONTROLLERS];
 
-void wiced_hci_serial_data_rcv_handler(uint8_t* data, uint8_t len){
+void wiced_hci_serial_data_rcv_handler(wiced_hci_controller_t controller, uint8_t* data, uint8_t len){
+    HciUart& port = hci_uart[controller];
     uint8_t pos = 0;
+    uint32_t level = 0;
     while(len)
     {
-        hci_uart_buffer.push(data[pos++]);
+        /* a full ring overwrites its oldest byte */
+        if (port.buffer.full())
+        {
+            port.overflow_bytes++;
+        }
+        port.buffer.push(data[pos++]);
         len--;
     }
+    level = port.buffer.size();
+    if (level > port.max_level)
+    {
+        port.max_level = level;
+    }
 }
 
-void mbed_os_uart_read(uint8_t* data, uint32_t* length, uint32_t timeout_ms)
+void mbed_os_uart_read(wiced_hci_controller_t controller, uint8_t* data, uint32_t* length, uint32_t timeout_ms)
 {
-    if (!data || !length)
+    if (!data || !length || controller >= WICED_HCI_MAX_CONTROLLERS)
     {
         printf("[UART] Error Reading from Wiced HCI UART - Bad parameter\n");
         return;
@@ -70,13 +91,14 @@ void mbed_os_uart_read(uint8_t* data, uint32_t* length, uint32_t timeout_ms)
         return;
     }
 
+    HciUart& port = hci_uart[controller];
     uint32_t requested_len = *length;
     int i = 0;
 
     /* not using timeout for now, will be added later  */
     (void)timeout_ms;
 
-    while(hci_uart_buffer.size() < requested_len)
+    while(port.buffer.size() < requested_len)
     {
         // busy-wait till we get the buffer filled upto the size we are looking for...
     }
@@ -84,27 +106,50 @@ void mbed_os_uart_read(uint8_t* data, uint32_t* length, uint32_t timeout_ms)
     /* wait until the requested length */
     while(requested_len){
         /* transfer it to the buffer given by user */
-        hci_uart_buffer.pop(data[i++]);
+        port.buffer.pop(data[i++]);
         requested_len--;
     }
 }
 
-void mbed_os_uart_write(uint8_t* data, uint16_t length)
+void mbed_os_uart_write(wiced_hci_controller_t controller, uint8_t* data, uint16_t length)
 {
+    WICED_HCI_CAPTURE(( controller, WICED_HCI_CAPTURE_TX, data, length, NULL, 0 ));
+
     uint8_t cmd_type = data[0];
     data++;
-    uint16_t bytes_transmitted = hci_driver->write(cmd_type, length-1, data);
+    uint16_t bytes_transmitted = hci_uart[controller].driver->write(cmd_type, length-1, data);
     (void)bytes_transmitted;
 }
 
-void mbed_os_uart_init(void)
+void mbed_os_uart_get_stats(wiced_hci_controller_t controller, uint32_t* overflow_bytes, uint32_t* max_level)
 {
-    hci_driver = &(ble_get_embedded_hci_driver());
-    hci_driver->initialize();
+    *overflow_bytes = hci_uart[controller].overflow_bytes;
+    *max_level = hci_uart[controller].max_level;
 }
 
-void mbed_os_uart_deinit(void)
+cy_rslt_t mbed_os_uart_init(wiced_hci_controller_t controller)
 {
-    hci_driver->terminate();
+    EmbeddedHCIDriver* driver = ble_get_embedded_hci_driver(controller);
+
+    if (driver == NULL)
+    {
+        printf("[UART] No HCI driver attached to controller %d\n", controller);
+        return CY_RSLT_MW_ERROR;
+    }
+
+    HciUart& port = hci_uart[controller];
+    port.overflow_bytes = 0;
+    port.max_level = 0;
+    port.buffer.reset();
+    port.driver = driver;
+    port.driver->initialize(controller);
+    return CY_RSLT_SUCCESS;
 }
 
+void mbed_os_uart_deinit(wiced_hci_controller_t controller)
+{
+    if (controller < WICED_HCI_MAX_CONTROLLERS && hci_uart[controller].driver)
+    {
+        hci_uart[controller].driver->terminate();
+    }
+}
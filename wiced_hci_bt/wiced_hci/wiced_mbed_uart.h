@@ -33,14 +33,19 @@
 
 #pragma once
 
+#include "cy_result.h"
+#include "wiced_bt_hci.h"
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
-void mbed_os_uart_write(uint8_t* data, uint16_t length);
-void mbed_os_uart_init(void);
-void mbed_os_uart_deinit(void);
-void mbed_os_uart_read(uint8_t* data, uint32_t* length, uint32_t timeout_ms);
+void mbed_os_uart_write(wiced_hci_controller_t controller, uint8_t* data, uint16_t length);
+cy_rslt_t mbed_os_uart_init(wiced_hci_controller_t controller);
+void mbed_os_uart_deinit(wiced_hci_controller_t controller);
+void mbed_os_uart_read(wiced_hci_controller_t controller, uint8_t* data, uint32_t* length, uint32_t timeout_ms);
+void mbed_os_uart_get_stats(wiced_hci_controller_t controller, uint32_t* overflow_bytes, uint32_t* max_level);
+void wiced_hci_serial_data_rcv_handler(wiced_hci_controller_t controller, uint8_t* data, uint8_t len);
 
 #ifdef __cplusplus
 }
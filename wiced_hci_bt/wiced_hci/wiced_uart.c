@@ -64,7 +64,7 @@
 /******************************************************
  *               Static Function Declarations
  ******************************************************/
-extern cy_rslt_t bt_issue_reset ( void );
+extern cy_rslt_t bt_issue_reset ( wiced_hci_controller_t controller );
 
 /******************************************************
   *               External Variable Declarations
@@ -81,26 +81,30 @@ extern cy_rslt_t bt_issue_reset ( void );
 /******************************************************
  *               Function Definitions
  ******************************************************/
-cy_rslt_t cy_hci_uart_init(void)
+cy_rslt_t cy_hci_uart_init(wiced_hci_controller_t controller)
 {
-    mbed_os_uart_init();
-    return CY_RSLT_SUCCESS;
+    return mbed_os_uart_init(controller);
 }
 
-cy_rslt_t cy_hci_uart_deinit( void )
+cy_rslt_t cy_hci_uart_deinit( wiced_hci_controller_t controller )
 {
-    mbed_os_uart_deinit();
+    mbed_os_uart_deinit(controller);
     return CY_RSLT_SUCCESS;
 }
 
-cy_rslt_t cy_hci_uart_write(uint8_t* data, uint16_t length)
+cy_rslt_t cy_hci_uart_write(wiced_hci_controller_t controller, uint8_t* data, uint16_t length)
 {
-    mbed_os_uart_write(data, length);
+    mbed_os_uart_write(controller, data, length);
     return CY_RSLT_SUCCESS;
 }
 
-cy_rslt_t cy_hci_uart_read(uint8_t* data, uint32_t* length, uint32_t timeout_ms)
+cy_rslt_t cy_hci_uart_read(wiced_hci_controller_t controller, uint8_t* data, uint32_t* length, uint32_t timeout_ms)
 {
-    mbed_os_uart_read(data, length, timeout_ms);
+    mbed_os_uart_read(controller, data, length, timeout_ms);
     return CY_RSLT_SUCCESS;
 }
+
+void cy_hci_uart_get_stats(wiced_hci_controller_t controller, cy_hci_uart_stats_t* stats)
+{
+    mbed_os_uart_get_stats(controller, &stats->overflow_bytes, &stats->max_level);
+}
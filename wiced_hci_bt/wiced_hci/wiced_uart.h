@@ -36,6 +36,7 @@
 extern "C" {
 #endif
 #include "cy_result.h"
+#include "wiced_bt_hci.h"
 
 
 
@@ -54,6 +55,13 @@ extern "C" {
  *                    Structures
  ******************************************************/
 
+/* Receive ring counters, since cy_hci_uart_init() */
+typedef struct
+{
+    uint32_t    overflow_bytes;     /* bytes lost because the ring was full */
+    uint32_t    max_level;          /* most bytes waiting in the ring */
+} cy_hci_uart_stats_t;
+
 /******************************************************
  *                 Global Variables
  ******************************************************/
@@ -61,11 +69,13 @@ extern "C" {
 /******************************************************
  *               Function Declarations
  ******************************************************/
-cy_rslt_t cy_hci_uart_init(void);
-cy_rslt_t cy_hci_uart_deinit(void);
-cy_rslt_t cy_hci_uart_reconfig(uint32_t baudrate);
-cy_rslt_t cy_hci_uart_write(uint8_t* data, uint16_t length);
-cy_rslt_t cy_hci_uart_read(uint8_t* data,  uint32_t* length, uint32_t timeout_ms);
+/* Every controller has its own UART, the functions apply to the UART of the controller given */
+cy_rslt_t cy_hci_uart_init(wiced_hci_controller_t controller);
+cy_rslt_t cy_hci_uart_deinit(wiced_hci_controller_t controller);
+cy_rslt_t cy_hci_uart_reconfig(wiced_hci_controller_t controller, uint32_t baudrate);
+cy_rslt_t cy_hci_uart_write(wiced_hci_controller_t controller, uint8_t* data, uint16_t length);
+cy_rslt_t cy_hci_uart_read(wiced_hci_controller_t controller, uint8_t* data,  uint32_t* length, uint32_t timeout_ms);
+void cy_hci_uart_get_stats(wiced_hci_controller_t controller, cy_hci_uart_stats_t* stats);
 
 #ifdef __cplusplus
 } /* extern C */